@@ -34,6 +34,8 @@ layout( location = 0 ) in vec3 aVertex;
 layout( location = 1 ) in vec3 aNormal;
 layout( location = 2 ) in vec3 aColor;
 layout( location = 3 ) in vec2 aTexCoord;
+layout( location = 4 ) in vec4 aInstanceTranslateScale;	// per-instance: xyz = where it goes, w = scale
+layout( location = 5 ) in vec4 aInstanceColor;		// per-instance
 
 
 layout ( location = 0 ) out vec3 vColor;
@@ -52,13 +54,15 @@ main( )
 	mat4 VM = V * M;
 	mat4 PVM = P * VM;
 
-//	vColor    = aColor;
+	vColor    = aInstanceColor.rgb;
 	vTexCoord = aTexCoord;
 
+	vec4 vertex = vec4( aInstanceTranslateScale.w * aVertex + aInstanceTranslateScale.xyz, 1. );
+
 	vN = normalize( mat3( Matrices.uNormalMatrix ) * aNormal );
 	                                                        // surface normal vector
 
-	vec4 ECposition = M * vec4( aVertex, 1. );
+	vec4 ECposition = M * vertex;
 	vec4 lightPos = vec4( Light.uLightPos.xyz, 1. );        // light source in fixed location
 	                                                        // because not transformed
 	vL = normalize( lightPos.xyz  -  ECposition.xyz );      // vector from the point
@@ -67,17 +71,5 @@ main( )
 	vec4 eyePos = Light.uEyePos;
 	vE = normalize( eyePos.xyz -  ECposition.xyz );          // vector from the point
 
-  int    NUMINSTANCES = 16;
-  float DELTA         =  3.0;
-
-  float xdelta = DELTA * float( gl_InstanceIndex % 4 );
-  float ydelta = DELTA * float( gl_InstanceIndex / 4 );
-  vColor = vec3( 1., float( (1.+gl_InstanceIndex) ) / float( NUMINSTANCES ), 0. );
-
-  xdelta -= DELTA * sqrt( float(NUMINSTANCES) ) / 2.;
-  ydelta -= DELTA * sqrt( float(NUMINSTANCES) ) / 2.;
-  vec4 vertex = vec4( aVertex.xyz + vec3( xdelta, ydelta, 0. ), 1. );
-
-
   gl_Position = PVM * vertex;
 }
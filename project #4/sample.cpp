@@ -61,6 +61,9 @@
 #include <signal.h>
 
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 #ifdef _WIN32
 #include <io.h>
@@ -110,9 +113,30 @@ int	fopen_s( FILE**, const char *, const char * );
 
 #define SECONDS_PER_CYCLE	3.f
 #define FRAME_LAG		2
-#define SWAPCHAINIMAGECOUNT	2
+#define SWAPCHAINIMAGECOUNT	2		// how many swapchain images to ask for, unless --images says otherwise (3 = triple buffering)
+
+// the present modes that can be asked for, with --present or by cycling with the 's' key:
+
+#define NUM_LATENCY_POLICIES	4
+
+struct latencyPolicy
+{
+	const char *		name;
+	VkPresentModeKHR	presentMode;
+} LatencyPolicies[NUM_LATENCY_POLICIES] =
+{
+	{ "mailbox",		VK_PRESENT_MODE_MAILBOX_KHR },		// no tearing, newest frame wins -- use with --images 3
+	{ "immediate",		VK_PRESENT_MODE_IMMEDIATE_KHR },	// lowest latency, may tear
+	{ "fifo",		VK_PRESENT_MODE_FIFO_KHR },		// vsync, always available
+	{ "fifo-relaxed",	VK_PRESENT_MODE_FIFO_RELAXED_KHR },	// vsync, but tears instead of waiting when late
+};
+
+#define EXAMPLE_OF_USING_DYNAMIC_STATE_VARIABLES	// the viewport and scissor are dynamic, so a resize does not need a new pipeline
 
 //#define NUM_INSTANCES		16
+#define MAX_INSTANCES		(1024*1024)	// the most instances the instance benchmark draws
+#define INSTANCE_DELTA		3.f		// distance between instances in the grid
+#define CULL_WORK_GROUP_SIZE	64		// local_size_x in sample-cull.comp
 
 // these are here to flag why addresses are being passed into a vulkan function --
 // 1. is it because the function wants to consume the contents of that tructure or array (IN)?
@@ -218,6 +242,37 @@ typedef struct MyBuffer
 } MyBuffer;
 
 
+// the per-instance vertex attributes (binding 1, VK_VERTEX_INPUT_RATE_INSTANCE):
+
+struct instance
+{
+	glm::vec4	translateScale;		// xyz = where this instance goes, w = how much to scale it
+	glm::vec4	color;
+};
+
+
+// everything the recorded command buffers depend on -- when it changes, they get recorded again:
+
+struct drawKey
+{
+	bool		useIndexBuffer;
+	bool		useCulling;
+	int		mode;
+	VkPipeline	pipeline;
+	uint32_t	numInstances;
+	uint32_t	instancesPerDraw;
+};
+
+
+// sample-cull.comp's push constants:
+
+struct cullPush
+{
+	uint32_t	numInstances;
+	float		radius;			// bounding sphere radius of one instance at scale 1.
+};
+
+
 typedef struct MyTexture
 {
 	uint32_t			width;
@@ -316,21 +371,23 @@ struct vertex
 // VULKAN-RELATED GLOBAL VARIABLES:
 // ********************************
 
-VkCommandBuffer			CommandBuffers[2];			// 2, because of double-buffering
+std::vector<VkCommandBuffer>	CommandBuffers;				// one per swapchain image
 VkPipeline			ComputePipeline;
 VkPipelineCache			ComputePipelineCache;
 VkPipelineLayout		ComputePipelineLayout;
 VkDataBuffer 			DataBuffer;
 VkImage				DepthStencilImage;
+VkDeviceMemory			DepthStencilImageMemory;
 VkImageView			DepthStencilImageView;
 VkDescriptorPool		DescriptorPool;
-VkDescriptorSetLayout		DescriptorSetLayouts[4];
-VkDescriptorSet			DescriptorSets[4];
+VkDescriptorSetLayout		DescriptorSetLayouts[5];	// 0-3 = graphics, 4 = culling
+VkDescriptorSet			DescriptorSets[5];
 VkDebugReportCallbackEXT	ErrorCallback = VK_NULL_HANDLE;
 VkEvent				Event;
 VkFence				Fence;
-VkFramebuffer			Framebuffers[2];
+std::vector<VkFramebuffer>	Framebuffers;				// one per swapchain image
 VkCommandPool			GraphicsCommandPool;
+std::vector<VkCommandBuffer>	SecondaryCommandBuffers;		// the scene's draws, one per swapchain image
 VkPipeline			GraphicsPipeline;
 VkPipelineCache			GraphicsPipelineCache;
 VkPipelineLayout		GraphicsPipelineLayout;
@@ -351,12 +408,20 @@ VkRect2D			RenderArea;
 VkRenderPass			RenderPass;
 VkSemaphore			SemaphoreImageAvailable;
 VkSemaphore			SemaphoreRenderFinished;
+VkShaderModule			ShaderModuleCull;
 VkShaderModule			ShaderModuleFragment;
 VkShaderModule			ShaderModuleVertex;
 VkBuffer			StagingBuffer;
 VkDeviceMemory			StagingBufferMemory;
 VkSurfaceKHR			Surface;
 VkSwapchainKHR			SwapChain;
+uint32_t			SwapchainImageCount;		// how many images the driver actually gave us
+uint32_t			RequestedImageCount;		// how many we ask for
+bool				FramebufferResized;		// set by GLFW -- the swapchain needs to be re-made
+int				SwapchainRecreations;
+int				LatencyPolicy;			// index into LatencyPolicies[ ] -- the present mode asked for
+bool				LatencyPolicyChanged;		// the swapchain needs to be re-made with the new present mode
+VkPresentModeKHR		PresentMode;			// the present mode actually in use
 VkCommandBuffer			TextureCommandBuffer;	// used for transfering texture from staging buffer to actual texture buffer
 VkImage				TextureImage;
 VkDeviceMemory			TextureImageMemory;
@@ -387,7 +452,32 @@ MyBuffer			MyMiscUniformBuffer;
 MyBuffer			MyVertexDataBuffer;
 MyBuffer			MyJustIndexDataBuffer;
 MyBuffer			MyJustVertexDataBuffer;
+MyBuffer			MyInstanceDataBuffer;		// NUM_INSTANCES struct instances
+void *				InstanceDataMapped;		// MyInstanceDataBuffer stays mapped
+uint32_t			InstanceDataCapacity;		// how many instances MyInstanceDataBuffer has room for
+uint32_t			InstanceDataCount;		// how many instances are in it now
+bool				InstanceBench;			// true = run the instance benchmark, then exit
+MyBuffer			MyVisibleInstanceBuffer;	// the instances that survived culling, packed together
+MyBuffer			MyIndirectBuffer;		// the VkDrawIndexedIndirectCommand the culling fills
+VkDrawIndexedIndirectCommand *	IndirectMapped;			// MyIndirectBuffer stays mapped
+float				CullRadius;			// bounding sphere radius of one instance
+uint32_t			NumVisibleInstances;		// how many survived culling last frame
+uint32_t			InstancesPerDraw;		// 0 = all of the instances in one draw
+double				RecordSeconds;			// time spent recording the secondary command buffers
+int				RecordFrames;
+bool				UseCommandCache;		// false = record every frame (--no-command-cache)
+std::vector<struct drawKey>	RecordedKeys;			// what each swapchain image's command buffers were recorded for
+std::vector<bool>		RecordedValid;
+int				CommandCacheHits;		// frames that re-submitted what was already recorded
+int				CommandCacheMisses;		// frames that had to record
 bool				NeedToExit;			// true means the program should exit
+float				FrameLimit;			// frames per second to hold to, 0 = as fast as the present mode allows
+double				NextPresentTime;		// when the frame limiter wants the next present to happen
+double				FrameWorkSeconds;		// smoothed time from sampling the input to presenting
+double				FrameSampleTime;		// when this frame sampled its input
+double				InputTime;			// when the oldest input that no frame has sampled yet arrived, < 0 = none
+double				FrameInputTime;			// the input this frame sampled, < 0 = none
+std::vector<double>		LatencySamples[NUM_LATENCY_POLICIES];	// seconds from an input callback to vkQueuePresentKHR, by the PresentMode in use
 int				NumRenders;			// how many times the render loop has been called
 bool				Paused;				// true means don't animate
 float				Scale;				// scaling factor
@@ -395,6 +485,7 @@ double				Time;
 bool				Verbose;			// true = write messages into a file
 int				Xmouse, Ymouse;			// mouse values
 float				Xrot, Yrot;			// rotation angles in degrees
+bool				UseCulling;			// true = frustum-cull the instances on the gpu and draw indirect
 bool				UseIndexBuffer;			// true = use both vertex and index buffer, false = just use vertex buffer
 bool				UseLighting;			// true = use lighting for display
 bool				UseRotate;			// true = rotate-animate, false = use mouse for interaction
@@ -432,7 +523,9 @@ VkResult			Init05DataBuffer( VkDeviceSize, VkBufferUsageFlags, OUT MyBuffer * );
 VkResult			Init05UniformBuffer( VkDeviceSize, OUT MyBuffer * );
 VkResult			Init05MyIndexDataBuffer(VkDeviceSize, OUT MyBuffer *);
 VkResult			Init05MyVertexDataBuffer( VkDeviceSize, OUT MyBuffer * );
+VkResult			Init05MyInstanceDataBuffer( uint32_t );
 VkResult			Fill05DataBuffer( IN MyBuffer, IN void * );
+VkResult			Fill05InstanceData( uint32_t );
 
 VkResult			Init06CommandPools( );
 VkResult			Init06CommandBuffers( );
@@ -443,6 +536,8 @@ VkResult			Init07TextureBuffer( INOUT MyTexture * );
 VkResult			Init07TextureBufferAndFillFromBmpFile( IN std::string, OUT MyTexture * );
 
 VkResult			Init08Swapchain( );
+VkResult			Init08SwapchainCommandBuffers( );
+VkResult			Recreate08Swapchain( );
 
 VkResult			Init09DepthStencilImage( );
 
@@ -455,6 +550,7 @@ VkResult			Init12SpirvShader( std::string, OUT VkShaderModule * );
 VkResult			Init13DescriptorSetPool( );
 VkResult			Init13DescriptorSetLayouts( );
 VkResult			Init13DescriptorSets( );
+VkResult			Init13CullDescriptorSet( );
 
 VkResult			Init14GraphicsPipelineLayout( );
 VkResult			Init14GraphicsVertexFragmentPipeline( VkShaderModule, VkShaderModule, VkPrimitiveTopology, OUT VkPipeline * );
@@ -462,6 +558,19 @@ VkResult			Init14ComputePipeline( VkShaderModule, OUT VkPipeline * );
 
 
 VkResult			RenderScene( );
+void				RecordCulling( VkCommandBuffer, uint32_t );
+void				RecordDrawBatch( VkCommandBuffer, uint32_t, uint32_t );
+void				RecordDrawBatches( uint32_t );
+void				RecordCommandBuffer( uint32_t );
+struct drawKey			CurrentDrawKey( );
+bool				SameDrawKey( IN struct drawKey, IN struct drawKey );
+void				InvalidateRecordedCommands( );
+void				InstanceBenchmark( );
+void				LimitFrameRate( );
+void				SampleInput( );
+void				NoteInput( );
+void				NotePresent( );
+void				ReportLatency( );
 void				UpdateScene( );
 //VkBool32			WarningCallback( VkDebugReportFlagsEXT, VkDebugReportObjectTypeEXT, uint64_t, size_t, int32_t, const char *, const char *, void * );
 
@@ -474,12 +583,14 @@ void				GLFWErrorCallback( int, const char * );
 void				GLFWKeyboard( GLFWwindow *, int, int, int, int );
 void				GLFWMouseButton( GLFWwindow *, int, int, int );
 void				GLFWMouseMotion( GLFWwindow *, double, double );
+void				GLFWFramebufferSize( GLFWwindow *, int, int );
 double				GLFWGetTime( );
 
 int				ReadInt( FILE * );
 short				ReadShort( FILE * );
 
 
+
 
 // *************
 // MAIN PROGRAM:
@@ -509,15 +620,59 @@ main( int argc, char * argv[ ] )
 #endif
 	fprintf(FpDebug, "FpDebug: Width = %d ; Height = %d\n", Width, Height);
 
+	InstanceBench = false;
+	InstancesPerDraw = 0;
+	UseCommandCache = true;
+	RequestedImageCount = SWAPCHAINIMAGECOUNT;
+	LatencyPolicy = 0;
+	FrameLimit = 0.;
+	for( int i = 1; i < argc; i++ )
+	{
+		if( strcmp( argv[i], "--instance-bench" ) == 0 )
+			InstanceBench = true;
+		else if( strcmp( argv[i], "--instances-per-draw" ) == 0  &&  i+1 < argc )
+			InstancesPerDraw = (uint32_t)atoi( argv[++i] );
+		else if( strcmp( argv[i], "--no-command-cache" ) == 0 )
+			UseCommandCache = false;
+		else if( strcmp( argv[i], "--images" ) == 0  &&  i+1 < argc )
+			RequestedImageCount = (uint32_t)atoi( argv[++i] );
+		else if( strcmp( argv[i], "--present" ) == 0  &&  i+1 < argc )
+		{
+			i++;
+			int p;
+			for( p = 0; p < NUM_LATENCY_POLICIES; p++ )
+			{
+				if( strcmp( argv[i], LatencyPolicies[p].name ) == 0 )
+					break;
+			}
+			if( p < NUM_LATENCY_POLICIES )
+				LatencyPolicy = p;
+			else
+				fprintf( stderr, "Unknown present mode '%s' -- use mailbox, immediate, fifo, or fifo-relaxed\n", argv[i] );
+		}
+		else if( strcmp( argv[i], "--fps" ) == 0  &&  i+1 < argc )
+			FrameLimit = (float)atof( argv[++i] );
+		else
+			fprintf( stderr, "Unknown option '%s'\n", argv[i] );
+	}
+
 	Reset( );
 	InitGraphics( );
 
+	if( InstanceBench )
+	{
+		InstanceBenchmark( );
+		NeedToExit = true;
+	}
+
 
 	// loop until the user closes the window:
 
-	while( glfwWindowShouldClose( MainWindow ) == 0 )
+	while( ! NeedToExit  &&  glfwWindowShouldClose( MainWindow ) == 0 )
 	{
+		LimitFrameRate( );		// sleeps first, so the input gets sampled as late as it can be
 		glfwPollEvents( );
+		SampleInput( );
 		Time = glfwGetTime( );		// elapsed time, in double-precision seconds
 		UpdateScene( );
 		RenderScene( );
@@ -526,6 +681,9 @@ main( int argc, char * argv[ ] )
 	}
 
 	fprintf(FpDebug, "Closing the GLFW window\n");
+	fprintf(FpDebug, "Command buffers: recorded on %d frames, re-submitted as they were on %d\n", CommandCacheMisses, CommandCacheHits);
+	fprintf(FpDebug, "Swapchain: %d images, re-made %d times\n", SwapchainImageCount, SwapchainRecreations);
+	ReportLatency( );
 
 	vkQueueWaitIdle( Queue );
 	vkDeviceWaitIdle( LogicalDevice );
@@ -573,6 +731,23 @@ InitGraphics( )
 	Init05MyIndexDataBuffer(  sizeof(JustIndexData), &MyJustIndexDataBuffer );
 	Fill05DataBuffer( MyJustIndexDataBuffer,                (void *) JustIndexData );
 
+	Init05MyInstanceDataBuffer( NUM_INSTANCES );
+	Fill05InstanceData( NUM_INSTANCES );
+
+	Init05DataBuffer( sizeof(VkDrawIndexedIndirectCommand),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &MyIndirectBuffer );
+	vkMapMemory( LogicalDevice, MyIndirectBuffer.vdm, OFFSET_ZERO, VK_WHOLE_SIZE, 0, (void **)&IndirectMapped );
+
+	// the bounding sphere of one instance, centered on the instance's origin:
+
+	CullRadius = 0.;
+	for( int i = 0; i < (int)( sizeof(VertexData) / sizeof(VertexData[0]) ); i++ )
+	{
+		float r = glm::length( VertexData[i].position );
+		if( r > CullRadius )
+			CullRadius = r;
+	}
+
 	Init06CommandPools();
 	Init06CommandBuffers();
 
@@ -580,6 +755,7 @@ InitGraphics( )
 	Init07TextureBufferAndFillFromBmpFile("puppy.bmp", &MyPuppyTexture);
 
 	Init08Swapchain( );
+	Init08SwapchainCommandBuffers( );
 
 	Init09DepthStencilImage( );
 
@@ -589,12 +765,14 @@ InitGraphics( )
 
 	Init12SpirvShader( "sample-vert.spv", &ShaderModuleVertex );
 	Init12SpirvShader( "sample-frag.spv", &ShaderModuleFragment );
+	Init12SpirvShader( "sample-cull.spv", &ShaderModuleCull );
 
 	Init13DescriptorSetPool( );
 	Init13DescriptorSetLayouts();
 	Init13DescriptorSets( );
 
 	Init14GraphicsVertexFragmentPipeline( ShaderModuleVertex, ShaderModuleFragment, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &GraphicsPipeline  );
+	Init14ComputePipeline( ShaderModuleCull, &ComputePipeline );
 }
 
 
@@ -1305,6 +1483,40 @@ Init05UniformBuffer( VkDeviceSize size, MyBuffer * pMyBuffer )
 }
 
 
+
+// **************************************
+// CREATE THE PER-INSTANCE VERTEX BUFFER:
+// **************************************
+// room for numInstances struct instances -- it stays mapped, so filling it is just writing to memory
+// the buffer that the culling packs the visible instances into gets made the same size:
+
+VkResult
+Init05MyInstanceDataBuffer( uint32_t numInstances )
+{
+	HERE_I_AM( "Init05MyInstanceDataBuffer" );
+
+	if( numInstances < 1 )
+		numInstances = 1;
+
+	// both get read as vertex buffers, and by the culling compute shader as storage buffers:
+
+	VkResult result = Init05DataBuffer( numInstances * sizeof(struct instance),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, OUT &MyInstanceDataBuffer );
+	REPORT( "Init05MyInstanceDataBuffer" );
+
+	result = Init05DataBuffer( numInstances * sizeof(struct instance),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, OUT &MyVisibleInstanceBuffer );
+	REPORT( "Init05MyInstanceDataBuffer -- visible instances" );
+
+	result = vkMapMemory( LogicalDevice, IN MyInstanceDataBuffer.vdm, OFFSET_ZERO, VK_WHOLE_SIZE, 0, OUT &InstanceDataMapped );
+	REPORT( "vkMapMemory -- instance data" );
+
+	InstanceDataCapacity = numInstances;
+	InstanceDataCount = 0;
+	return result;
+}
+
+
 // *******************
 // FILL A DATA BUFFER:
 // *******************
@@ -1329,6 +1541,67 @@ Fill05DataBuffer( IN MyBuffer myBuffer, IN void * data )
 
 
 
+// ***************************
+// FILL THE PER-INSTANCE DATA:
+// ***************************
+// lays numInstances instances out in a square grid, centered on the origin, straight into the mapped buffer
+// the buffer grows (to at least double) if it is too small
+// only call between frames -- RenderScene( ) waits for its frame to finish, so the gpu is not reading it then
+
+VkResult
+Fill05InstanceData( uint32_t numInstances )
+{
+	VkResult result = VK_SUCCESS;
+
+	if( numInstances > InstanceDataCapacity )
+	{
+		vkQueueWaitIdle( Queue );
+		vkUnmapMemory( LogicalDevice, MyInstanceDataBuffer.vdm );
+		vkDestroyBuffer( LogicalDevice, MyInstanceDataBuffer.buffer, PALLOCATOR );
+		vkFreeMemory( LogicalDevice, MyInstanceDataBuffer.vdm, PALLOCATOR );
+		vkDestroyBuffer( LogicalDevice, MyVisibleInstanceBuffer.buffer, PALLOCATOR );
+		vkFreeMemory( LogicalDevice, MyVisibleInstanceBuffer.vdm, PALLOCATOR );
+
+		uint32_t capacity = 2 * InstanceDataCapacity;
+		if( capacity < numInstances )
+			capacity = numInstances;
+		result = Init05MyInstanceDataBuffer( capacity );
+		if( result != VK_SUCCESS )
+			return result;
+
+		if( DescriptorSets[4] != VK_NULL_HANDLE )
+			Init13CullDescriptorSet( );		// it points at the old buffers
+		InvalidateRecordedCommands( );			// and so do they
+	}
+
+	uint32_t side = (uint32_t)ceil( sqrt( (double)numInstances ) );
+	float center = 0.5f * INSTANCE_DELTA * (float)( side - 1 );
+	struct instance * instances = (struct instance *)InstanceDataMapped;
+	for( uint32_t i = 0; i < numInstances; i++ )
+	{
+		float x = INSTANCE_DELTA * (float)( i % side ) - center;
+		float y = INSTANCE_DELTA * (float)( i / side ) - center;
+		instances[i].translateScale = glm::vec4( x, y, 0.f, 1.f );
+		instances[i].color = glm::vec4( 1.f, (float)( i + 1 ) / (float)numInstances, 0.f, 1.f );
+	}
+
+	// the memory might not be host-coherent:
+
+	VkMappedMemoryRange			vmmr;
+		vmmr.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		vmmr.pNext = nullptr;
+		vmmr.memory = MyInstanceDataBuffer.vdm;
+		vmmr.offset = 0;
+		vmmr.size = VK_WHOLE_SIZE;
+	result = vkFlushMappedMemoryRanges( LogicalDevice, 1, IN &vmmr );
+	REPORT( "vkFlushMappedMemoryRanges -- instance data" );
+
+	InstanceDataCount = numInstances;
+	return result;
+}
+
+
+
 
 
 // *************************
@@ -1956,7 +2229,24 @@ vsc.VkCompositeAlphaFlagsKHR         supportedCompositeAlpha;
 vsc.VkImageUsageFlags                supportedUsageFlags;
 #endif
 
+	// 0xffffffff means the surface takes its size from the swapchain -- use the window's:
+
 	VkExtent2D surfaceRes = vsc.currentExtent;
+	if( surfaceRes.width == 0xffffffff )
+	{
+		int width, height;
+		glfwGetFramebufferSize( MainWindow, &width, &height );
+		surfaceRes.width  = glm::clamp( (uint32_t)width,  vsc.minImageExtent.width,  vsc.maxImageExtent.width );
+		surfaceRes.height = glm::clamp( (uint32_t)height, vsc.minImageExtent.height, vsc.maxImageExtent.height );
+	}
+	Width  = surfaceRes.width;			// the depth image, the framebuffers, and the viewport all use these
+	Height = surfaceRes.height;
+
+	uint32_t minImageCount = RequestedImageCount;
+	if( minImageCount < vsc.minImageCount )
+		minImageCount = vsc.minImageCount;
+	if( vsc.maxImageCount != 0  &&  minImageCount > vsc.maxImageCount )	// 0 = no maximum
+		minImageCount = vsc.maxImageCount;
 	fprintf( FpDebug, "\nvkGetPhysicalDeviceSurfaceCapabilitiesKHR:\n" );
 	fprintf( FpDebug, "\tminImageCount = %d ; maxImageCount = %d\n", vsc.minImageCount, vsc.maxImageCount );
 	fprintf( FpDebug, "\tcurrentExtent = %d x %d\n", vsc.currentExtent.width, vsc.currentExtent.height );
@@ -2064,17 +2354,20 @@ VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR = 1000111001,
 	fprintf( stderr, "\n" );
 
 
-	// find the present mode we should use:
+	// find the present mode we should use -- the latency policy's, if the surface has it:
+	// (VK_PRESENT_MODE_IMMEDIATE_KHR is 0, the same as VK_NULL_HANDLE, so "found" is kept separately)
 
 	VkPresentModeKHR acceptablePresentModes[ ] =
 	{
+			LatencyPolicies[LatencyPolicy].presentMode,
 			VK_PRESENT_MODE_MAILBOX_KHR,
 			VK_PRESENT_MODE_FIFO_KHR,
 			VK_PRESENT_MODE_FIFO_RELAXED_KHR,
 			VK_PRESENT_MODE_IMMEDIATE_KHR,
 	};
 
-	VkPresentModeKHR thePresentMode = (VkPresentModeKHR) VK_NULL_HANDLE;
+	VkPresentModeKHR thePresentMode = VK_PRESENT_MODE_FIFO_KHR;	// the one that every surface has to have
+	bool found = false;
 	for( VkPresentModeKHR apm : acceptablePresentModes )
 	{
 		for( uint32_t i = 0; i < presentModeCount; i++ )
@@ -2082,14 +2375,15 @@ VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR = 1000111001,
 			if( apm == presentModes[i] )
 			{
 				thePresentMode = apm;
+				found = true;
 				break;
 			}
 		}
-		if (thePresentMode != (VkPresentModeKHR)VK_NULL_HANDLE)
+		if( found )
 			break;
 	}
 
-	if( thePresentMode == (VkPresentModeKHR) VK_NULL_HANDLE )
+	if( ! found )
 	{
 		fprintf( FpDebug, "Couldn't find an acceptable Present Mode!\n" );
 	}
@@ -2097,6 +2391,9 @@ VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR = 1000111001,
 	{
 		fprintf( FpDebug, "The Present Mode to use = %d\n", thePresentMode );
 	}
+	if( thePresentMode != LatencyPolicies[LatencyPolicy].presentMode )
+		fprintf( FpDebug, "The surface does not have the '%s' present mode -- using %d instead\n", LatencyPolicies[LatencyPolicy].name, thePresentMode );
+	PresentMode = thePresentMode;
 
 	delete [ ] presentModes;
 
@@ -2111,7 +2408,7 @@ surfaceRes.height;
 		vscci.pNext = nullptr;
 		vscci.flags = 0;
 		vscci.surface = Surface;
-		vscci.minImageCount = 2;			// double buffering
+		vscci.minImageCount = minImageCount;		// 2 = double buffering, 3 = triple buffering (use with mailbox)
 		//vscci.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
 		vscci.imageFormat = VK_FORMAT_B8G8R8A8_SRGB;
 		vscci.imageColorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
@@ -2126,30 +2423,30 @@ surfaceRes.height;
 		vscci.pQueueFamilyIndices = (const uint32_t *)nullptr;
 		//vscci.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
 		vscci.presentMode = thePresentMode;
-		vscci.oldSwapchain = VK_NULL_HANDLE;	// we're not replacing an old swapchain
+		vscci.oldSwapchain = SwapChain;		// VK_NULL_HANDLE the first time, the one being replaced after that
 		vscci.clipped = VK_TRUE;
 
+	VkSwapchainKHR oldSwapchain = SwapChain;
 	result = vkCreateSwapchainKHR( LogicalDevice, IN &vscci, PALLOCATOR, OUT &SwapChain );
 	REPORT( "vkCreateSwapchainKHR" );
+	if( oldSwapchain != VK_NULL_HANDLE )
+		vkDestroySwapchainKHR( LogicalDevice, oldSwapchain, PALLOCATOR );	// the device is idle, so nothing is using it
 
 
 	uint32_t imageCount;
 	result = vkGetSwapchainImagesKHR( LogicalDevice, IN SwapChain, OUT &imageCount, (VkImage *)nullptr );	// 0
 	REPORT( "vkGetSwapchainImagesKHR - 0" );
-	if( imageCount != 2 )
-	{
-		fprintf( FpDebug, "imageCount return from vkGetSwapchainImages = %d; should have been 2\n", imageCount );
-		return result;
-	}
+	fprintf( FpDebug, "Swapchain: asked for %d images, got %d, %d x %d\n", minImageCount, imageCount, Width, Height );
+	SwapchainImageCount = imageCount;		// the driver may give us more than we asked for
 
 	PresentImages = new VkImage[ imageCount ];
 	result = vkGetSwapchainImagesKHR( LogicalDevice, SwapChain, OUT &imageCount, PresentImages );	// 0
 	REPORT( "vkGetSwapchainImagesKHR - 1" );
 
 
-	// present views for the double-buffering:
+	// present views, one per swapchain image:
 
-	PresentImageViews = new VkImageView[ imageCount ];	// better be 2
+	PresentImageViews = new VkImageView[ imageCount ];
 	for( unsigned int i = 0; i < imageCount; i++ )
 	{
 		VkImageViewCreateInfo		vivci;
@@ -2179,6 +2476,111 @@ surfaceRes.height;
 
 
 
+// ******************************************************
+// ALLOCATE THE COMMAND BUFFERS FOR EACH SWAPCHAIN IMAGE:
+// ******************************************************
+// a primary and a secondary, both from GraphicsCommandPool
+// does nothing if there are already the right number -- otherwise frees the old ones first
+
+VkResult
+Init08SwapchainCommandBuffers( )
+{
+	HERE_I_AM( "Init08SwapchainCommandBuffers" );
+
+	VkResult result = VK_SUCCESS;
+
+	if( CommandBuffers.size( ) == SwapchainImageCount )
+		return result;
+
+	if( ! CommandBuffers.empty( ) )
+	{
+		vkFreeCommandBuffers( LogicalDevice, GraphicsCommandPool, (uint32_t)CommandBuffers.size( ), CommandBuffers.data( ) );
+		vkFreeCommandBuffers( LogicalDevice, GraphicsCommandPool, (uint32_t)SecondaryCommandBuffers.size( ), SecondaryCommandBuffers.data( ) );
+	}
+
+	CommandBuffers.resize( SwapchainImageCount );
+	{
+		VkCommandBufferAllocateInfo			vcbai;
+			vcbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			vcbai.pNext = nullptr;
+			vcbai.commandPool = GraphicsCommandPool;
+			vcbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			vcbai.commandBufferCount = SwapchainImageCount;
+
+		result = vkAllocateCommandBuffers( LogicalDevice, IN &vcbai, OUT CommandBuffers.data( ) );
+		REPORT( "vkAllocateCommandBuffers -- Primary" );
+	}
+
+	SecondaryCommandBuffers.resize( SwapchainImageCount );
+	{
+		VkCommandBufferAllocateInfo			vcbai;
+			vcbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			vcbai.pNext = nullptr;
+			vcbai.commandPool = GraphicsCommandPool;
+			vcbai.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			vcbai.commandBufferCount = SwapchainImageCount;
+
+		result = vkAllocateCommandBuffers( LogicalDevice, IN &vcbai, OUT SecondaryCommandBuffers.data( ) );
+		REPORT( "vkAllocateCommandBuffers -- Secondary" );
+	}
+
+	RecordedKeys.assign( SwapchainImageCount, drawKey( ) );
+	RecordedValid.assign( SwapchainImageCount, false );
+	return result;
+}
+
+
+
+// ******************************************************************
+// RE-MAKE THE SWAPCHAIN AND EVERYTHING SIZED BY IT (AFTER A RESIZE):
+// ******************************************************************
+// the new swapchain is created with the old one as its oldSwapchain, then the depth image,
+// the framebuffers, and (if the image count changed) the per-image command buffers are re-made
+
+VkResult
+Recreate08Swapchain( )
+{
+	HERE_I_AM( "Recreate08Swapchain" );
+
+	// a minimized window has a 0 x 0 framebuffer -- wait until it is back:
+
+	int width = 0, height = 0;
+	glfwGetFramebufferSize( MainWindow, &width, &height );
+	while( ( width == 0  ||  height == 0 )  &&  ! glfwWindowShouldClose( MainWindow ) )
+	{
+		glfwWaitEvents( );
+		glfwGetFramebufferSize( MainWindow, &width, &height );
+	}
+
+	vkDeviceWaitIdle( LogicalDevice );
+
+	for( size_t i = 0; i < Framebuffers.size( ); i++ )
+		vkDestroyFramebuffer( LogicalDevice, Framebuffers[i], PALLOCATOR );
+	Framebuffers.clear( );
+
+	vkDestroyImageView( LogicalDevice, DepthStencilImageView, PALLOCATOR );
+	vkDestroyImage( LogicalDevice, DepthStencilImage, PALLOCATOR );
+	vkFreeMemory( LogicalDevice, DepthStencilImageMemory, PALLOCATOR );
+
+	for( uint32_t i = 0; i < SwapchainImageCount; i++ )
+		vkDestroyImageView( LogicalDevice, PresentImageViews[i], PALLOCATOR );
+	delete [ ] PresentImageViews;
+	delete [ ] PresentImages;			// these belong to the swapchain -- only the array is ours
+
+	VkResult result = Init08Swapchain( );
+	REPORT( "Init08Swapchain -- re-made" );
+	Init08SwapchainCommandBuffers( );
+	Init09DepthStencilImage( );
+	Init11Framebuffers( );
+
+	InvalidateRecordedCommands( );		// they hold the old framebuffers and the old viewport size
+	SwapchainRecreations++;
+	fprintf( FpDebug, "Swapchain re-made: %d x %d, %d images\n", Width, Height, SwapchainImageCount );
+	return result;
+}
+
+
+
 // *************************************
 // CREATING THE DEPTH AND STENCIL IMAGE:
 // *************************************
@@ -2221,11 +2623,10 @@ Init09DepthStencilImage( )
 		vmai.allocationSize = vmr.size;
 		vmai.memoryTypeIndex = FindMemoryThatIsDeviceLocal( vmr.memoryTypeBits );
 
-	VkDeviceMemory imageMemory;
-	result = vkAllocateMemory( LogicalDevice, IN &vmai, PALLOCATOR, OUT &imageMemory );
+	result = vkAllocateMemory( LogicalDevice, IN &vmai, PALLOCATOR, OUT &DepthStencilImageMemory );
 	REPORT( "vkAllocateMemory" );
 
-	result = vkBindImageMemory( LogicalDevice, DepthStencilImage, imageMemory, OFFSET_ZERO );
+	result = vkBindImageMemory( LogicalDevice, DepthStencilImage, DepthStencilImageMemory, OFFSET_ZERO );
 	REPORT( "vkBindImageMemory" );
 
 	VkImageViewCreateInfo			vivci;
@@ -2350,15 +2751,16 @@ Init11Framebuffers( )
 		vfbci.height = Height;
 		vfbci.layers = 1;
 
-	frameBufferAttachments[0] = PresentImageViews[0];
-	frameBufferAttachments[1] = DepthStencilImageView;
-	result = vkCreateFramebuffer( LogicalDevice, IN &vfbci, PALLOCATOR, OUT &Framebuffers[0] );
-	REPORT( "vkCreateFrameBuffer - 0" );
+	// one per swapchain image, all sharing the one depth image:
 
-	frameBufferAttachments[0] = PresentImageViews[1];
-	frameBufferAttachments[1] = DepthStencilImageView;
-	result = vkCreateFramebuffer( LogicalDevice, IN &vfbci, PALLOCATOR, OUT &Framebuffers[1] );
-	REPORT( "vkCreateFrameBuffer - 1" );
+	Framebuffers.resize( SwapchainImageCount );
+	for( uint32_t i = 0; i < SwapchainImageCount; i++ )
+	{
+		frameBufferAttachments[0] = PresentImageViews[i];
+		frameBufferAttachments[1] = DepthStencilImageView;
+		result = vkCreateFramebuffer( LogicalDevice, IN &vfbci, PALLOCATOR, OUT &Framebuffers[i] );
+		REPORT( "vkCreateFrameBuffer" );
+	}
 
 	return result;
 }
@@ -2418,19 +2820,8 @@ Init06CommandBuffers( )
 
 	VkResult result = VK_SUCCESS;
 
-	// allocate 2 command buffers for the double-buffered rendering:
-
-	{
-		VkCommandBufferAllocateInfo			vcbai;
-			vcbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-			vcbai.pNext = nullptr;
-			vcbai.commandPool = GraphicsCommandPool;
-			vcbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-			vcbai.commandBufferCount = 2;		// 2, because of double-buffering
-
-		result = vkAllocateCommandBuffers( LogicalDevice, IN &vcbai, OUT &CommandBuffers[0] );
-		REPORT( "vkAllocateCommandBuffers - 1" );
-	}
+	// the rendering's command buffers, one per swapchain image, get allocated in Init08SwapchainCommandBuffers( )
+	// once it is known how many images there are
 
 
 	// allocate 1 command buffer for the transfering pixels from a staging buffer to a texture buffer:
@@ -2511,15 +2902,17 @@ Init13DescriptorSetPool()
 
 	VkResult result = VK_SUCCESS;
 
-	VkDescriptorPoolSize				vdps[4];
+	VkDescriptorPoolSize				vdps[5];
 		vdps[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		vdps[0].descriptorCount = 1;
 		vdps[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		vdps[1].descriptorCount = 1;
 		vdps[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		vdps[2].descriptorCount = 1;
+		vdps[2].descriptorCount = 2;		// the culling set reads the matrices too
 		vdps[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		vdps[3].descriptorCount = 1;
+		vdps[4].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		vdps[4].descriptorCount = 3;		// all instances, visible instances, indirect command
 #ifdef CHOICES
 VkDescriptorType:
 VK_DESCRIPTOR_TYPE_SAMPLER
@@ -2543,8 +2936,8 @@ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
 0
 VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
 #endif
-		vdpci.maxSets = 4;
-		vdpci.poolSizeCount = 4;
+		vdpci.maxSets = 5;
+		vdpci.poolSizeCount = 5;
 		vdpci.pPoolSizes = &vdps[0];
 
 	result = vkCreateDescriptorPool(LogicalDevice, IN &vdpci, PALLOCATOR, OUT &DescriptorPool);
@@ -2631,6 +3024,32 @@ Init13DescriptorSetLayouts( )
 		TexSamplerSet[0].stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;
 		TexSamplerSet[0].pImmutableSamplers = (VkSampler *)nullptr;
 
+	// DS #4 (the culling compute shader's set 0):
+	VkDescriptorSetLayoutBinding		CullSet[4];
+		CullSet[0].binding            = 0;		// the matrices
+		CullSet[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		CullSet[0].descriptorCount    = 1;
+		CullSet[0].stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+		CullSet[0].pImmutableSamplers = (VkSampler *)nullptr;
+
+		CullSet[1].binding            = 1;		// all of the instances
+		CullSet[1].descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		CullSet[1].descriptorCount    = 1;
+		CullSet[1].stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+		CullSet[1].pImmutableSamplers = (VkSampler *)nullptr;
+
+		CullSet[2].binding            = 2;		// the visible instances
+		CullSet[2].descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		CullSet[2].descriptorCount    = 1;
+		CullSet[2].stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+		CullSet[2].pImmutableSamplers = (VkSampler *)nullptr;
+
+		CullSet[3].binding            = 3;		// the indirect draw command
+		CullSet[3].descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		CullSet[3].descriptorCount    = 1;
+		CullSet[3].stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+		CullSet[3].pImmutableSamplers = (VkSampler *)nullptr;
+
 #ifdef CHOICES
 VkDescriptorType:
 VK_DESCRIPTOR_TYPE_SAMPLER
@@ -2674,6 +3093,13 @@ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
 		vdslc3.bindingCount = 1;
 		vdslc3.pBindings = &TexSamplerSet[0];
 
+	VkDescriptorSetLayoutCreateInfo			vdslc4;
+		vdslc4.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		vdslc4.pNext = nullptr;
+		vdslc4.flags = 0;
+		vdslc4.bindingCount = 4;
+		vdslc4.pBindings = &CullSet[0];
+
 	result = vkCreateDescriptorSetLayout( LogicalDevice, &vdslc0, PALLOCATOR, OUT &DescriptorSetLayouts[0] );
 	REPORT( "vkCreateDescriptorSetLayout - 0" );
 
@@ -2686,6 +3112,9 @@ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
 	result = vkCreateDescriptorSetLayout( LogicalDevice, &vdslc3, PALLOCATOR, OUT &DescriptorSetLayouts[3] );
 	REPORT( "vkCreateDescriptorSetLayout - 3" );
 
+	result = vkCreateDescriptorSetLayout( LogicalDevice, &vdslc4, PALLOCATOR, OUT &DescriptorSetLayouts[4] );
+	REPORT( "vkCreateDescriptorSetLayout - 4" );
+
 	return result;
 }
 
@@ -2707,7 +3136,7 @@ Init13DescriptorSets( )
 		vdsai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 		vdsai.pNext = nullptr;
 		vdsai.descriptorPool = DescriptorPool;
-		vdsai.descriptorSetCount = 4;
+		vdsai.descriptorSetCount = 5;
 		vdsai.pSetLayouts = DescriptorSetLayouts;
 
 
@@ -2795,6 +3224,49 @@ Init13DescriptorSets( )
 	vkUpdateDescriptorSets( LogicalDevice, 1, IN &vwds2, IN copyCount, (VkCopyDescriptorSet *)nullptr );
 	vkUpdateDescriptorSets( LogicalDevice, 1, IN &vwds3, IN copyCount, (VkCopyDescriptorSet *)nullptr );
 
+	return Init13CullDescriptorSet( );
+}
+
+
+
+// ***************************************
+// WRITE THE CULLING SHADER'S DESCRIPTORS:
+// ***************************************
+// called again whenever the instance buffers get re-made
+
+VkResult
+Init13CullDescriptorSet( )
+{
+	VkDescriptorBufferInfo				vdbi[4];
+		vdbi[0].buffer = MyMatrixUniformBuffer.buffer;
+		vdbi[0].offset = 0;
+		vdbi[0].range = sizeof(Matrices);
+		vdbi[1].buffer = MyInstanceDataBuffer.buffer;
+		vdbi[1].offset = 0;
+		vdbi[1].range = VK_WHOLE_SIZE;
+		vdbi[2].buffer = MyVisibleInstanceBuffer.buffer;
+		vdbi[2].offset = 0;
+		vdbi[2].range = VK_WHOLE_SIZE;
+		vdbi[3].buffer = MyIndirectBuffer.buffer;
+		vdbi[3].offset = 0;
+		vdbi[3].range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet				vwds[4];
+	for( int i = 0; i < 4; i++ )
+	{
+		vwds[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		vwds[i].pNext = nullptr;
+		vwds[i].dstSet = DescriptorSets[4];
+		vwds[i].dstBinding = i;
+		vwds[i].dstArrayElement = 0;
+		vwds[i].descriptorCount = 1;
+		vwds[i].descriptorType = ( i == 0 ) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		vwds[i].pBufferInfo = &vdbi[i];
+		vwds[i].pImageInfo = (VkDescriptorImageInfo *)nullptr;
+		vwds[i].pTexelBufferView = (VkBufferView *)nullptr;
+	}
+
+	vkUpdateDescriptorSets( LogicalDevice, 4, IN vwds, 0, (VkCopyDescriptorSet *)nullptr );
 	return VK_SUCCESS;
 }
 
@@ -2923,10 +3395,14 @@ VK_SHADER_STAGE_ALL
 		vpssci[1].pName = "main";
 		vpssci[1].pSpecializationInfo = (VkSpecializationInfo *)nullptr;
 
-	VkVertexInputBindingDescription			vvibd[1];	// an array containing one of these per buffer being used
+	VkVertexInputBindingDescription			vvibd[2];	// an array containing one of these per buffer being used
 		vvibd[0].binding = 0;		// which binding # this is
 		vvibd[0].stride = sizeof( struct vertex );		// bytes between successive
 		vvibd[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		vvibd[1].binding = 1;		// the per-instance data
+		vvibd[1].stride = sizeof( struct instance );
+		vvibd[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;	// advances once per instance, not once per vertex
 #ifdef CHOICES
 VK_VERTEX_INPUT_RATE_VERTEX
 VK_VERTEX_INPUT_RATE_INSTANCE
@@ -2941,8 +3417,8 @@ struct vertex
 	glm::vec2	texCoord;
 } Vertices;
 #endif
-	VkVertexInputAttributeDescription		vviad[4];		// an array containing one of these per vertex attribute in all bindings
-		// 4 = vertex, normal, color, texture coord
+	VkVertexInputAttributeDescription		vviad[6];		// an array containing one of these per vertex attribute in all bindings
+		// 6 = vertex, normal, color, texture coord, instance translate+scale, instance color
 		vviad[0].location = 0;			// location in the layout decoration
 		vviad[0].binding = 0;			// which binding description this is part of
 		vviad[0].format = VK_FORMAT_VEC3;	// x, y, z
@@ -2976,14 +3452,23 @@ VK_FORMAT_X = VK_FORMAT_R32_SFLOAT
 		vviad[3].format = VK_FORMAT_VEC2;	// s, t
 		vviad[3].offset = offsetof( struct vertex, texCoord );			// 36
 
+		vviad[4].location = 4;
+		vviad[4].binding = 1;
+		vviad[4].format = VK_FORMAT_VEC4;	// x, y, z, scale
+		vviad[4].offset = offsetof( struct instance, translateScale );		// 0
+
+		vviad[5].location = 5;
+		vviad[5].binding = 1;
+		vviad[5].format = VK_FORMAT_VEC4;	// r, g, b, a
+		vviad[5].offset = offsetof( struct instance, color );			// 16
 
 	VkPipelineVertexInputStateCreateInfo			vpvisci;			// used to describe the input vertex attributes
 		vpvisci.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		vpvisci.pNext = nullptr;
 		vpvisci.flags = 0;
-		vpvisci.vertexBindingDescriptionCount = 1;
+		vpvisci.vertexBindingDescriptionCount = 2;
 		vpvisci.pVertexBindingDescriptions = vvibd;
-		vpvisci.vertexAttributeDescriptionCount = 4;
+		vpvisci.vertexAttributeDescriptionCount = 6;
 		vpvisci.pVertexAttributeDescriptions = vviad;
 
 	VkPipelineInputAssemblyStateCreateInfo			vpiasci;
@@ -3236,8 +3721,7 @@ VK_PIPELINE_CREATE_DERIVATIVE_BIT
 		vgpci.pMultisampleState = &vpmsci;
 		vgpci.pDepthStencilState = &vpdssci;
 		vgpci.pColorBlendState = &vpcbsci;
-		vgpci.pDynamicState = (VkPipelineDynamicStateCreateInfo *) nullptr;
-		//vgpci.pDynamicState = &vpdsci;
+		vgpci.pDynamicState = &vpdsci;		// viewport and scissor, so a resized swapchain needs no new pipeline
 		vgpci.layout = IN GraphicsPipelineLayout;
 		vgpci.renderPass = IN RenderPass;
 		vgpci.subpass = 0;				// subpass number
@@ -3275,14 +3759,21 @@ Init14ComputePipeline( VkShaderModule computeShader, OUT VkPipeline * pComputePi
 		vpssci.pName = "main";
 		vpssci.pSpecializationInfo = (VkSpecializationInfo *)nullptr;
 
+	// the culling shader's one set is DS #4, and it gets the instance count and radius as push constants:
+
+	VkPushConstantRange					vpcr;
+		vpcr.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		vpcr.offset = 0;
+		vpcr.size = sizeof(struct cullPush);
+
 	VkPipelineLayoutCreateInfo				vplci;
 		vplci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		vplci.pNext = nullptr;
 		vplci.flags = 0;
 		vplci.setLayoutCount = 1;
-		vplci.pSetLayouts = DescriptorSetLayouts;
-		vplci.pushConstantRangeCount = 0;
-		vplci.pPushConstantRanges = (VkPushConstantRange *)nullptr;
+		vplci.pSetLayouts = &DescriptorSetLayouts[4];
+		vplci.pushConstantRangeCount = 1;
+		vplci.pPushConstantRanges = &vpcr;
 
 	result = vkCreatePipelineLayout( LogicalDevice, IN &vplci, PALLOCATOR, OUT &ComputePipelineLayout );
 	REPORT( "vkCreatePipelineLayout" );
@@ -3333,7 +3824,7 @@ InitFence( )
 		vsi.pWaitSemaphores = (VkSemaphore *)nullptr;			// ??????
 		vsi.pWaitDstStageMask = (VkPipelineStageFlags *)nullptr;	// ?????
 		vsi.commandBufferCount = 1;
-		vsi.pCommandBuffers = CommandBuffers;
+		vsi.pCommandBuffers = CommandBuffers.data( );
 		vsi.signalSemaphoreCount = 0;					// ?????
 		vsi.pSignalSemaphores = (VkSemaphore *)nullptr;			// ?????
 
@@ -3632,7 +4123,7 @@ DestroyAllVulkan( )
 
 	//destroy the swap chain imageViews
 #ifdef TREVOR
-	for(uint32_t i = 0; i < SWAPCHAINIMAGECOUNT; i++)
+	for(uint32_t i = 0; i < SwapchainImageCount; i++)
 		vkDestroyImageView(LogicalDevice, PresentImageViews[i], PALLOCATOR);
 	delete[] PresentImageViews;
 	vkDestroySwapchainKHR(LogicalDevice, SwapChain, PALLOCATOR);
@@ -3646,7 +4137,8 @@ DestroyAllVulkan( )
 	// The source code is not using the global semaphore variables
 	//vkDestroySemaphore(LogicalDevice, SemaphoreImageAvailable, PALLOCATOR);
 
-	vkFreeCommandBuffers(LogicalDevice, GraphicsCommandPool, sizeof(CommandBuffers) / sizeof(CommandBuffers[0]), CommandBuffers);
+	vkFreeCommandBuffers(LogicalDevice, GraphicsCommandPool, (uint32_t)CommandBuffers.size(), CommandBuffers.data());
+	vkFreeCommandBuffers(LogicalDevice, GraphicsCommandPool, (uint32_t)SecondaryCommandBuffers.size(), SecondaryCommandBuffers.data());
 	vkFreeCommandBuffers(LogicalDevice, TransferCommandPool, 1, &TextureCommandBuffer);
 
 	vkDestroyRenderPass(LogicalDevice, RenderPass, PALLOCATOR);
@@ -3656,6 +4148,7 @@ DestroyAllVulkan( )
 
 	vkDestroyShaderModule(LogicalDevice, ShaderModuleVertex, PALLOCATOR);
 	vkDestroyShaderModule(LogicalDevice, ShaderModuleFragment, PALLOCATOR);
+	vkDestroyShaderModule(LogicalDevice, ShaderModuleCull, PALLOCATOR);
 
 	//destory depth/stencil
 	vkDestroyImageView(LogicalDevice, DepthStencilImageView, PALLOCATOR);
@@ -3672,13 +4165,23 @@ DestroyAllVulkan( )
 	vkFreeMemory(LogicalDevice, MyPuppyTexture.textureMemory, PALLOCATOR);
 
 	vkDestroyPipeline(LogicalDevice, GraphicsPipeline, PALLOCATOR);
+	vkDestroyPipeline(LogicalDevice, ComputePipeline, PALLOCATOR);
 
 	vkDestroyPipelineLayout(LogicalDevice, GraphicsPipelineLayout, PALLOCATOR);
+	vkDestroyPipelineLayout(LogicalDevice, ComputePipelineLayout, PALLOCATOR);
 	for(auto descriptorSetLayout: DescriptorSetLayouts)
 		vkDestroyDescriptorSetLayout(LogicalDevice, descriptorSetLayout, PALLOCATOR);
 
 	vkDestroyBuffer(LogicalDevice, MyVertexDataBuffer.buffer, PALLOCATOR);
 	vkFreeMemory(LogicalDevice, MyVertexDataBuffer.vdm, PALLOCATOR);
+	vkUnmapMemory(LogicalDevice, MyInstanceDataBuffer.vdm);
+	vkDestroyBuffer(LogicalDevice, MyInstanceDataBuffer.buffer, PALLOCATOR);
+	vkFreeMemory(LogicalDevice, MyInstanceDataBuffer.vdm, PALLOCATOR);
+	vkDestroyBuffer(LogicalDevice, MyVisibleInstanceBuffer.buffer, PALLOCATOR);
+	vkFreeMemory(LogicalDevice, MyVisibleInstanceBuffer.vdm, PALLOCATOR);
+	vkUnmapMemory(LogicalDevice, MyIndirectBuffer.vdm);
+	vkDestroyBuffer(LogicalDevice, MyIndirectBuffer.buffer, PALLOCATOR);
+	vkFreeMemory(LogicalDevice, MyIndirectBuffer.vdm, PALLOCATOR);
 	vkDestroyBuffer(LogicalDevice, MyMatrixUniformBuffer.buffer, PALLOCATOR);
 	vkFreeMemory(LogicalDevice, MyMatrixUniformBuffer.vdm, PALLOCATOR);
 	vkDestroyBuffer(LogicalDevice, MyLightUniformBuffer.buffer, PALLOCATOR);
@@ -3854,72 +4357,72 @@ FindQueueFamilyThatDoesTransfer( )
 
 
 
-// *********************************************
-// EXECUTE THE CODE FOR THE RENDERING OPERATION:
-// *********************************************
+// ************************************
+// RECORD THE GPU FRUSTUM CULLING PASS:
+// ************************************
+// goes before the render pass -- resets the indirect command, culls NUM_INSTANCES instances into
+// MyVisibleInstanceBuffer, and makes the draw wait for both
+//
+// the indirect command is used as a VkDrawIndexedIndirectCommand when drawing with the index buffer
+// and as a VkDrawIndirectCommand when not -- with the last three words zero, the first two mean the same in both:
+//	{ indexCount or vertexCount, instanceCount, 0, 0, 0 }
 
-VkResult
-RenderScene( )
+void
+RecordCulling( VkCommandBuffer commandBuffer, uint32_t countPerInstance )
 {
-	NumRenders++;
-	if (NumRenders <= 2)
-		HERE_I_AM( "RenderScene" );
-
-	VkResult result = VK_SUCCESS;
-
-	VkSemaphoreCreateInfo			vsci;
-		vsci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-		vsci.pNext = nullptr;
-		vsci.flags = 0;
-
-	VkSemaphore imageReadySemaphore;
-	result = vkCreateSemaphore( LogicalDevice, IN &vsci, PALLOCATOR, OUT &imageReadySemaphore );
-	uint32_t nextImageIndex;
-	vkAcquireNextImageKHR( LogicalDevice, IN SwapChain, IN UINT64_MAX,
-				IN imageReadySemaphore, IN VK_NULL_HANDLE, OUT &nextImageIndex );
-	//REPORT( "vkCreateSemaphore" );
-
-	if( Verbose &&  NumRenders <= 2 )	fprintf(FpDebug, "nextImageIndex = %d\n", nextImageIndex);
-
-	VkCommandBufferBeginInfo		vcbbi;
-		vcbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		vcbbi.pNext = nullptr;
-		vcbbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		//vcbbi.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;   <----- or could use this one??
-		vcbbi.pInheritanceInfo = (VkCommandBufferInheritanceInfo *)nullptr;
-
-	result = vkBeginCommandBuffer( CommandBuffers[nextImageIndex], IN &vcbbi );
-	//REPORT( "vkBeginCommandBuffer" );
+	VkDrawIndexedIndirectCommand		vdiic;
+		vdiic.indexCount = countPerInstance;
+		vdiic.instanceCount = 0;			// the shader counts the survivors in here
+		vdiic.firstIndex = 0;
+		vdiic.vertexOffset = 0;
+		vdiic.firstInstance = 0;
+	vkCmdUpdateBuffer( commandBuffer, MyIndirectBuffer.buffer, 0, sizeof(vdiic), &vdiic );
+
+	VkMemoryBarrier				vmb;
+		vmb.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		vmb.pNext = nullptr;
+		vmb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vmb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, IN &vmb, 0, (VkBufferMemoryBarrier *)nullptr, 0, (VkImageMemoryBarrier *)nullptr );
+
+	struct cullPush push;
+		push.numInstances = NUM_INSTANCES;
+		push.radius = CullRadius;
+
+	vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ComputePipeline );
+	vkCmdBindDescriptorSets( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ComputePipelineLayout, 0, 1, &DescriptorSets[4], 0, (uint32_t *)nullptr );
+	vkCmdPushConstants( commandBuffer, ComputePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push );
+	vkCmdDispatch( commandBuffer, ( NUM_INSTANCES + CULL_WORK_GROUP_SIZE - 1 ) / CULL_WORK_GROUP_SIZE, 1, 1 );
+
+	// the draw reads the command as an indirect command and the survivors as vertex attributes:
+
+		vmb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vmb.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+			1, IN &vmb, 0, (VkBufferMemoryBarrier *)nullptr, 0, (VkImageMemoryBarrier *)nullptr );
+
+	// and the host reads the count after the fence:
+
+		vmb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vmb.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			1, IN &vmb, 0, (VkBufferMemoryBarrier *)nullptr, 0, (VkImageMemoryBarrier *)nullptr );
+}
 
-	VkClearColorValue			vccv;
-		vccv.float32[0] = 0.0;
-		vccv.float32[1] = 0.0;
-		vccv.float32[2] = 0.0;
-		vccv.float32[3] = 1.0;
 
-	VkClearDepthStencilValue		vcdsv;
-		vcdsv.depth = 1.f;
-		vcdsv.stencil = 0;
 
-	VkClearValue				vcv[2];
-		vcv[0].color = vccv;
-		vcv[1].depthStencil = vcdsv;
 
-	VkOffset2D o2d = { 0, 0 };
-	VkExtent2D e2d = { Width, Height };
-	VkRect2D r2d = { o2d, e2d };
+// **************************************
+// RECORD ONE BATCH OF THE SCENE'S DRAWS:
+// **************************************
+// records draws [firstDraw,lastDraw) into commandBuffer, after binding everything they need
+// (a secondary command buffer inherits none of the primary's bound state)
 
-	VkRenderPassBeginInfo				vrpbi;
-		vrpbi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		vrpbi.pNext = nullptr;
-		vrpbi.renderPass = RenderPass;
-		vrpbi.framebuffer = Framebuffers[ nextImageIndex ];
-		vrpbi.renderArea = r2d;
-		vrpbi.clearValueCount = 2;
-		vrpbi.pClearValues = vcv;		// used for VK_ATTACHMENT_LOAD_OP_CLEAR
-	vkCmdBeginRenderPass( CommandBuffers[nextImageIndex], IN &vrpbi, IN VK_SUBPASS_CONTENTS_INLINE );
-
-	vkCmdBindPipeline( CommandBuffers[nextImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, GraphicsPipeline );
+void
+RecordDrawBatch( VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t lastDraw )
+{
+	vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GraphicsPipeline );
 
 #ifdef EXAMPLE_OF_USING_DYNAMIC_STATE_VARIABLES
 	VkViewport viewport =
@@ -3932,7 +4435,7 @@ RenderScene( )
 		1.			// maxDepth
 	};
 
-	vkCmdSetViewport( CommandBuffers[nextImageIndex], 0, 1, IN &viewport );		// 0=firstViewport, 1=viewportCount
+	vkCmdSetViewport( commandBuffer, 0, 1, IN &viewport );		// 0=firstViewport, 1=viewportCount
 
 	VkRect2D scissor =
 	{
@@ -3942,13 +4445,13 @@ RenderScene( )
 		Height
 	};
 
-	vkCmdSetScissor( CommandBuffers[nextImageIndex], 0, 1, &scissor );
+	vkCmdSetScissor( commandBuffer, 0, 1, &scissor );
 #endif
 
 
-	vkCmdBindDescriptorSets( CommandBuffers[nextImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, GraphicsPipelineLayout, 0, 4, DescriptorSets, 0, (uint32_t *)nullptr );
+	vkCmdBindDescriptorSets( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GraphicsPipelineLayout, 0, 4, DescriptorSets, 0, (uint32_t *)nullptr );
 														    // dynamic offset count, dynamic offsets
-	//vkCmdBindPushConstants( CommandBuffers[nextImageIndex], PipelineLayout, VK_SHADER_STAGE_ALL, offset, size, void *values );
+	//vkCmdBindPushConstants( commandBuffer, PipelineLayout, VK_SHADER_STAGE_ALL, offset, size, void *values );
 
 	// all 3 buffer for geometry:
 
@@ -3959,37 +4462,267 @@ RenderScene( )
 
 	if( UseIndexBuffer )
 	{
-        	vkCmdBindVertexBuffers( CommandBuffers[nextImageIndex], 0, 1, vBuffers, offsets );              // 0, 1 = firstBinding, bindingCount
-        	vkCmdBindIndexBuffer( CommandBuffers[nextImageIndex], iBuffer, 0, VK_INDEX_TYPE_UINT32 );
+        	vkCmdBindVertexBuffers( commandBuffer, 0, 1, vBuffers, offsets );              // 0, 1 = firstBinding, bindingCount
+        	vkCmdBindIndexBuffer( commandBuffer, iBuffer, 0, VK_INDEX_TYPE_UINT32 );
 	}
 	else
 	{
-        	vkCmdBindVertexBuffers( CommandBuffers[nextImageIndex], 0, 1, buffers, offsets );               // 0, 1 = firstBinding, bindingCount
+        	vkCmdBindVertexBuffers( commandBuffer, 0, 1, buffers, offsets );               // 0, 1 = firstBinding, bindingCount
 	}
+	if( UseCulling )
+		vkCmdBindVertexBuffers( commandBuffer, 1, 1, &MyVisibleInstanceBuffer.buffer, offsets );	// what survived
+	else
+		vkCmdBindVertexBuffers( commandBuffer, 1, 1, &MyInstanceDataBuffer.buffer, offsets );	// the per-instance data
 
 
 //1027
 	const uint32_t vertexCount = sizeof(VertexData) / sizeof(VertexData[0]);
 	const uint32_t indexCount = sizeof(JustIndexData) / sizeof(JustIndexData[0]);
-	//const uint32_t instanceCount = 1;
-	const uint32_t instanceCount = NUM_INSTANCES;
 	const uint32_t firstVertex = 0;
 	const uint32_t firstIndex = 0;
-	const uint32_t firstInstance = 0;
 	const uint32_t vertexOffset = 0;
 
-	if (UseIndexBuffer)
+	if( UseCulling )
 	{
-		vkCmdDrawIndexed(CommandBuffers[nextImageIndex], indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		// the counts come from what the culling wrote:
+
+		if( UseIndexBuffer )
+			vkCmdDrawIndexedIndirect( commandBuffer, MyIndirectBuffer.buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand) );
+		else
+			vkCmdDrawIndirect( commandBuffer, MyIndirectBuffer.buffer, 0, 1, sizeof(VkDrawIndirectCommand) );
+		return;
 	}
-	else
+
+	// draw d is instances [ d*perDraw, (d+1)*perDraw ) -- the instance-rate attributes start at firstInstance:
+
+	uint32_t perDraw = InstancesPerDraw > 0 ? InstancesPerDraw : NUM_INSTANCES;
+	for( uint32_t d = firstDraw; d < lastDraw; d++ )
+	{
+		uint32_t firstInstance = d * perDraw;
+		uint32_t instanceCount = NUM_INSTANCES - firstInstance < perDraw ? NUM_INSTANCES - firstInstance : perDraw;
+		if (UseIndexBuffer)
+		{
+			vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		}
+		else
+		{
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+		}
+	}
+}
+
+
+
+// *****************************************************
+// RECORD THE SCENE'S DRAWS INTO THEIR SECONDARY BUFFER:
+// *****************************************************
+// all of the draws go into SecondaryCommandBuffers[imageIndex], so it only gets recorded when the draw key changes
+
+void
+RecordDrawBatches( uint32_t imageIndex )
+{
+	uint32_t numDraws = 1;
+	if( ! UseCulling  &&  InstancesPerDraw > 0 )
+		numDraws = ( NUM_INSTANCES + InstancesPerDraw - 1 ) / InstancesPerDraw;
+
+	double start = glfwGetTime( );
+
+	VkCommandBufferInheritanceInfo		vcbii;
+		vcbii.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		vcbii.pNext = nullptr;
+		vcbii.renderPass = RenderPass;
+		vcbii.subpass = 0;
+		vcbii.framebuffer = Framebuffers[ imageIndex ];
+		vcbii.occlusionQueryEnable = VK_FALSE;
+		vcbii.queryFlags = 0;
+		vcbii.pipelineStatistics = 0;
+
+	VkCommandBufferBeginInfo		vcbbi;
+		vcbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		vcbbi.pNext = nullptr;
+		vcbbi.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;		// kept and re-submitted, like the primary
+		vcbbi.pInheritanceInfo = &vcbii;
+
+	VkCommandBuffer commandBuffer = SecondaryCommandBuffers[imageIndex];
+	vkBeginCommandBuffer( commandBuffer, IN &vcbbi );
+	RecordDrawBatch( commandBuffer, 0, numDraws );
+	vkEndCommandBuffer( commandBuffer );
+
+	RecordSeconds += glfwGetTime( ) - start;
+	RecordFrames++;
+}
+
+
+
+
+// ************************************************
+// RECORD THE PRIMARY COMMAND BUFFER FOR ONE IMAGE:
+// ************************************************
+// the culling pass, then the render pass running the secondary command buffers
+// nothing in here depends on the uniform buffers' contents, so the result can be submitted frame after frame
+
+void
+RecordCommandBuffer( uint32_t imageIndex )
+{
+	VkResult result = VK_SUCCESS;
+
+	VkCommandBufferBeginInfo		vcbbi;
+		vcbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		vcbbi.pNext = nullptr;
+		vcbbi.flags = 0;		// not ONE_TIME_SUBMIT -- it gets submitted again until the draw key changes
+		//vcbbi.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;   <----- only needed if it could be pending twice at once
+		vcbbi.pInheritanceInfo = (VkCommandBufferInheritanceInfo *)nullptr;
+
+	result = vkBeginCommandBuffer( CommandBuffers[imageIndex], IN &vcbbi );
+	REPORT( "vkBeginCommandBuffer" );
+
+	const uint32_t vertexCount = sizeof(VertexData) / sizeof(VertexData[0]);
+	const uint32_t indexCount = sizeof(JustIndexData) / sizeof(JustIndexData[0]);
+
+	if( UseCulling )
+		RecordCulling( CommandBuffers[imageIndex], UseIndexBuffer ? indexCount : vertexCount );
+
+	VkClearColorValue			vccv;
+		vccv.float32[0] = 0.0;
+		vccv.float32[1] = 0.0;
+		vccv.float32[2] = 0.0;
+		vccv.float32[3] = 1.0;
+
+	VkClearDepthStencilValue		vcdsv;
+		vcdsv.depth = 1.f;
+		vcdsv.stencil = 0;
+
+	VkClearValue				vcv[2];
+		vcv[0].color = vccv;
+		vcv[1].depthStencil = vcdsv;
+
+	VkOffset2D o2d = { 0, 0 };
+	VkExtent2D e2d = { Width, Height };
+	VkRect2D r2d = { o2d, e2d };
+
+	VkRenderPassBeginInfo				vrpbi;
+		vrpbi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		vrpbi.pNext = nullptr;
+		vrpbi.renderPass = RenderPass;
+		vrpbi.framebuffer = Framebuffers[ imageIndex ];
+		vrpbi.renderArea = r2d;
+		vrpbi.clearValueCount = 2;
+		vrpbi.pClearValues = vcv;		// used for VK_ATTACHMENT_LOAD_OP_CLEAR
+	vkCmdBeginRenderPass( CommandBuffers[imageIndex], IN &vrpbi, IN VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS );
+
+	RecordDrawBatches( imageIndex );
+	vkCmdExecuteCommands( CommandBuffers[imageIndex], 1, &SecondaryCommandBuffers[imageIndex] );
+
+	vkCmdEndRenderPass( CommandBuffers[imageIndex] );
+
+	result = vkEndCommandBuffer( CommandBuffers[imageIndex] );
+	REPORT( "vkEndCommandBuffer" );
+}
+
+
+
+// ********************************************
+// WHAT THE RECORDED COMMAND BUFFERS DEPEND ON:
+// ********************************************
+
+struct drawKey
+CurrentDrawKey( )
+{
+	struct drawKey key;
+	memset( &key, 0, sizeof(key) );
+	key.useIndexBuffer = UseIndexBuffer;
+	key.useCulling = UseCulling;
+	key.mode = Mode;
+	key.pipeline = GraphicsPipeline;
+	key.numInstances = NUM_INSTANCES;
+	key.instancesPerDraw = InstancesPerDraw;
+	return key;
+}
+
+
+bool
+SameDrawKey( IN struct drawKey a, IN struct drawKey b )
+{
+	return a.useIndexBuffer == b.useIndexBuffer  &&  a.useCulling == b.useCulling  &&  a.mode == b.mode  &&
+		a.pipeline == b.pipeline  &&  a.numInstances == b.numInstances  &&  a.instancesPerDraw == b.instancesPerDraw;
+}
+
+
+// call when something a recorded command buffer refers to gets re-made (a buffer, a descriptor set, a framebuffer):
+
+void
+InvalidateRecordedCommands( )
+{
+	for( size_t i = 0; i < RecordedValid.size( ); i++ )
+		RecordedValid[i] = false;
+}
+
+
+
+
+// *********************************************
+// EXECUTE THE CODE FOR THE RENDERING OPERATION:
+// *********************************************
+
+VkResult
+RenderScene( )
+{
+	NumRenders++;
+	if (NumRenders <= 2)
+		HERE_I_AM( "RenderScene" );
+
+	VkResult result = VK_SUCCESS;
+
+	// the keyboard may have changed how many instances there are:
+
+	if( NUM_INSTANCES != InstanceDataCount )
+		Fill05InstanceData( NUM_INSTANCES );
+
+	if( FramebufferResized  ||  LatencyPolicyChanged )
 	{
-		vkCmdDraw(CommandBuffers[nextImageIndex], vertexCount, instanceCount, firstVertex, firstInstance);
+		FramebufferResized = false;
+		LatencyPolicyChanged = false;
+		Recreate08Swapchain( );
 	}
 
-	vkCmdEndRenderPass( CommandBuffers[nextImageIndex] );
+	VkSemaphoreCreateInfo			vsci;
+		vsci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		vsci.pNext = nullptr;
+		vsci.flags = 0;
 
-	vkEndCommandBuffer( CommandBuffers[nextImageIndex] );
+	VkSemaphore imageReadySemaphore;
+	result = vkCreateSemaphore( LogicalDevice, IN &vsci, PALLOCATOR, OUT &imageReadySemaphore );
+	uint32_t nextImageIndex;
+	result = vkAcquireNextImageKHR( LogicalDevice, IN SwapChain, IN UINT64_MAX,
+				IN imageReadySemaphore, IN VK_NULL_HANDLE, OUT &nextImageIndex );
+	//REPORT( "vkCreateSemaphore" );
+
+	// the swapchain no longer matches the window -- re-make it and skip this frame:
+	// (VK_SUBOPTIMAL_KHR still presents, so draw this frame and re-make it after the present)
+
+	if( result == VK_ERROR_OUT_OF_DATE_KHR )
+	{
+		vkDestroySemaphore( LogicalDevice, imageReadySemaphore, PALLOCATOR );
+		return Recreate08Swapchain( );
+	}
+	bool recreateAfterPresent = ( result == VK_SUBOPTIMAL_KHR );
+
+	if( Verbose &&  NumRenders <= 2 )	fprintf(FpDebug, "nextImageIndex = %d\n", nextImageIndex);
+
+	// the command buffers for this image only get recorded again if what they draw changed:
+
+	struct drawKey key = CurrentDrawKey( );
+	if( ! UseCommandCache  ||  ! RecordedValid[nextImageIndex]  ||  ! SameDrawKey( key, RecordedKeys[nextImageIndex] ) )
+	{
+		RecordCommandBuffer( nextImageIndex );
+		RecordedKeys[nextImageIndex] = key;
+		RecordedValid[nextImageIndex] = true;
+		CommandCacheMisses++;
+	}
+	else
+	{
+		CommandCacheHits++;
+	}
 
 	VkFenceCreateInfo			vfci;
 		vfci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
@@ -4041,6 +4774,8 @@ VK_PIPELINE_STAGE_COMMAND_PROCESS_BIT_NVX = 0x00020000,
 	result = vkWaitForFences( LogicalDevice, 1, IN &renderFence, VK_TRUE, UINT64_MAX );	// waitAll, timeout
 	if (Verbose && NumRenders <= 2)		REPORT("vkWaitForFences");
 
+	NumVisibleInstances = UseCulling ? IndirectMapped->instanceCount : NUM_INSTANCES;
+
 	vkDestroyFence( LogicalDevice, renderFence, PALLOCATOR );
 
 	VkPresentInfoKHR				vpi;
@@ -4055,14 +4790,194 @@ VK_PIPELINE_STAGE_COMMAND_PROCESS_BIT_NVX = 0x00020000,
 
 	result = vkQueuePresentKHR( presentQueue, IN &vpi );
 	if (Verbose && NumRenders <= 2)		REPORT("vkQueuePresentKHR");
+	NotePresent( );
 
 	vkDestroySemaphore( LogicalDevice, imageReadySemaphore, PALLOCATOR );
 
+	if( result == VK_ERROR_OUT_OF_DATE_KHR  ||  result == VK_SUBOPTIMAL_KHR  ||  recreateAfterPresent  ||  FramebufferResized )
+	{
+		FramebufferResized = false;
+		result = Recreate08Swapchain( );
+	}
+
 	return result;
 }
 
 
 
+// ***********************************************
+// TIME THE DRAWING AS THE INSTANCE COUNT GOES UP:
+// ***********************************************
+// 16, 64, 256, ... 1M instances, INSTANCE_BENCH_FRAMES frames each
+// RenderScene( ) waits for each frame to finish, so the time per frame includes the gpu's work
+// (at the small counts, the present mode's vsync may be what is being timed)
+// the vertex rate counts every instance asked for -- with culling on ('c'), only the visible ones really get drawn
+// run with culling off and --instances-per-draw N to see the recording time grow with the number of draws
+// -- and with --no-command-cache, since otherwise only the first frame at each count records anything
+
+#define INSTANCE_BENCH_FRAMES	100
+
+void
+InstanceBenchmark( )
+{
+	HERE_I_AM( "InstanceBenchmark" );
+
+	const uint32_t vertexCount = sizeof(VertexData) / sizeof(VertexData[0]);
+	const uint32_t indexCount = sizeof(JustIndexData) / sizeof(JustIndexData[0]);
+	uint32_t verticesPerInstance = UseIndexBuffer ? indexCount : vertexCount;
+
+	fprintf( FpDebug, "\nInstance benchmark: %d vertices per instance, %d frames per count\n", verticesPerInstance, INSTANCE_BENCH_FRAMES );
+	fprintf( stderr,  "\nInstance benchmark: %d vertices per instance, %d frames per count\n", verticesPerInstance, INSTANCE_BENCH_FRAMES );
+	fprintf( stderr,  "%10s  %10s  %12s  %12s  %16s  %8s\n", "instances", "visible", "ms/frame", "record ms", "Mvertices/sec", "records" );
+
+	uint32_t saveNumInstances = NUM_INSTANCES;
+	for( uint32_t numInstances = 16; numInstances <= MAX_INSTANCES; numInstances *= 4 )
+	{
+		NUM_INSTANCES = numInstances;
+
+		// one untimed frame to do the upload (and any buffer growing):
+
+		glfwPollEvents( );
+		Time = glfwGetTime( );
+		UpdateScene( );
+		RenderScene( );
+
+		RecordSeconds = 0.;
+		RecordFrames = 0;
+		CommandCacheMisses = 0;
+		double start = glfwGetTime( );
+		for( int f = 0; f < INSTANCE_BENCH_FRAMES; f++ )
+		{
+			glfwPollEvents( );
+			Time = glfwGetTime( );
+			UpdateScene( );
+			RenderScene( );
+		}
+		double seconds = glfwGetTime( ) - start;
+
+		double vertices = (double)numInstances * (double)verticesPerInstance * (double)INSTANCE_BENCH_FRAMES;
+		double msPerFrame = 1000. * seconds / (double)INSTANCE_BENCH_FRAMES;
+		double mVerticesPerSecond = vertices / seconds / 1000000.;
+		double recordMs = RecordFrames > 0 ? 1000. * RecordSeconds / (double)RecordFrames : 0.;
+		fprintf( FpDebug, "%10d instances (%d visible): %8.3f ms/frame, %8.3f ms recording, %10.1f Mvertices/sec, recorded %d of %d frames\n",
+			numInstances, NumVisibleInstances, msPerFrame, recordMs, mVerticesPerSecond, CommandCacheMisses, INSTANCE_BENCH_FRAMES );
+		fprintf( stderr,  "%10d  %10d  %12.3f  %12.3f  %16.1f  %8d\n", numInstances, NumVisibleInstances, msPerFrame, recordMs, mVerticesPerSecond, CommandCacheMisses );
+		fflush( FpDebug );
+
+		if( glfwWindowShouldClose( MainWindow ) )
+			break;
+	}
+	NUM_INSTANCES = saveNumInstances;
+}
+
+
+
+// *************************************************
+// HOLD THE FRAME RATE WITH AS LITTLE LAG AS CAN BE:
+// *************************************************
+// with --fps N, the frame's input gets sampled just long enough before the next present is due to do
+// the frame's work (FrameWorkSeconds), instead of right after the last present and then waiting
+// does nothing without --fps -- then the present mode is what paces the frames
+
+#define FRAME_LIMIT_MARGIN	1.10		// start a little early, in case this frame takes longer than the last ones
+#define FRAME_LIMIT_SPIN	0.001		// sleeping is not that accurate -- spin for the last millisecond
+
+void
+LimitFrameRate( )
+{
+	if( FrameLimit <= 0. )
+		return;
+
+	double now = glfwGetTime( );
+	if( NextPresentTime < now )
+		NextPresentTime = now;			// fell behind -- do not try to catch up
+
+	double wakeTime = NextPresentTime - FRAME_LIMIT_MARGIN * FrameWorkSeconds;
+	if( wakeTime - now > FRAME_LIMIT_SPIN )
+		std::this_thread::sleep_for( std::chrono::duration<double>( wakeTime - now - FRAME_LIMIT_SPIN ) );
+	while( glfwGetTime( ) < wakeTime )
+		;
+
+	NextPresentTime += 1. / (double)FrameLimit;
+}
+
+
+
+// ******************************
+// MEASURE INPUT-TO-PRESENT TIME:
+// ******************************
+// the GLFW callbacks call NoteInput( ) -- only the oldest input a frame has not sampled yet counts,
+// since that is the one that waited the longest
+// the latency stops at vkQueuePresentKHR( ) returning, which is not the same as the photons coming out,
+// but it is the part the present mode, the image count, and the frame limiter can change
+
+void
+NoteInput( )
+{
+	if( InputTime < 0. )
+		InputTime = glfwGetTime( );
+}
+
+
+// right after glfwPollEvents( ), before the scene gets updated and recorded:
+
+void
+SampleInput( )
+{
+	FrameSampleTime = glfwGetTime( );
+	FrameInputTime = InputTime;
+	InputTime = -1.;
+}
+
+
+void
+NotePresent( )
+{
+	double now = glfwGetTime( );
+
+	if( FrameSampleTime > 0. )
+		FrameWorkSeconds = 0.9 * FrameWorkSeconds + 0.1 * ( now - FrameSampleTime );
+	if( FrameInputTime >= 0. )
+	{
+		// file it under the present mode the swapchain really has, not the one asked for --
+		// they differ when the surface did not have it and fifo got used instead:
+
+		for( int p = 0; p < NUM_LATENCY_POLICIES; p++ )
+		{
+			if( LatencyPolicies[p].presentMode == PresentMode )
+				LatencySamples[p].push_back( now - FrameInputTime );
+		}
+	}
+	FrameInputTime = -1.;
+}
+
+
+// min, average, 99th percentile, and max for each present mode that got used:
+
+void
+ReportLatency( )
+{
+	fprintf( FpDebug, "Input-to-present latency (--fps %.1f, %d swapchain images):\n", FrameLimit, SwapchainImageCount );
+	for( int p = 0; p < NUM_LATENCY_POLICIES; p++ )
+	{
+		std::vector<double> samples = LatencySamples[p];
+		if( samples.empty( ) )
+			continue;
+
+		std::sort( samples.begin( ), samples.end( ) );
+		double sum = 0.;
+		for( size_t i = 0; i < samples.size( ); i++ )
+			sum += samples[i];
+		size_t p99 = ( 99 * ( samples.size( ) - 1 ) ) / 100;
+		fprintf( FpDebug, "%14s: %6d inputs, min %8.3f ms, avg %8.3f ms, p99 %8.3f ms, max %8.3f ms\n",
+			LatencyPolicies[p].name, (int)samples.size( ), 1000. * samples.front( ), 1000. * sum / (double)samples.size( ),
+			1000. * samples[p99], 1000. * samples.back( ) );
+	}
+	fflush( FpDebug );
+}
+
+
+
 
 // ***************************
 // RESET THE GLOBAL VARIABLES:
@@ -4077,6 +4992,9 @@ Reset( )
 	NumRenders = 0;
 	Paused = false;
 	Scale  = 1.0;
+	UseCulling = true;
+	InputTime = -1.;
+	FrameInputTime = -1.;
 	UseIndexBuffer = false;
 	UseLighting = false;
 	UseRotate = true;
@@ -4195,7 +5113,7 @@ InitGLFW( )
 	glfwInit( );
 
 	glfwWindowHint( GLFW_CLIENT_API, GLFW_NO_API );
-	glfwWindowHint( GLFW_RESIZABLE, GLFW_FALSE );
+	glfwWindowHint( GLFW_RESIZABLE, GLFW_TRUE );		// RenderScene( ) re-makes the swapchain when it changes
 	MainWindow = glfwCreateWindow( Width, Height, "Vulkan Sample", NULL, NULL );
 
 	uint32_t count;
@@ -4209,6 +5127,19 @@ InitGLFW( )
 	glfwSetKeyCallback( MainWindow, GLFWKeyboard );
 	glfwSetCursorPosCallback( MainWindow, GLFWMouseMotion );
 	glfwSetMouseButtonCallback( MainWindow, GLFWMouseButton );
+	glfwSetFramebufferSizeCallback( MainWindow, GLFWFramebufferSize );
+}
+
+
+// the window got resized -- the next RenderScene( ) re-makes the swapchain:
+
+void
+GLFWFramebufferSize( GLFWwindow * window, int width, int height )
+{
+	(void)window;		// Recreate08Swapchain( ) asks the surface for the new extent itself
+	(void)width;
+	(void)height;
+	FramebufferResized = true;
 }
 
 
@@ -4231,10 +5162,17 @@ GLFWErrorCallback( int error, const char * description )
 void
 GLFWKeyboard( GLFWwindow * window, int key, int scancode, int action, int mods )
 {
+	NoteInput( );
+
 	if( action == GLFW_PRESS )
 	{
 		switch( key )
 		{
+			case 'c':
+			case 'C':
+				UseCulling = ! UseCulling;
+				break;
+
 			case 'i':
 			case 'I':
 				UseIndexBuffer = ! UseIndexBuffer;
@@ -4268,6 +5206,13 @@ GLFWKeyboard( GLFWwindow * window, int key, int scancode, int action, int mods )
 				UseRotate = ! UseRotate;
 				break;
 
+			case 's':
+			case 'S':
+				LatencyPolicy = ( LatencyPolicy + 1 ) % NUM_LATENCY_POLICIES;
+				LatencyPolicyChanged = true;
+				fprintf( stderr, "Present mode: %s\n", LatencyPolicies[LatencyPolicy].name );
+				break;
+
 			case 'v':
 			case 'V':
 				Verbose = ! Verbose;
@@ -4305,6 +5250,8 @@ GLFWKeyboard( GLFWwindow * window, int key, int scancode, int action, int mods )
 void
 GLFWMouseButton( GLFWwindow *window, int button, int action, int mods )
 {
+	NoteInput( );
+
 	if( Verbose )		fprintf( FpDebug, "Mouse button = %d; Action = %d\n", button, action );
 
 	int b = 0;		// LEFT, MIDDLE, or RIGHT
@@ -4353,6 +5300,9 @@ GLFWMouseButton( GLFWwindow *window, int button, int action, int mods )
 void
 GLFWMouseMotion( GLFWwindow *window, double xpos, double ypos )
 {
+	if( ActiveButton != 0 )
+		NoteInput( );			// only a drag changes the scene
+
 	int dx = (int)xpos - Xmouse;		// change in mouse coords
 	int dy = (int)ypos - Ymouse;
 
@@ -0,0 +1,227 @@
+// ****************************************************************************************************
+// DETERMINISTIC BENCHMARK:
+//
+// Normally Time comes from the clock, so the scene is never in the same place twice and no two runs can
+// be compared.  With --bench N, frame i gets Time = i * dt instead (--dt X seconds, 1/60 by default), so
+// every run renders the same sequence of frames:
+//	* the first --warmup W frames (BENCH_WARMUP_FRAMES by default) are not measured -- they let the
+//	  caches warm up
+//	* the warm-up goes on past W frames until no texture is still streaming in and the pipeline compiler
+//	  is idle, so every measured frame draws with the real textures and the real pipeline variant, not
+//	  the placeholder or the uber pipeline (BENCH_MAX_WARMUP_FRAMES is where it gives up waiting)
+//	* then the gpu is drained, and the next N frames are measured:
+//		cpu: the time from the start of a frame's UpdateScene( ) to the end of its RenderScene( )
+//		gpu: the profiler's "frame" scope, if the queue has timestamps
+//	* the run stops after those N frames
+// The measured frames always get Time = ( W + m ) * dt for measured frame m, however long the warm-up
+// went on, so they see the same sequence of scenes on every run.
+//
+// BenchReport( ) writes min, median, p95, p99 (and the average) of both, plus the throughput, as JSON
+// into --bench-json file (BENCH_JSON_FILE by default), so builds can be compared by a script.
+// It works with or without --headless, and with any --scene.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define BENCH_WARMUP_FRAMES	100
+#define BENCH_MAX_WARMUP_FRAMES	10000		// stop waiting for the streaming and the compiler after this many
+#define BENCH_DEFAULT_DT	(1./60.)
+#define BENCH_JSON_FILE		"sample-bench.json"
+
+
+int					BenchWarmup;
+int					BenchFrame;			// frames started so far, warm-up included
+int					BenchMeasureFrame;		// the frame the measuring started on, -1 = still warming up
+std::string				BenchJsonFile;
+std::vector<double>			BenchCpuTimes;			// milliseconds, one per measured frame
+std::chrono::steady_clock::time_point	BenchFrameStart;		// when the frame being measured started
+std::chrono::steady_clock::time_point	BenchStart;			// when the first measured frame started
+
+
+struct benchStats
+{
+	double		min, median, p95, p99, avg;
+};
+
+
+static double
+BenchMilliseconds( std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to )
+{
+	return std::chrono::duration<double, std::milli>( to - from ).count( );
+}
+
+
+// the same percentile that Report06GpuProfiler( ) uses:
+
+static struct benchStats
+BenchStatsOf( std::vector<double> samples )
+{
+	struct benchStats stats = { 0., 0., 0., 0., 0. };
+	if( samples.empty( ) )
+		return stats;
+
+	std::sort( samples.begin( ), samples.end( ) );
+	double sum = 0.;
+	for( size_t i = 0; i < samples.size( ); i++ )
+		sum += samples[i];
+
+	size_t last = samples.size( ) - 1;
+	stats.min    = samples.front( );
+	stats.median = samples[ ( 50 * last ) / 100 ];
+	stats.p95    = samples[ ( 95 * last ) / 100 ];
+	stats.p99    = samples[ ( 99 * last ) / 100 ];
+	stats.avg    = sum / (double)samples.size( );
+	return stats;
+}
+
+
+static void
+BenchWriteStats( FILE * fp, IN const char * name, IN const struct benchStats & stats, bool last )
+{
+	fprintf( fp, "  \"%s\": { \"min\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"avg\": %.4f }%s\n",
+		name, stats.min, stats.median, stats.p95, stats.p99, stats.avg, last ? "" : "," );
+}
+
+
+
+// *************************
+// SET UP THE BENCHMARK RUN:
+// *************************
+
+// warmup < 0 and dt <= 0. mean the defaults, a NULL filename means BENCH_JSON_FILE
+
+void
+BenchInit( int frames, double dt, int warmup, IN const char * jsonFile )
+{
+	BenchFrames = frames;
+	BenchDt = dt > 0. ? dt : BENCH_DEFAULT_DT;
+	BenchWarmup = warmup >= 0 ? warmup : BENCH_WARMUP_FRAMES;
+	BenchJsonFile = jsonFile != NULL ? jsonFile : BENCH_JSON_FILE;
+	BenchFrame = 0;
+	BenchMeasureFrame = -1;
+	BenchCpuTimes.clear( );
+	BenchCpuTimes.reserve( BenchFrames );
+
+	LOG_INFO( "Benchmark: %d warm-up frames, then %d measured frames, dt = %.6f s\n", BenchWarmup, BenchFrames, BenchDt );
+}
+
+
+
+// ****************************
+// START AND FINISH EACH FRAME:
+// ****************************
+
+// call at the start of every frame -- returns what Time should be
+
+double
+BenchBeginFrame( )
+{
+	if( BenchMeasureFrame < 0  &&  BenchFrame >= BenchWarmup )
+	{
+		bool settled = ! Stream07Busy( )  &&  ! Busy14PipelineCompiler( );
+		if( ! settled  &&  BenchFrame >= BENCH_MAX_WARMUP_FRAMES )
+		{
+			LOG_WARN( "Benchmark: still streaming or compiling after %d frames -- measuring anyway\n", BenchFrame );
+			settled = true;
+		}
+
+		if( settled )
+		{
+			// the warm-up frames' gpu times must not get mixed in with the measured ones:
+
+			vkDeviceWaitIdle( LogicalDevice );
+			Flush06GpuProfiler( );
+			Keep06GpuScopeTimes( true );
+			LOG_INFO( "Benchmark: warm-up done after %d frames, measuring\n", BenchFrame );
+			BenchMeasureFrame = BenchFrame;
+			BenchStart = std::chrono::steady_clock::now( );
+		}
+	}
+
+	BenchFrameStart = std::chrono::steady_clock::now( );
+	if( BenchMeasureFrame < 0 )
+		return (double)BenchFrame * BenchDt;
+	return (double)( BenchWarmup + BenchFrame - BenchMeasureFrame ) * BenchDt;
+}
+
+
+// call at the end of every frame -- returns true once all of the measured frames are done
+
+bool
+BenchEndFrame( )
+{
+	if( BenchMeasureFrame >= 0 )
+		BenchCpuTimes.push_back( BenchMilliseconds( BenchFrameStart, std::chrono::steady_clock::now( ) ) );
+
+	BenchFrame++;
+	return (int)BenchCpuTimes.size( ) >= BenchFrames;
+}
+
+
+
+// ******************************
+// WRITE THE RESULTS OUT AS JSON:
+// ******************************
+
+// the device must be idle, so that the last frames' gpu times can be read back
+
+void
+BenchReport( )
+{
+	int measured = (int)BenchCpuTimes.size( );
+	if( measured == 0 )
+	{
+		LOG_INFO( "Benchmark: stopped before any frames were measured\n" );
+		return;
+	}
+	double seconds = BenchMilliseconds( BenchStart, std::chrono::steady_clock::now( ) ) / 1000.;
+
+	Flush06GpuProfiler( );
+	std::vector<double> gpuTimes;
+	Take06GpuScopeTimes( "frame", OUT &gpuTimes );
+	Keep06GpuScopeTimes( false );
+
+	struct benchStats cpu = BenchStatsOf( BenchCpuTimes );
+	struct benchStats gpu = BenchStatsOf( gpuTimes );
+
+	FILE * fp;
+#ifdef _WIN32
+	errno_t err = fopen_s( &fp, BenchJsonFile.c_str( ), "w" );
+	if( err != 0 )
+		fp = NULL;
+#else
+	fp = fopen( BenchJsonFile.c_str( ), "w" );
+#endif
+	if( fp == NULL )
+	{
+		LOG_ERROR( "Cannot write the benchmark file '%s'\n", BenchJsonFile.c_str( ) );
+		return;
+	}
+
+	fprintf( fp, "{\n" );
+	fprintf( fp, "  \"device\": \"%s\",\n", PhysicalDeviceProperties.deviceName );
+	fprintf( fp, "  \"headless\": %s,\n", Headless ? "true" : "false" );
+	fprintf( fp, "  \"scene\": \"%s\",\n", SceneName.c_str( ) );
+	fprintf( fp, "  \"scale\": %d,\n", SceneScale );
+	fprintf( fp, "  \"width\": %d,\n", Width );
+	fprintf( fp, "  \"height\": %d,\n", Height );
+	fprintf( fp, "  \"robots\": %d,\n", NumRobots );
+	fprintf( fp, "  \"arm_depth\": %d,\n", RobotArmDepth );
+	fprintf( fp, "  \"textures\": %d,\n", (int)SceneTextures.size( ) );
+	fprintf( fp, "  \"frame_lag\": %d,\n", FRAME_LAG );
+	fprintf( fp, "  \"dt\": %.6f,\n", BenchDt );
+	fprintf( fp, "  \"warmup_frames\": %d,\n", BenchMeasureFrame );
+	fprintf( fp, "  \"frames\": %d,\n", measured );
+	fprintf( fp, "  \"complete\": %s,\n", measured == BenchFrames ? "true" : "false" );
+	fprintf( fp, "  \"seconds\": %.6f,\n", seconds );
+	fprintf( fp, "  \"frames_per_second\": %.3f,\n", seconds > 0. ? (double)measured / seconds : 0. );
+	fprintf( fp, "  \"gpu_frames\": %d,\n", (int)gpuTimes.size( ) );
+	BenchWriteStats( fp, "cpu_frame_ms", cpu, gpuTimes.empty( ) );
+	if( ! gpuTimes.empty( ) )
+		BenchWriteStats( fp, "gpu_frame_ms", gpu, true );
+	fprintf( fp, "}\n" );
+	fclose( fp );
+
+	LOG_INFO( "Benchmark: %d frames in %.3f s = %.1f fps ; cpu median = %.3f ms, p99 = %.3f ms ; gpu median = %.3f ms, p99 = %.3f ms -> '%s'\n",
+		measured, seconds, (double)measured / seconds, cpu.median, cpu.p99, gpu.median, gpu.p99, BenchJsonFile.c_str( ) );
+}
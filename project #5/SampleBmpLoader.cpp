@@ -0,0 +1,628 @@
+// ****************************************************************************************************
+// BMP LOADER:
+//
+// Maps (Linux) or bulk-reads (everything else) a .bmp file and decodes it into rgba, 1 byte each,
+// with the bottom row first -- the same layout the old fgetc( ) loop produced.
+//
+// Handles:
+//	* 24-bit BGR and 32-bit BGRA (BI_RGB, or BI_BITFIELDS with the standard masks)
+//	* bottom-up (biHeight > 0) and top-down (biHeight < 0) row order
+//
+// The BGR -> RGBA swizzle uses SSSE3 or AVX2 shuffles when the cpu has them (checked at run time),
+// and falls back to plain C otherwise.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BMP_SIMD_X86
+#include <immintrin.h>
+#ifdef _WIN32
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef __GNUC__
+#define BMP_TARGET(isa)		__attribute__((target(isa)))
+#else
+#define BMP_TARGET(isa)
+#endif
+
+#define BMP_BI_RGB		0
+#define BMP_BI_BITFIELDS	3
+
+
+// a .bmp file that has been opened and its headers read:
+
+struct bmpFile
+{
+	unsigned char *		bytes;			// the whole file
+	size_t			numBytes;
+	bool			mapped;			// true = bytes came from mmap( ), false = from new[ ]
+	int			width;
+	int			height;			// always positive
+	bool			topDown;		// true = the first row in the file is the top row
+	int			bitCount;		// 24 or 32
+	bool			hasAlpha;		// 32-bit only: true = keep the file's alpha, false = make it 255
+	size_t			rowPitch;		// bytes per row in the file, including padding
+	unsigned char *		pixels;			// the first row in the file
+};
+
+
+void	BmpClose( INOUT struct bmpFile * );
+
+
+// a row swizzler converts one row of width pixels into rgba:
+
+typedef void (*bmpRowFunc)( const unsigned char *, unsigned char *, int );
+
+
+static inline unsigned int
+BmpGet32( const unsigned char * p )
+{
+	return (unsigned int)p[0] | ( (unsigned int)p[1] << 8 ) | ( (unsigned int)p[2] << 16 ) | ( (unsigned int)p[3] << 24 );
+}
+
+
+static inline unsigned short
+BmpGet16( const unsigned char * p )
+{
+	return (unsigned short)( p[0] | ( p[1] << 8 ) );
+}
+
+
+
+// **********************
+// PLAIN-C ROW SWIZZLERS:
+// **********************
+
+static void
+BmpRow24Scalar( const unsigned char * src, unsigned char * dst, int width )
+{
+	for( int s = 0; s < width; s++, src += 3, dst += 4 )
+	{
+		dst[0] = src[2];		// r
+		dst[1] = src[1];		// g
+		dst[2] = src[0];		// b
+		dst[3] = 255;			// a
+	}
+}
+
+
+static void
+BmpRow32Scalar( const unsigned char * src, unsigned char * dst, int width )
+{
+	for( int s = 0; s < width; s++, src += 4, dst += 4 )
+	{
+		dst[0] = src[2];
+		dst[1] = src[1];
+		dst[2] = src[0];
+		dst[3] = src[3];
+	}
+}
+
+
+static void
+BmpRow32OpaqueScalar( const unsigned char * src, unsigned char * dst, int width )
+{
+	for( int s = 0; s < width; s++, src += 4, dst += 4 )
+	{
+		dst[0] = src[2];
+		dst[1] = src[1];
+		dst[2] = src[0];
+		dst[3] = 255;
+	}
+}
+
+
+
+#ifdef BMP_SIMD_X86
+
+// *****************************
+// SSSE3 AND AVX2 ROW SWIZZLERS:
+// *****************************
+
+// a 16-byte load of 24-bit pixels holds 5 1/3 pixels -- only the first 4 get used,
+// so the loop stops while there are still 16 bytes left to read in the row
+
+BMP_TARGET("ssse3") static void
+BmpRow24Ssse3( const unsigned char * src, unsigned char * dst, int width )
+{
+	const __m128i shuffle = _mm_setr_epi8( 2,1,0,-1, 5,4,3,-1, 8,7,6,-1, 11,10,9,-1 );
+	const __m128i alpha   = _mm_set1_epi32( (int)0xff000000 );
+	int s = 0;
+	for( ; s + 6 <= width; s += 4, src += 12, dst += 16 )
+	{
+		__m128i bgr = _mm_loadu_si128( (const __m128i *)src );
+		_mm_storeu_si128( (__m128i *)dst, _mm_or_si128( _mm_shuffle_epi8( bgr, shuffle ), alpha ) );
+	}
+	BmpRow24Scalar( src, dst, width - s );
+}
+
+
+BMP_TARGET("ssse3") static void
+BmpRow32Ssse3( const unsigned char * src, unsigned char * dst, int width )
+{
+	const __m128i shuffle = _mm_setr_epi8( 2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15 );
+	int s = 0;
+	for( ; s + 4 <= width; s += 4, src += 16, dst += 16 )
+	{
+		__m128i bgra = _mm_loadu_si128( (const __m128i *)src );
+		_mm_storeu_si128( (__m128i *)dst, _mm_shuffle_epi8( bgra, shuffle ) );
+	}
+	BmpRow32Scalar( src, dst, width - s );
+}
+
+
+BMP_TARGET("ssse3") static void
+BmpRow32OpaqueSsse3( const unsigned char * src, unsigned char * dst, int width )
+{
+	const __m128i shuffle = _mm_setr_epi8( 2,1,0,-1, 6,5,4,-1, 10,9,8,-1, 14,13,12,-1 );
+	const __m128i alpha   = _mm_set1_epi32( (int)0xff000000 );
+	int s = 0;
+	for( ; s + 4 <= width; s += 4, src += 16, dst += 16 )
+	{
+		__m128i bgra = _mm_loadu_si128( (const __m128i *)src );
+		_mm_storeu_si128( (__m128i *)dst, _mm_or_si128( _mm_shuffle_epi8( bgra, shuffle ), alpha ) );
+	}
+	BmpRow32OpaqueScalar( src, dst, width - s );
+}
+
+
+// vpshufb only shuffles within each 128-bit half, so the 8 24-bit pixels get loaded
+// as two groups of 4: bytes 0-15 into the low half and bytes 12-27 into the high half
+
+BMP_TARGET("avx2") static void
+BmpRow24Avx2( const unsigned char * src, unsigned char * dst, int width )
+{
+	const __m256i shuffle = _mm256_setr_epi8( 2,1,0,-1, 5,4,3,-1, 8,7,6,-1, 11,10,9,-1,
+						  2,1,0,-1, 5,4,3,-1, 8,7,6,-1, 11,10,9,-1 );
+	const __m256i alpha   = _mm256_set1_epi32( (int)0xff000000 );
+	int s = 0;
+	for( ; s + 10 <= width; s += 8, src += 24, dst += 32 )
+	{
+		__m128i lo = _mm_loadu_si128( (const __m128i *)src );
+		__m128i hi = _mm_loadu_si128( (const __m128i *)( src + 12 ) );
+		__m256i bgr = _mm256_inserti128_si256( _mm256_castsi128_si256( lo ), hi, 1 );
+		_mm256_storeu_si256( (__m256i *)dst, _mm256_or_si256( _mm256_shuffle_epi8( bgr, shuffle ), alpha ) );
+	}
+	BmpRow24Ssse3( src, dst, width - s );
+}
+
+
+BMP_TARGET("avx2") static void
+BmpRow32Avx2( const unsigned char * src, unsigned char * dst, int width )
+{
+	const __m256i shuffle = _mm256_setr_epi8( 2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15,
+						  2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15 );
+	int s = 0;
+	for( ; s + 8 <= width; s += 8, src += 32, dst += 32 )
+	{
+		__m256i bgra = _mm256_loadu_si256( (const __m256i *)src );
+		_mm256_storeu_si256( (__m256i *)dst, _mm256_shuffle_epi8( bgra, shuffle ) );
+	}
+	BmpRow32Ssse3( src, dst, width - s );
+}
+
+
+BMP_TARGET("avx2") static void
+BmpRow32OpaqueAvx2( const unsigned char * src, unsigned char * dst, int width )
+{
+	const __m256i shuffle = _mm256_setr_epi8( 2,1,0,-1, 6,5,4,-1, 10,9,8,-1, 14,13,12,-1,
+						  2,1,0,-1, 6,5,4,-1, 10,9,8,-1, 14,13,12,-1 );
+	const __m256i alpha   = _mm256_set1_epi32( (int)0xff000000 );
+	int s = 0;
+	for( ; s + 8 <= width; s += 8, src += 32, dst += 32 )
+	{
+		__m256i bgra = _mm256_loadu_si256( (const __m256i *)src );
+		_mm256_storeu_si256( (__m256i *)dst, _mm256_or_si256( _mm256_shuffle_epi8( bgra, shuffle ), alpha ) );
+	}
+	BmpRow32OpaqueSsse3( src, dst, width - s );
+}
+
+#endif		// BMP_SIMD_X86
+
+
+
+// *****************************************
+// FIND OUT WHAT THE CPU CAN DO (ONLY ONCE):
+// *****************************************
+
+#define BMP_ISA_SCALAR		0
+#define BMP_ISA_SSSE3		1
+#define BMP_ISA_AVX2		2
+
+const char * BmpIsaNames[ ] = { "scalar", "ssse3", "avx2" };
+
+
+int
+BmpBestIsa( )
+{
+	static int isa = -1;
+	if( isa >= 0 )
+		return isa;
+
+	isa = BMP_ISA_SCALAR;
+#ifdef BMP_SIMD_X86
+#ifdef __GNUC__
+	__builtin_cpu_init( );
+	if( __builtin_cpu_supports( "ssse3" ) )
+		isa = BMP_ISA_SSSE3;
+	if( __builtin_cpu_supports( "avx2" ) )
+		isa = BMP_ISA_AVX2;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid( info, 1 );
+	if( ( info[2] & ( 1 << 9 ) ) != 0 )					// ssse3
+		isa = BMP_ISA_SSSE3;
+	bool osSavesYmm = ( info[2] & ( 1 << 27 ) ) != 0  &&  ( _xgetbv( 0 ) & 6 ) == 6;	// osxsave, and the os saves the ymm registers
+	__cpuidex( info, 7, 0 );
+	if( osSavesYmm  &&  ( info[1] & ( 1 << 5 ) ) != 0 )			// avx2
+		isa = BMP_ISA_AVX2;
+#endif
+#endif
+	return isa;
+}
+
+
+static bmpRowFunc
+BmpRowFuncFor( int bitCount, bool hasAlpha, int isa )
+{
+#ifdef BMP_SIMD_X86
+	if( isa == BMP_ISA_AVX2 )
+		return bitCount == 24 ? BmpRow24Avx2  : ( hasAlpha ? BmpRow32Avx2  : BmpRow32OpaqueAvx2 );
+	if( isa == BMP_ISA_SSSE3 )
+		return bitCount == 24 ? BmpRow24Ssse3 : ( hasAlpha ? BmpRow32Ssse3 : BmpRow32OpaqueSsse3 );
+#endif
+	return bitCount == 24 ? BmpRow24Scalar : ( hasAlpha ? BmpRow32Scalar : BmpRow32OpaqueScalar );
+}
+
+
+
+// *************************************
+// OPEN A BMP FILE AND READ ITS HEADERS:
+// *************************************
+
+bool
+BmpOpen( IN const char * filename, OUT struct bmpFile * pBmp )
+{
+	pBmp->bytes = (unsigned char *)nullptr;
+	pBmp->numBytes = 0;
+	pBmp->mapped = false;
+
+#ifdef __linux__
+	int fd = open( filename, O_RDONLY );
+	if( fd < 0 )
+	{
+		fprintf( stderr, "Cannot open BMP file '%s'\n", filename );
+		return false;
+	}
+	struct stat st;
+	if( fstat( fd, &st ) != 0  ||  st.st_size < 14+40 )
+	{
+		fprintf( stderr, "Cannot size BMP file '%s'\n", filename );
+		close( fd );
+		return false;
+	}
+	void * p = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );				// the mapping stays valid after the close
+	if( p == MAP_FAILED )
+	{
+		fprintf( stderr, "Cannot mmap BMP file '%s'\n", filename );
+		return false;
+	}
+	madvise( p, (size_t)st.st_size, MADV_SEQUENTIAL );
+	pBmp->bytes = (unsigned char *)p;
+	pBmp->numBytes = (size_t)st.st_size;
+	pBmp->mapped = true;
+#else
+	FILE * fp;
+#ifdef _WIN32
+	errno_t err = fopen_s( &fp, filename, "rb" );
+	if( err != 0 )
+		fp = NULL;
+#else
+	fp = fopen( filename, "rb" );
+#endif
+	if( fp == NULL )
+	{
+		fprintf( stderr, "Cannot open BMP file '%s'\n", filename );
+		return false;
+	}
+	fseek( fp, 0, SEEK_END );
+	long size = ftell( fp );
+	rewind( fp );
+	if( size < 14+40 )
+	{
+		fprintf( stderr, "BMP file '%s' is too short\n", filename );
+		fclose( fp );
+		return false;
+	}
+	pBmp->bytes = new unsigned char[ size ];
+	pBmp->numBytes = fread( pBmp->bytes, 1, (size_t)size, fp );	// one read for the whole file
+	fclose( fp );
+#endif
+
+	// the headers get read into locals, not the FileHeader and InfoHeader globals,
+	// so that worker threads can open files at the same time:
+
+	const unsigned char * h = pBmp->bytes;
+	struct bmfh fileHeader;
+	struct bmih infoHeader;
+
+	fileHeader.bfType      = BmpGet16( &h[0] );
+	fileHeader.bfSize      = BmpGet32( &h[2] );
+	fileHeader.bfReserved1 = BmpGet16( &h[6] );
+	fileHeader.bfReserved2 = BmpGet16( &h[8] );
+	fileHeader.bfOffBits   = BmpGet32( &h[10] );
+
+	// if bfType is not 0x4d42, the file is not a bmp:
+
+	if( (unsigned short)fileHeader.bfType != 0x4d42 )
+	{
+		LOG_INFO( "Wrong type of file: 0x%0x\n", fileHeader.bfType );
+		BmpClose( pBmp );
+		return false;
+	}
+
+	infoHeader.biSize          = BmpGet32( &h[14] );
+	infoHeader.biWidth         = BmpGet32( &h[18] );
+	infoHeader.biHeight        = BmpGet32( &h[22] );
+	infoHeader.biPlanes        = BmpGet16( &h[26] );
+	infoHeader.biBitCount      = BmpGet16( &h[28] );
+	infoHeader.biCompression   = BmpGet32( &h[30] );
+	infoHeader.biSizeImage     = BmpGet32( &h[34] );
+	infoHeader.biXPelsPerMeter = BmpGet32( &h[38] );
+	infoHeader.biYPelsPerMeter = BmpGet32( &h[42] );
+	infoHeader.biClrUsed       = BmpGet32( &h[46] );
+	infoHeader.biClrImportant  = BmpGet32( &h[50] );
+
+	pBmp->width    = infoHeader.biWidth;
+	pBmp->topDown  = infoHeader.biHeight < 0;
+	pBmp->height   = pBmp->topDown ? -infoHeader.biHeight : infoHeader.biHeight;
+	pBmp->bitCount = infoHeader.biBitCount;
+	pBmp->hasAlpha = false;
+
+	if( pBmp->bitCount != 24  &&  pBmp->bitCount != 32 )
+	{
+		LOG_INFO( "Wrong number of bits per pixel: %d\n", pBmp->bitCount );
+		BmpClose( pBmp );
+		return false;
+	}
+
+	// we do not support compression
+	// (BI_BITFIELDS is ok if it is just describing ordinary BGRA):
+
+	bool ok = infoHeader.biCompression == BMP_BI_RGB;
+	if( infoHeader.biCompression == BMP_BI_BITFIELDS  &&  pBmp->bitCount == 32  &&  14 + 40 + 12 <= (int)pBmp->numBytes )
+	{
+		ok = BmpGet32( &h[54] ) == 0x00ff0000  &&  BmpGet32( &h[58] ) == 0x0000ff00  &&  BmpGet32( &h[62] ) == 0x000000ff;
+		if( infoHeader.biSize >= 56 )						// a V3 or later header carries an alpha mask too
+			pBmp->hasAlpha = BmpGet32( &h[66] ) == 0xff000000;
+	}
+	if( ! ok )
+	{
+		LOG_INFO( "Wrong type of image compression: %d\n", infoHeader.biCompression );
+		BmpClose( pBmp );
+		return false;
+	}
+
+	// rows are padded out to a multiple of 4 bytes:
+
+	pBmp->rowPitch = 4 * ( ( (size_t)pBmp->width * pBmp->bitCount / 8 + 3 ) / 4 );
+	pBmp->pixels = pBmp->bytes + fileHeader.bfOffBits;
+	if( pBmp->width <= 0  ||  pBmp->height <= 0  ||
+	    (size_t)fileHeader.bfOffBits + pBmp->rowPitch * pBmp->height > pBmp->numBytes )
+	{
+		LOG_INFO( "BMP file '%s' is truncated or has a bad size: %d x %d\n", filename, pBmp->width, pBmp->height );
+		BmpClose( pBmp );
+		return false;
+	}
+
+	return true;
+}
+
+
+
+// ******************************************
+// READ JUST THE SIZE OUT OF A BMP'S HEADERS:
+// ******************************************
+
+// cheap enough for the main thread -- only the first 26 bytes get read
+// BmpOpen( ) still does all of the checking
+
+bool
+BmpReadSize( IN const char * filename, OUT int * pWidth, OUT int * pHeight )
+{
+	FILE * fp;
+#ifdef _WIN32
+	errno_t err = fopen_s( &fp, filename, "rb" );
+	if( err != 0 )
+		fp = NULL;
+#else
+	fp = fopen( filename, "rb" );
+#endif
+	if( fp == NULL )
+		return false;
+
+	unsigned char h[26];
+	size_t n = fread( h, 1, sizeof(h), fp );
+	fclose( fp );
+	if( n != sizeof(h)  ||  BmpGet16( &h[0] ) != 0x4d42 )
+		return false;
+
+	int biHeight = (int)BmpGet32( &h[22] );
+	*pWidth  = (int)BmpGet32( &h[18] );
+	*pHeight = biHeight < 0 ? -biHeight : biHeight;
+	return *pWidth > 0  &&  *pHeight > 0;
+}
+
+
+
+// *************************************
+// DECODE THE PIXELS INTO RGBA, 4 BYTES:
+// *************************************
+
+// dst must have room for 4*width*height bytes
+// row 0 of dst is the bottom row of the image, no matter how the file stores it
+
+void
+BmpDecodeRgba( IN struct bmpFile * pBmp, OUT unsigned char * dst, int isa )
+{
+	bmpRowFunc rowFunc = BmpRowFuncFor( pBmp->bitCount, pBmp->hasAlpha, isa );
+	size_t dstPitch = 4 * (size_t)pBmp->width;
+	for( int t = 0; t < pBmp->height; t++ )
+	{
+		int fileRow = pBmp->topDown ? ( pBmp->height - 1 - t ) : t;
+		( *rowFunc )( pBmp->pixels + fileRow * pBmp->rowPitch, dst + t * dstPitch, pBmp->width );
+	}
+}
+
+
+void
+BmpClose( INOUT struct bmpFile * pBmp )
+{
+	if( pBmp->bytes == nullptr )
+		return;
+#ifdef __linux__
+	if( pBmp->mapped )
+		munmap( pBmp->bytes, pBmp->numBytes );
+	else
+#endif
+		delete [ ] pBmp->bytes;
+	pBmp->bytes = (unsigned char *)nullptr;
+}
+
+
+
+// **************************************
+// THE OLD WAY -- FOR THE BENCHMARK ONLY:
+// **************************************
+
+// this is the fgetc( ) loop that the bmp textures used to be read with
+
+bool
+BmpLoadWithFgetc( IN const char * filename, OUT unsigned char * texture )
+{
+	FILE * fp;
+#ifdef _WIN32
+	errno_t err = fopen_s( &fp, filename, "rb" );
+	if( err != 0 )
+		return false;
+#else
+	fp = fopen( filename, "rb" );
+	if( fp == NULL )
+		return false;
+#endif
+
+	FileHeader.bfType = ReadShort( fp );
+	FileHeader.bfSize = ReadInt( fp );
+	FileHeader.bfReserved1 = ReadShort( fp );
+	FileHeader.bfReserved2 = ReadShort( fp );
+	FileHeader.bfOffBits = ReadInt( fp );
+
+	InfoHeader.biSize = ReadInt( fp );
+	InfoHeader.biWidth = ReadInt( fp );
+	InfoHeader.biHeight = ReadInt( fp );
+	InfoHeader.biPlanes = ReadShort( fp );
+	InfoHeader.biBitCount = ReadShort( fp );
+	InfoHeader.biCompression = ReadInt( fp );
+	InfoHeader.biSizeImage = ReadInt( fp );
+	InfoHeader.biXPelsPerMeter = ReadInt( fp );
+	InfoHeader.biYPelsPerMeter = ReadInt( fp );
+	InfoHeader.biClrUsed = ReadInt( fp );
+	InfoHeader.biClrImportant = ReadInt( fp );
+
+	uint32_t texWidth  = InfoHeader.biWidth;
+	uint32_t texHeight = InfoHeader.biHeight;
+	int numExtra =  4*(( (3*InfoHeader.biWidth)+3)/4) - 3*InfoHeader.biWidth;
+
+	fseek( fp, 14+40, SEEK_SET );
+
+	unsigned char *tp = texture;
+	for( unsigned int t = 0; t < texHeight; t++ )
+	{
+		for( unsigned int s = 0; s < texWidth; s++, tp += 4 )
+		{
+			*(tp+3) = 255;			// a
+			*(tp+2) = fgetc( fp );		// b
+			*(tp+1) = fgetc( fp );		// g
+			*(tp+0) = fgetc( fp );		// r
+		}
+
+		for( int e = 0; e < numExtra; e++ )
+		{
+			fgetc( fp );
+		}
+	}
+	fclose( fp );
+	return true;
+}
+
+
+
+// *******************************
+// THE BMP LOADER MICRO-BENCHMARK:
+// *******************************
+
+// run with --bmp-bench to compare the fgetc( ) loop against the new loader on the same file
+// the file should be in the disk cache after the first pass, so this mostly measures the decode
+
+int
+BmpBenchmark( IN const char * filename, int numTrials )
+{
+	struct bmpFile bmp;
+	if( ! BmpOpen( filename, OUT &bmp ) )
+		return 1;
+	int width = bmp.width;
+	int height = bmp.height;
+	int bitCount = bmp.bitCount;
+	size_t numTexels = (size_t)width * height;
+	bool compareOld = bmp.bitCount == 24  &&  ! bmp.topDown;		// all that the old loop could read
+	BmpClose( &bmp );
+
+	unsigned char * reference = new unsigned char[ 4 * numTexels ];
+	unsigned char * texture   = new unsigned char[ 4 * numTexels ];
+
+	fprintf( stderr, "BMP benchmark: '%s', %d x %d x %d bits, %d trials, best isa = %s\n",
+		filename, width, height, bitCount, numTrials, BmpIsaNames[ BmpBestIsa( ) ] );
+
+	if( compareOld )
+	{
+		double best = 1.e30;
+		for( int trial = 0; trial < numTrials; trial++ )
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+			BmpLoadWithFgetc( filename, reference );
+			double dt = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+			if( dt < best )
+				best = dt;
+		}
+		fprintf( stderr, "\t%-20s %8.3f ms  %8.1f Mtexels/s\n", "fgetc", 1000.*best, (double)numTexels / best / 1.e6 );
+	}
+
+	for( int isa = BMP_ISA_SCALAR; isa <= BmpBestIsa( ); isa++ )
+	{
+		double best = 1.e30;
+		for( int trial = 0; trial < numTrials; trial++ )
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+			BmpOpen( filename, OUT &bmp );
+			BmpDecodeRgba( &bmp, texture, isa );
+			BmpClose( &bmp );
+			double dt = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+			if( dt < best )
+				best = dt;
+		}
+
+		if( isa == BMP_ISA_SCALAR  &&  ! compareOld )
+			memcpy( reference, texture, 4 * numTexels );		// nothing else to check against
+		bool same = memcmp( reference, texture, 4 * numTexels ) == 0;
+		fprintf( stderr, "\t%-20s %8.3f ms  %8.1f Mtexels/s  %s\n", BmpIsaNames[isa], 1000.*best, (double)numTexels / best / 1.e6,
+			same ? "(matches)" : "(DOES NOT MATCH)" );
+	}
+
+	delete [ ] reference;
+	delete [ ] texture;
+	return 0;
+}
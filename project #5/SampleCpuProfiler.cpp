@@ -0,0 +1,247 @@
+// ****************************************************************************************************
+// CPU PROFILER WITH CHROME-TRACE OUTPUT:
+//
+// HERE_I_AM( ) says where the program is, but not how long it spent there.  A zone says both:
+//	{
+//		CPU_ZONE( "Init08Swapchain" );
+//		...
+//	}
+// times from the CPU_ZONE( ) to the end of the enclosing block.  A zone that ends part way through a block:
+//	struct cpuZone zone( "record" );
+//	...
+//	zone.end( );
+// Zone names have to be string literals (only the pointer gets kept).
+//
+// Each thread writes its finished zones into its own ring of CPU_TRACE_RING_SIZE events, so recording
+// takes no lock -- when a ring fills up, its oldest zones get overwritten.  The clock is steady_clock,
+// relative to CpuProfilerInit( ).
+//
+// Run with --trace file.json to turn it on.  At exit the rings get written out as Chrome trace-event
+// JSON, which chrome://tracing or https://ui.perfetto.dev can open.  Each thread is its own track.
+// The "first frame presented" mark shows the time to the first frame.
+// Without --trace, a zone costs one test of CpuTraceOn.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define CPU_TRACE_RING_SIZE	65536		// zones kept per thread
+
+#define CPU_ZONE_NAME2(line)	cpuZone_##line
+#define CPU_ZONE_NAME(line)	CPU_ZONE_NAME2(line)
+#define CPU_ZONE(s)		struct cpuZone CPU_ZONE_NAME(__LINE__)( s )
+
+
+struct cpuTraceEvent
+{
+	const char *	name;
+	int64_t		start;			// nanoseconds since CpuProfilerInit( )
+	int64_t		end;
+	bool		mark;			// true = an instant, not a zone
+};
+
+
+// one per thread that has recorded anything -- kept until CpuProfilerWrite( ), so a thread can finish before the trace is written:
+
+struct cpuTraceRing
+{
+	int				tid;
+	std::string			threadName;
+	std::vector<struct cpuTraceEvent>	events;
+	size_t				next;		// where the next event goes
+	bool				wrapped;	// true = events[next] is the oldest
+};
+
+bool					CpuTraceOn;
+std::string				CpuTraceFilename;
+std::chrono::steady_clock::time_point	CpuTraceStart;
+std::mutex				CpuTraceMutex;			// only for adding a ring to CpuTraceRings
+std::vector<struct cpuTraceRing *>	CpuTraceRings;
+static thread_local struct cpuTraceRing *	CpuTraceMine;		// this thread's ring
+
+
+static int64_t
+CpuTraceNow( )
+{
+	return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now( ) - CpuTraceStart ).count( );
+}
+
+
+static struct cpuTraceRing *
+CpuTraceRing( )
+{
+	if( CpuTraceMine == NULL )
+	{
+		struct cpuTraceRing * ring = new struct cpuTraceRing;
+		ring->events.resize( CPU_TRACE_RING_SIZE );
+		ring->next = 0;
+		ring->wrapped = false;
+
+		std::lock_guard<std::mutex> lock( CpuTraceMutex );
+		ring->tid = (int)CpuTraceRings.size( );
+		ring->threadName = ring->tid == 0 ? "main" : "thread " + std::to_string( ring->tid );
+		CpuTraceRings.push_back( ring );
+		CpuTraceMine = ring;
+	}
+	return CpuTraceMine;
+}
+
+
+static void
+CpuTraceRecord( IN const char * name, int64_t start, int64_t end, bool mark )
+{
+	struct cpuTraceRing * ring = CpuTraceRing( );
+	struct cpuTraceEvent & e = ring->events[ ring->next ];
+	e.name = name;
+	e.start = start;
+	e.end = end;
+	e.mark = mark;
+	ring->next++;
+	if( ring->next == ring->events.size( ) )
+	{
+		ring->next = 0;
+		ring->wrapped = true;
+	}
+}
+
+
+// what CPU_ZONE( ) makes -- records itself when it goes out of scope:
+
+struct cpuZone
+{
+	const char *	name;
+	int64_t		start;
+
+	cpuZone( IN const char * s )
+	{
+		name = s;
+		start = CpuTraceOn ? CpuTraceNow( ) : 0;
+	}
+
+	~cpuZone( )
+	{
+		end( );
+	}
+
+	// for a zone that has to end before its block does:
+
+	void
+	end( )
+	{
+		if( CpuTraceOn  &&  name != NULL )
+			CpuTraceRecord( name, start, CpuTraceNow( ), false );
+		name = NULL;
+	}
+};
+
+
+
+// **********************
+// START RECORDING ZONES:
+// **********************
+
+// call from the main thread, before anything else is zoned, so the main thread gets track 0
+// a NULL or empty filename leaves the profiler off
+
+void
+CpuProfilerInit( IN const char * filename )
+{
+	CpuTraceStart = std::chrono::steady_clock::now( );
+	if( filename == NULL  ||  filename[0] == '\0' )
+		return;
+
+	CpuTraceFilename = filename;
+	CpuTraceOn = true;
+	CpuTraceRing( );
+}
+
+
+
+// ***********************************
+// MARK ONE MOMENT (AN INSTANT EVENT):
+// ***********************************
+
+void
+CpuProfilerMark( IN const char * name )
+{
+	if( ! CpuTraceOn )
+		return;
+
+	int64_t now = CpuTraceNow( );
+	CpuTraceRecord( name, now, now, true );
+}
+
+
+// milliseconds since CpuProfilerInit( ), whether or not the profiler is on:
+
+double
+CpuProfilerMilliseconds( )
+{
+	return (double)CpuTraceNow( ) / 1000000.;
+}
+
+
+
+// **********************************
+// WRITE THE CHROME TRACE-EVENT JSON:
+// **********************************
+
+// call once nothing is recording any more (after ThreadPoolDestroy( ))
+
+void
+CpuProfilerWrite( )
+{
+	if( ! CpuTraceOn )
+		return;
+	CpuTraceOn = false;
+
+	FILE * fp;
+#ifdef _WIN32
+	errno_t err = fopen_s( &fp, CpuTraceFilename.c_str( ), "w" );
+	if( err != 0 )
+		fp = NULL;
+#else
+	fp = fopen( CpuTraceFilename.c_str( ), "w" );
+#endif
+	if( fp == NULL )
+	{
+		LOG_INFO( "Cannot write the cpu trace file '%s'\n", CpuTraceFilename.c_str( ) );
+		return;
+	}
+
+	// timestamps in the trace-event format are microseconds:
+
+	int numEvents = 0;
+	fprintf( fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+	for( size_t r = 0; r < CpuTraceRings.size( ); r++ )
+	{
+		struct cpuTraceRing * ring = CpuTraceRings[r];
+		fprintf( fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			r == 0 ? "" : ",\n", ring->tid, ring->threadName.c_str( ) );
+
+		size_t count = ring->wrapped ? ring->events.size( ) : ring->next;
+		size_t first = ring->wrapped ? ring->next : 0;
+		for( size_t i = 0; i < count; i++ )
+		{
+			struct cpuTraceEvent & e = ring->events[ ( first + i ) % ring->events.size( ) ];
+			if( e.mark )
+			{
+				fprintf( fp, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+					e.name, ring->tid, (double)e.start / 1000. );
+			}
+			else
+			{
+				fprintf( fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					e.name, ring->tid, (double)e.start / 1000., (double)( e.end - e.start ) / 1000. );
+			}
+			numEvents++;
+		}
+	}
+	fprintf( fp, "\n]}\n" );
+	fclose( fp );
+
+	LOG_INFO( "Wrote %d cpu zones from %d threads to '%s'\n", numEvents, (int)CpuTraceRings.size( ), CpuTraceFilename.c_str( ) );
+
+	for( size_t r = 0; r < CpuTraceRings.size( ); r++ )
+		delete CpuTraceRings[r];
+	CpuTraceRings.clear( );
+}
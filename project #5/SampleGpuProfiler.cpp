@@ -0,0 +1,366 @@
+// ****************************************************************************************************
+// GPU TIMESTAMP PROFILER:
+//
+// glfwGetTime( ) only says how long the cpu took.  To see where the gpu's time goes, named scopes
+// get wrapped around parts of the command buffer:
+//	int scope = Begin06GpuScope( commandBuffer, "render pass" );
+//	...
+//	End06GpuScope( commandBuffer, scope );
+// Each scope writes a timestamp query at its start (top of pipe) and at its end (bottom of pipe).
+// A render pass whose draws are all in secondary command buffers cannot have timestamps written in the
+// primary, so there Reserve06GpuScope( ) takes the scope's queries on the main thread, and the secondary
+// that gets recorded (maybe on a worker, maybe frames earlier) writes them with Write06GpuTimestamp( ).
+//
+// Every frame-in-flight has its own slice of the query pool.  A frame's results are read back when
+// Begin06GpuProfilerFrame( ) reuses its slice -- FRAME_LAG frames later, after RenderScene( ) has waited
+// on that frame's fence -- so reading them never stalls.  The ticks get turned into milliseconds with
+// timestampPeriod, and each scope name keeps its last GPU_PROFILER_WINDOW times for the min/avg/p99.
+//
+// For a benchmark, Keep06GpuScopeTimes( true ) also keeps every time, not just the last GPU_PROFILER_WINDOW,
+// until Take06GpuScopeTimes( ) hands them over.
+//
+// A queue family without timestamps (timestampValidBits == 0) turns the whole thing into no-ops.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define GPU_PROFILER_MAX_SCOPES		96		// per frame -- scopes past this are not timed (one per draw group, plus a few)
+#define GPU_PROFILER_WINDOW		256		// how many of the most recent times each scope keeps
+
+
+struct gpuScopeStats
+{
+	std::string		name;
+	std::vector<double>	samples;		// milliseconds, a ring of up to GPU_PROFILER_WINDOW
+	size_t			next;			// where the next sample goes once the ring is full
+	std::vector<double>	kept;			// every sample since keeping was turned on
+};
+
+
+// one scope recorded into a frame's command buffer:
+
+struct gpuScopeQuery
+{
+	int		stats;				// index into GpuScopeStats
+	bool		ended;				// false = End06GpuScope( ) was never called, so it has no end time
+};
+
+VkQueryPool				GpuQueryPool;
+bool					GpuProfilerOn;
+double					GpuTimestampPeriod;		// nanoseconds per tick
+uint64_t				GpuTimestampMask;		// the bits of a timestamp that mean something
+std::vector<struct gpuScopeStats>	GpuScopeStats;
+std::map<std::string, int>		GpuScopeByName;			// index into GpuScopeStats
+std::vector<struct gpuScopeQuery>	GpuFrameScopes[FRAME_LAG];	// what each frame-in-flight's slice holds
+VkCommandBuffer				GpuFrameCommandBuffer;		// the command buffer that the current frame's scopes go into
+bool					GpuKeepTimes;			// true = also put every sample in kept
+
+
+// scope s of frame f uses queries 2*s (begin) and 2*s+1 (end) of the frame's slice:
+
+static uint32_t
+GpuQueryIndex( int frame, int scope )
+{
+	return (uint32_t)( 2 * ( frame * GPU_PROFILER_MAX_SCOPES + scope ) );
+}
+
+
+// read a frame's slice back into the per-scope times -- the frame's fence has already been waited on:
+
+static void
+GpuCollectFrame( int frame )
+{
+	std::vector<struct gpuScopeQuery> & scopes = GpuFrameScopes[frame];
+	if( scopes.empty( ) )
+		return;
+
+	// each query comes back as { value, availability }:
+
+	std::vector<uint64_t> results( 2 * 2 * scopes.size( ), 0 );
+	VkResult result = vkGetQueryPoolResults( LogicalDevice, GpuQueryPool, GpuQueryIndex( frame, 0 ), (uint32_t)( 2 * scopes.size( ) ),
+				results.size( ) * sizeof(uint64_t), OUT results.data( ), 2 * sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT );	// no WAIT -- a query that is not there yet is skipped
+	if( result != VK_SUCCESS  &&  result != VK_NOT_READY )
+	{
+		scopes.clear( );
+		return;
+	}
+
+	for( size_t s = 0; s < scopes.size( ); s++ )
+	{
+		uint64_t * begin = &results[ 4 * s ];
+		uint64_t * end   = &results[ 4 * s + 2 ];
+		if( ! scopes[s].ended  ||  begin[1] == 0  ||  end[1] == 0 )
+			continue;
+
+		uint64_t ticks = ( end[0] - begin[0] ) & GpuTimestampMask;
+		double ms = (double)ticks * GpuTimestampPeriod / 1000000.;
+
+		struct gpuScopeStats & stats = GpuScopeStats[ scopes[s].stats ];
+		if( GpuKeepTimes )
+			stats.kept.push_back( ms );
+		if( stats.samples.size( ) < GPU_PROFILER_WINDOW )
+			stats.samples.push_back( ms );
+		else
+		{
+			stats.samples[ stats.next ] = ms;
+			stats.next = ( stats.next + 1 ) % GPU_PROFILER_WINDOW;
+		}
+	}
+	scopes.clear( );
+}
+
+
+
+// *****************************
+// CREATE THE TIMESTAMP QUERIES:
+// *****************************
+
+VkResult
+Init06GpuProfiler( )
+{
+	HERE_I_AM( "Init06GpuProfiler" );
+	CPU_ZONE( "Init06GpuProfiler" );
+
+	VkResult result = VK_SUCCESS;
+	GpuProfilerOn = false;
+
+	uint32_t count = -1;
+	vkGetPhysicalDeviceQueueFamilyProperties( IN PhysicalDevice, &count, OUT (VkQueueFamilyProperties *)nullptr );
+	VkQueueFamilyProperties *vqfp = new VkQueueFamilyProperties[ count ];
+	vkGetPhysicalDeviceQueueFamilyProperties( IN PhysicalDevice, &count, OUT vqfp );
+	uint32_t validBits = vqfp[ GraphicsQueueFamily ].timestampValidBits;
+	delete[ ] vqfp;
+
+	if( validBits == 0 )
+	{
+		LOG_INFO( "GPU profiler: the graphics queue family has no timestamps -- not timing anything\n" );
+		return result;
+	}
+	GpuTimestampMask = validBits >= 64 ? ~(uint64_t)0 : ( (uint64_t)1 << validBits ) - 1;
+	GpuTimestampPeriod = (double)PhysicalDeviceProperties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo			vqpci;
+		vqpci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		vqpci.pNext = nullptr;
+		vqpci.flags = 0;
+		vqpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		vqpci.queryCount = 2 * FRAME_LAG * GPU_PROFILER_MAX_SCOPES;
+		vqpci.pipelineStatistics = 0;
+
+	result = vkCreateQueryPool( LogicalDevice, IN &vqpci, PALLOCATOR, OUT &GpuQueryPool );
+	REPORT( "vkCreateQueryPool" );
+	if( result != VK_SUCCESS )
+		return result;
+
+	GpuProfilerOn = true;
+	LOG_INFO( "GPU profiler: %d valid timestamp bits, %.3f ns per tick\n", validBits, GpuTimestampPeriod );
+	return result;
+}
+
+
+
+// **************************************
+// START TIMING A FRAME'S COMMAND BUFFER:
+// **************************************
+
+// call right after vkBeginCommandBuffer( ), once the frame's fence has been waited on
+// (it reads back what this frame-in-flight's slice timed FRAME_LAG frames ago, then resets the slice)
+
+void
+Begin06GpuProfilerFrame( VkCommandBuffer commandBuffer )
+{
+	if( ! GpuProfilerOn )
+		return;
+
+	GpuCollectFrame( CurrentFrame );
+	vkCmdResetQueryPool( commandBuffer, GpuQueryPool, GpuQueryIndex( CurrentFrame, 0 ), 2 * GPU_PROFILER_MAX_SCOPES );
+	GpuFrameCommandBuffer = commandBuffer;
+}
+
+
+
+// ****************************
+// START AND END A NAMED SCOPE:
+// ****************************
+
+// add a scope to this frame's list -- -1 if the slice is full:
+
+static int
+GpuAddScope( IN const char * name, bool ended )
+{
+	std::vector<struct gpuScopeQuery> & scopes = GpuFrameScopes[CurrentFrame];
+	if( scopes.size( ) >= GPU_PROFILER_MAX_SCOPES )
+		return -1;
+
+	std::map<std::string, int>::iterator it = GpuScopeByName.find( name );
+	if( it == GpuScopeByName.end( ) )
+	{
+		GpuScopeByName[ name ] = (int)GpuScopeStats.size( );
+		GpuScopeStats.push_back( gpuScopeStats( ) );
+		GpuScopeStats.back( ).name = name;
+		GpuScopeStats.back( ).next = 0;
+		it = GpuScopeByName.find( name );
+	}
+
+	struct gpuScopeQuery scope;
+	scope.stats = it->second;
+	scope.ended = ended;
+	scopes.push_back( scope );
+	return (int)scopes.size( ) - 1;
+}
+
+
+// returns -1 if the scope is not being timed -- End06GpuScope( ) ignores that
+// scopes can nest, and can be inside or outside a render pass (but not start in one and end outside it)
+
+int
+Begin06GpuScope( VkCommandBuffer commandBuffer, IN const char * name )
+{
+	if( ! GpuProfilerOn  ||  commandBuffer != GpuFrameCommandBuffer )
+		return -1;
+
+	int s = GpuAddScope( name, false );
+	if( s >= 0 )
+		vkCmdWriteTimestamp( commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, GpuQueryPool, GpuQueryIndex( CurrentFrame, s ) );
+	return s;
+}
+
+
+void
+End06GpuScope( VkCommandBuffer commandBuffer, int s )
+{
+	if( s < 0  ||  ! GpuProfilerOn  ||  commandBuffer != GpuFrameCommandBuffer )
+		return;
+
+	vkCmdWriteTimestamp( commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, GpuQueryPool, GpuQueryIndex( CurrentFrame, s ) + 1 );
+	GpuFrameScopes[CurrentFrame][s].ended = true;
+}
+
+
+
+// *******************************************
+// A SCOPE WHOSE TIMESTAMPS ARE WRITTEN LATER:
+// *******************************************
+
+// call on the main thread, in the same order every frame, so a scope keeps its index while
+// a secondary command buffer that writes it gets re-submitted -- returns -1 if it is not being timed
+
+int
+Reserve06GpuScope( IN const char * name )
+{
+	if( ! GpuProfilerOn )
+		return -1;
+
+	return GpuAddScope( name, true );		// the secondary writes both ends
+}
+
+
+// can be called from any thread, on a command buffer that will run in frame-in-flight frame's slot:
+
+void
+Write06GpuTimestamp( VkCommandBuffer commandBuffer, int s, int frame, bool end )
+{
+	if( s < 0  ||  ! GpuProfilerOn )
+		return;
+
+	vkCmdWriteTimestamp( commandBuffer, end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		GpuQueryPool, GpuQueryIndex( frame, s ) + ( end ? 1 : 0 ) );
+}
+
+
+
+// ***************************
+// REPORT THE PER-SCOPE TIMES:
+// ***************************
+
+void
+Report06GpuProfiler( )
+{
+	if( ! GpuProfilerOn )
+		return;
+
+	for( size_t i = 0; i < GpuScopeStats.size( ); i++ )
+	{
+		std::vector<double> samples = GpuScopeStats[i].samples;
+		if( samples.empty( ) )
+			continue;
+
+		std::sort( samples.begin( ), samples.end( ) );
+		double sum = 0.;
+		for( size_t j = 0; j < samples.size( ); j++ )
+			sum += samples[j];
+		size_t p99 = ( 99 * ( samples.size( ) - 1 ) ) / 100;
+		LOG_INFO( "GPU %-18s: min = %7.3f ms ; avg = %7.3f ms ; p99 = %7.3f ms  (last %d frames)\n",
+			GpuScopeStats[i].name.c_str( ), samples.front( ), sum / (double)samples.size( ), samples[p99], (int)samples.size( ) );
+	}
+}
+
+
+
+// **********************************************
+// READ BACK EVERY FRAME THAT IS STILL IN FLIGHT:
+// **********************************************
+
+// the device must be idle
+
+void
+Flush06GpuProfiler( )
+{
+	if( ! GpuProfilerOn )
+		return;
+
+	for( int f = 0; f < FRAME_LAG; f++ )
+		GpuCollectFrame( f );
+}
+
+
+
+// **************************************
+// KEEP EVERY TIME (FOR A BENCHMARK RUN):
+// **************************************
+
+// turning keeping on or off throws away whatever was kept before
+
+void
+Keep06GpuScopeTimes( bool keep )
+{
+	GpuKeepTimes = keep;
+	for( size_t i = 0; i < GpuScopeStats.size( ); i++ )
+		GpuScopeStats[i].kept.clear( );
+}
+
+
+// hands over (and forgets) every time the named scope has kept -- none if it was never timed:
+
+void
+Take06GpuScopeTimes( IN const char * name, OUT std::vector<double> * pTimes )
+{
+	pTimes->clear( );
+	std::map<std::string, int>::iterator it = GpuScopeByName.find( name );
+	if( it == GpuScopeByName.end( ) )
+		return;
+
+	pTimes->swap( GpuScopeStats[ it->second ].kept );
+}
+
+
+
+// ***********************
+// DESTROY THE QUERY POOL:
+// ***********************
+
+// the device must be idle -- the frames still in flight get counted first
+
+void
+Destroy06GpuProfiler( )
+{
+	if( ! GpuProfilerOn )
+		return;
+
+	Flush06GpuProfiler( );
+	Report06GpuProfiler( );
+
+	vkDestroyQueryPool( LogicalDevice, GpuQueryPool, PALLOCATOR );
+	GpuProfilerOn = false;
+}
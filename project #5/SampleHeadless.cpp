@@ -0,0 +1,318 @@
+// ****************************************************************************************************
+// HEADLESS (OFFSCREEN) RENDERING:
+//
+// With --headless there is no window, no surface, and no swapchain, so the sample can run on a machine
+// with no display -- or no gpu at all, under a software ICD such as lavapipe:
+//	* InitGLFW( ) and InitGLFWSurface( ) are skipped, and so are the surface instance extensions
+//	  and VK_KHR_swapchain
+//	* Init08Offscreen( ) takes the place of Init08Swapchain( ) -- it creates --images (SWAPCHAINIMAGECOUNT)
+//	  device-local color images and puts them in PresentImages and PresentImageViews, so the
+//	  framebuffers and the render pass get built the same way as always
+//	* RenderScene( ) takes the images round-robin instead of acquiring them, and does not present
+//	* the loop runs as fast as it can for --frames N frames, then reports the frames per second
+//
+// With --dump-every N, every Nth frame gets copied into one slice of a host-visible readback ring
+// (FRAME_LAG slices).  The slice is read FRAME_LAG frames later, after RenderScene( ) has waited on that
+// frame's fence, so the copy never stalls the loop.  A thread-pool job then writes the frame out as
+// headless-NNNNN.ppm and logs a checksum of its pixels, for regression checks.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define OFFSCREEN_FORMAT		VK_FORMAT_B8G8R8A8_SRGB		// the same as the swapchain's
+#define OFFSCREEN_FILE_FORMAT		"headless-%05d.ppm"
+
+
+std::vector<MyAllocation>	OffscreenImageMemory;		// one per image
+MyBuffer		OffscreenReadback;			// FRAME_LAG slices of Width x Height BGRA pixels
+VkDeviceSize		OffscreenSliceSize;			// bytes per frame-in-flight
+int			OffscreenSliceFrame[FRAME_LAG];		// which frame each slice holds, 0 = none
+double			OffscreenStartTime;			// when the first frame started
+std::atomic<int>	OffscreenWritesInFlight;		// image files still being written
+std::atomic<int>	OffscreenImagesWritten;
+
+
+// write one frame's pixels to a file -- runs on a worker thread:
+
+static void
+OffscreenWriteFrame( int frame, IN std::vector<unsigned char> * pixels )
+{
+	CPU_ZONE( "OffscreenWriteFrame" );
+
+	// the image is BGRA, a ppm is RGB:
+
+	size_t numPixels = (size_t)Width * (size_t)Height;
+	std::vector<unsigned char> rgb( 3 * numPixels );
+	uint64_t checksum = 14695981039346656037ULL;		// 64-bit fnv-1a
+	for( size_t p = 0; p < numPixels; p++ )
+	{
+		rgb[3*p+0] = (*pixels)[4*p+2];
+		rgb[3*p+1] = (*pixels)[4*p+1];
+		rgb[3*p+2] = (*pixels)[4*p+0];
+		for( int c = 0; c < 3; c++ )
+		{
+			checksum ^= rgb[3*p+c];
+			checksum *= 1099511628211ULL;
+		}
+	}
+	delete pixels;
+
+	char filename[64];
+	snprintf( filename, sizeof(filename), OFFSCREEN_FILE_FORMAT, frame );
+
+	FILE * fp;
+#ifdef _WIN32
+	errno_t err = fopen_s( &fp, filename, "wb" );
+	if( err != 0 )
+		fp = NULL;
+#else
+	fp = fopen( filename, "wb" );
+#endif
+	if( fp == NULL )
+	{
+		LOG_INFO( "Cannot write the headless frame '%s'\n", filename );
+	}
+	else
+	{
+		fprintf( fp, "P6\n%d %d\n255\n", Width, Height );
+		fwrite( rgb.data( ), 1, rgb.size( ), fp );
+		fclose( fp );
+		OffscreenImagesWritten++;
+		LOG_INFO( "Headless frame %5d: '%s', checksum = 0x%016llx\n", frame, filename, (unsigned long long)checksum );
+	}
+
+	OffscreenWritesInFlight--;
+}
+
+
+
+// *******************************************************
+// CREATE THE OFFSCREEN IMAGES (INSTEAD OF A SWAPCHAIN'S):
+// *******************************************************
+
+VkResult
+Init08Offscreen( )
+{
+	HERE_I_AM( "Init08Offscreen" );
+	CPU_ZONE( "Init08Offscreen" );
+
+	VkResult result = VK_SUCCESS;
+
+	SwapchainImageCount = RequestedImageCount > 0 ? RequestedImageCount : 1;	// there is no driver to ask
+	ImageFences.assign( SwapchainImageCount, (VkFence)VK_NULL_HANDLE );
+	OffscreenImageMemory.resize( SwapchainImageCount );
+	PresentImages = new VkImage[ SwapchainImageCount ];
+	PresentImageViews = new VkImageView[ SwapchainImageCount ];
+
+	VkExtent3D ve3d = { Width, Height, 1 };
+
+	for( uint32_t i = 0; i < SwapchainImageCount; i++ )
+	{
+		VkImageCreateInfo			vici;
+			vici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			vici.pNext = nullptr;
+			vici.flags = 0;
+			vici.imageType = VK_IMAGE_TYPE_2D;
+			vici.format = OFFSCREEN_FORMAT;
+			vici.extent = ve3d;
+			vici.mipLevels = 1;
+			vici.arrayLayers = 1;
+			vici.samples = VK_SAMPLE_COUNT_1_BIT;
+			vici.tiling = VK_IMAGE_TILING_OPTIMAL;
+			vici.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			vici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			vici.queueFamilyIndexCount = 0;
+			vici.pQueueFamilyIndices = (const uint32_t *)nullptr;
+			vici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		result = vkCreateImage( LogicalDevice, IN &vici, PALLOCATOR, OUT &PresentImages[i] );
+		REPORT( "vkCreateImage -- offscreen" );
+
+		VkMemoryRequirements			vmr;
+		vkGetImageMemoryRequirements( LogicalDevice, IN PresentImages[i], OUT &vmr );
+
+		result = Alloc05Memory( vmr, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, OUT &OffscreenImageMemory[i] );
+		REPORT( "Alloc05Memory -- offscreen" );
+		if( result != VK_SUCCESS )
+			return result;
+
+		result = vkBindImageMemory( LogicalDevice, PresentImages[i], OffscreenImageMemory[i].vdm, OffscreenImageMemory[i].offset );
+		REPORT( "vkBindImageMemory -- offscreen" );
+
+		VkImageViewCreateInfo			vivci;
+			vivci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			vivci.pNext = nullptr;
+			vivci.flags = 0;
+			vivci.image = PresentImages[i];
+			vivci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			vivci.format = OFFSCREEN_FORMAT;
+			vivci.components.r = VK_COMPONENT_SWIZZLE_R;
+			vivci.components.g = VK_COMPONENT_SWIZZLE_G;
+			vivci.components.b = VK_COMPONENT_SWIZZLE_B;
+			vivci.components.a = VK_COMPONENT_SWIZZLE_A;
+			vivci.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			vivci.subresourceRange.baseMipLevel = 0;
+			vivci.subresourceRange.levelCount = 1;
+			vivci.subresourceRange.baseArrayLayer = 0;
+			vivci.subresourceRange.layerCount = 1;
+
+		result = vkCreateImageView( LogicalDevice, IN &vivci, PALLOCATOR, OUT &PresentImageViews[i] );
+		REPORT( "vkCreateImageView -- offscreen" );
+	}
+
+	// the readback ring only gets made if frames are going to be written out:
+
+	OffscreenSliceSize = 0;
+	for( int f = 0; f < FRAME_LAG; f++ )
+		OffscreenSliceFrame[f] = 0;
+	OffscreenWritesInFlight.store( 0 );
+	OffscreenImagesWritten.store( 0 );
+
+	if( HeadlessDumpEvery > 0 )
+	{
+		OffscreenSliceSize = (VkDeviceSize)Width * (VkDeviceSize)Height * 4;
+		result = Init05DataBuffer( FRAME_LAG * OffscreenSliceSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, OUT &OffscreenReadback );
+		REPORT( "Init05DataBuffer -- offscreen readback" );
+	}
+
+	LOG_INFO( "Headless: %d offscreen %d x %d images, %d frames, writing every %d frame(s) out\n",
+		SwapchainImageCount, Width, Height, HeadlessFrames, HeadlessDumpEvery );
+	return result;
+}
+
+
+
+// ***************************************
+// PICK THE IMAGE THIS FRAME RENDERS INTO:
+// ***************************************
+
+// takes the place of vkAcquireNextImageKHR( ) -- there is nothing to wait for, so it just goes round-robin
+
+uint32_t
+Next08OffscreenImage( )
+{
+	if( NumRenders == 1 )
+		OffscreenStartTime = GLFWGetTime( );
+
+	return (uint32_t)( NumRenders - 1 ) % SwapchainImageCount;
+}
+
+
+
+// ****************************************
+// HAND A FINISHED FRAME OFF TO BE WRITTEN:
+// ****************************************
+
+// call right after RenderScene( ) has waited on frame-in-flight f's fence
+// (f's slice then holds what was copied into it FRAME_LAG frames ago)
+
+void
+Collect08Offscreen( int f )
+{
+	int frame = OffscreenSliceFrame[f];
+	if( frame == 0 )
+		return;
+	OffscreenSliceFrame[f] = 0;
+
+	// copy the pixels out of the slice now, so the next copy into it can go ahead -- a worker does the rest:
+
+	unsigned char * slice = (unsigned char *)OffscreenReadback.allocation.mapped + f * OffscreenSliceSize;
+	std::vector<unsigned char> * pixels = new std::vector<unsigned char>( slice, slice + OffscreenSliceSize );
+	OffscreenWritesInFlight++;
+	ThreadPoolSubmit( [ = ]( )
+	{
+		OffscreenWriteFrame( frame, pixels );
+	} );
+}
+
+
+
+// ****************************************
+// COPY THIS FRAME INTO ITS READBACK SLICE:
+// ****************************************
+
+// call after vkCmdEndRenderPass( ) -- the render pass leaves the image in TRANSFER_SRC_OPTIMAL
+// only every HeadlessDumpEvery'th frame gets copied, so measuring the frame rate costs no copies
+
+void
+Record08Readback( VkCommandBuffer commandBuffer, uint32_t imageIndex )
+{
+	if( HeadlessDumpEvery <= 0  ||  NumRenders % HeadlessDumpEvery != 0 )
+		return;
+
+	int readbackScope = Begin06GpuScope( commandBuffer, "readback" );
+
+	VkBufferImageCopy			vbic;
+		vbic.bufferOffset = CurrentFrame * OffscreenSliceSize;
+		vbic.bufferRowLength = 0;		// tightly packed
+		vbic.bufferImageHeight = 0;
+		vbic.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		vbic.imageSubresource.mipLevel = 0;
+		vbic.imageSubresource.baseArrayLayer = 0;
+		vbic.imageSubresource.layerCount = 1;
+		vbic.imageOffset = { 0, 0, 0 };
+		vbic.imageExtent = { Width, Height, 1 };
+
+	vkCmdCopyImageToBuffer( commandBuffer, PresentImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			OffscreenReadback.buffer, 1, IN &vbic );
+
+	// the cpu reads the slice once the fence says the frame is done:
+
+	VkBufferMemoryBarrier			vbmb;
+		vbmb.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		vbmb.pNext = nullptr;
+		vbmb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vbmb.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vbmb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vbmb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vbmb.buffer = OffscreenReadback.buffer;
+		vbmb.offset = CurrentFrame * OffscreenSliceSize;
+		vbmb.size = OffscreenSliceSize;
+
+	vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			0, (VkMemoryBarrier *)nullptr, 1, IN &vbmb, 0, (VkImageMemoryBarrier *)nullptr );
+
+	End06GpuScope( commandBuffer, readbackScope );
+	OffscreenSliceFrame[CurrentFrame] = NumRenders;
+}
+
+
+
+// *******************************************************
+// REPORT THE FRAME RATE AND DESTROY THE OFFSCREEN IMAGES:
+// *******************************************************
+
+// the device must be idle -- the frames still in the ring get written out first
+
+void
+Destroy08Offscreen( )
+{
+	double seconds = GLFWGetTime( ) - OffscreenStartTime;
+	if( NumRenders > 0  &&  seconds > 0. )
+	{
+		LOG_INFO( "Headless: %d frames in %.3f s = %.1f fps\n", NumRenders, seconds, (double)NumRenders / seconds );
+	}
+
+	for( int f = 0; f < FRAME_LAG; f++ )
+		Collect08Offscreen( f );
+	while( OffscreenWritesInFlight.load( ) > 0 )
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	if( HeadlessDumpEvery > 0 )
+		LOG_INFO( "Headless: wrote %d frame(s)\n", OffscreenImagesWritten.load( ) );
+
+	if( OffscreenSliceSize > 0 )
+	{
+		vkDestroyBuffer( LogicalDevice, OffscreenReadback.buffer, PALLOCATOR );
+		Free05Memory( &OffscreenReadback.allocation );
+	}
+
+	for( uint32_t i = 0; i < SwapchainImageCount; i++ )
+	{
+		vkDestroyImageView( LogicalDevice, PresentImageViews[i], PALLOCATOR );
+		vkDestroyImage( LogicalDevice, PresentImages[i], PALLOCATOR );
+		Free05Memory( &OffscreenImageMemory[i] );
+	}
+	delete[ ] PresentImageViews;
+	delete[ ] PresentImages;
+}
@@ -0,0 +1,170 @@
+// ****************************************************************************************************
+// PRESENT MODES, FRAME LIMITING, AND INPUT-TO-PRESENT LATENCY:
+//
+// Which present mode the swapchain asks for is a latency policy -- pick one with --present, or cycle
+// through them with the 's' key (RenderScene( ) then re-makes the swapchain with it).
+//
+// With --fps N, LimitFrameRate( ) holds the frame rate by sleeping *before* the input gets sampled,
+// for just long enough that the frame's work ends right when the next present is due.  Sleeping after
+// the present instead would make every input wait out the sleep too.
+//
+// The GLFW callbacks call NoteInput( ), and NotePresent( ) files the time from the oldest input a frame
+// sampled to vkQueuePresentKHR( ) returning, under the present mode really in use.  With FRAME_LAG
+// frames in flight the gpu may still be drawing that frame when the present returns, so this is the
+// cpu's share of the latency -- the part that the present mode, the image count, and the limiter change.
+// ReportLatency( ) writes the min, average, 99th percentile, and max for each mode at exit.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define FRAME_LIMIT_MARGIN	1.10		// start a little early, in case this frame takes longer than the last ones
+#define FRAME_LIMIT_SPIN	0.001		// sleeping is not that accurate -- spin for the last millisecond
+
+
+// the present modes that can be asked for, with --present or by cycling with the 's' key:
+
+#define NUM_LATENCY_POLICIES	4
+
+struct latencyPolicy
+{
+	const char *		name;
+	VkPresentModeKHR	presentMode;
+} LatencyPolicies[NUM_LATENCY_POLICIES] =
+{
+	{ "mailbox",		VK_PRESENT_MODE_MAILBOX_KHR },		// no tearing, newest frame wins -- use with --images 3
+	{ "immediate",		VK_PRESENT_MODE_IMMEDIATE_KHR },	// lowest latency, may tear
+	{ "fifo",		VK_PRESENT_MODE_FIFO_KHR },		// vsync, always available
+	{ "fifo-relaxed",	VK_PRESENT_MODE_FIFO_RELAXED_KHR },	// vsync, but tears instead of waiting when late
+};
+
+
+int			LatencyPolicy;			// index into LatencyPolicies[ ] -- the present mode asked for
+bool			LatencyPolicyChanged;		// the swapchain needs to be re-made with the new present mode
+VkPresentModeKHR	PresentMode;			// the present mode actually in use
+float			FrameLimit;			// frames per second to hold to, 0 = as fast as the present mode allows
+double			NextPresentTime;		// when the frame limiter wants the next present to happen
+double			FrameWorkSeconds;		// smoothed time from sampling the input to presenting
+double			FrameSampleTime;		// when this frame sampled its input
+double			InputTime = -1.;		// when the oldest input that no frame has sampled yet arrived, < 0 = none
+double			FrameInputTime = -1.;		// the input this frame sampled, < 0 = none
+std::vector<double>	LatencySamples[NUM_LATENCY_POLICIES];	// seconds from an input callback to vkQueuePresentKHR, by the PresentMode in use
+
+
+// --present's argument -> an index into LatencyPolicies[ ], -1 if it is not one of them:
+
+int
+LatencyPolicyNamed( IN const char * name )
+{
+	for( int p = 0; p < NUM_LATENCY_POLICIES; p++ )
+	{
+		if( strcmp( name, LatencyPolicies[p].name ) == 0 )
+			return p;
+	}
+	return -1;
+}
+
+
+
+// *************************************************
+// HOLD THE FRAME RATE WITH AS LITTLE LAG AS CAN BE:
+// *************************************************
+
+// call at the top of the loop, before glfwPollEvents( )
+// does nothing without --fps -- then the present mode is what paces the frames
+
+void
+LimitFrameRate( )
+{
+	if( FrameLimit <= 0. )
+		return;
+
+	CPU_ZONE( "LimitFrameRate" );
+
+	double now = GLFWGetTime( );
+	if( NextPresentTime < now )
+		NextPresentTime = now;			// fell behind -- do not try to catch up
+
+	double wakeTime = NextPresentTime - FRAME_LIMIT_MARGIN * FrameWorkSeconds;
+	if( wakeTime - now > FRAME_LIMIT_SPIN )
+		std::this_thread::sleep_for( std::chrono::duration<double>( wakeTime - now - FRAME_LIMIT_SPIN ) );
+	while( GLFWGetTime( ) < wakeTime )
+		;
+
+	NextPresentTime += 1. / (double)FrameLimit;
+}
+
+
+
+// ******************************
+// MEASURE INPUT-TO-PRESENT TIME:
+// ******************************
+
+// from the GLFW callbacks -- only the oldest input a frame has not sampled yet counts,
+// since that is the one that waited the longest:
+
+void
+NoteInput( )
+{
+	if( InputTime < 0. )
+		InputTime = GLFWGetTime( );
+}
+
+
+// right after glfwPollEvents( ), before the scene gets updated and recorded:
+
+void
+SampleInput( )
+{
+	FrameSampleTime = GLFWGetTime( );
+	FrameInputTime = InputTime;
+	InputTime = -1.;
+}
+
+
+// right after vkQueuePresentKHR( ):
+
+void
+NotePresent( )
+{
+	double now = GLFWGetTime( );
+
+	if( FrameSampleTime > 0. )
+		FrameWorkSeconds = 0.9 * FrameWorkSeconds + 0.1 * ( now - FrameSampleTime );
+	if( FrameInputTime >= 0. )
+	{
+		// file it under the present mode the swapchain really has, not the one asked for --
+		// they differ when the surface did not have it and fifo got used instead:
+
+		for( int p = 0; p < NUM_LATENCY_POLICIES; p++ )
+		{
+			if( LatencyPolicies[p].presentMode == PresentMode )
+				LatencySamples[p].push_back( now - FrameInputTime );
+		}
+	}
+	FrameInputTime = -1.;
+}
+
+
+// min, average, 99th percentile, and max for each present mode that got used:
+
+void
+ReportLatency( )
+{
+	LOG_INFO( "Input-to-present latency (--fps %.1f, %d swapchain images, %d frames in flight):\n",
+		FrameLimit, SwapchainImageCount, FRAME_LAG );
+	for( int p = 0; p < NUM_LATENCY_POLICIES; p++ )
+	{
+		std::vector<double> samples = LatencySamples[p];
+		if( samples.empty( ) )
+			continue;
+
+		std::sort( samples.begin( ), samples.end( ) );
+		double sum = 0.;
+		for( size_t i = 0; i < samples.size( ); i++ )
+			sum += samples[i];
+		size_t p99 = ( 99 * ( samples.size( ) - 1 ) ) / 100;
+		LOG_INFO( "%14s: %6d inputs, min %8.3f ms, avg %8.3f ms, p99 %8.3f ms, max %8.3f ms\n",
+			LatencyPolicies[p].name, (int)samples.size( ), 1000. * samples.front( ), 1000. * sum / (double)samples.size( ),
+			1000. * samples[p99], 1000. * samples.back( ) );
+	}
+}
@@ -0,0 +1,428 @@
+// ****************************************************************************************************
+// ASYNCHRONOUS LOGGER:
+//
+// fprintf( FpDebug, ... ) followed by fflush( FpDebug ) puts a disk write on whatever thread logged --
+// the render loop, the input callbacks, the thread-pool jobs.  The LOG_* macros only format the message
+// and copy it into a ring that belongs to the calling thread; a background thread drains every ring
+// into FpDebug and does the flushing.
+//
+//	LOG_TRACE( ... )	per-frame detail -- compiled out unless LOG_MIN_LEVEL is LOG_LEVEL_TRACE
+//	LOG_DEBUG( ... )	only written while Verbose is on ('v' toggles it)
+//	LOG_INFO( ... )		what FpDebug always got
+//	LOG_WARN( ... )
+//	LOG_ERROR( ... )
+//
+// A level below LOG_MIN_LEVEL compiles to nothing -- its arguments are not even evaluated.  Build with
+// -DLOG_MIN_LEVEL=LOG_LEVEL_INFO (what NDEBUG gives) and the LOG_DEBUG( )s cost nothing at all.
+//
+// Each ring has one writer (its thread) and one reader (the drain thread), so a message goes in with
+// two atomic loads and one atomic store, and no lock.  A full ring drops the message rather than wait,
+// and the drops get counted.  Messages from one thread stay in order; messages from different threads
+// are only in order to within one drain pass.
+//
+// Before LogInit( ) and after LogDestroy( ), the macros write to FpDebug directly, the old way.
+// --log-bench times each kind of logging call against the old fprintf( ) + fflush( ) and exits.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define LOG_LEVEL_TRACE		0
+#define LOG_LEVEL_DEBUG		1
+#define LOG_LEVEL_INFO		2
+#define LOG_LEVEL_WARN		3
+#define LOG_LEVEL_ERROR		4
+
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL		LOG_LEVEL_INFO
+#else
+#define LOG_MIN_LEVEL		LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define LOG_RING_SIZE		(256*1024)	// bytes per thread -- must be a power of 2
+#define LOG_DRAIN_SLEEP		2		// milliseconds the drain thread sleeps when every ring is empty
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(...)		do { LogWrite( LOG_LEVEL_TRACE, __VA_ARGS__ ); } while( 0 )
+#else
+#define LOG_TRACE(...)		do { } while( 0 )
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...)		do { if( Verbose )  LogWrite( LOG_LEVEL_DEBUG, __VA_ARGS__ ); } while( 0 )
+#else
+#define LOG_DEBUG(...)		do { } while( 0 )
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...)		do { LogWrite( LOG_LEVEL_INFO, __VA_ARGS__ ); } while( 0 )
+#else
+#define LOG_INFO(...)		do { } while( 0 )
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...)		do { LogWrite( LOG_LEVEL_WARN, __VA_ARGS__ ); } while( 0 )
+#else
+#define LOG_WARN(...)		do { } while( 0 )
+#endif
+
+#define LOG_ERROR(...)		do { LogWrite( LOG_LEVEL_ERROR, __VA_ARGS__ ); } while( 0 )
+
+
+// one per thread that has logged anything -- kept until LogDestroy( ), so a thread can finish first:
+// a message is a uint32_t byte count followed by that many bytes, wrapping around the end of bytes[ ]
+
+struct logRing
+{
+	unsigned char			bytes[LOG_RING_SIZE];
+	std::atomic<uint64_t>		head;			// total bytes ever written -- only the owning thread stores it
+	std::atomic<uint64_t>		tail;			// total bytes ever drained -- only the drain thread stores it
+	std::atomic<int>		dropped;		// messages that did not fit
+};
+
+FILE *				LogFp;			// where the drain thread writes
+std::atomic<bool>		LogRunning;
+std::thread			LogDrainThread;
+std::mutex			LogRingsMutex;		// only for adding a ring to LogRings
+std::vector<struct logRing *>	LogRings;
+int				LogGeneration;		// goes up with every LogInit( ), so old rings do not get reused
+static thread_local struct logRing *	LogMine;	// this thread's ring
+static thread_local int		LogMineGeneration;
+
+
+static struct logRing *
+LogRing( )
+{
+	if( LogMine == NULL  ||  LogMineGeneration != LogGeneration )
+	{
+		struct logRing * ring = new struct logRing;
+		ring->head.store( 0 );
+		ring->tail.store( 0 );
+		ring->dropped.store( 0 );
+
+		std::lock_guard<std::mutex> lock( LogRingsMutex );
+		LogRings.push_back( ring );
+		LogMine = ring;
+		LogMineGeneration = LogGeneration;
+	}
+	return LogMine;
+}
+
+
+static void
+LogRingCopyIn( struct logRing * ring, uint64_t at, IN const void * from, size_t size )
+{
+	size_t offset = (size_t)( at & ( LOG_RING_SIZE - 1 ) );
+	size_t first = size < LOG_RING_SIZE - offset ? size : LOG_RING_SIZE - offset;
+	memcpy( &ring->bytes[offset], from, first );
+	memcpy( &ring->bytes[0], (const unsigned char *)from + first, size - first );
+}
+
+
+static void
+LogRingCopyOut( struct logRing * ring, uint64_t at, OUT void * to, size_t size )
+{
+	size_t offset = (size_t)( at & ( LOG_RING_SIZE - 1 ) );
+	size_t first = size < LOG_RING_SIZE - offset ? size : LOG_RING_SIZE - offset;
+	memcpy( to, &ring->bytes[offset], first );
+	memcpy( (unsigned char *)to + first, &ring->bytes[0], size - first );
+}
+
+
+// write out everything that is in the rings now -- only the drain thread (or LogDestroy( ), after it stops) calls this:
+
+static bool
+LogDrainOnce( )
+{
+	std::vector<struct logRing *> rings;
+	{
+		std::lock_guard<std::mutex> lock( LogRingsMutex );
+		rings = LogRings;
+	}
+
+	bool wroteAny = false;
+	std::vector<char> message;
+	for( size_t r = 0; r < rings.size( ); r++ )
+	{
+		struct logRing * ring = rings[r];
+		uint64_t tail = ring->tail.load( std::memory_order_relaxed );
+		uint64_t head = ring->head.load( std::memory_order_acquire );	// sees the bytes written before the head moved
+		while( tail < head )
+		{
+			uint32_t length;
+			LogRingCopyOut( ring, tail, OUT &length, sizeof(length) );
+			message.resize( length );
+			LogRingCopyOut( ring, tail + sizeof(length), OUT message.data( ), length );
+			fwrite( message.data( ), 1, length, LogFp );
+			tail += sizeof(length) + length;
+			wroteAny = true;
+		}
+		ring->tail.store( tail, std::memory_order_release );		// the writer can reuse the space now
+	}
+
+	if( wroteAny )
+		fflush( LogFp );
+	return wroteAny;
+}
+
+
+static void
+LogDrain( )
+{
+	while( LogRunning.load( ) )
+	{
+		if( ! LogDrainOnce( ) )
+			std::this_thread::sleep_for( std::chrono::milliseconds( LOG_DRAIN_SLEEP ) );
+	}
+	LogDrainOnce( );
+}
+
+
+
+// ************************************
+// FORMAT A MESSAGE AND QUEUE IT UP:
+// ************************************
+
+// called through the LOG_* macros -- never waits on the disk
+
+void
+LogWrite( int level, IN const char * format, ... )
+{
+	char small[512];
+	va_list args;
+	va_start( args, format );
+	int length = vsnprintf( small, sizeof(small), format, args );
+	va_end( args );
+	if( length < 0 )
+		return;
+
+	const char * text = small;
+	std::string big;
+	if( length >= (int)sizeof(small) )
+	{
+		big.resize( length + 1 );
+		va_start( args, format );
+		vsnprintf( &big[0], big.size( ), format, args );
+		va_end( args );
+		text = big.c_str( );
+	}
+
+	if( ! LogRunning.load( std::memory_order_relaxed ) )
+	{
+		fwrite( text, 1, length, FpDebug );		// not started yet, or already stopped
+		if( level >= LOG_LEVEL_WARN )
+			fflush( FpDebug );
+		return;
+	}
+
+	struct logRing * ring = LogRing( );
+	uint32_t size = (uint32_t)length;
+	uint64_t head = ring->head.load( std::memory_order_relaxed );
+	uint64_t tail = ring->tail.load( std::memory_order_acquire );
+	if( LOG_RING_SIZE - ( head - tail ) < sizeof(size) + size )
+	{
+		ring->dropped++;
+		return;
+	}
+
+	LogRingCopyIn( ring, head, &size, sizeof(size) );
+	LogRingCopyIn( ring, head + sizeof(size), text, size );
+	ring->head.store( head + sizeof(size) + size, std::memory_order_release );
+}
+
+
+
+// ************************
+// START THE DRAIN THREAD:
+// ************************
+
+void
+LogInit( IN FILE * fp )
+{
+	LogFp = fp;
+	LogGeneration++;
+	LogRunning.store( true );
+	LogDrainThread = std::thread( LogDrain );
+}
+
+
+
+// ***************************************
+// WAIT FOR EVERYTHING SO FAR TO BE WRITTEN:
+// ***************************************
+
+void
+LogFlush( )
+{
+	if( ! LogRunning.load( ) )
+	{
+		fflush( FpDebug );
+		return;
+	}
+
+	for( ; ; )
+	{
+		bool empty = true;
+		{
+			std::lock_guard<std::mutex> lock( LogRingsMutex );
+			for( size_t r = 0; r < LogRings.size( ); r++ )
+			{
+				if( LogRings[r]->tail.load( ) != LogRings[r]->head.load( ) )
+					empty = false;
+			}
+		}
+		if( empty )
+			break;
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	}
+}
+
+
+// how many messages did not fit in their ring:
+
+int
+LogDropped( )
+{
+	std::lock_guard<std::mutex> lock( LogRingsMutex );
+	int dropped = 0;
+	for( size_t r = 0; r < LogRings.size( ); r++ )
+		dropped += LogRings[r]->dropped.load( );
+	return dropped;
+}
+
+
+
+// ********************************************
+// DRAIN WHAT IS LEFT AND STOP THE DRAIN THREAD:
+// ********************************************
+
+// the rings stay allocated only until here -- nothing may be logging on another thread
+// (anything logged after this goes straight to FpDebug)
+
+void
+LogDestroy( )
+{
+	if( ! LogRunning.load( ) )
+		return;
+
+	LogRunning.store( false );
+	LogDrainThread.join( );
+
+	int dropped = LogDropped( );
+	if( dropped != 0 )
+		fprintf( LogFp, "Logger: %d messages were dropped because their ring was full\n", dropped );
+	fflush( LogFp );
+
+	for( size_t r = 0; r < LogRings.size( ); r++ )
+		delete LogRings[r];
+	LogRings.clear( );
+}
+
+
+
+// *****************************************
+// TIME EACH KIND OF LOGGING CALL (AND EXIT):
+// *****************************************
+
+// the calls go into a scratch file in bursts that fit in the ring, with the drain waited for between bursts,
+// so what gets timed is only what the logging thread itself pays for
+// (runs before glfwInit( ), so it times with steady_clock)
+
+#define LOG_BENCH_BURSTS	100
+#define LOG_BENCH_PER_BURST	1000
+#define LOG_BENCH_FILE		"logbench.txt"
+
+int
+LogBenchmark( )
+{
+	FILE * fp;
+#ifdef _WIN32
+	errno_t err = fopen_s( &fp, LOG_BENCH_FILE, "w" );
+	if( err != 0 )
+		fp = NULL;
+#else
+	fp = fopen( LOG_BENCH_FILE, "w" );
+#endif
+	if( fp == NULL )
+	{
+		fprintf( stderr, "Cannot open '%s'\n", LOG_BENCH_FILE );
+		return 1;
+	}
+
+	const char * names[5] =
+	{
+		"fprintf + fflush (the old REPORT)",
+		"LOG_INFO",
+		"LOG_DEBUG, Verbose off",
+		"LOG_TRACE, compiled out",
+		"fprintf, no fflush",
+	};
+	double ns[5];
+	bool saveVerbose = Verbose;
+	FILE * saveFpDebug = FpDebug;
+	FpDebug = fp;
+
+	for( int kind = 0; kind < 5; kind++ )
+	{
+		Verbose = kind != 2;
+		if( kind == 1 || kind == 2 || kind == 3 )
+			LogInit( fp );
+
+		double seconds = 0.;
+		for( int b = 0; b < LOG_BENCH_BURSTS; b++ )
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+			for( int i = 0; i < LOG_BENCH_PER_BURST; i++ )
+			{
+				switch( kind )
+				{
+					case 0:
+						fprintf( fp, "%s: %s (%d)\n", "vkQueueSubmit", "Successful", i );
+						fflush( fp );
+						break;
+
+					case 1:
+						LOG_INFO( "%s: %s (%d)\n", "vkQueueSubmit", "Successful", i );
+						break;
+
+					case 2:
+						LOG_DEBUG( "%s: %s (%d)\n", "vkQueueSubmit", "Successful", i );
+						break;
+
+					case 3:
+						LOG_TRACE( "%s: %s (%d)\n", "vkQueueSubmit", "Successful", i );
+						break;
+
+					case 4:
+						fprintf( fp, "%s: %s (%d)\n", "vkQueueSubmit", "Successful", i );
+						break;
+				}
+			}
+			seconds += std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+			LogFlush( );
+		}
+		ns[kind] = 1.e9 * seconds / (double)( LOG_BENCH_BURSTS * LOG_BENCH_PER_BURST );
+
+		if( LogRunning.load( ) )
+		{
+			int dropped = LogDropped( );
+			LogDestroy( );
+			if( dropped != 0 )
+				fprintf( stderr, "(%s dropped %d messages -- the timing is too good)\n", names[kind], dropped );
+		}
+	}
+
+	FpDebug = saveFpDebug;
+	Verbose = saveVerbose;
+	fclose( fp );
+	remove( LOG_BENCH_FILE );
+
+	fprintf( stderr, "Logging benchmark, %d calls each:\n", LOG_BENCH_BURSTS * LOG_BENCH_PER_BURST );
+	for( int kind = 0; kind < 5; kind++ )
+	{
+		fprintf( stderr,  "%36s: %8.1f ns per call\n", names[kind], ns[kind] );
+		fprintf( FpDebug, "%36s: %8.1f ns per call\n", names[kind], ns[kind] );
+	}
+	return 0;
+}
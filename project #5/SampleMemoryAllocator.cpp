@@ -0,0 +1,317 @@
+// ****************************************************************************************************
+// GPU MEMORY SUB-ALLOCATOR:
+//
+// Rather than one vkAllocateMemory( ) per buffer or image, memory comes out of big blocks
+// (MEMORY_BLOCK_SIZE bytes each) using a buddy allocator:
+//	* every allocation is rounded up to a power of 2, so it is always aligned to its own size
+//	* freeing an allocation merges it with its "buddy" whenever the buddy is free too
+//
+// Blocks are kept separate by memory type and by "kind" (linear = buffers, optimal = tiled images),
+// so a buffer and an optimal image never share a page and bufferImageGranularity can be ignored.
+// Host-visible blocks are mapped once, when they are created, and stay mapped.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define MEMORY_BLOCK_SIZE	(64*1024*1024)		// bytes per block -- must be a power of 2
+#define MEMORY_MIN_ORDER	8			// the smallest allocation is 2^8 = 256 bytes
+#define MEMORY_MAX_ORDERS	40			// enough orders for a 2^39 byte block
+
+#define MEMORY_KIND_LINEAR	0			// buffers and linearly-tiled images
+#define MEMORY_KIND_OPTIMAL	1			// optimally-tiled images
+
+
+// one big piece of device memory, carved up by the buddy allocator:
+
+struct memoryBlock
+{
+	VkDeviceMemory		vdm;
+	uint32_t		memoryType;
+	int			kind;
+	bool			dedicated;		// true = holds one allocation that was too big for a normal block
+	VkDeviceSize		size;
+	int			topOrder;		// size = 2^topOrder (unless dedicated)
+	unsigned char *		mapped;			// cpu address of the block, if host-visible
+	int			numAllocations;
+	std::set<VkDeviceSize>	freeLists[MEMORY_MAX_ORDERS];	// offsets of the free pieces of each size
+};
+
+std::vector<struct memoryBlock *>	MemoryBlocks;
+VkDeviceSize				MemoryBytesUsed;	// bytes the callers asked for
+VkDeviceSize				MemoryBytesAllocated;	// bytes handed out, after rounding up to a power of 2
+int					MemoryNumAllocations;
+
+
+static int
+MemoryOrderFor( VkDeviceSize size )
+{
+	int order = MEMORY_MIN_ORDER;
+	while( ( (VkDeviceSize)1 << order ) < size )
+		order++;
+	return order;
+}
+
+
+// make a new block for this memory type and kind:
+
+static struct memoryBlock *
+MemoryNewBlock( uint32_t memoryType, int kind, VkDeviceSize size, bool dedicated )
+{
+	VkMemoryAllocateInfo			vmai;
+		vmai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		vmai.pNext = nullptr;
+		vmai.allocationSize = size;
+		vmai.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory vdm;
+	VkResult result = vkAllocateMemory( LogicalDevice, IN &vmai, PALLOCATOR, OUT &vdm );
+	REPORT( "vkAllocateMemory -- memory block" );
+	if( result != VK_SUCCESS )
+		return (struct memoryBlock *)nullptr;
+
+	struct memoryBlock * block = new struct memoryBlock;
+	block->vdm = vdm;
+	block->memoryType = memoryType;
+	block->kind = kind;
+	block->dedicated = dedicated;
+	block->size = size;
+	block->topOrder = dedicated ? -1 : MemoryOrderFor( size );
+	block->mapped = (unsigned char *)nullptr;
+	block->numAllocations = 0;
+	if( ! dedicated )
+		block->freeLists[block->topOrder].insert( 0 );
+
+	VkPhysicalDeviceMemoryProperties	vpdmp;
+	vkGetPhysicalDeviceMemoryProperties( PhysicalDevice, OUT &vpdmp );
+	if( ( vpdmp.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ) != 0 )
+	{
+		void * pGpuMemory;
+		result = vkMapMemory( LogicalDevice, IN vdm, OFFSET_ZERO, VK_WHOLE_SIZE, 0, OUT &pGpuMemory );	// 0 is the flags bitmask
+		REPORT( "vkMapMemory -- memory block" );
+		block->mapped = (unsigned char *)pGpuMemory;
+	}
+
+	MemoryBlocks.push_back( block );
+
+	if( Verbose )
+	{
+		LOG_INFO( "New memory block: type %d, kind %d, %lld bytes%s, %d blocks now\n",
+			memoryType, kind, (long long)size, dedicated ? " (dedicated)" : "", (int)MemoryBlocks.size( ) );
+	}
+
+	return block;
+}
+
+
+// take a piece of size 2^order out of a block, splitting bigger pieces as needed
+// returns false if the block does not have room:
+
+static bool
+MemoryTakeFromBlock( struct memoryBlock * block, int order, OUT VkDeviceSize * pOffset )
+{
+	int k = order;
+	while( k <= block->topOrder  &&  block->freeLists[k].empty( ) )
+		k++;
+	if( k > block->topOrder )
+		return false;
+
+	VkDeviceSize offset = *block->freeLists[k].begin( );
+	block->freeLists[k].erase( block->freeLists[k].begin( ) );
+
+	// split down to the size we want, putting the upper halves back on the free lists:
+
+	while( k > order )
+	{
+		k--;
+		block->freeLists[k].insert( offset + ( (VkDeviceSize)1 << k ) );
+	}
+
+	*pOffset = offset;
+	return true;
+}
+
+
+static void
+MemoryFreeBlock( int b )
+{
+	struct memoryBlock * block = MemoryBlocks[b];
+	if( block->mapped != nullptr )
+		vkUnmapMemory( LogicalDevice, block->vdm );
+	vkFreeMemory( LogicalDevice, block->vdm, PALLOCATOR );
+	delete block;
+	MemoryBlocks.erase( MemoryBlocks.begin( ) + b );
+}
+
+
+
+// ***************************
+// ALLOCATE A PIECE OF MEMORY:
+// ***************************
+
+// memoryFlags are the VK_MEMORY_PROPERTY_* bits that must all be present
+// linear is true for buffers and linear images, false for optimal images
+
+VkResult
+Alloc05Memory( IN VkMemoryRequirements vmr, VkMemoryPropertyFlags memoryFlags, bool linear, OUT MyAllocation * pMyAllocation )
+{
+	int memoryType = FindMemoryByFlagAndType( (VkMemoryPropertyFlagBits)memoryFlags, vmr.memoryTypeBits );
+	if( memoryType < 0 )
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+	int kind = linear ? MEMORY_KIND_LINEAR : MEMORY_KIND_OPTIMAL;
+
+	VkDeviceSize size = vmr.size > vmr.alignment ? vmr.size : vmr.alignment;
+	int order = MemoryOrderFor( size );
+
+	struct memoryBlock * block = (struct memoryBlock *)nullptr;
+	VkDeviceSize offset = 0;
+
+	if( ( (VkDeviceSize)1 << order ) > MEMORY_BLOCK_SIZE )
+	{
+		// too big to share a block -- give it one of its own:
+
+		block = MemoryNewBlock( memoryType, kind, vmr.size, true );
+		order = -1;
+	}
+	else
+	{
+		for( size_t b = 0; b < MemoryBlocks.size( ); b++ )
+		{
+			struct memoryBlock * candidate = MemoryBlocks[b];
+			if( candidate->memoryType != (uint32_t)memoryType  ||  candidate->kind != kind  ||  candidate->dedicated )
+				continue;
+			if( MemoryTakeFromBlock( candidate, order, OUT &offset ) )
+			{
+				block = candidate;
+				break;
+			}
+		}
+
+		if( block == nullptr )
+		{
+			block = MemoryNewBlock( memoryType, kind, MEMORY_BLOCK_SIZE, false );
+			if( block != nullptr )
+				MemoryTakeFromBlock( block, order, OUT &offset );
+		}
+	}
+
+	if( block == nullptr )
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+	block->numAllocations++;
+
+	pMyAllocation->vdm = block->vdm;
+	pMyAllocation->offset = offset;
+	pMyAllocation->size = vmr.size;
+	pMyAllocation->order = order;
+	pMyAllocation->mapped = block->mapped != nullptr ? (void *)( block->mapped + offset ) : nullptr;
+
+	MemoryBytesUsed += vmr.size;
+	MemoryBytesAllocated += order >= 0 ? ( (VkDeviceSize)1 << order ) : vmr.size;
+	MemoryNumAllocations++;
+
+	return VK_SUCCESS;
+}
+
+
+
+// ***********************
+// FREE A PIECE OF MEMORY:
+// ***********************
+
+void
+Free05Memory( INOUT MyAllocation * pMyAllocation )
+{
+	if( pMyAllocation->vdm == VK_NULL_HANDLE )
+		return;
+
+	for( int b = 0; b < (int)MemoryBlocks.size( ); b++ )
+	{
+		struct memoryBlock * block = MemoryBlocks[b];
+		if( block->vdm != pMyAllocation->vdm )
+			continue;
+
+		MemoryBytesUsed -= pMyAllocation->size;
+		MemoryBytesAllocated -= pMyAllocation->order >= 0 ? ( (VkDeviceSize)1 << pMyAllocation->order ) : pMyAllocation->size;
+		MemoryNumAllocations--;
+		block->numAllocations--;
+
+		if( ! block->dedicated )
+		{
+			// merge with the buddy for as long as the buddy is free:
+
+			VkDeviceSize offset = pMyAllocation->offset;
+			int order = pMyAllocation->order;
+			while( order < block->topOrder )
+			{
+				VkDeviceSize buddy = offset ^ ( (VkDeviceSize)1 << order );
+				std::set<VkDeviceSize>::iterator it = block->freeLists[order].find( buddy );
+				if( it == block->freeLists[order].end( ) )
+					break;
+				block->freeLists[order].erase( it );
+				if( buddy < offset )
+					offset = buddy;
+				order++;
+			}
+			block->freeLists[order].insert( offset );
+		}
+
+		// give empty blocks back to the driver:
+
+		if( block->numAllocations == 0 )
+			MemoryFreeBlock( b );
+		break;
+	}
+
+	pMyAllocation->vdm = VK_NULL_HANDLE;
+	pMyAllocation->mapped = nullptr;
+}
+
+
+
+// *****************************
+// GET THE ALLOCATOR STATISTICS:
+// *****************************
+
+void
+Stats05Memory( OUT MyMemoryStats * pMyStats )
+{
+	pMyStats->bytesUsed = MemoryBytesUsed;
+	pMyStats->bytesWasted = MemoryBytesAllocated - MemoryBytesUsed;		// lost to rounding up
+	pMyStats->bytesReserved = 0;
+	for( size_t b = 0; b < MemoryBlocks.size( ); b++ )
+		pMyStats->bytesReserved += MemoryBlocks[b]->size;
+	pMyStats->numBlocks = (int)MemoryBlocks.size( );
+	pMyStats->numAllocations = MemoryNumAllocations;
+}
+
+
+void
+Report05Memory( )
+{
+	MyMemoryStats stats;
+	Stats05Memory( OUT &stats );
+	LOG_INFO( "Device memory: %.2f MB used, %.2f MB wasted, %.2f MB reserved in %d blocks, %d allocations\n",
+		(double)stats.bytesUsed / 1048576., (double)stats.bytesWasted / 1048576., (double)stats.bytesReserved / 1048576.,
+		stats.numBlocks, stats.numAllocations );
+}
+
+
+
+// **************************
+// DESTROY ALL OF THE BLOCKS:
+// **************************
+
+void
+Destroy05MemoryAllocator( )
+{
+	if( Verbose  &&  MemoryNumAllocations != 0 )
+		LOG_INFO( "Destroy05MemoryAllocator: %d allocations were never freed\n", MemoryNumAllocations );
+
+	while( ! MemoryBlocks.empty( ) )
+		MemoryFreeBlock( (int)MemoryBlocks.size( ) - 1 );
+
+	MemoryBytesUsed = 0;
+	MemoryBytesAllocated = 0;
+	MemoryNumAllocations = 0;
+}
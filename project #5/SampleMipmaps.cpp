@@ -0,0 +1,146 @@
+// ****************************************************************************************************
+// CPU MIPMAP GENERATION:
+//
+// The fallback for when the texture format cannot be vkCmdBlitImage'd with linear filtering.
+// Each level is a 2x2 box filter of the level above it (odd sizes clamp at the edge).
+// The rows of each level are split across the thread pool, and the inner loop uses SSE2
+// to average 8 source texels into 4 destination texels at a time.
+//
+// Note: the averaging is done on the stored bytes, so for sRGB textures it is (slightly) too dark --
+// the gpu blit path does it in linear space.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define MIP_SSE2
+#include <emmintrin.h>
+#endif
+
+
+// how many mip levels a full chain has for this size:
+
+uint32_t
+MipNumLevels( uint32_t width, uint32_t height )
+{
+	uint32_t size = width > height ? width : height;
+	uint32_t levels = 1;
+	while( size > 1 )
+	{
+		size /= 2;
+		levels++;
+	}
+	return levels;
+}
+
+
+static inline uint32_t
+MipNext( uint32_t size )
+{
+	return size > 1 ? size / 2 : 1;
+}
+
+
+// make destination rows [firstRow,lastRow) of a level from the level above it:
+
+static void
+MipDownsampleRows( const unsigned char * src, uint32_t sw, uint32_t sh, unsigned char * dst, uint32_t dw, int firstRow, int lastRow )
+{
+	for( int t = firstRow; t < lastRow; t++ )
+	{
+		uint32_t t0 = 2 * t;
+		uint32_t t1 = t0 + 1 < sh ? t0 + 1 : sh - 1;
+		const unsigned char * row0 = src + 4 * (size_t)sw * t0;
+		const unsigned char * row1 = src + 4 * (size_t)sw * t1;
+		unsigned char * out = dst + 4 * (size_t)dw * t;
+
+		uint32_t s = 0;
+#ifdef MIP_SSE2
+		const __m128i zero = _mm_setzero_si128( );
+		const __m128i two  = _mm_set1_epi16( 2 );
+		for( ; 2 * s + 8 <= sw  &&  s + 4 <= dw; s += 4 )
+		{
+			// 8 texels from each row = 4 texels out:
+
+			__m128i a0 = _mm_loadu_si128( (const __m128i *)( row0 + 8 * s ) );
+			__m128i a1 = _mm_loadu_si128( (const __m128i *)( row0 + 8 * s + 16 ) );
+			__m128i b0 = _mm_loadu_si128( (const __m128i *)( row1 + 8 * s ) );
+			__m128i b1 = _mm_loadu_si128( (const __m128i *)( row1 + 8 * s + 16 ) );
+
+			// widen to 16 bits and add the two rows -- each register holds 2 texels:
+
+			__m128i s01 = _mm_add_epi16( _mm_unpacklo_epi8( a0, zero ), _mm_unpacklo_epi8( b0, zero ) );
+			__m128i s23 = _mm_add_epi16( _mm_unpackhi_epi8( a0, zero ), _mm_unpackhi_epi8( b0, zero ) );
+			__m128i s45 = _mm_add_epi16( _mm_unpacklo_epi8( a1, zero ), _mm_unpacklo_epi8( b1, zero ) );
+			__m128i s67 = _mm_add_epi16( _mm_unpackhi_epi8( a1, zero ), _mm_unpackhi_epi8( b1, zero ) );
+
+			// add each pair of neighboring texels, round, and divide by 4:
+
+			__m128i lo = _mm_add_epi16( _mm_unpacklo_epi64( s01, s23 ), _mm_unpackhi_epi64( s01, s23 ) );
+			__m128i hi = _mm_add_epi16( _mm_unpacklo_epi64( s45, s67 ), _mm_unpackhi_epi64( s45, s67 ) );
+			lo = _mm_srli_epi16( _mm_add_epi16( lo, two ), 2 );
+			hi = _mm_srli_epi16( _mm_add_epi16( hi, two ), 2 );
+
+			_mm_storeu_si128( (__m128i *)( out + 4 * s ), _mm_packus_epi16( lo, hi ) );
+		}
+#endif
+		for( ; s < dw; s++ )
+		{
+			uint32_t s0 = 2 * s;
+			uint32_t s1 = s0 + 1 < sw ? s0 + 1 : sw - 1;
+			for( int c = 0; c < 4; c++ )
+			{
+				int sum = row0[4*s0+c] + row0[4*s1+c] + row1[4*s0+c] + row1[4*s1+c];
+				out[4*s+c] = (unsigned char)( ( sum + 2 ) >> 2 );
+			}
+		}
+	}
+}
+
+
+
+// *************************************
+// MAKE ALL OF THE LEVELS BELOW LEVEL 0:
+// *************************************
+
+// level0 is width x height rgba texels
+// dst gets levels 1 through mipLevels-1, one after the other, each tightly packed
+
+void
+MipGenerateChain( IN const unsigned char * level0, uint32_t width, uint32_t height, uint32_t mipLevels, OUT unsigned char * dst )
+{
+	const unsigned char * src = level0;
+	uint32_t sw = width;
+	uint32_t sh = height;
+	for( uint32_t level = 1; level < mipLevels; level++ )
+	{
+		uint32_t dw = MipNext( sw );
+		uint32_t dh = MipNext( sh );
+
+		ThreadPoolParallelFor( (int)dh, 16, [ = ]( int first, int last )
+		{
+			MipDownsampleRows( src, sw, sh, dst, dw, first, last );
+		} );
+
+		src = dst;
+		dst += 4 * (size_t)dw * dh;
+		sw = dw;
+		sh = dh;
+	}
+}
+
+
+// how many bytes MipGenerateChain( ) needs for levels 1 and below:
+
+VkDeviceSize
+MipChainBytes( uint32_t width, uint32_t height, uint32_t mipLevels )
+{
+	VkDeviceSize bytes = 0;
+	for( uint32_t level = 1; level < mipLevels; level++ )
+	{
+		width  = MipNext( width );
+		height = MipNext( height );
+		bytes += 4 * (VkDeviceSize)width * height;
+	}
+	return bytes;
+}
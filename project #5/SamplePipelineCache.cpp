@@ -0,0 +1,260 @@
+// ****************************************************************************************************
+// PIPELINE CACHES THAT SURVIVE BETWEEN RUNS:
+//
+// Creating a pipeline is where the driver compiles the SPIR-V into gpu code.
+// A VkPipelineCache remembers that work; saving its contents to a file at exit and seeding
+// the next run's cache from it lets a warm start skip the compiling.
+//
+// The file is our own small header followed by exactly what vkGetPipelineCacheData( ) gave back.
+// The header records which gpu and driver made the data -- a different gpu or driver version
+// (or a damaged file) means the data gets thrown away and the run starts cold.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define PIPELINE_CACHE_MAGIC	0x43504b56		// "VKPC"
+#define PIPELINE_CACHE_VERSION	1
+
+
+struct pipelineCacheFileHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	vendorID;
+	uint32_t	deviceID;
+	uint32_t	driverVersion;
+	uint8_t		pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t	dataSize;		// bytes of cache data after this header
+	uint64_t	dataHash;		// FNV-1a of the cache data
+};
+
+double		PipelineCreateSeconds;		// total time spent in vkCreate*Pipelines( )
+int		PipelineCreateCount;
+int		PipelineCacheWarm;		// how many caches were seeded from a file
+std::mutex	PipelineCreateMutex;		// pipelines also get created on worker threads
+
+
+static uint64_t
+PipelineCacheHash( const unsigned char * data, size_t size )
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for( size_t i = 0; i < size; i++ )
+	{
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+
+// does the file's data belong to this gpu and driver?
+
+static bool
+PipelineCacheHeaderIsGood( IN struct pipelineCacheFileHeader * h, size_t bytesAfterHeader )
+{
+	VkPhysicalDeviceProperties & p = PhysicalDeviceProperties;
+	if( h->magic != PIPELINE_CACHE_MAGIC  ||  h->version != PIPELINE_CACHE_VERSION )
+		return false;
+	if( h->vendorID != p.vendorID  ||  h->deviceID != p.deviceID  ||  h->driverVersion != p.driverVersion )
+		return false;
+	if( memcmp( h->pipelineCacheUUID, p.pipelineCacheUUID, VK_UUID_SIZE ) != 0 )
+		return false;
+	return h->dataSize == bytesAfterHeader;
+}
+
+
+
+// ********************************************
+// CREATE A PIPELINE CACHE, SEEDED FROM A FILE:
+// ********************************************
+
+// a missing or mismatched file is not an error -- it just means a cold start
+
+VkResult
+Init14PipelineCache( IN const char * filename, OUT VkPipelineCache * pPipelineCache )
+{
+	HERE_I_AM( "Init14PipelineCache" );
+	CPU_ZONE( "Init14PipelineCache" );
+
+	VkResult result = VK_SUCCESS;
+
+	unsigned char * file = (unsigned char *)nullptr;
+	size_t fileSize = 0;
+
+	FILE * fp;
+#ifdef _WIN32
+	errno_t err = fopen_s( &fp, filename, "rb" );
+	if( err != 0 )
+		fp = NULL;
+#else
+	fp = fopen( filename, "rb" );
+#endif
+	if( fp != NULL  &&  ! ColdPipelines )
+	{
+		fseek( fp, 0, SEEK_END );
+		long size = ftell( fp );
+		rewind( fp );
+		if( size > 0 )
+		{
+			file = new unsigned char[ size ];
+			fileSize = fread( file, 1, (size_t)size, fp );
+		}
+	}
+	if( fp != NULL )
+		fclose( fp );
+
+	const unsigned char * data = (const unsigned char *)nullptr;
+	size_t dataSize = 0;
+	if( fileSize >= sizeof(struct pipelineCacheFileHeader) )
+	{
+		struct pipelineCacheFileHeader header;
+		memcpy( &header, file, sizeof(header) );
+		size_t bytesAfterHeader = fileSize - sizeof(header);
+		if( PipelineCacheHeaderIsGood( &header, bytesAfterHeader )  &&
+		    PipelineCacheHash( file + sizeof(header), bytesAfterHeader ) == header.dataHash )
+		{
+			data = file + sizeof(header);
+			dataSize = bytesAfterHeader;
+		}
+		else
+		{
+			LOG_INFO( "Pipeline cache '%s' is from a different gpu or driver, or is damaged -- ignoring it\n", filename );
+		}
+	}
+
+	VkPipelineCacheCreateInfo			vpcci;
+		vpcci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		vpcci.pNext = nullptr;
+		vpcci.flags = 0;
+		vpcci.initialDataSize = dataSize;
+		vpcci.pInitialData = (const void *)data;
+
+	result = vkCreatePipelineCache( LogicalDevice, IN &vpcci, PALLOCATOR, OUT pPipelineCache );
+	REPORT( "vkCreatePipelineCache" );
+
+	if( result != VK_SUCCESS  &&  dataSize != 0 )
+	{
+		// the driver did not like the data after all -- start empty:
+
+		vpcci.initialDataSize = 0;
+		vpcci.pInitialData = nullptr;
+		dataSize = 0;
+		result = vkCreatePipelineCache( LogicalDevice, IN &vpcci, PALLOCATOR, OUT pPipelineCache );
+		REPORT( "vkCreatePipelineCache -- empty" );
+	}
+
+	if( dataSize != 0 )
+		PipelineCacheWarm++;
+	LOG_INFO( "Pipeline cache '%s': %s (%lld bytes)\n", filename, dataSize != 0 ? "warm" : "cold", (long long)dataSize );
+
+	delete[ ] file;
+	return result;
+}
+
+
+
+// *********************************
+// WRITE A PIPELINE CACHE TO A FILE:
+// *********************************
+
+// writes a temporary file and renames it, so a crash part way through cannot leave a damaged cache
+
+VkResult
+Save14PipelineCache( IN const char * filename, IN VkPipelineCache pipelineCache )
+{
+	HERE_I_AM( "Save14PipelineCache" );
+	CPU_ZONE( "Save14PipelineCache" );
+
+	if( pipelineCache == VK_NULL_HANDLE )
+		return VK_SUCCESS;
+
+	size_t dataSize = 0;
+	VkResult result = vkGetPipelineCacheData( LogicalDevice, pipelineCache, OUT &dataSize, (void *)nullptr );
+	REPORT( "vkGetPipelineCacheData -- size" );
+	if( result != VK_SUCCESS  ||  dataSize == 0 )
+		return result;
+
+	std::vector<unsigned char> data( dataSize );
+	result = vkGetPipelineCacheData( LogicalDevice, pipelineCache, INOUT &dataSize, OUT data.data( ) );
+	REPORT( "vkGetPipelineCacheData" );
+	if( result != VK_SUCCESS )
+		return result;
+
+	struct pipelineCacheFileHeader header;
+	memset( &header, 0, sizeof(header) );
+	header.magic = PIPELINE_CACHE_MAGIC;
+	header.version = PIPELINE_CACHE_VERSION;
+	header.vendorID = PhysicalDeviceProperties.vendorID;
+	header.deviceID = PhysicalDeviceProperties.deviceID;
+	header.driverVersion = PhysicalDeviceProperties.driverVersion;
+	memcpy( header.pipelineCacheUUID, PhysicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE );
+	header.dataSize = dataSize;
+	header.dataHash = PipelineCacheHash( data.data( ), dataSize );
+
+	std::string tempname = std::string( filename ) + ".tmp";
+	FILE * fp;
+#ifdef _WIN32
+	errno_t err = fopen_s( &fp, tempname.c_str( ), "wb" );
+	if( err != 0 )
+		fp = NULL;
+#else
+	fp = fopen( tempname.c_str( ), "wb" );
+#endif
+	if( fp == NULL )
+	{
+		LOG_INFO( "Cannot write pipeline cache file '%s'\n", tempname.c_str( ) );
+		return VK_INCOMPLETE;
+	}
+
+	bool ok = fwrite( &header, sizeof(header), 1, fp ) == 1  &&  fwrite( data.data( ), 1, dataSize, fp ) == dataSize;
+	ok = fclose( fp ) == 0  &&  ok;
+	if( ok )
+	{
+#ifdef _WIN32
+		remove( filename );			// rename( ) will not replace an existing file on Windows
+#endif
+		ok = rename( tempname.c_str( ), filename ) == 0;
+	}
+	if( ! ok )
+	{
+		LOG_INFO( "Failed writing pipeline cache file '%s'\n", filename );
+		remove( tempname.c_str( ) );
+		return VK_INCOMPLETE;
+	}
+
+	LOG_INFO( "Saved pipeline cache '%s' (%lld bytes)\n", filename, (long long)dataSize );
+	return VK_SUCCESS;
+}
+
+
+
+// ***********************************
+// COUNT ONE PIPELINE CREATION'S TIME:
+// ***********************************
+
+// can be called from any thread
+
+void
+Count14PipelineCreation( double seconds )
+{
+	std::lock_guard<std::mutex> lock( PipelineCreateMutex );
+	PipelineCreateSeconds += seconds;
+	PipelineCreateCount++;
+}
+
+
+
+// **********************************
+// REPORT THE PIPELINE CREATION TIME:
+// **********************************
+
+// run with --cold-pipelines (or delete the cache files) to get the cold-start number to compare against
+// the variants get compiled lazily, in the background, so only the report at exit has all of them in it
+
+void
+Report14PipelineCreation( IN const char * when )
+{
+	std::lock_guard<std::mutex> lock( PipelineCreateMutex );
+	LOG_INFO( "Pipeline creation %s: %d pipelines in %.3f ms, %s start\n",
+		when, PipelineCreateCount, 1000. * PipelineCreateSeconds, PipelineCacheWarm > 0 ? "warm" : "cold" );
+}
@@ -0,0 +1,225 @@
+// ****************************************************************************************************
+// BACKGROUND PIPELINE COMPILER:
+//
+// Creating a pipeline can take long enough to hitch a frame, so the (Mode, UseLighting) variants
+// of the graphics pipeline are never created on the render thread:
+//	* the uber pipeline -- the fragment shader with its specialization constants left at -1, so it
+//	  reads Misc.uMode and Misc.uLighting -- gets created once, up front, and can draw anything
+//	* the first time RenderScene( ) asks Get14GraphicsPipeline( ) for a variant, a thread-pool job
+//	  starts creating it, and draws use the uber pipeline in the meantime
+//	* once the job is done, the next Get14GraphicsPipeline( ) hands back the specialized variant
+//
+// Every frame that drew with the uber pipeline while a variant was compiling counts as a hitch avoided.
+// The compile latency is the time from the first request to the variant being usable.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define VARIANT_NOT_BUILT	0
+#define VARIANT_COMPILING	1		// a job is creating it
+#define VARIANT_DONE		2		// the job is finished -- CompilerPipelines holds the result
+#define VARIANT_READY		3		// in GraphicsPipelines
+#define VARIANT_FAILED		4		// stays on the uber pipeline
+
+VkPipeline		GraphicsUberPipeline;
+std::atomic<int>	CompilerStates[NUM_MODES][NUM_LIGHTINGS];
+VkPipeline		CompilerPipelines[NUM_MODES][NUM_LIGHTINGS];	// written by the job, read once the state is DONE
+double			CompilerRequestTimes[NUM_MODES][NUM_LIGHTINGS];
+std::atomic<int>	CompilerInFlight;				// how many jobs are still running
+
+int			CompilerHitchesAvoided;		// frames drawn with the uber pipeline instead of waiting
+int			CompilerNumCompiled;
+double			CompilerSumLatency;		// seconds
+double			CompilerMaxLatency;
+
+
+// create one variant -- runs on a worker thread:
+
+static void
+CompilerBuildVariant( int mode, int lighting, VkShaderModule vertexShader, VkShaderModule fragmentShader, VkPipeline uber )
+{
+	CPU_ZONE( "CompilerBuildVariant" );
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = Init14GraphicsVertexFragmentPipeline( vertexShader, fragmentShader, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+				mode, lighting, uber, OUT &pipeline );
+	if( result != VK_SUCCESS )
+		pipeline = VK_NULL_HANDLE;
+
+	CompilerPipelines[mode][lighting] = pipeline;
+	CompilerStates[mode][lighting].store( VARIANT_DONE );	// the main thread sees the pipeline once it sees this
+	CompilerInFlight--;
+}
+
+
+
+// *********************************************************
+// CREATE THE UBER PIPELINE THAT ALL DRAWS CAN FALL BACK ON:
+// *********************************************************
+
+VkResult
+Init14PipelineCompiler( )
+{
+	HERE_I_AM( "Init14PipelineCompiler" );
+	CPU_ZONE( "Init14PipelineCompiler" );
+
+	for( int m = 0; m < NUM_MODES; m++ )
+	{
+		for( int l = 0; l < NUM_LIGHTINGS; l++ )
+		{
+			GraphicsPipelines[m][l] = VK_NULL_HANDLE;
+			CompilerPipelines[m][l] = VK_NULL_HANDLE;
+			CompilerStates[m][l].store( VARIANT_NOT_BUILT );
+		}
+	}
+	CompilerInFlight.store( 0 );
+
+	return Init14GraphicsVertexFragmentPipeline( ShaderModuleVertex, ShaderModuleFragment, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+				-1, -1, VK_NULL_HANDLE, OUT &GraphicsUberPipeline );
+}
+
+
+
+// ********************************************
+// GET THE PIPELINE TO DRAW A VARIANT WITH NOW:
+// ********************************************
+
+// never waits -- returns the uber pipeline if the variant is not ready yet
+
+VkPipeline
+Get14GraphicsPipeline( int mode, int lighting )
+{
+	switch( CompilerStates[mode][lighting].load( ) )
+	{
+		case VARIANT_READY:
+			return GraphicsPipelines[mode][lighting];
+
+		case VARIANT_DONE:
+		{
+			VkPipeline pipeline = CompilerPipelines[mode][lighting];
+			CompilerPipelines[mode][lighting] = VK_NULL_HANDLE;
+			if( pipeline == VK_NULL_HANDLE )
+			{
+				LOG_INFO( "Pipeline variant (mode %d, lighting %d) failed to compile -- staying on the uber pipeline\n", mode, lighting );
+				CompilerStates[mode][lighting].store( VARIANT_FAILED );
+				return GraphicsUberPipeline;
+			}
+
+			double latency = GLFWGetTime( ) - CompilerRequestTimes[mode][lighting];
+			CompilerNumCompiled++;
+			CompilerSumLatency += latency;
+			if( latency > CompilerMaxLatency )
+				CompilerMaxLatency = latency;
+			LOG_INFO( "Pipeline variant (mode %d, lighting %d) ready after %.3f ms\n", mode, lighting, 1000. * latency );
+
+			GraphicsPipelines[mode][lighting] = pipeline;
+			CompilerStates[mode][lighting].store( VARIANT_READY );
+			return pipeline;
+		}
+
+		case VARIANT_NOT_BUILT:
+		{
+			CompilerRequestTimes[mode][lighting] = GLFWGetTime( );
+			CompilerStates[mode][lighting].store( VARIANT_COMPILING );
+			CompilerInFlight++;
+
+			// the job gets its own copies of the modules and the base, in case a hot-reload swaps them:
+
+			VkShaderModule vertexShader = ShaderModuleVertex;
+			VkShaderModule fragmentShader = ShaderModuleFragment;
+			VkPipeline uber = GraphicsUberPipeline;
+			ThreadPoolSubmit( [ = ]( )
+			{
+				CompilerBuildVariant( mode, lighting, vertexShader, fragmentShader, uber );
+			} );
+			CompilerHitchesAvoided++;
+			return GraphicsUberPipeline;
+		}
+
+		case VARIANT_COMPILING:
+			CompilerHitchesAvoided++;
+			return GraphicsUberPipeline;
+
+		default:
+			return GraphicsUberPipeline;
+	}
+}
+
+
+
+// ***********************
+// IS A JOB STILL RUNNING:
+// ***********************
+
+// while one is, the shader modules and the uber pipeline it was given must stay alive
+
+bool
+Busy14PipelineCompiler( )
+{
+	return CompilerInFlight.load( ) > 0;
+}
+
+
+
+// *****************************************************
+// START OVER WITH A NEW UBER PIPELINE (AFTER A RELOAD):
+// *****************************************************
+
+// only call when Busy14PipelineCompiler( ) is false
+// everything that was in use goes into *pRetired, for the caller to destroy once the gpu is done with it
+
+void
+Reset14PipelineCompiler( VkPipeline newUber, OUT std::vector<VkPipeline> * pRetired )
+{
+	pRetired->push_back( GraphicsUberPipeline );
+	for( int m = 0; m < NUM_MODES; m++ )
+	{
+		for( int l = 0; l < NUM_LIGHTINGS; l++ )
+		{
+			if( GraphicsPipelines[m][l] != VK_NULL_HANDLE )
+				pRetired->push_back( GraphicsPipelines[m][l] );
+			if( CompilerPipelines[m][l] != VK_NULL_HANDLE )
+				pRetired->push_back( CompilerPipelines[m][l] );
+			GraphicsPipelines[m][l] = VK_NULL_HANDLE;
+			CompilerPipelines[m][l] = VK_NULL_HANDLE;
+			CompilerStates[m][l].store( VARIANT_NOT_BUILT );
+		}
+	}
+	GraphicsUberPipeline = newUber;
+}
+
+
+
+// *******************************
+// REPORT THE COMPILER'S COUNTERS:
+// *******************************
+
+void
+Report14PipelineCompiler( )
+{
+	LOG_INFO( "Pipeline compiler: %d variants compiled in the background, average latency %.3f ms, max %.3f ms, %d hitches avoided\n",
+		CompilerNumCompiled, CompilerNumCompiled > 0 ? 1000. * CompilerSumLatency / CompilerNumCompiled : 0., 1000. * CompilerMaxLatency,
+		CompilerHitchesAvoided );
+}
+
+
+
+// **********************************
+// DESTROY THE UBER AND THE VARIANTS:
+// **********************************
+
+// the device must be idle
+
+void
+Destroy14PipelineCompiler( )
+{
+	while( Busy14PipelineCompiler( ) )
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+
+	Report14PipelineCompiler( );
+
+	std::vector<VkPipeline> pipelines;
+	Reset14PipelineCompiler( VK_NULL_HANDLE, OUT &pipelines );
+	for( size_t i = 0; i < pipelines.size( ); i++ )
+		vkDestroyPipeline( LogicalDevice, pipelines[i], PALLOCATOR );
+}
@@ -0,0 +1,170 @@
+// ****************************************************************************************************
+// ROBOTS ON THE GPU:
+//
+// Each robot is RobotArmDepth arms (three, unless a scene asks for more).  The cpu only decides each robot's
+// three joint angles.  A compute pass turns those angles into every arm's world matrix (the m1g, m21, m32 chain),
+// and writes the matrix, color, and scale into an instance storage buffer.
+// The vertex shader reads its arm from that buffer with gl_InstanceIndex, so all of the robots
+// get drawn with one instanced draw -- ten thousand robots cost the same number of calls as one.
+//
+//	RobotJoints:	host-visible, FRAME_LAG slices, set 4 binding 0 (a dynamic storage buffer)
+//	RobotInstances:	device-local, RobotArmDepth * NumRobots armInstances, set 4 binding 1 for the compute
+//			shader, and set 2 binding 1 for the vertex shader -- so the graphics pipeline needs only
+//			four sets, which is all that maxBoundDescriptorSets is sure to allow
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define ROBOTS_PER_WORKGROUP	64		// local_size_x in sample-robots.comp
+#define ROBOT_SPACING		50.f		// default distance between robots -- a three-arm chain reaches 24
+
+
+// one per robot, written by the cpu:
+
+struct robotJoints
+{
+	glm::vec4	base;			// xyz = where the robot stands
+	glm::vec4	angles;			// xyz = the rotations of arms 1, 2, and 3 about z, in radians
+};
+
+
+// one per arm, written by the compute shader:
+
+struct armInstance
+{
+	glm::mat4	armMatrix;
+	glm::vec4	armColorScale;		// rgb = color, a = scale factor in x
+};
+
+
+// the compute shader's push constants:
+
+struct robotPush
+{
+	glm::vec4	armColorScale[3];
+	uint32_t	numRobots;
+	uint32_t	armDepth;
+};
+
+MyBuffer		RobotJoints;
+VkDeviceSize		RobotJointsSliceSize;		// bytes per frame-in-flight
+MyBuffer		RobotInstances;
+int			RobotGridSide;			// the robots stand in a RobotGridSide x RobotGridSide square
+int			RobotArmDepth;			// arms per robot
+float			RobotSpacing;			// distance between neighboring robots
+
+
+
+// ***************************
+// CREATE THE ROBOTS' BUFFERS:
+// ***************************
+
+// armDepth < 1 and spacing <= 0. mean the defaults (three arms, ROBOT_SPACING)
+
+VkResult
+Robots05Init( int numRobots, int armDepth, float spacing )
+{
+	HERE_I_AM( "Robots05Init" );
+	CPU_ZONE( "Robots05Init" );
+
+	VkResult result = VK_SUCCESS;
+
+	if( numRobots < 1 )
+		numRobots = 1;
+	NumRobots = numRobots;
+	RobotGridSide = (int)ceil( sqrt( (double)NumRobots ) );
+	RobotArmDepth = armDepth >= 1 ? armDepth : 3;
+	RobotSpacing = spacing > 0.f ? spacing : ROBOT_SPACING;
+
+	VkDeviceSize alignment = PhysicalDeviceProperties.limits.minStorageBufferOffsetAlignment;
+	if( alignment == 0 )
+		alignment = 1;
+	RobotJointsSliceSize = NumRobots * sizeof(struct robotJoints);
+	RobotJointsSliceSize = ( ( RobotJointsSliceSize + alignment - 1 ) / alignment ) * alignment;
+
+	// host-coherent, so that writing the angles is all it takes for the gpu to see them:
+
+	result = Init05DataBuffer( FRAME_LAG * RobotJointsSliceSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, OUT &RobotJoints );
+	REPORT( "Init05DataBuffer -- robot joints" );
+
+	result = Init05DataBuffer( RobotArmDepth * NumRobots * sizeof(struct armInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, OUT &RobotInstances );
+	REPORT( "Init05DataBuffer -- robot instances" );
+
+	LOG_INFO( "Robots: %d, in a %d x %d grid, %d arms each\n", NumRobots, RobotGridSide, RobotGridSide, RobotArmDepth );
+	return result;
+}
+
+
+
+// **********************************************
+// RECORD THE COMPUTE PASS THAT POSES THE ROBOTS:
+// **********************************************
+
+// call after the frame's fence wait (this frame's slice of RobotJoints gets overwritten), outside the render pass
+
+void
+Robots14Dispatch( VkCommandBuffer commandBuffer )
+{
+	// every robot's joint angles -- robot 0 moves the way the single robot always did,
+	// the others are offset in phase so they do not all move in lockstep:
+
+	struct robotJoints * joints = (struct robotJoints *)( (unsigned char *)RobotJoints.allocation.mapped + CurrentFrame * RobotJointsSliceSize );
+	float center = 0.5f * (float)( RobotGridSide - 1 );
+	for( int r = 0; r < NumRobots; r++ )
+	{
+		float phase = 0.37f * (float)r;
+		joints[r].base = glm::vec4( RobotSpacing * ( (float)( r % RobotGridSide ) - center ), RobotSpacing * ( (float)( r / RobotGridSide ) - center ), 0.f, 1.f );
+		joints[r].angles = glm::vec4( RobotAngles.x + phase, RobotAngles.y + 2.f*phase, RobotAngles.z + 4.f*phase, 0.f );
+	}
+
+	// the vertex shaders of the last frame that used RobotInstances have to be done reading it:
+
+	vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, (VkMemoryBarrier *)nullptr, 0, (VkBufferMemoryBarrier *)nullptr, 0, (VkImageMemoryBarrier *)nullptr );
+
+	struct robotPush push;
+	push.armColorScale[0] = glm::vec4( Arm1.armColor, Arm1.armScale );
+	push.armColorScale[1] = glm::vec4( Arm2.armColor, Arm2.armScale );
+	push.armColorScale[2] = glm::vec4( Arm3.armColor, Arm3.armScale );
+	push.numRobots = (uint32_t)NumRobots;
+	push.armDepth = (uint32_t)RobotArmDepth;
+
+	uint32_t jointsOffset = (uint32_t)( CurrentFrame * RobotJointsSliceSize );
+	vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ComputePipeline );
+	vkCmdBindDescriptorSets( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ComputePipelineLayout, 0, 1, &DescriptorSets[4], 1, &jointsOffset );
+	vkCmdPushConstants( commandBuffer, ComputePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push );
+	vkCmdDispatch( commandBuffer, ( NumRobots + ROBOTS_PER_WORKGROUP - 1 ) / ROBOTS_PER_WORKGROUP, 1, 1 );
+
+	// and the vertex shaders of this frame have to see what the compute shader wrote:
+
+	VkBufferMemoryBarrier			vbmb;
+		vbmb.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		vbmb.pNext = nullptr;
+		vbmb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vbmb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vbmb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vbmb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vbmb.buffer = RobotInstances.buffer;
+		vbmb.offset = 0;
+		vbmb.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+			0, (VkMemoryBarrier *)nullptr, 1, IN &vbmb, 0, (VkImageMemoryBarrier *)nullptr );
+}
+
+
+
+// ****************************
+// DESTROY THE ROBOTS' BUFFERS:
+// ****************************
+
+void
+Robots05Destroy( )
+{
+	vkDestroyBuffer( LogicalDevice, RobotJoints.buffer, PALLOCATOR );
+	Free05Memory( &RobotJoints.allocation );
+	vkDestroyBuffer( LogicalDevice, RobotInstances.buffer, PALLOCATOR );
+	Free05Memory( &RobotInstances.allocation );
+}
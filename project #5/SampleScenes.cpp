@@ -0,0 +1,225 @@
+// ****************************************************************************************************
+// BUILT-IN BENCHMARK SCENES:
+//
+// Projects #1, #2, #3, and #5 each exercise a different path -- the textured cube in #1, lighting in
+// #2 and #3, and the robot arms in #5.  Here those four are scenes of this one program, picked with
+// --scene name, and each one has a single --scale knob that sets how much load it makes:
+//	cube	#1	textured cubes, each with a texture of its own	scale = texture count
+//	lit	#2, #3	lit, colored cubes				scale = instance count
+//	grid	#5	a flat grid of unlit, colored cubes		scale = instance count
+//	robots	#5	three-arm robots				scale = robot count (the default scene)
+//	arms	#5	one robot with a longer chain of arms		scale = arm depth
+// Every scene is drawn by the same robots compute pass and instanced draw -- a cube is a robot with
+// a one-arm chain -- so a scene only changes the counts, the spacing, and the Mode and UseLighting
+// it starts with.  #4's paths (the instance-rate vertex binding, the compute culling, and the indirect
+// draw) are not in this program, so #4 has no scene here -- it keeps its own --instance-bench.
+// None of it cares about the window, so every scene runs the same with --headless.
+//
+// --scenes lists them.  Together with --bench, running one scene at several scales gives the curve of
+// how the cost grows with the load (the scene and the scale go into the JSON).
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define SCENE_CUBE_SPACING	3.f		// a one-arm cube is 2 units wide
+#define SCENE_TEXTURE_MB	5		// about what one puppy texture takes, with its mip levels
+
+
+struct scene
+{
+	const char *	name;
+	const char *	project;		// which of the sample projects it came from
+	const char *	knob;			// what --scale changes
+	int		defaultScale;		// 0 = use --robots
+	void		(*setup)( int );	// sets the counts and the starting state
+};
+
+std::string		SceneName;
+int			SceneScale;
+int			SceneArmDepth;			// for Robots05Init( )
+float			SceneSpacing;
+int			SceneNumTextures;		// how many textures Scene07RequestTextures( ) asks for
+std::vector<int>	SceneTextures;			// stream handles -- the instances get split evenly among them
+
+
+// shrink a grid of cubes so all of it is in view:
+
+static void
+SceneFitGrid( int numCubes )
+{
+	int side = (int)ceil( sqrt( (double)numCubes ) );
+	Scale = 0.8f / (float)side;
+	if( Scale < MINSCALE )
+		Scale = MINSCALE;
+}
+
+
+// one-arm robots are just cubes:
+
+static void
+SceneCubeArm( )
+{
+	SceneArmDepth = 1;
+	SceneSpacing = SCENE_CUBE_SPACING;
+	Arm1.armScale = 1.f;
+}
+
+
+static void
+SceneCube( int scale )
+{
+	SceneCubeArm( );
+	NumRobots = scale;
+	SceneNumTextures = scale;
+	Mode = 1;					// textures
+	Arm1.armColor = glm::vec3( 1.f, 1.f, 1.f );
+	SceneFitGrid( scale );
+}
+
+
+static void
+SceneLit( int scale )
+{
+	SceneCubeArm( );
+	NumRobots = scale;
+	UseLighting = true;
+	SceneFitGrid( scale );
+}
+
+
+// a flat grid of one-arm cubes -- the most instances for the least work per instance:
+
+static void
+SceneGrid( int scale )
+{
+	SceneCubeArm( );
+	NumRobots = scale;
+	SceneFitGrid( scale );
+}
+
+
+static void
+SceneRobots( int scale )
+{
+	NumRobots = scale;
+}
+
+
+static void
+SceneArms( int scale )
+{
+	NumRobots = 1;
+	SceneArmDepth = scale;
+}
+
+
+struct scene	Scenes[ ] =
+{
+	{ "cube",	"#1",		"texture count",	1,	SceneCube	},
+	{ "lit",	"#2, #3",	"instance count",	16,	SceneLit	},
+	{ "grid",	"#5",		"instance count",	100,	SceneGrid	},
+	{ "robots",	"#5",		"robot count",		0,	SceneRobots	},
+	{ "arms",	"#5",		"arm depth",		3,	SceneArms	},
+};
+
+#define NUM_SCENES	( sizeof(Scenes) / sizeof(Scenes[0]) )
+
+
+
+// ****************
+// LIST THE SCENES:
+// ****************
+
+int
+SceneList( )
+{
+	fprintf( stdout, "%-8s %-8s %-16s %s\n", "scene", "project", "--scale", "default" );
+	for( size_t i = 0; i < NUM_SCENES; i++ )
+	{
+		if( Scenes[i].defaultScale > 0 )
+			fprintf( stdout, "%-8s %-8s %-16s %d\n", Scenes[i].name, Scenes[i].project, Scenes[i].knob, Scenes[i].defaultScale );
+		else
+			fprintf( stdout, "%-8s %-8s %-16s --robots\n", Scenes[i].name, Scenes[i].project, Scenes[i].knob );
+	}
+	return 0;
+}
+
+
+
+// *****************
+// SET UP THE SCENE:
+// *****************
+
+// call after Reset( ) and before InitGraphics( )
+// returns false if there is no scene by that name
+// scale <= 0 means the scene's default
+
+bool
+SceneInit( IN const char * name, int scale )
+{
+	struct scene * sc = (struct scene *)nullptr;
+	for( size_t i = 0; i < NUM_SCENES; i++ )
+	{
+		if( strcmp( Scenes[i].name, name ) == 0 )
+			sc = &Scenes[i];
+	}
+	if( sc == nullptr )
+	{
+		LOG_ERROR( "There is no scene named '%s' -- --scenes lists them\n", name );
+		return false;
+	}
+
+	if( scale <= 0 )
+		scale = sc->defaultScale > 0 ? sc->defaultScale : NumRobots;
+	if( scale < 1 )
+		scale = 1;
+
+	SceneName = sc->name;
+	SceneScale = scale;
+	SceneArmDepth = 0;				// Robots05Init( )'s defaults
+	SceneSpacing = 0.f;
+	SceneNumTextures = 1;
+	sc->setup( scale );
+
+	if( SceneNumTextures > STREAM_MAX_TEXTURES - 1 )
+	{
+		LOG_WARN( "Scene '%s': only %d textures can stream in, not %d\n", SceneName.c_str( ), STREAM_MAX_TEXTURES - 1, SceneNumTextures );
+		SceneNumTextures = STREAM_MAX_TEXTURES - 1;
+	}
+
+	// the texture count is what is being measured, not evictions, so all of them have to fit:
+
+	VkDeviceSize needed = (VkDeviceSize)SceneNumTextures * SCENE_TEXTURE_MB * 1024 * 1024;
+	if( TextureBudget < needed )
+	{
+		LOG_INFO( "Scene '%s': raising the texture budget to %d MB so that %d textures stay resident\n",
+			SceneName.c_str( ), (int)( needed / ( 1024 * 1024 ) ), SceneNumTextures );
+		TextureBudget = needed;
+	}
+
+	LOG_INFO( "Scene '%s' (from project %s): %s = %d\n", SceneName.c_str( ), sc->project, sc->knob, SceneScale );
+	return true;
+}
+
+
+
+// ***************************************
+// ASK FOR THE SCENE'S TEXTURES TO STREAM:
+// ***************************************
+
+// call after Stream07Init( ) -- the first texture is the puppy that every scene has
+
+void
+Scene07RequestTextures( )
+{
+	SceneTextures.clear( );
+	SceneTextures.push_back( PuppyTexture );
+
+	for( int t = 1; t < SceneNumTextures; t++ )
+	{
+		int handle = Stream07Request( ( t % 2 ) == 0 ? "puppy.bmp" : "puppy0.bmp", t / 2 );
+		if( handle < 0 )
+			break;
+		SceneTextures.push_back( handle );
+	}
+}
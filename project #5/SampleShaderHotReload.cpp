@@ -0,0 +1,328 @@
+// ****************************************************************************************************
+// SHADER HOT-RELOAD:
+//
+// Edit sample-vert.vert or sample-frag.frag while the program runs and the change shows up
+// a moment later, without restarting:
+//	* an inotify watch on the current directory notices when one of the sources gets saved
+//	* a thread-pool job runs the bundled glslangValidator on both sources, makes new shader modules,
+//	  and builds a new uber pipeline with Init14GraphicsVertexFragmentPipeline( )
+//	* at the start of the next frame, Poll14ShaderHotReload( ) swaps the new uber pipeline in, and the
+//	  background pipeline compiler starts making the specialized variants over again
+//	* the old pipelines are destroyed FRAME_LAG frames later, when no frame-in-flight can still be using them
+//
+// A source that does not compile leaves the running pipelines alone -- the compiler's messages go to FpDebug.
+// The .spv files only get replaced when both compiled, so the next run starts with what was last working.
+//
+// The watcher is Linux-only.  Everywhere else Init14ShaderHotReload( ) just says so.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#define HOT_RELOAD_IDLE		0
+#define HOT_RELOAD_BUILDING	1
+#define HOT_RELOAD_READY	2		// HotReloadPipeline is waiting to be swapped in
+#define HOT_RELOAD_FAILED	3		// HotReloadLog says why
+
+#define HOT_RELOAD_NUM_SHADERS	2
+
+const char *	HotReloadSources[HOT_RELOAD_NUM_SHADERS] = { "sample-vert.vert", "sample-frag.frag" };
+const char *	HotReloadSpirv[HOT_RELOAD_NUM_SHADERS]   = { "sample-vert.spv",  "sample-frag.spv"  };
+
+struct retiredPipeline
+{
+	VkPipeline	pipeline;
+	uint64_t	destroyFrame;		// destroy it once HotReloadFrame gets here
+};
+
+int				HotReloadFd = -1;		// the inotify instance
+std::atomic<int>		HotReloadState;
+bool				HotReloadPending;		// a source changed, and a rebuild has not started for it yet
+uint64_t			HotReloadFrame;			// counts Poll14ShaderHotReload( ) calls
+VkPipeline			HotReloadPipeline;		// the new uber pipeline -- written by the job, read once the state is READY
+VkShaderModule			HotReloadModules[HOT_RELOAD_NUM_SHADERS];
+std::vector<uint32_t>		HotReloadCode[HOT_RELOAD_NUM_SHADERS];
+std::string			HotReloadLog;
+double				HotReloadStart;
+std::vector<struct retiredPipeline>	HotReloadRetired;
+
+
+#ifdef __linux__
+
+// run glslangValidator on one source, into a temporary .spv -- runs on a worker thread:
+
+static bool
+HotReloadCompile( int s, OUT std::string * pLog )
+{
+	const char * compiler = access( "./glslangValidator", X_OK ) == 0 ? "./glslangValidator" : "glslangValidator";
+	std::string tempname = std::string( HotReloadSpirv[s] ) + ".tmp";
+	std::string command = std::string( compiler ) + " -V " + HotReloadSources[s] + " -o " + tempname + " 2>&1";
+
+	FILE * fp = popen( command.c_str( ), "r" );
+	if( fp == NULL )
+	{
+		*pLog += "Cannot run '" + command + "'\n";
+		return false;
+	}
+	char line[256];
+	while( fgets( line, sizeof(line), fp ) != NULL )
+		*pLog += line;
+	int status = pclose( fp );
+	if( status != 0 )
+	{
+		remove( tempname.c_str( ) );
+		return false;
+	}
+
+	struct shaderModuleEntry e;
+	e.filename = tempname;
+	ShaderReadFile( INOUT &e );
+	if( ! e.ok )
+	{
+		*pLog += "'" + tempname + "' did not come out as spir-v\n";
+		return false;
+	}
+
+	VkShaderModuleCreateInfo		vsmci;
+		vsmci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		vsmci.pNext = nullptr;
+		vsmci.flags = 0;
+		vsmci.codeSize = 4 * e.code.size( );		// bytes
+		vsmci.pCode = e.code.data( );
+
+	if( vkCreateShaderModule( LogicalDevice, IN &vsmci, PALLOCATOR, OUT &HotReloadModules[s] ) != VK_SUCCESS )
+	{
+		*pLog += "vkCreateShaderModule failed for '" + tempname + "'\n";
+		return false;
+	}
+	HotReloadCode[s].swap( e.code );
+	return true;
+}
+
+
+// the whole rebuild -- runs on a worker thread:
+
+static void
+HotReloadBuild( )
+{
+	CPU_ZONE( "HotReloadBuild" );
+
+	std::string log;
+	bool ok = true;
+	for( int s = 0; s < HOT_RELOAD_NUM_SHADERS; s++ )
+		HotReloadModules[s] = VK_NULL_HANDLE;
+	for( int s = 0; s < HOT_RELOAD_NUM_SHADERS  &&  ok; s++ )
+		ok = HotReloadCompile( s, OUT &log );
+
+	if( ok )
+	{
+		// reads RenderPass, GraphicsPipelineLayout, and GraphicsPipelineCache, none of which the main thread changes:
+
+		VkResult result = Init14GraphicsVertexFragmentPipeline( HotReloadModules[0], HotReloadModules[1],
+						VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, -1, -1, VK_NULL_HANDLE, OUT &HotReloadPipeline );
+		ok = result == VK_SUCCESS;
+		if( ! ok )
+			log += "Init14GraphicsVertexFragmentPipeline failed\n";
+	}
+
+	for( int s = 0; s < HOT_RELOAD_NUM_SHADERS; s++ )
+	{
+		std::string tempname = std::string( HotReloadSpirv[s] ) + ".tmp";
+		if( ok )
+			rename( tempname.c_str( ), HotReloadSpirv[s] );
+		else
+			remove( tempname.c_str( ) );
+
+		if( ! ok  &&  HotReloadModules[s] != VK_NULL_HANDLE )
+		{
+			vkDestroyShaderModule( LogicalDevice, HotReloadModules[s], PALLOCATOR );
+			HotReloadModules[s] = VK_NULL_HANDLE;
+		}
+	}
+
+	HotReloadLog = log;
+	HotReloadState.store( ok ? HOT_RELOAD_READY : HOT_RELOAD_FAILED );	// the main thread sees everything above once it sees this
+}
+
+
+// did any of the sources get saved since the last look?
+
+static bool
+HotReloadSourcesChanged( )
+{
+	bool changed = false;
+	alignas( struct inotify_event ) char buffer[4096];
+	for( ; ; )
+	{
+		ssize_t n = read( HotReloadFd, buffer, sizeof(buffer) );
+		if( n <= 0 )
+			break;				// EAGAIN -- nothing more right now
+
+		for( char * p = buffer; p < buffer + n; )
+		{
+			struct inotify_event * event = (struct inotify_event *)p;
+			for( int s = 0; s < HOT_RELOAD_NUM_SHADERS; s++ )
+			{
+				if( event->len > 0  &&  strcmp( event->name, HotReloadSources[s] ) == 0 )
+					changed = true;
+			}
+			p += sizeof(struct inotify_event) + event->len;
+		}
+	}
+	return changed;
+}
+
+#endif
+
+
+
+// ***************************
+// START WATCHING THE SOURCES:
+// ***************************
+
+void
+Init14ShaderHotReload( )
+{
+	HERE_I_AM( "Init14ShaderHotReload" );
+	CPU_ZONE( "Init14ShaderHotReload" );
+
+	HotReloadState.store( HOT_RELOAD_IDLE );
+
+#ifdef __linux__
+	HotReloadFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( HotReloadFd < 0 )
+	{
+		LOG_INFO( "Shader hot-reload: inotify_init1 failed -- shaders will not reload\n" );
+		return;
+	}
+
+	// editors either write the file in place or write a new file and rename it over the old one:
+
+	if( inotify_add_watch( HotReloadFd, ".", IN_CLOSE_WRITE | IN_MOVED_TO ) < 0 )
+	{
+		LOG_INFO( "Shader hot-reload: cannot watch the current directory -- shaders will not reload\n" );
+		close( HotReloadFd );
+		HotReloadFd = -1;
+		return;
+	}
+	LOG_INFO( "Shader hot-reload: watching %s and %s\n", HotReloadSources[0], HotReloadSources[1] );
+#else
+	LOG_INFO( "Shader hot-reload is only available on Linux\n" );
+#endif
+}
+
+
+
+// **********************************************
+// START REBUILDS AND SWAP IN FINISHED PIPELINES:
+// **********************************************
+
+// call once per frame, after the frame's fence wait and before anything is recorded
+
+void
+Poll14ShaderHotReload( )
+{
+	HotReloadFrame++;
+
+	// destroy the pipelines that every frame-in-flight has finished with:
+
+	for( size_t i = 0; i < HotReloadRetired.size( ); )
+	{
+		if( HotReloadFrame >= HotReloadRetired[i].destroyFrame )
+		{
+			vkDestroyPipeline( LogicalDevice, HotReloadRetired[i].pipeline, PALLOCATOR );
+			HotReloadRetired.erase( HotReloadRetired.begin( ) + i );
+			InvalidateRecordedCommands( );		// the draw groups recorded with it cannot be executed again
+		}
+		else
+			i++;
+	}
+
+#ifdef __linux__
+	if( HotReloadFd >= 0  &&  HotReloadSourcesChanged( ) )
+		HotReloadPending = true;
+#endif
+
+	switch( HotReloadState.load( ) )
+	{
+		case HOT_RELOAD_READY:
+		{
+			// a variant job still compiling against the old modules has to finish first:
+
+			if( Busy14PipelineCompiler( ) )
+				break;
+
+			std::vector<VkPipeline> old;
+			Reset14PipelineCompiler( HotReloadPipeline, OUT &old );
+			for( size_t i = 0; i < old.size( ); i++ )
+			{
+				struct retiredPipeline retired;
+				retired.pipeline = old[i];
+				retired.destroyFrame = HotReloadFrame + FRAME_LAG;
+				HotReloadRetired.push_back( retired );
+			}
+
+			// the registry takes over the new modules (and destroys the old ones):
+
+			for( int s = 0; s < HOT_RELOAD_NUM_SHADERS; s++ )
+				Replace12ShaderModule( HotReloadSpirv[s], HotReloadModules[s], INOUT &HotReloadCode[s] );
+			ShaderModuleVertex   = HotReloadModules[0];
+			ShaderModuleFragment = HotReloadModules[1];
+
+			LOG_INFO( "Shader hot-reload: new uber pipeline swapped in, %.1f ms after the save\n", 1000. * ( GLFWGetTime( ) - HotReloadStart ) );
+			HotReloadState.store( HOT_RELOAD_IDLE );
+			break;
+		}
+
+		case HOT_RELOAD_FAILED:
+			LOG_INFO( "Shader hot-reload failed -- keeping the old pipelines:\n%s\n", HotReloadLog.c_str( ) );
+			HotReloadState.store( HOT_RELOAD_IDLE );
+			break;
+	}
+
+#ifdef __linux__
+	if( HotReloadPending  &&  HotReloadState.load( ) == HOT_RELOAD_IDLE )
+	{
+		HotReloadPending = false;
+		HotReloadStart = GLFWGetTime( );
+		HotReloadState.store( HOT_RELOAD_BUILDING );
+		ThreadPoolSubmit( HotReloadBuild );
+	}
+#endif
+}
+
+
+
+// **************
+// STOP WATCHING:
+// **************
+
+// the device must be idle
+
+void
+Destroy14ShaderHotReload( )
+{
+	while( HotReloadState.load( ) == HOT_RELOAD_BUILDING )
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+
+	if( HotReloadState.load( ) == HOT_RELOAD_READY )
+	{
+		vkDestroyPipeline( LogicalDevice, HotReloadPipeline, PALLOCATOR );
+		for( int s = 0; s < HOT_RELOAD_NUM_SHADERS; s++ )
+			vkDestroyShaderModule( LogicalDevice, HotReloadModules[s], PALLOCATOR );
+	}
+	HotReloadState.store( HOT_RELOAD_IDLE );
+
+	for( size_t i = 0; i < HotReloadRetired.size( ); i++ )
+		vkDestroyPipeline( LogicalDevice, HotReloadRetired[i].pipeline, PALLOCATOR );
+	HotReloadRetired.clear( );
+
+#ifdef __linux__
+	if( HotReloadFd >= 0 )
+		close( HotReloadFd );
+#endif
+	HotReloadFd = -1;
+}
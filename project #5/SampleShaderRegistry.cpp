@@ -0,0 +1,349 @@
+// ****************************************************************************************************
+// SHADER MODULE REGISTRY:
+//
+// Every .spv file gets read once and turned into a VkShaderModule once, no matter how many
+// pipelines ask for it:
+//	* Load12ShaderModules( ) reads a list of files at the same time on the thread pool
+//	  (mmap on Linux, one fread everywhere else), checks them, and hashes their contents
+//	* files whose contents are identical share one VkShaderModule
+//	* Get12ShaderModule( ) hands back the cached module, loading the file first if it has to
+//
+// The registry owns the modules -- Replace12ShaderModule( ) and Destroy12ShaderRegistry( ) are the only
+// things that destroy them.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+struct shaderModuleEntry
+{
+	std::string		filename;
+	std::vector<uint32_t>	code;
+	uint64_t		hash;			// FNV-1a of the code
+	bool			ok;			// false = could not be read, or is not spir-v
+	VkShaderModule		module;
+	int			sameAs;			// -1, or the entry with identical code whose module this shares
+};
+
+std::vector<struct shaderModuleEntry>	ShaderEntries;
+std::map<std::string, int>		ShaderByFilename;		// index into ShaderEntries
+int					ShaderNumModules;		// how many distinct VkShaderModules got created
+
+
+static uint64_t
+ShaderHash( const uint32_t * code, size_t numWords )
+{
+	const unsigned char * p = (const unsigned char *)code;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for( size_t i = 0; i < 4 * numWords; i++ )
+	{
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+
+// read and check one file -- runs on a worker thread, so no Vulkan and no FpDebug in here:
+
+static void
+ShaderReadFile( INOUT struct shaderModuleEntry * e )
+{
+	e->ok = false;
+	const char * filename = e->filename.c_str( );
+
+#ifdef __linux__
+	int fd = open( filename, O_RDONLY );
+	if( fd < 0 )
+		return;
+	struct stat st;
+	if( fstat( fd, &st ) != 0 )
+	{
+		close( fd );
+		return;
+	}
+	size_t size = (size_t)st.st_size;
+	void * bytes = size > 0 ? mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 ) : MAP_FAILED;
+	close( fd );				// the mapping stays valid after the close
+	if( bytes == MAP_FAILED )
+		return;
+	if( size >= 4  &&  size % 4 == 0 )
+		e->code.assign( (const uint32_t *)bytes, (const uint32_t *)bytes + size / 4 );
+	munmap( bytes, size );
+#else
+	FILE * fp;
+#ifdef _WIN32
+	errno_t err = fopen_s( &fp, filename, "rb" );
+	if( err != 0 )
+		fp = NULL;
+#else
+	fp = fopen( filename, "rb" );
+#endif
+	if( fp == NULL )
+		return;
+	fseek( fp, 0L, SEEK_END );
+	long size = ftell( fp );
+	rewind( fp );
+	if( size >= 4  &&  size % 4 == 0 )
+	{
+		e->code.resize( (size_t)size / 4 );
+		if( fread( e->code.data( ), 4, e->code.size( ), fp ) != e->code.size( ) )
+			e->code.clear( );
+	}
+	fclose( fp );				// closed on every path -- the old loader leaked it on a bad magic number
+#endif
+
+	if( e->code.empty( )  ||  e->code[0] != SPIRV_MAGIC )
+		return;
+
+	e->hash = ShaderHash( e->code.data( ), e->code.size( ) );
+	e->ok = true;
+}
+
+
+// say why a file did not load -- on the main thread, after the workers are done:
+
+static void
+ShaderReportBadFile( IN struct shaderModuleEntry * e )
+{
+	if( e->code.empty( ) )
+		LOG_INFO( "Cannot open shader file '%s', or its size is not a multiple of 4\n", e->filename.c_str( ) );
+	else
+		LOG_INFO( "Magic number for spir-v file '%s' is 0x%08x -- should be 0x%08x\n", e->filename.c_str( ), e->code[0], SPIRV_MAGIC );
+}
+
+
+
+// ****************************************
+// LOAD A LIST OF SHADER FILES ALL AT ONCE:
+// ****************************************
+
+// files that are already in the registry are skipped
+
+VkResult
+Load12ShaderModules( IN std::vector<std::string> filenames )
+{
+	HERE_I_AM( "Load12ShaderModules" );
+	CPU_ZONE( "Load12ShaderModules" );
+
+	VkResult result = VK_SUCCESS;
+	VkResult failure = VK_SUCCESS;		// the first thing that went wrong -- result gets reused for each module
+	double start = GLFWGetTime( );
+
+	int first = (int)ShaderEntries.size( );
+	for( size_t f = 0; f < filenames.size( ); f++ )
+	{
+		if( ShaderByFilename.count( filenames[f] ) != 0 )
+			continue;
+		ShaderByFilename[ filenames[f] ] = (int)ShaderEntries.size( );
+		ShaderEntries.push_back( shaderModuleEntry( ) );
+		ShaderEntries.back( ).filename = filenames[f];
+		ShaderEntries.back( ).ok = false;
+		ShaderEntries.back( ).module = VK_NULL_HANDLE;
+		ShaderEntries.back( ).sameAs = -1;
+	}
+	int count = (int)ShaderEntries.size( ) - first;
+	if( count == 0 )
+		return result;
+
+
+	// read and hash the files in parallel:
+
+	ThreadPoolParallelFor( count, 1, [ = ]( int firstJob, int lastJob )
+	{
+		for( int i = firstJob; i < lastJob; i++ )
+			ShaderReadFile( &ShaderEntries[ first + i ] );
+	} );
+
+
+	// files with the same contents as one that is already loaded share its module:
+
+	std::vector<int> toCreate;
+	for( int i = first; i < first + count; i++ )
+	{
+		struct shaderModuleEntry * e = &ShaderEntries[i];
+		if( ! e->ok )
+		{
+			ShaderReportBadFile( e );
+			if( failure == VK_SUCCESS )
+				failure = VK_SHOULD_EXIT;
+			continue;
+		}
+
+		for( int j = 0; j < i; j++ )
+		{
+			struct shaderModuleEntry * other = &ShaderEntries[j];
+			if( other->ok  &&  other->sameAs < 0  &&  other->hash == e->hash  &&  other->code == e->code )
+			{
+				e->sameAs = j;
+				break;
+			}
+		}
+
+		if( e->sameAs < 0 )
+			toCreate.push_back( i );
+	}
+
+
+	// vkCreateShaderModule( ) needs no external synchronization, so the new modules get made in parallel too:
+
+	std::vector<VkResult> results( toCreate.size( ), VK_SUCCESS );
+	ThreadPoolParallelFor( (int)toCreate.size( ), 1, [ & ]( int firstJob, int lastJob )
+	{
+		for( int k = firstJob; k < lastJob; k++ )
+		{
+			struct shaderModuleEntry * e = &ShaderEntries[ toCreate[k] ];
+
+			VkShaderModuleCreateInfo		vsmci;
+				vsmci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+				vsmci.pNext = nullptr;
+				vsmci.flags = 0;
+				vsmci.codeSize = 4 * e->code.size( );		// bytes
+				vsmci.pCode = e->code.data( );
+
+			results[k] = vkCreateShaderModule( LogicalDevice, IN &vsmci, PALLOCATOR, OUT &e->module );
+		}
+	} );
+
+	for( size_t k = 0; k < toCreate.size( ); k++ )
+	{
+		result = results[k];
+		REPORT( "vkCreateShaderModule" );
+		if( result == VK_SUCCESS )
+			ShaderNumModules++;
+		else
+		{
+			ShaderEntries[ toCreate[k] ].ok = false;
+			if( failure == VK_SUCCESS )
+				failure = result;
+		}
+	}
+
+	for( int i = first; i < first + count; i++ )
+	{
+		struct shaderModuleEntry * e = &ShaderEntries[i];
+		if( e->sameAs >= 0 )
+		{
+			e->module = ShaderEntries[ e->sameAs ].module;
+			e->ok = ShaderEntries[ e->sameAs ].ok;
+		}
+		if( e->ok )
+		{
+			LOG_INFO( "Shader Module '%s' successfully loaded%s\n", e->filename.c_str( ),
+				e->sameAs >= 0 ? " (same code as an earlier one -- sharing its module)" : "" );
+		}
+		if( e->sameAs >= 0  ||  ! e->ok )
+		{
+			e->code.clear( );			// only the module owners keep their code, for comparing against later loads
+			e->code.shrink_to_fit( );
+		}
+	}
+
+	LOG_INFO( "Shader registry: %d files, %d modules, %.3f ms for this load\n",
+		(int)ShaderEntries.size( ), ShaderNumModules, 1000. * ( GLFWGetTime( ) - start ) );
+	return failure;
+}
+
+
+
+// *********************************
+// GET A SHADER MODULE BY FILE NAME:
+// *********************************
+
+// VK_NULL_HANDLE means the file could not be loaded
+
+VkShaderModule
+Get12ShaderModule( IN std::string filename )
+{
+	std::map<std::string, int>::iterator it = ShaderByFilename.find( filename );
+	if( it == ShaderByFilename.end( ) )
+	{
+		Load12ShaderModules( std::vector<std::string>( 1, filename ) );
+		it = ShaderByFilename.find( filename );
+	}
+
+	struct shaderModuleEntry * e = &ShaderEntries[ it->second ];
+	return e->ok ? e->module : VK_NULL_HANDLE;
+}
+
+
+
+// ***************************************
+// SWAP IN A NEW MODULE FOR ONE FILE NAME:
+// ***************************************
+
+// used by the shader hot-reload -- the registry takes ownership of module, and takes code out of *pCode
+// the old module goes to whatever other file was sharing it, or gets destroyed if nothing was
+// (the caller has to know that no pipeline still being created is using it)
+
+void
+Replace12ShaderModule( IN std::string filename, IN VkShaderModule module, INOUT std::vector<uint32_t> * pCode )
+{
+	std::map<std::string, int>::iterator it = ShaderByFilename.find( filename );
+	if( it == ShaderByFilename.end( ) )
+	{
+		ShaderByFilename[ filename ] = (int)ShaderEntries.size( );
+		ShaderEntries.push_back( shaderModuleEntry( ) );
+		ShaderEntries.back( ).filename = filename;
+		ShaderEntries.back( ).ok = false;
+		ShaderEntries.back( ).module = VK_NULL_HANDLE;
+		ShaderEntries.back( ).sameAs = -1;
+		it = ShaderByFilename.find( filename );
+	}
+	int index = it->second;
+	struct shaderModuleEntry * e = &ShaderEntries[index];
+
+	if( e->sameAs >= 0 )
+	{
+		e->sameAs = -1;				// it was borrowing someone else's module -- nothing to hand over
+	}
+	else if( e->module != VK_NULL_HANDLE )
+	{
+		// the first file that was sharing this one's module becomes its owner:
+
+		int newOwner = -1;
+		for( size_t j = 0; j < ShaderEntries.size( ); j++ )
+		{
+			if( ShaderEntries[j].sameAs != index )
+				continue;
+			if( newOwner < 0 )
+			{
+				newOwner = (int)j;
+				ShaderEntries[j].sameAs = -1;
+				ShaderEntries[j].code = e->code;
+			}
+			else
+				ShaderEntries[j].sameAs = newOwner;
+		}
+		if( newOwner < 0 )
+		{
+			vkDestroyShaderModule( LogicalDevice, e->module, PALLOCATOR );
+			ShaderNumModules--;
+		}
+	}
+
+	e->module = module;
+	e->code.swap( *pCode );
+	pCode->clear( );
+	e->hash = ShaderHash( e->code.data( ), e->code.size( ) );
+	e->ok = true;
+	ShaderNumModules++;
+}
+
+
+
+// ***************************
+// DESTROY ALL OF THE MODULES:
+// ***************************
+
+void
+Destroy12ShaderRegistry( )
+{
+	for( size_t i = 0; i < ShaderEntries.size( ); i++ )
+	{
+		if( ShaderEntries[i].sameAs < 0  &&  ShaderEntries[i].module != VK_NULL_HANDLE )
+			vkDestroyShaderModule( LogicalDevice, ShaderEntries[i].module, PALLOCATOR );
+	}
+	ShaderEntries.clear( );
+	ShaderByFilename.clear( );
+	ShaderNumModules = 0;
+}
@@ -0,0 +1,705 @@
+// ****************************************************************************************************
+// BACKGROUND TEXTURE STREAMING:
+//
+// Textures are asked for by file name and get a handle back right away.
+// Until a texture is resident, Stream07Use( ) hands back the placeholder's descriptor set instead.
+//
+// Each texture goes through these states:
+//	UNLOADED  -> DECODING	the staging buffer got made, and a decode job got queued on the thread pool
+//	DECODING  -> DECODED	the worker decoded the bmp straight into the staging buffer
+//	DECODED   -> UPLOADING	Stream07Pump( ) made the image and submitted the copy to the transfer queue
+//	UPLOADING -> RESIDENT	the copy finished, the graphics queue acquired the image and blitted its mip levels
+//	RESIDENT  -> EVICTING	the residency budget was exceeded and this was the least-recently-used texture
+//	EVICTING  -> UNLOADED	enough frames went by that no frame-in-flight can still be sampling it
+//
+// Only the decoding runs on the workers.  Everything that touches Vulkan or the memory sub-allocator
+// happens on the main thread -- the staging buffer is made (from just the size in the bmp's headers)
+// before the decode gets queued, so the worker writes the texels right where the copy reads them.
+//
+// A transfer-only queue cannot vkCmdBlitImage( ), so only level 0 goes over the transfer queue, and
+// the rest of the mip chain gets blitted from it on the graphics queue, in the same frame command
+// buffer as the acquire.  If the format cannot be blitted (or with --cpu-mips), the worker builds the
+// chain on the cpu instead, right after level 0 in the staging buffer, and the copy takes all of it.
+// If the transfer queue is in a different family from the graphics queue, the image changes owners:
+// a release barrier ends the transfer command buffer and an acquire barrier starts the frame's.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+#define STREAM_MAX_TEXTURES	64
+
+#define STREAM_UNLOADED		0
+#define STREAM_DECODING		1
+#define STREAM_DECODED		2
+#define STREAM_UPLOADING	3
+#define STREAM_RESIDENT		4
+#define STREAM_EVICTING		5
+#define STREAM_FAILED		6
+
+
+struct streamedTexture
+{
+	std::string		filename;
+	int			copy;			// the same file can be more than one texture -- see Stream07Request( )
+	std::atomic<int>	state;			// STREAM_*, the workers change it too
+	uint32_t		width;
+	uint32_t		height;
+	MyTexture		texture;
+	VkDescriptorSet		descriptorSet;		// a set 3 that points at this texture
+	MyBuffer		staging;		// level 0 (and, without blits, the rest of the mip chain), from the worker
+	VkCommandBuffer		commandBuffer;		// the copy, on the transfer queue
+	VkFence			fence;			// signaled when the copy is done
+	uint64_t		lastUsedFrame;
+	uint64_t		evictFrame;		// the image can be destroyed once StreamFrame gets here
+};
+
+struct streamedTexture		StreamTextures[STREAM_MAX_TEXTURES];
+int				StreamNumTextures;
+uint64_t			StreamFrame;		// counts Stream07Pump( ) calls
+VkDeviceSize			StreamResidentBytes;
+VkDescriptorSet			StreamPlaceholderSet;
+VkSampler			StreamSampler;
+bool				StreamBlitMips;		// true = the graphics queue blits the mip chain, false = the workers build it
+
+
+// does this texture's mip chain get blitted on the graphics queue?
+
+static inline bool
+StreamUsesBlits( IN struct streamedTexture * st )
+{
+	return StreamBlitMips  &&  MipNumLevels( st->width, st->height ) > 1;
+}
+
+
+static void
+StreamFreeStaging( struct streamedTexture * st )
+{
+	if( st->staging.buffer == VK_NULL_HANDLE )
+		return;
+	vkDestroyBuffer( LogicalDevice, st->staging.buffer, PALLOCATOR );
+	Free05Memory( &st->staging.allocation );
+	st->staging.buffer = VK_NULL_HANDLE;
+}
+
+
+// runs on a worker thread -- no Vulkan in here
+// the texels go straight into the staging buffer that StreamStartDecode( ) made:
+
+static void
+StreamDecode( struct streamedTexture * st )
+{
+	CPU_ZONE( "StreamDecode" );
+
+	struct bmpFile bmp;
+	if( ! BmpOpen( st->filename.c_str( ), OUT &bmp ) )
+	{
+		st->state.store( STREAM_FAILED );
+		return;
+	}
+	if( (uint32_t)bmp.width != st->width  ||  (uint32_t)bmp.height != st->height )
+	{
+		BmpClose( &bmp );				// the file changed since its headers were read
+		st->state.store( STREAM_FAILED );
+		return;
+	}
+
+	unsigned char * level0 = (unsigned char *)st->staging.allocation.mapped;
+	BmpDecodeRgba( &bmp, OUT level0, BmpBestIsa( ) );
+	BmpClose( &bmp );
+
+	if( ! StreamUsesBlits( st ) )
+	{
+		uint32_t mipLevels = MipNumLevels( st->width, st->height );
+		MipGenerateChain( level0, st->width, st->height, mipLevels, OUT level0 + 4 * (VkDeviceSize)st->width * st->height );
+	}
+
+	st->state.store( STREAM_DECODED );		// the main thread sees the texels once it sees this
+}
+
+
+// on the main thread -- make the staging buffer the worker will decode into, then queue the decode:
+
+static void
+StreamStartDecode( struct streamedTexture * st )
+{
+	int width, height;
+	if( ! BmpReadSize( st->filename.c_str( ), OUT &width, OUT &height ) )
+	{
+		LOG_ERROR( "Cannot stream '%s' -- it cannot be opened, or is not a bmp\n", st->filename.c_str( ) );
+		st->state.store( STREAM_FAILED );
+		return;
+	}
+	st->width  = width;
+	st->height = height;
+
+	VkDeviceSize bytes = 4 * (VkDeviceSize)width * height;
+	if( ! StreamUsesBlits( st ) )
+		bytes += MipChainBytes( width, height, MipNumLevels( width, height ) );
+
+	VkResult result = Init05DataBuffer( bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, OUT &st->staging );
+	REPORT( "Init05DataBuffer -- streaming staging" );
+
+	st->state.store( STREAM_DECODING );
+	ThreadPoolSubmit( [ st ]( )
+	{
+		StreamDecode( st );
+	} );
+}
+
+
+// make the image and start the transfer-queue copy out of the staging buffer the worker filled:
+
+static void
+StreamStartUpload( struct streamedTexture * st )
+{
+	VkResult result = VK_SUCCESS;
+
+	st->texture.width  = st->width;
+	st->texture.height = st->height;
+	st->texture.pixels = (unsigned char *)nullptr;
+	st->texture.texSampler = StreamSampler;
+	result = Init07TextureImage( INOUT &st->texture );
+	REPORT( "Init07TextureImage -- streamed" );
+
+	uint32_t mipLevels = st->texture.mipLevels;
+	bool blits = StreamUsesBlits( st );
+
+	VkCommandBufferAllocateInfo			vcbai;
+		vcbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		vcbai.pNext = nullptr;
+		vcbai.commandPool = TransferCommandPool;
+		vcbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		vcbai.commandBufferCount = 1;
+
+	result = vkAllocateCommandBuffers( LogicalDevice, IN &vcbai, OUT &st->commandBuffer );
+	REPORT( "vkAllocateCommandBuffers -- streaming" );
+
+	VkCommandBufferBeginInfo			vcbbi;
+		vcbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		vcbbi.pNext = nullptr;
+		vcbbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vcbbi.pInheritanceInfo = (VkCommandBufferInheritanceInfo *)nullptr;
+
+	vkBeginCommandBuffer( st->commandBuffer, IN &vcbbi );
+
+	VkImageSubresourceRange			visr;
+		visr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		visr.baseMipLevel = 0;
+		visr.levelCount = mipLevels;
+		visr.baseArrayLayer = 0;
+		visr.layerCount = 1;
+
+	VkImageMemoryBarrier			vimb;
+		vimb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		vimb.pNext = nullptr;
+		vimb.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		vimb.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		vimb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vimb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vimb.image = st->texture.texImage;
+		vimb.srcAccessMask = 0;
+		vimb.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vimb.subresourceRange = visr;
+
+	vkCmdPipelineBarrier( st->commandBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, (VkMemoryBarrier *)nullptr,
+			0, (VkBufferMemoryBarrier *)nullptr,
+			1, IN &vimb );
+
+	// the levels are packed one after the other in the staging buffer
+	// (with blits, only level 0 is there -- StreamFinishUpload( ) makes the rest):
+
+	std::vector<VkBufferImageCopy> regions;
+	VkDeviceSize offset = 0;
+	uint32_t mipWidth  = st->width;
+	uint32_t mipHeight = st->height;
+	uint32_t copyLevels = blits ? 1 : mipLevels;
+	for( uint32_t level = 0; level < copyLevels; level++ )
+	{
+		VkBufferImageCopy			vbic;
+			vbic.bufferOffset = offset;
+			vbic.bufferRowLength = 0;		// 0 = tightly packed
+			vbic.bufferImageHeight = 0;
+			vbic.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			vbic.imageSubresource.mipLevel = level;
+			vbic.imageSubresource.baseArrayLayer = 0;
+			vbic.imageSubresource.layerCount = 1;
+			vbic.imageOffset.x = 0;
+			vbic.imageOffset.y = 0;
+			vbic.imageOffset.z = 0;
+			vbic.imageExtent.width = mipWidth;
+			vbic.imageExtent.height = mipHeight;
+			vbic.imageExtent.depth = 1;
+		regions.push_back( vbic );
+
+		offset += 4 * (VkDeviceSize)mipWidth * mipHeight;
+		mipWidth  = mipWidth  > 1 ? mipWidth  / 2 : 1;
+		mipHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+	}
+
+	vkCmdCopyBufferToImage( st->commandBuffer, st->staging.buffer,
+		st->texture.texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size( ), IN regions.data( ) );
+
+	// hand the image over to the graphics family
+	// (the acquire half of this is in StreamFinishUpload( ) -- the layouts have to match,
+	// and with blits every level stays a transfer destination for them):
+
+	if( TransferQueueFamily != GraphicsQueueFamily )
+	{
+			vimb.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			vimb.newLayout = blits ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			vimb.srcQueueFamilyIndex = TransferQueueFamily;
+			vimb.dstQueueFamilyIndex = GraphicsQueueFamily;
+			vimb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vimb.dstAccessMask = 0;				// ignored for a release
+
+		vkCmdPipelineBarrier( st->commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, (VkMemoryBarrier *)nullptr,
+				0, (VkBufferMemoryBarrier *)nullptr,
+				1, IN &vimb );
+	}
+
+	vkEndCommandBuffer( st->commandBuffer );
+
+	VkFenceCreateInfo			vfci;
+		vfci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		vfci.pNext = nullptr;
+		vfci.flags = 0;
+
+	result = vkCreateFence( LogicalDevice, IN &vfci, PALLOCATOR, OUT &st->fence );
+	REPORT( "vkCreateFence -- streaming" );
+
+	VkSubmitInfo				vsi;
+		vsi.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		vsi.pNext = nullptr;
+		vsi.waitSemaphoreCount = 0;
+		vsi.pWaitSemaphores = (VkSemaphore *)nullptr;
+		vsi.pWaitDstStageMask = (VkPipelineStageFlags *)nullptr;
+		vsi.commandBufferCount = 1;
+		vsi.pCommandBuffers = &st->commandBuffer;
+		vsi.signalSemaphoreCount = 0;
+		vsi.pSignalSemaphores = (VkSemaphore *)nullptr;
+
+	result = vkQueueSubmit( TransferQueue, 1, IN &vsi, IN st->fence );
+	REPORT( "vkQueueSubmit -- streaming" );
+
+
+	// point this texture's own descriptor set at the new image
+	// (nothing in flight is using this set -- it has not been bound since the last eviction finished):
+
+	VkDescriptorImageInfo				vdii;
+		vdii.sampler   = StreamSampler;
+		vdii.imageView = st->texture.texImageView;
+		vdii.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkWriteDescriptorSet				vwds;
+		vwds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		vwds.pNext = nullptr;
+		vwds.dstSet = st->descriptorSet;
+		vwds.dstBinding = 0;
+		vwds.dstArrayElement = 0;
+		vwds.descriptorCount = 1;
+		vwds.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		vwds.pBufferInfo = (VkDescriptorBufferInfo *)nullptr;
+		vwds.pImageInfo = &vdii;
+		vwds.pTexelBufferView = (VkBufferView *)nullptr;
+
+	vkUpdateDescriptorSets( LogicalDevice, 1, IN &vwds, 0, (VkCopyDescriptorSet *)nullptr );
+
+	st->state.store( STREAM_UPLOADING );
+}
+
+
+static void
+StreamFreeUploadResources( struct streamedTexture * st )
+{
+	vkDestroyFence( LogicalDevice, st->fence, PALLOCATOR );
+	vkFreeCommandBuffers( LogicalDevice, TransferCommandPool, 1, &st->commandBuffer );
+	StreamFreeStaging( st );
+}
+
+
+// the copy is done -- acquire the image on the graphics queue, blit its mip levels, and start using it:
+
+static void
+StreamFinishUpload( struct streamedTexture * st, VkCommandBuffer commandBuffer )
+{
+	StreamFreeUploadResources( st );
+
+	bool handOver = TransferQueueFamily != GraphicsQueueFamily;
+	bool blits = StreamUsesBlits( st );
+
+	VkImageSubresourceRange			visr;
+		visr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		visr.baseMipLevel = 0;
+		visr.levelCount = st->texture.mipLevels;
+		visr.baseArrayLayer = 0;
+		visr.layerCount = 1;
+
+	if( blits )
+	{
+		// only an acquire is needed here -- the first of the blits' barriers makes level 0's copy visible:
+
+		if( handOver )
+		{
+			VkImageMemoryBarrier			vimb;
+				vimb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				vimb.pNext = nullptr;
+				vimb.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				vimb.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				vimb.srcQueueFamilyIndex = TransferQueueFamily;
+				vimb.dstQueueFamilyIndex = GraphicsQueueFamily;
+				vimb.image = st->texture.texImage;
+				vimb.srcAccessMask = 0;				// ignored for an acquire
+				vimb.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+				vimb.subresourceRange = visr;
+
+			vkCmdPipelineBarrier( commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+					0, (VkMemoryBarrier *)nullptr,
+					0, (VkBufferMemoryBarrier *)nullptr,
+					1, IN &vimb );
+		}
+
+		Record07MipBlits( commandBuffer, st->texture.texImage, st->width, st->height, st->texture.mipLevels );
+	}
+	else
+	{
+		// with one queue family, this is just the layout transition,
+		// and the transfer was submitted to this same queue earlier, so the barrier covers it:
+
+		VkImageMemoryBarrier			vimb;
+			vimb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			vimb.pNext = nullptr;
+			vimb.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			vimb.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			vimb.srcQueueFamilyIndex = handOver ? TransferQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+			vimb.dstQueueFamilyIndex = handOver ? GraphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+			vimb.image = st->texture.texImage;
+			vimb.srcAccessMask = handOver ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;	// ignored for an acquire
+			vimb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vimb.subresourceRange = visr;
+
+		vkCmdPipelineBarrier( commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+				0, (VkMemoryBarrier *)nullptr,
+				0, (VkBufferMemoryBarrier *)nullptr,
+				1, IN &vimb );
+	}
+
+	StreamResidentBytes += st->texture.allocation.size;
+	st->state.store( STREAM_RESIDENT );
+
+	if( Verbose )
+	{
+		LOG_INFO( "Streamed in '%s': %d x %d, %d mip levels (%s), %.2f MB of textures resident\n",
+			st->filename.c_str( ), st->width, st->height, st->texture.mipLevels, blits ? "blitted" : "cpu",
+			(double)StreamResidentBytes / 1048576. );
+	}
+}
+
+
+static void
+StreamDestroyImage( struct streamedTexture * st )
+{
+	vkDestroyImageView( LogicalDevice, st->texture.texImageView, PALLOCATOR );
+	vkDestroyImage( LogicalDevice, st->texture.texImage, PALLOCATOR );
+	Free05Memory( &st->texture.allocation );
+}
+
+
+static void
+StreamEvict( struct streamedTexture * st )
+{
+	// the last frame that sampled it has finished once FRAME_LAG more frames have started:
+
+	st->evictFrame = st->lastUsedFrame + FRAME_LAG;
+	StreamResidentBytes -= st->texture.allocation.size;
+	st->state.store( STREAM_EVICTING );
+
+	if( Verbose )
+	{
+		LOG_INFO( "Evicted '%s', %.2f MB of textures resident\n", st->filename.c_str( ), (double)StreamResidentBytes / 1048576. );
+	}
+}
+
+
+
+// **************************************************
+// CREATE THE PLACEHOLDER TEXTURE AND SHARED SAMPLER:
+// **************************************************
+
+// call while the startup upload batch is still recording
+// the placeholder's sampler is the one all of the streamed textures use
+
+VkResult
+Stream07InitPlaceholder( OUT MyTexture * pMyTexture )
+{
+	HERE_I_AM( "Stream07InitPlaceholder" );
+	CPU_ZONE( "Stream07InitPlaceholder" );
+
+	// a gray checkerboard, so it is obvious what has not streamed in yet:
+
+	static unsigned char checker[8*8*4];
+	for( int t = 0; t < 8; t++ )
+	{
+		for( int s = 0; s < 8; s++ )
+		{
+			unsigned char gray = ( ( s ^ t ) & 1 ) != 0 ? 160 : 96;
+			unsigned char * p = &checker[ 4 * ( 8 * t + s ) ];
+			p[0] = p[1] = p[2] = gray;
+			p[3] = 255;
+		}
+	}
+
+	VkResult result = Init07TextureSampler( OUT pMyTexture );
+	pMyTexture->width  = 8;
+	pMyTexture->height = 8;
+	pMyTexture->pixels = checker;
+	result = Init07TextureBuffer( INOUT pMyTexture );
+	StreamSampler = pMyTexture->texSampler;
+	return result;
+}
+
+
+
+// *******************************************
+// GET THE STREAMED TEXTURES' DESCRIPTOR SETS:
+// *******************************************
+
+// call after Init13DescriptorSets( ) has pointed placeholderSet at the placeholder
+
+VkResult
+Stream07Init( VkDescriptorSet placeholderSet )
+{
+	HERE_I_AM( "Stream07Init" );
+	CPU_ZONE( "Stream07Init" );
+
+	VkResult result = VK_SUCCESS;
+
+	StreamPlaceholderSet = placeholderSet;
+	StreamBlitMips = Texture07CanBlit( VK_FORMAT_R8G8B8A8_SRGB )  &&  ! ForceCpuMipmaps;
+	LOG_INFO( "Streamed textures get their mip levels %s\n", StreamBlitMips ? "blitted on the graphics queue" : "built on the cpu" );
+
+	VkDescriptorSetLayout layouts[STREAM_MAX_TEXTURES];
+	for( int i = 0; i < STREAM_MAX_TEXTURES; i++ )
+		layouts[i] = DescriptorSetLayouts[3];
+
+	VkDescriptorSet sets[STREAM_MAX_TEXTURES];
+
+	VkDescriptorSetAllocateInfo			vdsai;
+		vdsai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		vdsai.pNext = nullptr;
+		vdsai.descriptorPool = DescriptorPool;
+		vdsai.descriptorSetCount = STREAM_MAX_TEXTURES;
+		vdsai.pSetLayouts = layouts;
+
+	result = vkAllocateDescriptorSets( LogicalDevice, IN &vdsai, OUT sets );
+	REPORT( "vkAllocateDescriptorSets -- streaming" );
+
+	for( int i = 0; i < STREAM_MAX_TEXTURES; i++ )
+		StreamTextures[i].descriptorSet = sets[i];
+
+	return result;
+}
+
+
+
+// *******************************
+// ASK FOR A TEXTURE TO STREAM IN:
+// *******************************
+
+// returns a handle for Stream07Use( ), or -1 if there are no handles left
+// the decode starts right away
+// asking for the same file again gives back the same handle -- unless copy is different, which makes
+// a texture of its own (so a benchmark can have many textures out of one file)
+
+int
+Stream07Request( IN std::string filename, int copy )
+{
+	for( int i = 0; i < StreamNumTextures; i++ )
+	{
+		if( StreamTextures[i].filename == filename  &&  StreamTextures[i].copy == copy )
+			return i;
+	}
+
+	if( StreamNumTextures >= STREAM_MAX_TEXTURES )
+	{
+		LOG_INFO( "Stream07Request: no room for '%s'\n", filename.c_str( ) );
+		return -1;
+	}
+
+	struct streamedTexture * st = &StreamTextures[ StreamNumTextures ];
+	st->filename = filename;
+	st->copy = copy;
+	st->staging.buffer = VK_NULL_HANDLE;
+	st->lastUsedFrame = StreamFrame;
+	StreamStartDecode( st );
+	return StreamNumTextures++;
+}
+
+
+
+// **********************************************
+// GET THE DESCRIPTOR SET TO DRAW A TEXTURE WITH:
+// **********************************************
+
+// call after Stream07Pump( ) for this frame
+// gives back the placeholder's set until the texture is resident, and brings evicted textures back
+
+VkDescriptorSet
+Stream07Use( int handle )
+{
+	if( handle < 0  ||  handle >= StreamNumTextures )
+		return StreamPlaceholderSet;
+
+	struct streamedTexture * st = &StreamTextures[handle];
+	int state = st->state.load( );
+	if( state == STREAM_RESIDENT )
+	{
+		st->lastUsedFrame = StreamFrame;
+		return st->descriptorSet;
+	}
+
+	if( state == STREAM_UNLOADED )
+		StreamStartDecode( st );
+	return StreamPlaceholderSet;
+}
+
+
+
+// *************************
+// MOVE THE STREAMING ALONG:
+// *************************
+
+// call once per frame, after that frame's fence wait, while commandBuffer is recording
+// and before its render pass begins (the acquire barriers get recorded into it)
+
+void
+Stream07Pump( VkCommandBuffer commandBuffer )
+{
+	StreamFrame++;
+
+	for( int i = 0; i < StreamNumTextures; i++ )
+	{
+		struct streamedTexture * st = &StreamTextures[i];
+		switch( st->state.load( ) )
+		{
+			case STREAM_DECODED:
+				StreamStartUpload( st );
+				break;
+
+			case STREAM_UPLOADING:
+				if( vkGetFenceStatus( LogicalDevice, st->fence ) == VK_SUCCESS )
+					StreamFinishUpload( st, commandBuffer );
+				break;
+
+			case STREAM_EVICTING:
+				if( StreamFrame >= st->evictFrame )
+				{
+					StreamDestroyImage( st );
+					st->state.store( STREAM_UNLOADED );
+				}
+				break;
+
+			case STREAM_FAILED:
+				StreamFreeStaging( st );		// if the decode got as far as having one
+				break;
+		}
+	}
+
+	// over budget -- evict least-recently-used textures,
+	// but never one that the last frame drew with (that would just bring it right back):
+
+	while( StreamResidentBytes > TextureBudget )
+	{
+		struct streamedTexture * lru = (struct streamedTexture *)nullptr;
+		for( int i = 0; i < StreamNumTextures; i++ )
+		{
+			struct streamedTexture * st = &StreamTextures[i];
+			if( st->state.load( ) != STREAM_RESIDENT  ||  st->lastUsedFrame + 1 >= StreamFrame )
+				continue;
+			if( lru == nullptr  ||  st->lastUsedFrame < lru->lastUsedFrame )
+				lru = st;
+		}
+		if( lru == nullptr )
+			break;
+		StreamEvict( lru );
+	}
+}
+
+
+// evict everything that is resident (the textures that are still in use stream right back in):
+
+void
+Stream07EvictAll( )
+{
+	for( int i = 0; i < StreamNumTextures; i++ )
+	{
+		if( StreamTextures[i].state.load( ) == STREAM_RESIDENT )
+			StreamEvict( &StreamTextures[i] );
+	}
+}
+
+
+
+// is any texture still on its way in?
+
+bool
+Stream07Busy( )
+{
+	for( int i = 0; i < StreamNumTextures; i++ )
+	{
+		int state = StreamTextures[i].state.load( );
+		if( state == STREAM_DECODING  ||  state == STREAM_DECODED  ||  state == STREAM_UPLOADING )
+			return true;
+	}
+	return false;
+}
+
+
+
+// *************************************
+// DESTROY ALL OF THE STREAMED TEXTURES:
+// *************************************
+
+// the device must be idle
+
+void
+Stream07Destroy( )
+{
+	for( int i = 0; i < StreamNumTextures; i++ )
+	{
+		struct streamedTexture * st = &StreamTextures[i];
+
+		// a worker might still be decoding this one:
+
+		while( st->state.load( ) == STREAM_DECODING )
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+
+		switch( st->state.load( ) )
+		{
+			case STREAM_DECODED:
+			case STREAM_FAILED:
+				StreamFreeStaging( st );
+				break;
+
+			case STREAM_UPLOADING:
+				StreamFreeUploadResources( st );
+				StreamDestroyImage( st );
+				break;
+
+			case STREAM_RESIDENT:
+			case STREAM_EVICTING:
+				StreamDestroyImage( st );
+				break;
+		}
+		st->state.store( STREAM_UNLOADED );
+	}
+
+	StreamNumTextures = 0;
+	StreamResidentBytes = 0;
+}
@@ -0,0 +1,206 @@
+// ****************************************************************************************************
+// THREAD POOL:
+//
+// A fixed set of worker threads that pull jobs off one queue.
+// Use ThreadPoolSubmit( ) for fire-and-forget work, and ThreadPoolParallelFor( ) to split a loop
+// across the workers and wait for all of it to finish (the calling thread helps out too).
+//
+// While it waits, a ThreadPoolParallelFor( ) caller only ever works on pieces of its own loop -- never on
+// whatever else is in the queue -- so a short loop cannot get stuck behind a long unrelated job, like
+// a background pipeline compile or a shader hot-reload build.
+//
+// Jobs must not call Vulkan functions that need external synchronization (like anything that
+// records into a command buffer from a shared pool) unless they bring their own.
+//
+// This file is #include'd from sample.cpp after the globals and prototypes
+// ****************************************************************************************************
+
+std::vector<std::thread>		ThreadPoolWorkers;
+std::deque< std::function<void( )> >	ThreadPoolJobs;
+std::mutex				ThreadPoolMutex;
+std::condition_variable			ThreadPoolWakeUp;
+bool					ThreadPoolQuitting;
+
+
+// one ThreadPoolParallelFor( ) call -- shared, because a helper job can still be in the queue after
+// the call has returned (it then finds no pieces left and does nothing):
+
+struct threadPoolLoop
+{
+	std::function<void( int, int )>	body;
+	int				count;
+	int				perPiece;
+	int				numPieces;
+	std::atomic<int>		nextPiece;		// the next piece to hand out
+	std::atomic<int>		piecesLeft;		// pieces not finished yet
+	std::mutex			doneMutex;
+	std::condition_variable		doneCondition;
+};
+
+
+static void
+ThreadPoolWorker( )
+{
+	for( ; ; )
+	{
+		std::function<void( )> job;
+		{
+			std::unique_lock<std::mutex> lock( ThreadPoolMutex );
+			while( ThreadPoolJobs.empty( )  &&  ! ThreadPoolQuitting )
+				ThreadPoolWakeUp.wait( lock );
+			if( ThreadPoolJobs.empty( ) )
+				return;				// quitting, and nothing left to do
+			job = ThreadPoolJobs.front( );
+			ThreadPoolJobs.pop_front( );
+		}
+		CPU_ZONE( "thread pool job" );
+		job( );
+	}
+}
+
+
+
+// do pieces of one loop until there are none left to hand out:
+
+static void
+ThreadPoolRunPieces( IN std::shared_ptr<struct threadPoolLoop> loop )
+{
+	for( ; ; )
+	{
+		int piece = loop->nextPiece.fetch_add( 1 );
+		if( piece >= loop->numPieces )
+			return;
+
+		int first = piece * loop->perPiece;
+		int last  = first + loop->perPiece < loop->count ? first + loop->perPiece : loop->count;
+		if( first < last )
+			loop->body( first, last );
+
+		if( loop->piecesLeft.fetch_sub( 1 ) == 1 )
+		{
+			std::lock_guard<std::mutex> lock( loop->doneMutex );
+			loop->doneCondition.notify_all( );
+		}
+	}
+}
+
+
+
+// *************************
+// START THE WORKER THREADS:
+// *************************
+
+// numThreads <= 0 means one per core, less one for the main thread
+
+void
+ThreadPoolInit( int numThreads )
+{
+	if( numThreads <= 0 )
+	{
+		numThreads = (int)std::thread::hardware_concurrency( ) - 1;
+		if( numThreads < 1 )
+			numThreads = 1;
+	}
+
+	ThreadPoolQuitting = false;
+	for( int i = 0; i < numThreads; i++ )
+		ThreadPoolWorkers.push_back( std::thread( ThreadPoolWorker ) );
+
+	LOG_INFO( "Thread pool: %d worker threads\n", numThreads );
+}
+
+
+int
+ThreadPoolSize( )
+{
+	return (int)ThreadPoolWorkers.size( );
+}
+
+
+
+// ***************
+// QUEUE UP A JOB:
+// ***************
+
+void
+ThreadPoolSubmit( IN std::function<void( )> job )
+{
+	{
+		std::lock_guard<std::mutex> lock( ThreadPoolMutex );
+		ThreadPoolJobs.push_back( job );
+	}
+	ThreadPoolWakeUp.notify_one( );
+}
+
+
+
+// *****************************
+// SPLIT A LOOP ACROSS THE POOL:
+// *****************************
+
+// calls body( first, last ) on pieces of [0,count) and returns when all of them are done
+// minPerJob keeps tiny loops from being chopped up finer than is worth it
+
+void
+ThreadPoolParallelFor( int count, int minPerJob, IN std::function<void( int, int )> body )
+{
+	if( count <= 0 )
+		return;
+
+	int numJobs = ThreadPoolSize( ) + 1;			// +1 for this thread
+	if( minPerJob < 1 )
+		minPerJob = 1;
+	if( numJobs > count / minPerJob )
+		numJobs = count / minPerJob;
+	if( numJobs <= 1 )
+	{
+		body( 0, count );
+		return;
+	}
+
+	std::shared_ptr<struct threadPoolLoop> loop = std::make_shared<struct threadPoolLoop>( );
+	loop->body = body;
+	loop->count = count;
+	loop->perPiece = ( count + numJobs - 1 ) / numJobs;
+	loop->numPieces = numJobs;
+	loop->nextPiece.store( 0 );
+	loop->piecesLeft.store( numJobs );
+
+	for( int j = 1; j < numJobs; j++ )
+	{
+		ThreadPoolSubmit( [ loop ]( )
+		{
+			ThreadPoolRunPieces( loop );
+		} );
+	}
+
+	// this thread takes pieces too -- if the workers are busy with something else, it may end up doing
+	// all of them (which is also why a ParallelFor called from inside a job cannot deadlock the pool):
+
+	ThreadPoolRunPieces( loop );
+
+	// now every piece has been handed out, and the ones still going are running on workers:
+
+	std::unique_lock<std::mutex> lock( loop->doneMutex );
+	while( loop->piecesLeft.load( ) > 0 )
+		loop->doneCondition.wait( lock );
+}
+
+
+
+// ******************************************
+// STOP THE WORKERS (AFTER THE QUEUE DRAINS):
+// ******************************************
+
+void
+ThreadPoolDestroy( )
+{
+	{
+		std::lock_guard<std::mutex> lock( ThreadPoolMutex );
+		ThreadPoolQuitting = true;
+	}
+	ThreadPoolWakeUp.notify_all( );
+	for( size_t i = 0; i < ThreadPoolWorkers.size( ); i++ )
+		ThreadPoolWorkers[i].join( );
+	ThreadPoolWorkers.clear( );
+}
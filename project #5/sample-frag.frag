@@ -23,6 +23,13 @@ layout( std140, set = 2, binding = 0 ) uniform miscBuf
 	int   uLighting;
 } Misc;
 
+// the pipeline variant decides these, so there is no per-fragment branching on uniforms
+// (-1 is the uber pipeline, which reads Misc.uMode and Misc.uLighting instead, and is used
+// only while the specialized variant is still compiling):
+
+layout( constant_id = 0 ) const int MODE     = -1;	// 0 = use colors, 1 = use textures
+layout( constant_id = 1 ) const int LIGHTING = -1;	// 0 = off, 1 = on
+
 layout( push_constant ) uniform arm
 {
 	mat4  armMatrix;
@@ -45,8 +52,11 @@ layout ( location = 0 ) out vec4 fFragColor;
 void
 main( )
 {
+	int  mode     = MODE     >= 0 ? MODE          : Misc.uMode;
+	bool lighting = LIGHTING >= 0 ? LIGHTING != 0 : Misc.uLighting != 0;
+
 	vec3 rgb;
-	switch( Misc.uMode )
+	switch( mode )
 	{
 		case 0:
 			rgb = vColor;
@@ -60,7 +70,7 @@ main( )
 			rgb = vec3( 1., 1., 0. );
 	}
 
-	if( Misc.uLighting != 0 )
+	if( lighting )
 	{
 		vec3 normal = normalize(vN);
 		vec3 light  = normalize(vL);
@@ -1,4 +1,4 @@
-#version 400
+#version 450
 #extension GL_ARB_separate_shader_objects  : enable
 #extension GL_ARB_shading_language_420pack : enable
 
@@ -30,12 +30,18 @@ layout( std140, set = 2, binding = 0 ) uniform miscBuf
 	int   uLighting;
 } Misc;
 
-layout( push_constant ) uniform arm
+// every arm of every robot is one instance -- the robots compute shader fills these in:
+
+struct armInstance
+{
+	mat4 armMatrix;
+	vec4 armColorScale;	// rgb = color, a = scale factor in x
+};
+
+layout( std430, set = 2, binding = 1 ) readonly buffer instanceBuf
 {
-	mat4  armMatrix;
-	vec3  armColor;
-	float armScale;		// scale factor in x
-} RobotArm;
+	armInstance Instances[ ];
+};
 
 layout( location = 0 ) in vec3 aVertex;
 layout( location = 1 ) in vec3 aNormal;
@@ -59,7 +65,9 @@ main( )
 	mat4 VM = V * M;
 	mat4 PVM = P * VM;
 
-	vColor    = RobotArm.armColor;
+	armInstance RobotArm = Instances[ gl_InstanceIndex ];
+
+	vColor    = RobotArm.armColorScale.rgb;
 	vTexCoord = aTexCoord;
 
 	vN = normalize( mat3( Matrices.uNormalMatrix ) * aNormal );
@@ -80,7 +88,7 @@ main( )
   // do to bVertex just what the cube needs to become a robot arm:
   bVertex.x += 1.;
   //bVertex.x /= 2.; // now is [0., 1.]
-  bVertex.x *= RobotArm.armScale;
+  bVertex.x *= RobotArm.armColorScale.a;
   bVertex = vec3(  RobotArm.armMatrix * vec4( bVertex, 1. )  );
   //vec4 armColor = vec4( arm.armColor, 0. );
 
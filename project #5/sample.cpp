@@ -9,23 +9,20 @@
 // 	http://cs.oregonstate.edu/~mjb/vulkan
 //
 // Keyboard commands:
+// 	'f', 'F': Toggle overlapping frames-in-flight vs. waiting for the gpu after every frame
 // 	'i', 'I': Toggle using a vertex buffer only vs. a vertex/index buffer
 // 	'l', 'L': Toggle lighting off and on
 // 	'm', 'M': Toggle display mode (textures vs. colors, for now)
 // 	'p', 'P': Pause the animation
 // 	'q', 'Q': Esc: exit the program
 //	'r', 'R': Toggle rotation-animation and using the mouse
+// 	't', 'T': Evict the streamed textures (they stream back in)
 //
 // This code occassionally uses #defines for environment-specific-isms:
 // 	_WIN32		Windows
 // 	__linux__	Linux
 // 	__GNUC__	GNU compiler
 //
-// There are some pieces of the program that were tossed in to show how to do some things
-// they are not necessary in the program
-// #define them to turn them on, #undef them to turn them off
-//	#undef EXAMPLE_OF_USING_DYNAMIC_STATE_VARIABLES
-//
 // There are also some spots where options are listed just to show you what could have happened here:
 //	VkPipelineStageFlags waitAtBottom = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
 //	#ifdef CHOICES
@@ -61,11 +58,29 @@
 #include <signal.h>
 
 #include <vector>
+#include <algorithm>
+#include <set>
+#include <map>
+#include <deque>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
 
 #ifdef _WIN32
 #include <io.h>
 #endif
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #ifndef _WIN32
 typedef int errno_t;
 int	fopen_s( FILE**, const char *, const char * ); 
@@ -109,8 +124,17 @@ int	fopen_s( FILE**, const char *, const char * );
 #define APP_LONG_NAME		"Vulkan Cube Sample Program"
 
 #define SECONDS_PER_CYCLE	3.f
-#define FRAME_LAG		2
-#define SWAPCHAINIMAGECOUNT	2
+#define FRAME_LAG		2			// how many frames the cpu can get ahead of the gpu
+#define FRAME_STATS_INTERVAL	300			// how many frames between frame-time reports
+#define UNIFORM_ARENA_SLICE_SIZE	65536		// bytes of uniform data each frame-in-flight can push
+#define UPLOAD_STAGING_SIZE	(8*1024*1024)		// bytes per staging buffer in an upload batch
+#define TEXTURE_BUDGET_MB	64			// default megabytes of streamed textures that can stay resident
+#define GRAPHICS_PIPELINE_CACHE_FILE	"sample-graphics.pipelinecache"
+#define COMPUTE_PIPELINE_CACHE_FILE	"sample-compute.pipelinecache"
+#define SWAPCHAINIMAGECOUNT	2			// how many swapchain images to ask for, unless --images says otherwise (3 = triple buffering)
+#define NUM_MODES		2			// Mode: 0 = use colors, 1 = use textures
+#define NUM_LIGHTINGS		2			// UseLighting: 0 = off, 1 = on
+#define MAX_RECORD_SLOTS	16			// most threads the draw groups get recorded on
 
 #define NUM_INSTANCES		16
 
@@ -160,8 +184,8 @@ const int RIGHT  = { 1 };
 
 // report on a result return:
 
-#define REPORT(s)		{ PrintVkError( result, s );  fflush(FpDebug); }
-#define HERE_I_AM(s)		if( Verbose )  { fprintf( FpDebug, "\n***** %s *****\n", s );  fflush(FpDebug); }
+#define REPORT(s)		{ PrintVkError( result, s ); }
+#define HERE_I_AM(s)		LOG_DEBUG( "\n***** %s *****\n", s )		// the LOG_* macros are in SampleLogger.cpp
 
 
 // graphics parameters:
@@ -174,7 +198,7 @@ const float OMEGA =		2.*M_PI;		// angular velocity, radians/sec
 // if you do an od -x, the magic number looks like this:
 // 0000000 0203 0723 . . .
 
-#define NUM_QUEUES_WANTED	1
+#define NUM_QUEUES_WANTED	2			// graphics, plus transfer if it is a separate family
 
 #define ARRAY_SIZE(a)		(sizeof(a) / sizeof(a[0]))
 
@@ -208,25 +232,83 @@ typedef VkDeviceCreateInfo	VkLogicalDeviceCreateInfo;
 #define vkCreateLogicalDevice	vkCreateDevice
 
 
+// a piece of one of the sub-allocator's memory blocks (see SampleMemoryAllocator.cpp):
+
+typedef struct MyAllocation
+{
+	VkDeviceMemory		vdm;			// the block this came from -- bind with .offset
+	VkDeviceSize		offset;
+	VkDeviceSize		size;
+	int			order;			// the buddy size is 2^order, -1 = dedicated block
+	void *			mapped;			// cpu address, if the memory is host-visible
+} MyAllocation;
+
+
+// what the sub-allocator is holding:
+
+typedef struct MyMemoryStats
+{
+	VkDeviceSize		bytesUsed;		// bytes the callers asked for
+	VkDeviceSize		bytesWasted;		// bytes lost to rounding up to a power of 2
+	VkDeviceSize		bytesReserved;		// bytes in all of the blocks
+	int			numBlocks;
+	int			numAllocations;
+} MyMemoryStats;
+
+
 // holds all the information about a data buffer so it can be encapsulated in one variable:
 
 typedef struct MyBuffer
 {
 	VkDataBuffer		buffer;
-	VkDeviceMemory		vdm;
+	MyAllocation		allocation;
 	VkDeviceSize		size;
 } MyBuffer;
 
 
+// a uniform buffer that stays mapped for the life of the program
+// it is divided into FRAME_LAG slices, so the cpu never writes into a slice the gpu might still be reading:
+
+typedef struct MyUniformArena
+{
+	VkDataBuffer		buffer;
+	MyAllocation		allocation;
+	VkDeviceSize		sliceSize;		// bytes per frame-in-flight
+	VkDeviceSize		alignment;		// every push starts on a multiple of this
+	unsigned char *		mapped;			// cpu address of the start of the buffer
+	VkDeviceSize		sliceStart;		// where the current frame's slice starts
+	VkDeviceSize		head;			// next free byte in the current frame's slice
+} MyUniformArena;
+
+
+// gathers buffer and image uploads into staging memory and records them into one command buffer
+// the whole batch is submitted at once and the staging memory is released when its fence signals:
+
+typedef struct MyUploadBatch
+{
+	std::vector<MyBuffer>	staging;		// staging buffers, all host-visible and coherent
+	unsigned char *		mapped;			// cpu address of the last staging buffer
+	VkDeviceSize		head;			// next free byte in the last staging buffer
+	VkDeviceSize		alignment;		// every staged block starts on a multiple of this
+	VkCommandBuffer		commandBuffer;
+	VkFence			fence;
+	VkAccessFlags		bufferDstAccess;	// how the uploaded buffers will be read
+	VkPipelineStageFlags	bufferDstStages;	// where the uploaded buffers will be read
+	bool			recording;
+	bool			inFlight;
+} MyUploadBatch;
+
+
 typedef struct MyTexture
 {
 	uint32_t			width;
 	uint32_t			height;
 	unsigned char *			pixels;
+	uint32_t			mipLevels;		// 1 = just the base level
 	VkImage				texImage;
 	VkImageView			texImageView;
 	VkSampler			texSampler;
-	VkDeviceMemory			vdm;
+	MyAllocation			allocation;
 } MyTexture;
 
 
@@ -305,6 +387,33 @@ struct miscBuf
 };
 
 
+// running frame-time statistics, reported every FRAME_STATS_INTERVAL frames:
+
+struct frameStats
+{
+	int	count;
+	double	lastTime;			// when the previous frame started
+	double	sumFrame;			// seconds between successive frames
+	double	minFrame;
+	double	maxFrame;
+	double	sumWait;			// seconds the cpu spent blocked on fences
+};
+
+
+// everything a frame-in-flight's recorded draw groups depend on -- when it changes, they get recorded again:
+
+struct drawKey
+{
+	VkPipeline			pipeline;
+	bool				useIndexBuffer;
+	uint32_t			instanceCount;
+	uint32_t			width, height;			// the viewport and scissor
+	uint32_t			dynamicOffsets[3];		// into the uniform arena, one per dynamic buffer
+	std::vector<VkDescriptorSet>	textureSets;			// set 3 for each draw group
+	std::vector<int>		groupScopes;			// each draw group's gpu profiler scope
+};
+
+
 // an array of this struct will hold all vertex information:
 
 struct vertex
@@ -320,25 +429,32 @@ struct vertex
 // VULKAN-RELATED GLOBAL VARIABLES:
 // ********************************
 
-VkCommandBuffer			CommandBuffers[2];			// 2, because of double-buffering
+VkCommandBuffer			CommandBuffers[FRAME_LAG];		// one per frame-in-flight
 VkPipeline			ComputePipeline;
 VkPipelineCache			ComputePipelineCache;
 VkPipelineLayout		ComputePipelineLayout;
 VkDataBuffer 			DataBuffer;
 VkImage				DepthStencilImage;
+MyAllocation			DepthStencilImageMemory;
 VkImageView			DepthStencilImageView;
 VkDescriptorPool		DescriptorPool;
-VkDescriptorSetLayout		DescriptorSetLayouts[4];
-VkDescriptorSet			DescriptorSets[4];
+VkDescriptorSetLayout		DescriptorSetLayouts[5];
+VkDescriptorSet			DescriptorSets[5];
 VkDebugReportCallbackEXT	ErrorCallback = VK_NULL_HANDLE;
 VkEvent				Event;
 VkFence				Fence;
-VkFramebuffer			Framebuffers[2];
+VkFence				FrameFences[FRAME_LAG];		// signaled when the gpu is done with that frame's command buffer
+VkSemaphore			FrameImageAvailableSemaphores[FRAME_LAG];	// signaled when the acquired swapchain image can be drawn into
+VkSemaphore			FrameRenderFinishedSemaphores[FRAME_LAG];	// signaled when the frame can be presented
+std::vector<VkFramebuffer>	Framebuffers;			// one per swapchain image
 VkCommandPool			GraphicsCommandPool;
-VkPipeline			GraphicsPipeline;
+std::vector<VkCommandBuffer>	GroupCommandBuffers[FRAME_LAG];	// each frame-in-flight's secondary command buffers, in draw group order
+uint32_t			GraphicsQueueFamily;
+VkPipeline			GraphicsPipelines[NUM_MODES][NUM_LIGHTINGS];	// one variant per (Mode, UseLighting), created in the background
 VkPipelineCache			GraphicsPipelineCache;
 VkPipelineLayout		GraphicsPipelineLayout;
 uint32_t			Height;
+std::vector<VkFence>		ImageFences;			// the frame fence that last used each swapchain image
 VkInstance			Instance;
 VkExtensionProperties *		InstanceExtensions;
 VkLayerProperties *		InstanceLayers;
@@ -351,20 +467,29 @@ VkPhysicalDeviceFeatures	PhysicalDeviceFeatures;
 VkImage *			PresentImages;
 VkImageView *			PresentImageViews;	// the swap chain image views
 VkQueue				Queue;
+VkCommandPool			RecordCommandPools[MAX_RECORD_SLOTS];	// one per recording slot, so the slots can record at the same time
 VkRect2D			RenderArea;
 VkRenderPass			RenderPass; 
 VkSemaphore			SemaphoreImageAvailable;
 VkSemaphore			SemaphoreRenderFinished;
 VkShaderModule			ShaderModuleFragment;
+VkShaderModule			ShaderModuleRobots;
 VkShaderModule			ShaderModuleVertex;
+std::vector<VkCommandBuffer>	SecondaryCommandBuffers[FRAME_LAG][MAX_RECORD_SLOTS];	// what each slot has allocated from its pool
 VkBuffer			StagingBuffer;
 VkDeviceMemory			StagingBufferMemory;
 VkSurfaceKHR			Surface;
 VkSwapchainKHR			SwapChain;
-VkCommandBuffer			TextureCommandBuffer;	// used for transfering texture from staging buffer to actual texture buffer
+uint32_t			SwapchainImageCount;		// how many images the driver actually gave us
+uint32_t			RequestedImageCount;		// how many we ask for
+bool				FramebufferResized;		// set by GLFW -- the swapchain needs to be re-made
+int				SwapchainRecreations;
+VkCommandBuffer			TextureCommandBuffer;	// used for transfering buffers and textures from staging buffers to device-local memory
 VkImage				TextureImage;
 VkDeviceMemory			TextureImageMemory;
-VkCommandPool			TransferCommandPool;
+VkCommandPool			TransferCommandPool;	// for the streamed-texture copies
+VkQueue				TransferQueue;		// same as Queue if there is no separate transfer family
+uint32_t			TransferQueueFamily;
 VkDebugReportCallbackEXT	WarningCallback;
 uint32_t			Width;
 
@@ -378,27 +503,48 @@ uint32_t			Width;
 // *************************************
 
 int				ActiveButton;			// current button that is down
+double				BenchDt;			// benchmark: the fixed seconds between frames
+int				BenchFrames;			// benchmark: how many frames to measure, 0 = not benchmarking
+bool				ColdPipelines;			// true = ignore the pipeline cache files (they still get written)
+int				CommandCacheHits;		// frames that executed the draw groups as they were already recorded
+int				CommandCacheMisses;		// frames that had to record them
+int				CurrentFrame;			// which of the FRAME_LAG frames-in-flight is being recorded
 FILE *				FpDebug;			// where to send debugging messages
+struct frameStats		FrameStats;			// frame-time measurements
 struct lightBuf			Light;				// cpu struct to hold light information
 struct matBuf			Matrices;			// cpu struct to hold matrix information
 struct miscBuf			Misc;				// cpu struct to hold miscellaneous information information
 struct arm	    Arm1, Arm2, Arm3;
+bool				ForceCpuMipmaps;		// true = build mipmaps on the cpu even if the gpu could blit them
+bool				Headless;			// true = no window -- render offscreen (--headless)
+int				HeadlessDumpEvery;		// headless: write every Nth frame out as a ppm, 0 = none
+int				HeadlessFrames;			// headless: how many frames to render before exiting
 int				Mode;				// 0 = use colors, 1 = use textures, ...
-MyBuffer			MyLightUniformBuffer;
-MyTexture			MyPuppyTexture;			// the cute puppy texture struct
-MyBuffer			MyMatrixUniformBuffer;
-MyBuffer			MyMiscUniformBuffer;
+MyTexture			MyPlaceholderTexture;		// drawn with until a streamed texture is resident
+MyUniformArena			MyUniforms;			// per-frame matrix, light, and misc uniform data
+MyUploadBatch			MyUploads;			// static data on its way to device-local memory
 MyBuffer			MyVertexDataBuffer;
 MyBuffer			MyJustIndexDataBuffer;
 MyBuffer			MyJustVertexDataBuffer;
 bool				NeedToExit;			// true means the program should exit
 int				NumRenders;			// how many times the render loop has been called
+int				NumRecordSlots;			// how many threads the draw groups get recorded on
+int				NumRobots;			// how many robots get posed by the compute shader and drawn
 bool				Paused;				// true means don't animate
+int				PuppyTexture;			// streamed-texture handle for the cute puppy
+struct drawKey			RecordedKeys[FRAME_LAG];	// what each frame-in-flight's draw groups were recorded for
+bool				RecordedValid[FRAME_LAG];	// false = they have to be recorded, whatever the key says
+double				RecordSeconds;			// cpu time spent recording the draw groups
+int				RecordThreads;			// from --record-threads, 0 = one per thread-pool thread
+glm::vec3			RobotAngles;			// robot 0's three joint angles this frame
 float				Scale;				// scaling factor
+bool				SerializeFrames;		// true = wait for the gpu after every frame (no cpu/gpu overlap)
+VkDeviceSize			TextureBudget;			// bytes of streamed textures that can stay resident
 double				Time;
 bool				Verbose;			// true = write messages into a file
 int				Xmouse, Ymouse;			// mouse values
 float				Xrot, Yrot;			// rotation angles in degrees
+bool				UseCommandCache;		// false = record the draw groups every frame (--no-command-cache)
 bool				UseIndexBuffer;			// true = use both vertex and index buffer, false = just use vertex buffer
 bool				UseLighting;			// true = use lighting for display
 bool				UseRotate;			// true = rotate-animate, false = use mouse for interaction
@@ -416,6 +562,7 @@ VkResult			DestroyAllVulkan( );
 
 int				FindMemoryThatIsDeviceLocal( uint32_t );
 int				FindMemoryThatIsHostVisible( uint32_t );
+int				FindMemoryThatIsHostCoherent( uint32_t );
 int				FindMemoryByFlagAndType( VkMemoryPropertyFlagBits, uint32_t );
 
 int				FindQueueFamilyThatDoesGraphics( );
@@ -432,21 +579,73 @@ VkResult			Init03PhysicalDeviceAndGetQueueFamilyProperties( );
 
 VkResult			Init04LogicalDeviceAndQueue( );
 
-VkResult			Init05DataBuffer( VkDeviceSize, VkBufferUsageFlags, OUT MyBuffer * );
+VkResult			Init05DataBuffer( VkDeviceSize, VkBufferUsageFlags, VkMemoryPropertyFlags, OUT MyBuffer * );
 VkResult			Init05UniformBuffer( VkDeviceSize, OUT MyBuffer * );
 VkResult			Init05MyIndexDataBuffer(VkDeviceSize, OUT MyBuffer *);
 VkResult			Init05MyVertexDataBuffer( VkDeviceSize, OUT MyBuffer * );
 VkResult			Fill05DataBuffer( IN MyBuffer, IN void * );
+VkResult			Init05UniformArena( VkDeviceSize, OUT MyUniformArena * );
+void				Reset05UniformArena( INOUT MyUniformArena *, int );
+VkResult			Push05UniformArena( INOUT MyUniformArena *, IN void *, VkDeviceSize, OUT uint32_t * );
+VkResult			Init05UploadBatch( OUT MyUploadBatch * );
+unsigned char *			Reserve05Upload( INOUT MyUploadBatch *, VkDeviceSize, OUT VkDeviceSize * );
+VkDeviceSize			Stage05Upload( INOUT MyUploadBatch *, IN void *, VkDeviceSize );
+VkResult			Upload05DataBuffer( INOUT MyUploadBatch *, IN void *, IN MyBuffer, VkAccessFlags, VkPipelineStageFlags );
+VkResult			Upload07TextureImage( INOUT MyUploadBatch *, VkDeviceSize, uint32_t, uint32_t, uint32_t, IN VkImage );
+bool				Texture07CanBlit( VkFormat );
+void				Record07MipBlits( VkCommandBuffer, IN VkImage, uint32_t, uint32_t, uint32_t );
+VkResult			Submit05UploadBatch( INOUT MyUploadBatch * );
+bool				Poll05UploadBatch( INOUT MyUploadBatch * );
+void				Destroy05UploadBatch( INOUT MyUploadBatch * );
 
 VkResult			Init06CommandPools( );
 VkResult			Init06CommandBuffers( );
+VkResult			Init06RecordCommandPools( );
+VkResult			Init06FrameSyncObjects( );
+VkResult			Init06GpuProfiler( );
+void				Begin06GpuProfilerFrame( VkCommandBuffer );
+int				Begin06GpuScope( VkCommandBuffer, IN const char * );
+void				End06GpuScope( VkCommandBuffer, int );
+int				Reserve06GpuScope( IN const char * );
+void				Write06GpuTimestamp( VkCommandBuffer, int, int, bool );
+void				Report06GpuProfiler( );
+void				Flush06GpuProfiler( );
+void				Keep06GpuScopeTimes( bool );
+void				Take06GpuScopeTimes( IN const char *, OUT std::vector<double> * );
+void				Destroy06GpuProfiler( );
 
 VkResult			Init07TextureSampler( OUT MyTexture * );
 VkResult			Init07TextureBuffer( INOUT MyTexture * );
+VkResult			Init07TextureImage( INOUT MyTexture * );
+
 
-VkResult			Init07TextureBufferAndFillFromBmpFile( IN std::string, OUT MyTexture * );
+VkResult			Stream07InitPlaceholder( OUT MyTexture * );
+VkResult			Stream07Init( VkDescriptorSet );
+int				Stream07Request( IN std::string, int = 0 );
+VkDescriptorSet			Stream07Use( int );
+void				Stream07Pump( VkCommandBuffer );
+void				Stream07EvictAll( );
+bool				Stream07Busy( );
+void				Stream07Destroy( );
+
+VkResult			Robots05Init( int, int, float );
+void				Robots14Dispatch( VkCommandBuffer );
+void				Robots05Destroy( );
 
 VkResult			Init08Swapchain( );
+VkResult			Recreate08Swapchain( );
+VkResult			Init08Offscreen( );
+uint32_t			Next08OffscreenImage( );
+void				Collect08Offscreen( int );
+void				Record08Readback( VkCommandBuffer, uint32_t );
+void				Destroy08Offscreen( );
+
+int				LatencyPolicyNamed( IN const char * );
+void				LimitFrameRate( );
+void				NoteInput( );
+void				SampleInput( );
+void				NotePresent( );
+void				ReportLatency( );
 
 VkResult			Init09DepthStencilImage( );
 
@@ -455,26 +654,51 @@ VkResult			Init10RenderPasses( );
 VkResult			Init11Framebuffers( );
 
 VkResult			Init12SpirvShader( std::string, OUT VkShaderModule * );
+VkResult			Load12ShaderModules( IN std::vector<std::string> );
+VkShaderModule			Get12ShaderModule( IN std::string );
+void				Replace12ShaderModule( IN std::string, IN VkShaderModule, INOUT std::vector<uint32_t> * );
+void				Destroy12ShaderRegistry( );
 
 VkResult			Init13DescriptorSetPool( );
 VkResult			Init13DescriptorSetLayouts( );
 VkResult			Init13DescriptorSets( );
 
 VkResult			Init14GraphicsPipelineLayout( );
-VkResult			Init14GraphicsVertexFragmentPipeline( VkShaderModule, VkShaderModule, VkPrimitiveTopology, OUT VkPipeline * );
+VkResult			Init14GraphicsVertexFragmentPipeline( VkShaderModule, VkShaderModule, VkPrimitiveTopology, int, int, VkPipeline, OUT VkPipeline * );
+VkResult			Init14ComputePipelineLayout( );
 VkResult			Init14ComputePipeline( VkShaderModule, OUT VkPipeline * );
-
-
+VkResult			Init14PipelineCache( IN const char *, OUT VkPipelineCache * );
+VkResult			Save14PipelineCache( IN const char *, IN VkPipelineCache );
+void				Count14PipelineCreation( double );
+void				Report14PipelineCreation( IN const char * );
+VkResult			Init14PipelineCompiler( );
+VkPipeline			Get14GraphicsPipeline( int, int );
+bool				Busy14PipelineCompiler( );
+void				Reset14PipelineCompiler( VkPipeline, OUT std::vector<VkPipeline> * );
+void				Report14PipelineCompiler( );
+void				Destroy14PipelineCompiler( );
+void				Init14ShaderHotReload( );
+void				Poll14ShaderHotReload( );
+void				Destroy14ShaderHotReload( );
+
+
+void				RecordDrawGroup( VkCommandBuffer, IN const struct drawKey &, uint32_t );
+void				RecordDrawGroups( IN const struct drawKey & );
+bool				SameDrawKey( IN const struct drawKey &, IN const struct drawKey & );
+void				InvalidateRecordedCommands( );
 VkResult			RenderScene( );
 void				UpdateScene( );
 //VkBool32			WarningCallback( VkDebugReportFlagsEXT, VkDebugReportObjectTypeEXT, uint64_t, size_t, int32_t, const char *, const char *, void * );
 
 void				PrintVkError( VkResult, std::string = "" );
+void				ReportFrameStats( );
+void				ResetFrameStats( );
 void				Reset( );
 
 void				InitGLFW( );
 void				InitGLFWSurface( );
 void				GLFWErrorCallback( int, const char * );
+void				GLFWFramebufferSize( GLFWwindow *, int, int );
 void				GLFWKeyboard( GLFWwindow *, int, int, int, int );
 void				GLFWMouseButton( GLFWwindow *, int, int, int );
 void				GLFWMouseMotion( GLFWwindow *, double, double );
@@ -483,6 +707,62 @@ double				GLFWGetTime( );
 int				ReadInt( FILE * );
 short				ReadShort( FILE * );
 
+void				LogWrite( int, IN const char *, ... );
+void				LogInit( IN FILE * );
+void				LogFlush( );
+int				LogDropped( );
+void				LogDestroy( );
+int				LogBenchmark( );
+
+void				CpuProfilerInit( IN const char * );
+void				CpuProfilerMark( IN const char * );
+double				CpuProfilerMilliseconds( );
+void				CpuProfilerWrite( );
+
+void				BenchInit( int, double, int, IN const char * );
+double				BenchBeginFrame( );
+bool				BenchEndFrame( );
+void				BenchReport( );
+
+int				SceneList( );
+bool				SceneInit( IN const char *, int );
+void				Scene07RequestTextures( );
+
+void				ThreadPoolInit( int );
+int				ThreadPoolSize( );
+void				ThreadPoolSubmit( IN std::function<void( )> );
+void				ThreadPoolParallelFor( int, int, IN std::function<void( int, int )> );
+void				ThreadPoolDestroy( );
+
+uint32_t			MipNumLevels( uint32_t, uint32_t );
+VkDeviceSize			MipChainBytes( uint32_t, uint32_t, uint32_t );
+void				MipGenerateChain( IN const unsigned char *, uint32_t, uint32_t, uint32_t, OUT unsigned char * );
+
+VkResult			Alloc05Memory( IN VkMemoryRequirements, VkMemoryPropertyFlags, bool, OUT MyAllocation * );
+void				Free05Memory( INOUT MyAllocation * );
+void				Stats05Memory( OUT MyMemoryStats * );
+void				Report05Memory( );
+void				Destroy05MemoryAllocator( );
+
+
+#include "SampleLogger.cpp"
+#include "SampleCpuProfiler.cpp"
+#include "SampleMemoryAllocator.cpp"
+#include "SampleThreadPool.cpp"
+#include "SampleBmpLoader.cpp"
+#include "SampleMipmaps.cpp"
+#include "SampleTextureStreamer.cpp"
+#include "SamplePipelineCache.cpp"
+#include "SampleShaderRegistry.cpp"
+#include "SampleRobots.cpp"
+#include "SamplePipelineCompiler.cpp"
+#include "SampleShaderHotReload.cpp"
+#include "SampleGpuProfiler.cpp"
+#include "SampleHeadless.cpp"
+#include "SampleScenes.cpp"
+#include "SampleBenchmark.cpp"
+#include "SampleLatency.cpp"
+
 
 
 // *************
@@ -511,32 +791,148 @@ main( int argc, char * argv[ ] )
 		FpDebug = stderr;
 	}
 #endif
-	fprintf(FpDebug, "FpDebug: Width = %d ; Height = %d\n", Width, Height);
+	LOG_INFO( "FpDebug: Width = %d ; Height = %d\n", Width, Height);
+
+	TextureBudget = (VkDeviceSize)TEXTURE_BUDGET_MB * 1024 * 1024;
+	NumRobots = 1;
+	HeadlessFrames = 1000;
+	RequestedImageCount = SWAPCHAINIMAGECOUNT;
+	RecordThreads = 0;
+	UseCommandCache = true;
+	LatencyPolicy = 0;
+	FrameLimit = 0.;
+	const char * traceFile = (const char *)nullptr;
+	int benchFrames = 0;
+	double benchDt = 0.;
+	int benchWarmup = -1;
+	const char * benchJsonFile = (const char *)nullptr;
+	const char * sceneName = "robots";
+	int sceneScale = 0;
+	bool verbose = false;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( strcmp( argv[i], "--bmp-bench" ) == 0 )
+			return BmpBenchmark( "puppy.bmp", 10 );		// time the bmp loader and exit
+		if( strcmp( argv[i], "--log-bench" ) == 0 )
+			return LogBenchmark( );				// time the logging calls and exit
+		if( strcmp( argv[i], "--scenes" ) == 0 )
+			return SceneList( );				// list the built-in scenes and exit
+		if( strcmp( argv[i], "--cpu-mips" ) == 0 )
+			ForceCpuMipmaps = true;
+		if( strcmp( argv[i], "--cold-pipelines" ) == 0 )
+			ColdPipelines = true;
+		if( strcmp( argv[i], "--texture-budget" ) == 0  &&  i+1 < argc )
+			TextureBudget = (VkDeviceSize)atoi( argv[++i] ) * 1024 * 1024;	// megabytes
+		if( strcmp( argv[i], "--robots" ) == 0  &&  i+1 < argc )
+			NumRobots = atoi( argv[++i] );
+		if( strcmp( argv[i], "--trace" ) == 0  &&  i+1 < argc )
+			traceFile = argv[++i];				// chrome trace-event json of the cpu zones
+		if( strcmp( argv[i], "--headless" ) == 0 )
+			Headless = true;				// no window, no surface, no swapchain
+		if( strcmp( argv[i], "--frames" ) == 0  &&  i+1 < argc )
+			HeadlessFrames = atoi( argv[++i] );
+		if( strcmp( argv[i], "--dump-every" ) == 0  &&  i+1 < argc )
+			HeadlessDumpEvery = atoi( argv[++i] );
+		if( strcmp( argv[i], "--images" ) == 0  &&  i+1 < argc )
+			RequestedImageCount = (uint32_t)atoi( argv[++i] );	// swapchain (or offscreen) images
+		if( strcmp( argv[i], "--record-threads" ) == 0  &&  i+1 < argc )
+			RecordThreads = atoi( argv[++i] );		// most threads that record the draw groups
+		if( strcmp( argv[i], "--no-command-cache" ) == 0 )
+			UseCommandCache = false;			// record the draw groups every frame
+		if( strcmp( argv[i], "--present" ) == 0  &&  i+1 < argc )
+		{
+			i++;
+			int p = LatencyPolicyNamed( argv[i] );
+			if( p >= 0 )
+				LatencyPolicy = p;
+			else
+				fprintf( stderr, "Unknown present mode '%s' -- use mailbox, immediate, fifo, or fifo-relaxed\n", argv[i] );
+		}
+		if( strcmp( argv[i], "--fps" ) == 0  &&  i+1 < argc )
+			FrameLimit = (float)atof( argv[++i] );		// hold the frame rate, with as little lag as can be
+		if( strcmp( argv[i], "--bench" ) == 0  &&  i+1 < argc )
+			benchFrames = atoi( argv[++i] );		// fixed time steps, then a json report
+		if( strcmp( argv[i], "--dt" ) == 0  &&  i+1 < argc )
+			benchDt = atof( argv[++i] );
+		if( strcmp( argv[i], "--warmup" ) == 0  &&  i+1 < argc )
+			benchWarmup = atoi( argv[++i] );
+		if( strcmp( argv[i], "--bench-json" ) == 0  &&  i+1 < argc )
+			benchJsonFile = argv[++i];
+		if( strcmp( argv[i], "--scene" ) == 0  &&  i+1 < argc )
+			sceneName = argv[++i];				// cube, lit, grid, robots, or arms
+		if( strcmp( argv[i], "--scale" ) == 0  &&  i+1 < argc )
+			sceneScale = atoi( argv[++i] );			// the scene's one load knob
+		if( strcmp( argv[i], "--verbose" ) == 0 )
+			verbose = true;					// the debug-level messages, from the start
+	}
+
+	LogInit( FpDebug );		// from here on, a background thread does the writing to FpDebug
+	CpuProfilerInit( traceFile );
+	ThreadPoolInit( 0 );
 
 	Reset( );
+	Verbose = verbose;
+
+	if( ! SceneInit( sceneName, sceneScale ) )
+	{
+		ThreadPoolDestroy( );
+		CpuProfilerWrite( );
+		LogDestroy( );
+		return 1;
+	}
+
+	if( benchFrames > 0 )
+	{
+		BenchInit( benchFrames, benchDt, benchWarmup, benchJsonFile );
+		HeadlessFrames = 0x7fffffff;		// the benchmark decides when to stop
+	}
 
 	InitGraphics( );
 
 
-	// loop until the user closes the window:
+	// loop until the user closes the window (or, headless, until all of the frames are done):
 
-	while( glfwWindowShouldClose( MainWindow ) == 0 )
+	while( Headless ? NumRenders < HeadlessFrames : glfwWindowShouldClose( MainWindow ) == 0 )
 	{
-		glfwPollEvents( );
-		Time = glfwGetTime( );		// elapsed time, in double-precision seconds
+		CPU_ZONE( "frame" );
+		LimitFrameRate( );		// sleeps first, so the input gets sampled as late as it can be
+		if( ! Headless )
+			glfwPollEvents( );
+		SampleInput( );
+		Time = GLFWGetTime( );		// elapsed time, in double-precision seconds
+		if( BenchFrames > 0 )
+			Time = BenchBeginFrame( );	// the same sequence of times on every run
 		UpdateScene( );
 		RenderScene( );
+		if( BenchFrames > 0  &&  BenchEndFrame( ) )
+			break;
 		if( NeedToExit )
 			break;
 	}
 
-	fprintf(FpDebug, "Closing the GLFW window\n");
+	LOG_INFO( "Closing the GLFW window\n");
+	LOG_INFO( "Draw groups: recorded on %d frames (%.3f ms each), executed as they were on %d\n", CommandCacheMisses,
+		CommandCacheMisses > 0 ? 1000. * RecordSeconds / (double)CommandCacheMisses : 0., CommandCacheHits );
+	if( ! Headless )
+	{
+		LOG_INFO( "Swapchain: %d images, re-made %d times\n", SwapchainImageCount, SwapchainRecreations );
+		ReportLatency( );
+	}
 
 	vkQueueWaitIdle( Queue );
 	vkDeviceWaitIdle( LogicalDevice );
+	if( BenchFrames > 0 )
+		BenchReport( );
 	DestroyAllVulkan( );
-	glfwDestroyWindow( MainWindow );
-	glfwTerminate( );
+	if( ! Headless )
+	{
+		glfwDestroyWindow( MainWindow );
+		glfwTerminate( );
+	}
+	ThreadPoolDestroy( );
+	CpuProfilerWrite( );
+	LogDestroy( );
 	return 0;
 }
 
@@ -545,14 +941,17 @@ void
 InitGraphics( )
 {
 	HERE_I_AM( "InitGraphics" );
+	CPU_ZONE( "InitGraphics" );
 
 	VkResult result = VK_SUCCESS;
 
-	InitGLFW( );
+	if( ! Headless )
+		InitGLFW( );
 
 	Init01Instance( );
 
-	InitGLFWSurface( );
+	if( ! Headless )
+		InitGLFWSurface( );
 
 	Init02CreateDebugCallbacks( );
 
@@ -560,31 +959,36 @@ InitGraphics( )
 
 	Init04LogicalDeviceAndQueue( );
 
-	Init05UniformBuffer( sizeof(Matrices),   &MyMatrixUniformBuffer );
-	Fill05DataBuffer( MyMatrixUniformBuffer,(void *) &Matrices );
+	Init06CommandPools();
+	Init06CommandBuffers();
+	Init06RecordCommandPools( );
+	Init06FrameSyncObjects( );
+	Init06GpuProfiler( );
 
-	Init05UniformBuffer( sizeof(Light),      &MyLightUniformBuffer );
-	Fill05DataBuffer( MyLightUniformBuffer,	(void *) &Light );
+	Init05UniformArena( UNIFORM_ARENA_SLICE_SIZE, &MyUniforms );		// Matrices, Light, and Misc get pushed every frame
+	Robots05Init( NumRobots, SceneArmDepth, SceneSpacing );
 
-	Init05UniformBuffer( sizeof(Misc),   	&MyMiscUniformBuffer );
-	Fill05DataBuffer( MyMiscUniformBuffer,	(void *) &Misc );
+	// the static geometry and textures all go into device-local memory through one upload batch:
+
+	Init05UploadBatch( &MyUploads );
 
 	Init05MyVertexDataBuffer(  sizeof(VertexData), &MyVertexDataBuffer );
-	Fill05DataBuffer( MyVertexDataBuffer,			(void *) VertexData );
+	Upload05DataBuffer( &MyUploads, (void *) VertexData,     MyVertexDataBuffer,     VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT );
 
 	Init05MyVertexDataBuffer(  sizeof(JustVertexData), &MyJustVertexDataBuffer );
-	Fill05DataBuffer( MyJustVertexDataBuffer,               (void *) JustVertexData );
+	Upload05DataBuffer( &MyUploads, (void *) JustVertexData, MyJustVertexDataBuffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT );
 
 	Init05MyIndexDataBuffer(  sizeof(JustIndexData), &MyJustIndexDataBuffer );
-	Fill05DataBuffer( MyJustIndexDataBuffer,                (void *) JustIndexData );
+	Upload05DataBuffer( &MyUploads, (void *) JustIndexData,  MyJustIndexDataBuffer,  VK_ACCESS_INDEX_READ_BIT,            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT );
 
-	Init06CommandPools();
-	Init06CommandBuffers();
+	Stream07InitPlaceholder( &MyPlaceholderTexture );		// the puppy streams in later, off the main thread
 
-	Init07TextureSampler( &MyPuppyTexture );
-	Init07TextureBufferAndFillFromBmpFile("puppy.bmp", &MyPuppyTexture);
+	Submit05UploadBatch( &MyUploads );		// the gpu copies while we build the rest -- nothing waits for it
 
-	Init08Swapchain( );
+	if( Headless )
+		Init08Offscreen( );		// images of our own, instead of a swapchain's
+	else
+		Init08Swapchain( );
 
 	Init09DepthStencilImage( );
 
@@ -592,14 +996,37 @@ InitGraphics( )
 
 	Init11Framebuffers( );
 
+	// read every shader file at once -- the Init12SpirvShader( ) calls then just look them up:
+
+	std::vector<std::string> shaderFiles;
+	shaderFiles.push_back( "sample-vert.spv" );
+	shaderFiles.push_back( "sample-frag.spv" );
+	shaderFiles.push_back( "sample-robots.spv" );
+	Load12ShaderModules( shaderFiles );
+
 	Init12SpirvShader( "sample-vert.spv", &ShaderModuleVertex );
 	Init12SpirvShader( "sample-frag.spv", &ShaderModuleFragment );
+	Init12SpirvShader( "sample-robots.spv", &ShaderModuleRobots );
 
 	Init13DescriptorSetPool( );
 	Init13DescriptorSetLayouts();
 	Init13DescriptorSets( );
+	Stream07Init( DescriptorSets[3] );
 
-	Init14GraphicsVertexFragmentPipeline( ShaderModuleVertex, ShaderModuleFragment, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &GraphicsPipeline  );
+	PuppyTexture = Stream07Request( "puppy.bmp" );
+	Scene07RequestTextures( );		// any more that the scene draws with
+
+	Init14PipelineCache( GRAPHICS_PIPELINE_CACHE_FILE, &GraphicsPipelineCache );
+	Init14PipelineCache( COMPUTE_PIPELINE_CACHE_FILE,  &ComputePipelineCache );
+
+	Init14GraphicsPipelineLayout( );
+	Init14ComputePipelineLayout( );
+	Init14ComputePipeline( ShaderModuleRobots, &ComputePipeline );
+	Init14PipelineCompiler( );		// the variants in GraphicsPipelines get created later, in the background
+	Init14ShaderHotReload( );
+
+	Report05Memory( );
+	Report14PipelineCreation( "at startup" );
 }
 
 
@@ -613,6 +1040,7 @@ VkResult
 Init01Instance( )
 {
 	HERE_I_AM( "Init01Instance" );
+	CPU_ZONE( "Init01Instance" );
 
 	VkResult result = VK_SUCCESS;
 
@@ -643,10 +1071,10 @@ Init01Instance( )
 		};
 		uint32_t numLayersWanted = sizeof(instanceLayersWanted) / sizeof(char *);
 
-		fprintf(FpDebug, "\n%d Instance Layers originally wanted:\n", numLayersWanted);
+		LOG_INFO( "\n%d Instance Layers originally wanted:\n", numLayersWanted);
 		for (unsigned int i = 0; i < numLayersWanted; i++)
 		{
-			fprintf(FpDebug, "\t%s\n", instanceLayersWanted[i]);
+			LOG_INFO( "\t%s\n", instanceLayersWanted[i]);
 		}
 
 		// see what layers are actually available:
@@ -661,10 +1089,10 @@ Init01Instance( )
 			return result;
 		}
 
-		fprintf( FpDebug, "\n%d Instance Layers actually available:\n", numLayersAvailable );
+		LOG_INFO( "\n%d Instance Layers actually available:\n", numLayersAvailable );
 		for( unsigned int i = 0; i < numLayersAvailable; i++ )
 		{
-			fprintf( FpDebug, "0x%08x  %2d  '%s'  '%s'\n",
+			LOG_INFO( "0x%08x  %2d  '%s'  '%s'\n",
 				InstanceLayers[i].specVersion,
 				InstanceLayers[i].implementationVersion,
 				InstanceLayers[i].layerName,
@@ -684,10 +1112,10 @@ Init01Instance( )
 			}
 		}
 
-		fprintf( FpDebug, "\nWill now ask for %d Instance Layers:\n", (int) instanceLayersWantedAndAvailable.size( )  );
+		LOG_INFO( "\nWill now ask for %d Instance Layers:\n", (int) instanceLayersWantedAndAvailable.size( )  );
 		for( uint32_t  i = 0; i < instanceLayersWantedAndAvailable.size( ); i++ )
 		{
-			fprintf( FpDebug, "\t%s\n", instanceLayersWantedAndAvailable[i] );
+			LOG_INFO( "\t%s\n", instanceLayersWantedAndAvailable[i] );
 		}
 	}
 
@@ -707,10 +1135,10 @@ Init01Instance( )
 		};
 		uint32_t numExtensionsWanted = sizeof(instanceExtensionsWanted) / sizeof(char *);
 
-		fprintf(FpDebug, "\n%d Instance Extensions originally wanted:\n", numExtensionsWanted);
+		LOG_INFO( "\n%d Instance Extensions originally wanted:\n", numExtensionsWanted);
 		for (unsigned int i = 0; i < numExtensionsWanted; i++)
 		{
-			fprintf(FpDebug, "\t%s\n", instanceExtensionsWanted[i]);
+			LOG_INFO( "\t%s\n", instanceExtensionsWanted[i]);
 		}
 
 
@@ -726,10 +1154,10 @@ Init01Instance( )
 			return result;
 		}
 
-		fprintf(FpDebug, "\n%d Instance Extensions actually available:\n", numExtensionsAvailable);
+		LOG_INFO( "\n%d Instance Extensions actually available:\n", numExtensionsAvailable);
 		for (unsigned int i = 0; i < numExtensionsAvailable; i++)
 		{
-			fprintf(FpDebug, "0x%08x  '%s'\n",
+			LOG_INFO( "0x%08x  '%s'\n",
 				InstanceExtensions[i].specVersion,
 				InstanceExtensions[i].extensionName);
 		}
@@ -739,6 +1167,9 @@ Init01Instance( )
 		extensionsWantedAndAvailable.clear( );
 		for( uint32_t wanted = 0; wanted < numExtensionsWanted; wanted++ )
 		{
+			if( Headless  &&  strstr( instanceExtensionsWanted[wanted], "_surface" ) != NULL )
+				continue;		// no window to make a surface for
+
 			for( uint32_t available = 0; available < numExtensionsAvailable; available++ )
 			{
 				if( strcmp( instanceExtensionsWanted[wanted], InstanceExtensions[available].extensionName ) == 0 )
@@ -749,10 +1180,10 @@ Init01Instance( )
 			}
 		}
 
-		fprintf( FpDebug, "\nWill now ask for %d Instance Extensions\n", (int) extensionsWantedAndAvailable.size( )  );
+		LOG_INFO( "\nWill now ask for %d Instance Extensions\n", (int) extensionsWantedAndAvailable.size( )  );
 		for( uint32_t  i = 0; i < extensionsWantedAndAvailable.size( ); i++ )
 		{
-			fprintf( FpDebug, "\t%s\n", extensionsWantedAndAvailable[i] );
+			LOG_INFO( "\t%s\n", extensionsWantedAndAvailable[i] );
 		}
 	}
 	
@@ -785,6 +1216,7 @@ VkResult
 Init02CreateDebugCallbacks( )
 {
 	HERE_I_AM( "Init02CreateDebugCallbacks" );
+	CPU_ZONE( "Init02CreateDebugCallbacks" );
 	
 	VkResult result = VK_SUCCESS;
 
@@ -828,7 +1260,7 @@ ErrorCallback(	VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT objectTyp
 			uint64_t object, size_t location, int32_t messageCode,
 			const char *  pLayerPrefix, const char *  pMessage, void * pUserData )
 {
-	fprintf( FpDebug, "ErrorCallback: ObjectType = 0x%0x ; object = %ld ; LayerPrefix = '%s' ; Message = '%s'\n", objectType, object, pLayerPrefix, pMessage );
+	LOG_INFO( "ErrorCallback: ObjectType = 0x%0x ; object = %ld ; LayerPrefix = '%s' ; Message = '%s'\n", objectType, object, pLayerPrefix, pMessage );
 	return VK_TRUE;
 }
 
@@ -838,7 +1270,7 @@ WarningCallback( VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT objectT
 			uint64_t object, size_t location, int32_t messageCode,
 			const char *  pLayerPrefix, const char *  pMessage, void * pUserData )
 {
-	fprintf( FpDebug, "WarningCallback: ObjectType = 0x%0x ; object = %ld ; LayerPrefix = '%s' ; Message = '%s'\n", objectType, object, pLayerPrefix, pMessage );
+	LOG_INFO( "WarningCallback: ObjectType = 0x%0x ; object = %ld ; LayerPrefix = '%s' ; Message = '%s'\n", objectType, object, pLayerPrefix, pMessage );
 	return VK_TRUE;
 }
 #endif
@@ -854,6 +1286,7 @@ VkResult
 Init03PhysicalDeviceAndGetQueueFamilyProperties( )
 {
 	HERE_I_AM( "Init03PhysicalDeviceAndGetQueueFamilyProperties" );
+	CPU_ZONE( "Init03PhysicalDeviceAndGetQueueFamilyProperties" );
 
 	VkResult result = VK_SUCCESS;
 
@@ -861,18 +1294,18 @@ Init03PhysicalDeviceAndGetQueueFamilyProperties( )
 	REPORT( "vkEnumeratePhysicalDevices - 1" );
 	if( result != VK_SUCCESS || PhysicalDeviceCount <= 0 )
 	{
-		fprintf( FpDebug, "Could not count the physical devices\n" );
+		LOG_INFO( "Could not count the physical devices\n" );
 		return VK_SHOULD_EXIT;
 	}
 
-	fprintf(FpDebug, "\n%d physical devices found.\n", PhysicalDeviceCount);
+	LOG_INFO( "\n%d physical devices found.\n", PhysicalDeviceCount);
 
 	VkPhysicalDevice * physicalDevices = new VkPhysicalDevice[ PhysicalDeviceCount ];
 	result = vkEnumeratePhysicalDevices( Instance, OUT &PhysicalDeviceCount, OUT physicalDevices  );
 	REPORT( "vkEnumeratePhysicalDevices - 2" );
 	if( result != VK_SUCCESS )
 	{
-		fprintf( FpDebug, "Could not enumerate the %d physical devices\n", PhysicalDeviceCount );
+		LOG_INFO( "Could not enumerate the %d physical devices\n", PhysicalDeviceCount );
 		return VK_SHOULD_EXIT;
 	}
 
@@ -884,24 +1317,24 @@ Init03PhysicalDeviceAndGetQueueFamilyProperties( )
 		vkGetPhysicalDeviceProperties( IN physicalDevices[i], OUT &vpdp );
 		if( result != VK_SUCCESS )
 		{
-			fprintf( FpDebug, "Could not get the physical device properties of device %d\n", i );
+			LOG_INFO( "Could not get the physical device properties of device %d\n", i );
 			return VK_SHOULD_EXIT;
 		}
 
-		fprintf( FpDebug, " \n\nDevice %2d:\n", i );
-		fprintf( FpDebug, "\tAPI version: %d\n", vpdp.apiVersion );
-		fprintf( FpDebug, "\tDriver version: %d\n", vpdp.apiVersion );
-		fprintf( FpDebug, "\tVendor ID: 0x%04x\n", vpdp.vendorID );
-		fprintf( FpDebug, "\tDevice ID: 0x%04x\n", vpdp.deviceID );
-		fprintf( FpDebug, "\tPhysical Device Type: %d =", vpdp.deviceType );
-		if( vpdp.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU )	fprintf( FpDebug, " (Discrete GPU)\n" );
-		if( vpdp.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU )	fprintf( FpDebug, " (Integrated GPU)\n" );
-		if( vpdp.deviceType == VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU )	fprintf( FpDebug, " (Virtual GPU)\n" );
-		if( vpdp.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU )		fprintf( FpDebug, " (CPU)\n" );
-		fprintf( FpDebug, "\tDevice Name: %s\n", vpdp.deviceName );
-		fprintf( FpDebug, "\tPipeline Cache Size: %d\n", vpdp.pipelineCacheUUID[0] );
-		//fprintf( FpDebug, "?", vpdp.limits );
-		//fprintf( FpDebug, "?", vpdp.sparseProperties );
+		LOG_INFO( " \n\nDevice %2d:\n", i );
+		LOG_INFO( "\tAPI version: %d\n", vpdp.apiVersion );
+		LOG_INFO( "\tDriver version: %d\n", vpdp.apiVersion );
+		LOG_INFO( "\tVendor ID: 0x%04x\n", vpdp.vendorID );
+		LOG_INFO( "\tDevice ID: 0x%04x\n", vpdp.deviceID );
+		LOG_INFO( "\tPhysical Device Type: %d =", vpdp.deviceType );
+		if( vpdp.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU )	LOG_INFO( " (Discrete GPU)\n" );
+		if( vpdp.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU )	LOG_INFO( " (Integrated GPU)\n" );
+		if( vpdp.deviceType == VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU )	LOG_INFO( " (Virtual GPU)\n" );
+		if( vpdp.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU )		LOG_INFO( " (CPU)\n" );
+		LOG_INFO( "\tDevice Name: %s\n", vpdp.deviceName );
+		LOG_INFO( "\tPipeline Cache Size: %d\n", vpdp.pipelineCacheUUID[0] );
+		//LOG_INFO( "?", vpdp.limits );
+		//LOG_INFO( "?", vpdp.sparseProperties );
 
 		// need some logical here to decide which physical device to select:
 
@@ -925,29 +1358,29 @@ Init03PhysicalDeviceAndGetQueueFamilyProperties( )
 	}
 	else
 	{
-		fprintf( FpDebug, "Could not select a Physical Device\n" );
+		LOG_INFO( "Could not select a Physical Device\n" );
 		return VK_SHOULD_EXIT;
 	}
 
 	delete[ ] physicalDevices;
 
 	vkGetPhysicalDeviceProperties( PhysicalDevice, OUT &PhysicalDeviceProperties );
-	fprintf( FpDebug, "Device #%d selected ('%s')\n", which, PhysicalDeviceProperties.deviceName );
+	LOG_INFO( "Device #%d selected ('%s')\n", which, PhysicalDeviceProperties.deviceName );
 
 	vkGetPhysicalDeviceFeatures( IN PhysicalDevice, OUT &PhysicalDeviceFeatures );
 
-	fprintf( FpDebug, "\nPhysical Device Features:\n");
-	fprintf( FpDebug, "geometryShader = %2d\n", PhysicalDeviceFeatures.geometryShader);
-	fprintf( FpDebug, "tessellationShader = %2d\n", PhysicalDeviceFeatures.tessellationShader );
-	fprintf( FpDebug, "multiDrawIndirect = %2d\n", PhysicalDeviceFeatures.multiDrawIndirect );
-	fprintf( FpDebug, "wideLines = %2d\n", PhysicalDeviceFeatures.wideLines );
-	fprintf( FpDebug, "largePoints = %2d\n", PhysicalDeviceFeatures.largePoints );
-	fprintf( FpDebug, "multiViewport = %2d\n", PhysicalDeviceFeatures.multiViewport );
-	fprintf( FpDebug, "occlusionQueryPrecise = %2d\n", PhysicalDeviceFeatures.occlusionQueryPrecise );
-	fprintf( FpDebug, "pipelineStatisticsQuery = %2d\n", PhysicalDeviceFeatures.pipelineStatisticsQuery );
-	fprintf( FpDebug, "shaderFloat64 = %2d\n", PhysicalDeviceFeatures.shaderFloat64 );
-	fprintf( FpDebug, "shaderInt64 = %2d\n", PhysicalDeviceFeatures.shaderInt64 );
-	fprintf( FpDebug, "shaderInt16 = %2d\n", PhysicalDeviceFeatures.shaderInt16 );
+	LOG_INFO( "\nPhysical Device Features:\n");
+	LOG_INFO( "geometryShader = %2d\n", PhysicalDeviceFeatures.geometryShader);
+	LOG_INFO( "tessellationShader = %2d\n", PhysicalDeviceFeatures.tessellationShader );
+	LOG_INFO( "multiDrawIndirect = %2d\n", PhysicalDeviceFeatures.multiDrawIndirect );
+	LOG_INFO( "wideLines = %2d\n", PhysicalDeviceFeatures.wideLines );
+	LOG_INFO( "largePoints = %2d\n", PhysicalDeviceFeatures.largePoints );
+	LOG_INFO( "multiViewport = %2d\n", PhysicalDeviceFeatures.multiViewport );
+	LOG_INFO( "occlusionQueryPrecise = %2d\n", PhysicalDeviceFeatures.occlusionQueryPrecise );
+	LOG_INFO( "pipelineStatisticsQuery = %2d\n", PhysicalDeviceFeatures.pipelineStatisticsQuery );
+	LOG_INFO( "shaderFloat64 = %2d\n", PhysicalDeviceFeatures.shaderFloat64 );
+	LOG_INFO( "shaderInt64 = %2d\n", PhysicalDeviceFeatures.shaderInt64 );
+	LOG_INFO( "shaderInt16 = %2d\n", PhysicalDeviceFeatures.shaderInt16 );
 
 #ifdef COMMENT
 	All of these VkPhysicalDeviceFeatures are VkBool32s:
@@ -1026,61 +1459,61 @@ VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT = 0x00001000,
 VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_CUBIC_BIT_IMG = 0x00002000,
 #endif
 
-	fprintf( FpDebug, "\nImage Formats Checked:\n" );
+	LOG_INFO( "\nImage Formats Checked:\n" );
 	vkGetPhysicalDeviceFormatProperties( PhysicalDevice, IN VK_FORMAT_R32G32B32A32_SFLOAT, &vfp );
-	fprintf( FpDebug, "Format VK_FORMAT_R32G32B32A32_SFLOAT: 0x%08x 0x%08x  0x%08x\n",
+	LOG_INFO( "Format VK_FORMAT_R32G32B32A32_SFLOAT: 0x%08x 0x%08x  0x%08x\n",
 				vfp.linearTilingFeatures, vfp.optimalTilingFeatures, vfp.bufferFeatures );
 	vkGetPhysicalDeviceFormatProperties( PhysicalDevice, IN VK_FORMAT_R8G8B8A8_UNORM, &vfp );
-	fprintf( FpDebug, "Format VK_FORMAT_R8G8B8A8_UNORM: 0x%08x 0x%08x  0x%08x\n",
+	LOG_INFO( "Format VK_FORMAT_R8G8B8A8_UNORM: 0x%08x 0x%08x  0x%08x\n",
 				vfp.linearTilingFeatures, vfp.optimalTilingFeatures, vfp.bufferFeatures );
 	vkGetPhysicalDeviceFormatProperties( PhysicalDevice, IN VK_FORMAT_B8G8R8A8_UNORM, &vfp );
-	fprintf( FpDebug, "Format VK_FORMAT_B8G8R8A8_UNORM: 0x%08x 0x%08x  0x%08x\n",
+	LOG_INFO( "Format VK_FORMAT_B8G8R8A8_UNORM: 0x%08x 0x%08x  0x%08x\n",
 				vfp.linearTilingFeatures, vfp.optimalTilingFeatures, vfp.bufferFeatures );
 	vkGetPhysicalDeviceFormatProperties( PhysicalDevice, IN VK_FORMAT_B8G8R8A8_SRGB, &vfp );
-	fprintf( FpDebug, "Format VK_FORMAT_B8G8R8A8_SRGB: 0x%08x 0x%08x  0x%08x\n",
+	LOG_INFO( "Format VK_FORMAT_B8G8R8A8_SRGB: 0x%08x 0x%08x  0x%08x\n",
 				vfp.linearTilingFeatures, vfp.optimalTilingFeatures, vfp.bufferFeatures );
 
 	VkPhysicalDeviceMemoryProperties			vpdmp;
 	vkGetPhysicalDeviceMemoryProperties( PhysicalDevice, OUT &vpdmp );
 
-	fprintf( FpDebug, "\n%d Memory Types:\n", vpdmp.memoryTypeCount );
+	LOG_INFO( "\n%d Memory Types:\n", vpdmp.memoryTypeCount );
 	for( unsigned int i = 0; i < vpdmp.memoryTypeCount; i++ )
 	{
 		VkMemoryType vmt = vpdmp.memoryTypes[i];
 		VkMemoryPropertyFlags vmpf = vmt.propertyFlags;
-		fprintf( FpDebug, "Memory %2d: ", i );
-		if( (vmpf & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT       ) != 0 )	fprintf( FpDebug, " DeviceLocal" );
-		if( (vmpf & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT       ) != 0 )	fprintf( FpDebug, " HostVisible" );
-		if( (vmpf & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT      ) != 0 )	fprintf( FpDebug, " HostCoherent" );
-		if( (vmpf & VK_MEMORY_PROPERTY_HOST_CACHED_BIT        ) != 0 )	fprintf( FpDebug, " HostCached" );
-		if( (vmpf & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT   ) != 0 )	fprintf( FpDebug, " LazilyAllocated" );
-		fprintf(FpDebug, "\n");
+		LOG_INFO( "Memory %2d: ", i );
+		if( (vmpf & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT       ) != 0 )	LOG_INFO( " DeviceLocal" );
+		if( (vmpf & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT       ) != 0 )	LOG_INFO( " HostVisible" );
+		if( (vmpf & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT      ) != 0 )	LOG_INFO( " HostCoherent" );
+		if( (vmpf & VK_MEMORY_PROPERTY_HOST_CACHED_BIT        ) != 0 )	LOG_INFO( " HostCached" );
+		if( (vmpf & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT   ) != 0 )	LOG_INFO( " LazilyAllocated" );
+		LOG_INFO( "\n");
 	}
 
-	fprintf( FpDebug, "\n%d Memory Heaps:\n", vpdmp.memoryHeapCount );
+	LOG_INFO( "\n%d Memory Heaps:\n", vpdmp.memoryHeapCount );
 	for( unsigned int  i = 0; i < vpdmp.memoryHeapCount; i++ )
 	{
-		fprintf(FpDebug, "Heap %d: ", i);
+		LOG_INFO( "Heap %d: ", i);
 		VkMemoryHeap vmh = vpdmp.memoryHeaps[i];
-		fprintf( FpDebug, " size = 0x%08lx", (unsigned long int)vmh.size );
-		if( ( vmh.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT        ) != 0 )	fprintf( FpDebug, " DeviceLocal" );
-		if( ( vmh.flags & VK_MEMORY_HEAP_MULTI_INSTANCE_BIT  ) != 0 )	fprintf( FpDebug, " MultiInstance" );
-		fprintf(FpDebug, "\n");
+		LOG_INFO( " size = 0x%08lx", (unsigned long int)vmh.size );
+		if( ( vmh.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT        ) != 0 )	LOG_INFO( " DeviceLocal" );
+		if( ( vmh.flags & VK_MEMORY_HEAP_MULTI_INSTANCE_BIT  ) != 0 )	LOG_INFO( " MultiInstance" );
+		LOG_INFO( "\n");
 	}
 
 	uint32_t count = -1;
 	vkGetPhysicalDeviceQueueFamilyProperties( IN PhysicalDevice, &count, OUT (VkQueueFamilyProperties *)nullptr );
-	fprintf( FpDebug, "\nFound %d Queue Families:\n", count );
+	LOG_INFO( "\nFound %d Queue Families:\n", count );
 
 	VkQueueFamilyProperties *vqfp = new VkQueueFamilyProperties[ count ];
 	vkGetPhysicalDeviceQueueFamilyProperties( IN PhysicalDevice, &count, OUT vqfp );
 	for( unsigned int i = 0; i < count; i++ )
 	{
-		fprintf( FpDebug, "\t%d: Queue Family Count = %2d  ;   ", i, vqfp[i].queueCount );
-		if( ( vqfp[i].queueFlags & VK_QUEUE_GRAPHICS_BIT ) != 0 )	fprintf( FpDebug, " Graphics" );
-		if( ( vqfp[i].queueFlags & VK_QUEUE_COMPUTE_BIT  ) != 0 )	fprintf( FpDebug, " Compute" );
-		if( ( vqfp[i].queueFlags & VK_QUEUE_TRANSFER_BIT ) != 0 )	fprintf( FpDebug, " Transfer" );
-		fprintf(FpDebug, "\n");
+		LOG_INFO( "\t%d: Queue Family Count = %2d  ;   ", i, vqfp[i].queueCount );
+		if( ( vqfp[i].queueFlags & VK_QUEUE_GRAPHICS_BIT ) != 0 )	LOG_INFO( " Graphics" );
+		if( ( vqfp[i].queueFlags & VK_QUEUE_COMPUTE_BIT  ) != 0 )	LOG_INFO( " Compute" );
+		if( ( vqfp[i].queueFlags & VK_QUEUE_TRANSFER_BIT ) != 0 )	LOG_INFO( " Transfer" );
+		LOG_INFO( "\n");
 	}
 
 	delete[ ] vqfp;
@@ -1096,21 +1529,32 @@ VkResult
 Init04LogicalDeviceAndQueue( )
 {
 	HERE_I_AM( "Init04LogicalDeviceAndQueue" );
+	CPU_ZONE( "Init04LogicalDeviceAndQueue" );
 
 	VkResult result = VK_SUCCESS;
 
 	float 	queuePriorities[NUM_QUEUES_WANTED] =
 	{
+		1.,
 		1.
 	};
 
+	GraphicsQueueFamily = FindQueueFamilyThatDoesGraphics( );
+	TransferQueueFamily = FindQueueFamilyThatDoesTransfer( );
+	uint32_t queueCreateInfoCount = TransferQueueFamily != GraphicsQueueFamily ? 2 : 1;
+	LOG_INFO( "Graphics queue family = %d ; Transfer queue family = %d\n", GraphicsQueueFamily, TransferQueueFamily );
+
 	VkDeviceQueueCreateInfo				vdqci[NUM_QUEUES_WANTED];
 		vdqci[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		vdqci[0].pNext = nullptr;
 		vdqci[0].flags = 0;
-		vdqci[0].queueFamilyIndex = FindQueueFamilyThatDoesGraphics( );
+		vdqci[0].queueFamilyIndex = GraphicsQueueFamily;
 		vdqci[0].queueCount = 1;		// how many queues to create
-		vdqci[0].pQueuePriorities = queuePriorities;	// array of queue priorities [0.,1.]
+		vdqci[0].pQueuePriorities = &queuePriorities[0];	// array of queue priorities [0.,1.]
+
+		vdqci[1] = vdqci[0];			// only used if the transfer family is a different one
+		vdqci[1].queueFamilyIndex = TransferQueueFamily;
+		vdqci[1].pQueuePriorities = &queuePriorities[1];
 
 
 	const char * myDeviceLayers[ ] =
@@ -1137,10 +1581,10 @@ Init04LogicalDeviceAndQueue( )
 		return result;
 	}
 
-	fprintf(FpDebug, "\n%d physical device layers enumerated:\n", layerCount);
+	LOG_INFO( "\n%d physical device layers enumerated:\n", layerCount);
 	for (unsigned int i = 0; i < layerCount; i++)
 	{
-		fprintf(FpDebug, "0x%08x  %2d  '%s'  '%s'\n",
+		LOG_INFO( "0x%08x  %2d  '%s'  '%s'\n",
 			deviceLayers[i].specVersion,
 			deviceLayers[i].implementationVersion,
 			deviceLayers[i].layerName,
@@ -1159,14 +1603,14 @@ Init04LogicalDeviceAndQueue( )
 			return result;
 		}
 
-		fprintf(FpDebug, "\t%d device extensions enumerated for '%s':\n", extensionCount, deviceLayers[i].layerName );
+		LOG_INFO( "\t%d device extensions enumerated for '%s':\n", extensionCount, deviceLayers[i].layerName );
 		for (unsigned int ii = 0; ii < extensionCount; ii++)
 		{
-			fprintf(FpDebug, "\t0x%08x  '%s'\n",
+			LOG_INFO( "\t0x%08x  '%s'\n",
 				deviceExtensions[ii].specVersion,
 				deviceExtensions[ii].extensionName);
 		}
-		fprintf(FpDebug, "\n");
+		LOG_INFO( "\n");
 	}
 
 	delete[ ] deviceLayers;
@@ -1176,7 +1620,7 @@ Init04LogicalDeviceAndQueue( )
 		vdci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		vdci.pNext = nullptr;
 		vdci.flags = 0;
-		vdci.queueCreateInfoCount = NUM_QUEUES_WANTED;		// # of device queues, each of which can create multiple queues
+		vdci.queueCreateInfoCount = queueCreateInfoCount;	// # of device queues, each of which can create multiple queues
 		vdci.pQueueCreateInfos = IN &vdqci[0];			// array of VkDeviceQueueCreateInfo's
 
 		vdci.enabledLayerCount = sizeof(myDeviceLayers) / sizeof(char *);
@@ -1184,6 +1628,8 @@ Init04LogicalDeviceAndQueue( )
 		vdci.ppEnabledLayerNames = myDeviceLayers;
 
 		vdci.enabledExtensionCount = sizeof(myDeviceExtensions) / sizeof(char *);
+		if( Headless )
+			vdci.enabledExtensionCount = 0;			// nothing to present to, so no VK_KHR_swapchain
 		vdci.ppEnabledExtensionNames = myDeviceExtensions;
 
 		vdci.pEnabledFeatures = IN &PhysicalDeviceFeatures;	// already created
@@ -1194,8 +1640,9 @@ Init04LogicalDeviceAndQueue( )
 	
 	// get the queue for this logical device:
 	
-	vkGetDeviceQueue( LogicalDevice, 0, 0,  OUT &Queue );
+	vkGetDeviceQueue( LogicalDevice, GraphicsQueueFamily, 0,  OUT &Queue );
 				// queueFamilyIndex, queueIndex
+	vkGetDeviceQueue( LogicalDevice, TransferQueueFamily, 0,  OUT &TransferQueue );	// gives back Queue again if the families are the same
 	return result;
 }
 
@@ -1204,12 +1651,14 @@ Init04LogicalDeviceAndQueue( )
 // *********************
 
 // This just creates the data buffer -- filling it with data uses the Fill05DataBuffer function
+// (for host-visible memory) or Upload05DataBuffer (for device-local memory)
 // Use this for vertex buffers, index buffers, uniform buffers, and textures
 
 VkResult
-Init05DataBuffer( VkDeviceSize size, VkBufferUsageFlags usage, OUT MyBuffer * pMyBuffer )
+Init05DataBuffer( VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryFlags, OUT MyBuffer * pMyBuffer )
 {
 	HERE_I_AM( "Init05DataBuffer" );
+	CPU_ZONE( "Init05DataBuffer" );
 
 	VkResult result = VK_SUCCESS;
 
@@ -1246,24 +1695,17 @@ VK_SHARING_MODE_CONCURRENT
 	vkGetBufferMemoryRequirements( LogicalDevice, IN pMyBuffer->buffer, OUT &vmr );		// fills vmr
 	if( Verbose )
 	{
-		fprintf( FpDebug, "Buffer vmr.size = %lld\n", vmr.size );
-		fprintf( FpDebug, "Buffer vmr.alignment = %lld\n", vmr.alignment );
-		fprintf( FpDebug, "Buffer vmr.memoryTypeBits = 0x%08x\n", vmr.memoryTypeBits );
-		fflush( FpDebug );
+		LOG_INFO( "Buffer vmr.size = %lld\n", vmr.size );
+		LOG_INFO( "Buffer vmr.alignment = %lld\n", vmr.alignment );
+		LOG_INFO( "Buffer vmr.memoryTypeBits = 0x%08x\n", vmr.memoryTypeBits );
 	}
 
-	VkMemoryAllocateInfo			vmai;
-		vmai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		vmai.pNext = nullptr;
-		vmai.allocationSize = vmr.size;
-		vmai.memoryTypeIndex = FindMemoryThatIsHostVisible( vmr.memoryTypeBits );
+	// the memory comes out of one of the sub-allocator's blocks:
 
-	VkDeviceMemory				vdm;
-	result = vkAllocateMemory( LogicalDevice, IN &vmai, PALLOCATOR, OUT &vdm );
-	REPORT( "vkAllocateMemory" );
-	pMyBuffer->vdm = vdm;
+	result = Alloc05Memory( vmr, memoryFlags, true, OUT &pMyBuffer->allocation );
+	REPORT( "Alloc05Memory" );
 
-	result = vkBindBufferMemory( LogicalDevice, pMyBuffer->buffer, IN vdm, OFFSET_ZERO );
+	result = vkBindBufferMemory( LogicalDevice, pMyBuffer->buffer, IN pMyBuffer->allocation.vdm, pMyBuffer->allocation.offset );
 	REPORT( "vkBindBufferMemory" );
 
 	return result;
@@ -1271,11 +1713,12 @@ VK_SHARING_MODE_CONCURRENT
 // ***********************
 // CREATE AN INDEX BUFFER:
 // ***********************
-// this allocates space for a data buffer, but doesn't yet fill it:
+// this allocates device-local space for a data buffer, but doesn't yet fill it:
 VkResult
 Init05MyIndexDataBuffer(IN VkDeviceSize size, OUT MyBuffer * pMyBuffer)
 {
-        VkResult result = Init05DataBuffer(size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, pMyBuffer);          // fills pMyBuffer
+        VkResult result = Init05DataBuffer(size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pMyBuffer);          // fills pMyBuffer
         REPORT("Init05MyIndexDataBufferBuffer");
         return result;
 }
@@ -1284,12 +1727,13 @@ Init05MyIndexDataBuffer(IN VkDeviceSize size, OUT MyBuffer * pMyBuffer)
 // ***********************
 // CREATE A VERTEX BUFFER:
 // ***********************
-// this allocates space for a data buffer, but doesn't yet fill it:
+// this allocates device-local space for a data buffer, but doesn't yet fill it:
 
 VkResult
 Init05MyVertexDataBuffer( IN VkDeviceSize size, OUT MyBuffer * pMyBuffer )
 {
-	VkResult result = Init05DataBuffer( size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pMyBuffer );		// fills pMyBuffer
+	VkResult result = Init05DataBuffer( size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pMyBuffer );		// fills pMyBuffer
 	REPORT( "InitDataBuffer" );
 	return result;
 }
@@ -1304,7 +1748,7 @@ Init05MyVertexDataBuffer( IN VkDeviceSize size, OUT MyBuffer * pMyBuffer )
 VkResult
 Init05UniformBuffer( VkDeviceSize size, MyBuffer * pMyBuffer )
 {
-	VkResult result = Init05DataBuffer( size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, OUT pMyBuffer );	// fills pMyBuffer
+	VkResult result = Init05DataBuffer( size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, OUT pMyBuffer );	// fills pMyBuffer
 	return result;
 }
 
@@ -1317,11 +1761,14 @@ VkResult
 Fill05DataBuffer( IN MyBuffer myBuffer, IN void * data )
 {
 	// the size of the data had better match the size that was used to Init the buffer!
+	// host-visible memory blocks stay mapped, so there is no vkMapMemory( ) here:
 
-	void * pGpuMemory;
-	vkMapMemory( LogicalDevice, IN myBuffer.vdm, OFFSET_ZERO, VK_WHOLE_SIZE, 0, &pGpuMemory );	// 0 is the flags bitmask
-	memcpy( pGpuMemory, data, (size_t)myBuffer.size );
-	vkUnmapMemory( LogicalDevice, IN myBuffer.vdm );
+	if( myBuffer.allocation.mapped == nullptr )
+	{
+		LOG_INFO( "Fill05DataBuffer: this buffer is not in host-visible memory\n" );
+		return VK_FAILURE;
+	}
+	memcpy( myBuffer.allocation.mapped, data, (size_t)myBuffer.size );
 	return VK_SUCCESS;
 
 	// the way shown here makes it happen immediately
@@ -1333,577 +1780,752 @@ Fill05DataBuffer( IN MyBuffer myBuffer, IN void * data )
 
 
 
+// ***********************
+// CREATE A UNIFORM ARENA:
+// ***********************
 
-
-// *************************
-// CREATE A TEXTURE SAMPLER:
-// *************************
+// The arena is mapped once, here, and never unmapped.
+// Uniform data that changes every frame gets pushed into the current frame's slice,
+// and the shaders find it through VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC offsets.
 
 VkResult
-Init07TextureSampler( MyTexture * pMyTexture )
+Init05UniformArena( VkDeviceSize sliceSize, OUT MyUniformArena * pMyArena )
 {
-	HERE_I_AM( "Init07TextureSampler" );
+	HERE_I_AM( "Init05UniformArena" );
+	CPU_ZONE( "Init05UniformArena" );
 
 	VkResult result = VK_SUCCESS;
-	
-	VkSamplerCreateInfo					vsci;
-		vsci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		vsci.pNext = nullptr;
-		vsci.flags = 0;
-		vsci.magFilter = VK_FILTER_LINEAR;
-		vsci.minFilter = VK_FILTER_LINEAR;
-		vsci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		vsci.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		vsci.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		vsci.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-#ifdef CHOICES
-VK_SAMPLER_ADDRESS_MODE_REPEAT
-VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT
-VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE
-VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
-VK_SAMPLER_ADDRESS_MODE_MIRROR_CLAMP_TO_EDGE
-#endif
-		vsci.mipLodBias = 0.;
-		vsci.anisotropyEnable = VK_FALSE;
-		vsci.maxAnisotropy = 1.;
-		vsci.compareEnable = VK_FALSE;
-		vsci.compareOp = VK_COMPARE_OP_NEVER;
-#ifdef CHOICES
-VK_COMPARE_OP_NEVER
-VK_COMPARE_OP_LESS
-VK_COMPARE_OP_EQUAL
-VK_COMPARE_OP_LESS_OR_EQUAL
-VK_COMPARE_OP_GREATER
-VK_COMPARE_OP_NOT_EQUAL
-VK_COMPARE_OP_GREATER_OR_EQUAL
-VK_COMPARE_OP_ALWAYS
-#endif
-		vsci.minLod = 0.;
-		vsci.maxLod = 0.;
-		vsci.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
-#ifdef CHOICES
-VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK
-VK_BORDER_COLOR_INT_TRANSPARENT_BLACK
-VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK
-VK_BORDER_COLOR_INT_OPAQUE_BLACK
-VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE
-VK_BORDER_COLOR_INT_OPAQUE_WHITE
-#endif
-		vsci.unnormalizedCoordinates = VK_FALSE;	// VK_TRUE means we are use raw texels as the index
-								// VK_FALSE means we are uing the usual 0. - 1.
 
-	result = vkCreateSampler( LogicalDevice, IN &vsci, PALLOCATOR, OUT &pMyTexture->texSampler );
-	REPORT( "vkCreateSampler" );
+	VkDeviceSize alignment = PhysicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+	if( alignment == 0 )
+		alignment = 1;
+	sliceSize = ( ( sliceSize + alignment - 1 ) / alignment ) * alignment;
+
+	VkBufferCreateInfo  vbci;
+		vbci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		vbci.pNext = nullptr;
+		vbci.flags = 0;
+		vbci.size = FRAME_LAG * sliceSize;
+		vbci.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+		vbci.queueFamilyIndexCount = 0;
+		vbci.pQueueFamilyIndices = (const uint32_t *)nullptr;
+		vbci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	result = vkCreateBuffer( LogicalDevice, IN &vbci, PALLOCATOR, OUT &pMyArena->buffer );
+	REPORT( "vkCreateBuffer -- uniform arena" );
+
+	VkMemoryRequirements			vmr;
+	vkGetBufferMemoryRequirements( LogicalDevice, IN pMyArena->buffer, OUT &vmr );
+
+	// host-coherent, so that a memcpy is all it takes for the gpu to see the new values
+	// (the sub-allocator keeps host-visible blocks mapped):
+
+	result = Alloc05Memory( vmr, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true, OUT &pMyArena->allocation );
+	REPORT( "Alloc05Memory -- uniform arena" );
+
+	result = vkBindBufferMemory( LogicalDevice, pMyArena->buffer, IN pMyArena->allocation.vdm, pMyArena->allocation.offset );
+	REPORT( "vkBindBufferMemory -- uniform arena" );
+
+	pMyArena->sliceSize = sliceSize;
+	pMyArena->alignment = alignment;
+	pMyArena->mapped = (unsigned char *)pMyArena->allocation.mapped;
+	pMyArena->sliceStart = 0;
+	pMyArena->head = 0;
+
 	return result;
 }
 
 
+// start pushing into the slice that belongs to this frame-in-flight
+// (only call this once that frame's fence has signaled):
 
-// ************************
-// CREATE A TEXTURE BUFFER:
-// ************************
+void
+Reset05UniformArena( INOUT MyUniformArena * pMyArena, int frame )
+{
+	pMyArena->sliceStart = (VkDeviceSize)frame * pMyArena->sliceSize;
+	pMyArena->head = 0;
+}
 
-// assume we get to here and have in a MyTexture struct:
-// 	* an unsigned char array, holding the pixel rgba
-//	* width  is the number of texels in s
-//	* height is the number of texels in t
+
+// copy a block of uniform data into the current slice
+// *pOffset gets the dynamic offset to hand to vkCmdBindDescriptorSets( )
+// if the slice is full, nothing is copied and VK_FAILURE comes back -- starting over at the front of
+// the slice would overwrite the blocks that this frame has already pushed:
 
 VkResult
-Init07TextureBuffer( INOUT MyTexture * pMyTexture)
+Push05UniformArena( INOUT MyUniformArena * pMyArena, IN void * data, VkDeviceSize size, OUT uint32_t * pOffset )
 {
-	HERE_I_AM( "Init07TextureBuffer" );
+	VkDeviceSize offset = pMyArena->head;
+	if( offset + size > pMyArena->sliceSize )
+	{
+		LOG_ERROR( "Uniform arena slice overflow: %d + %d > %d -- raise UNIFORM_ARENA_SLICE_SIZE\n", (int)offset, (int)size, (int)pMyArena->sliceSize );
+		return VK_FAILURE;
+	}
+
+	memcpy( pMyArena->mapped + pMyArena->sliceStart + offset, data, (size_t)size );
+	pMyArena->head = ( ( offset + size + pMyArena->alignment - 1 ) / pMyArena->alignment ) * pMyArena->alignment;
+	*pOffset = (uint32_t)( pMyArena->sliceStart + offset );
+	return VK_SUCCESS;
+}
+
+
+
+// ***********************
+// CREATE AN UPLOAD BATCH:
+// ***********************
+
+// Uploads get staged into host-visible memory and recorded into TextureCommandBuffer.
+// Nothing goes to the gpu until Submit05UploadBatch( ), and nothing ever waits for it --
+// the barriers recorded here make the results visible to everything submitted to Queue afterwards.
+// Call Poll05UploadBatch( ) once a frame to free the staging memory when the copies are done.
+
+VkResult
+Init05UploadBatch( OUT MyUploadBatch * pMyBatch )
+{
+	HERE_I_AM( "Init05UploadBatch" );
+	CPU_ZONE( "Init05UploadBatch" );
 
 	VkResult result = VK_SUCCESS;
 
-	uint32_t texWidth = pMyTexture->width;
-	uint32_t texHeight = pMyTexture->height;
-	unsigned char *texture = pMyTexture->pixels;
-	VkDeviceSize textureSize = texWidth * texHeight * 4;		// rgba, 1 byte each
+	pMyBatch->staging.clear( );
+	pMyBatch->mapped = (unsigned char *)nullptr;
+	pMyBatch->head = 0;
+	pMyBatch->alignment = PhysicalDeviceProperties.limits.optimalBufferCopyOffsetAlignment;
+	if( pMyBatch->alignment < 16 )
+		pMyBatch->alignment = 16;		// also keeps image copies on a texel boundary
+	pMyBatch->commandBuffer = TextureCommandBuffer;
+	pMyBatch->bufferDstAccess = 0;
+	pMyBatch->bufferDstStages = 0;
+	pMyBatch->inFlight = false;
 
-	VkImage  stagingImage;
-	VkImage  textureImage;
+	VkFenceCreateInfo			vfci;
+		vfci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		vfci.pNext = nullptr;
+		vfci.flags = 0;
 
+	result = vkCreateFence( LogicalDevice, IN &vfci, PALLOCATOR, OUT &pMyBatch->fence );
+	REPORT( "vkCreateFence -- upload batch" );
 
-	// *******************************************************************************
-	// this first {...} is to create the staging image:
-	// *******************************************************************************
+	VkCommandBufferBeginInfo		vcbbi;
+		vcbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		vcbbi.pNext = nullptr;
+		vcbbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vcbbi.pInheritanceInfo = (VkCommandBufferInheritanceInfo *)nullptr;
+
+	result = vkBeginCommandBuffer( pMyBatch->commandBuffer, IN &vcbbi );
+	REPORT( "Init05UploadBatch -- vkBeginCommandBuffer" );
+	pMyBatch->recording = true;
+
+	return result;
+}
+
+
+// find room for size bytes in staging memory, adding another staging buffer if this one is full
+// returns the cpu address to write the data to -- *pOffset is where that is in the last staging buffer:
+
+unsigned char *
+Reserve05Upload( INOUT MyUploadBatch * pMyBatch, VkDeviceSize size, OUT VkDeviceSize * pOffset )
+{
+	VkDeviceSize offset = ( ( pMyBatch->head + pMyBatch->alignment - 1 ) / pMyBatch->alignment ) * pMyBatch->alignment;
+
+	if( pMyBatch->staging.empty( )  ||  offset + size > pMyBatch->staging.back( ).size )
 	{
-		VkImageCreateInfo			vici;
-			vici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-			vici.pNext = nullptr;
-			vici.flags = 0;
-#ifdef CHOICES
-VK_IMAGE_CREATE_SPARSE_BINDING_BIT
-VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT
-VK_IMAGE_CREATE_SPARSE_ALIASED_BIT
-VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT
-VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT
-VK_IMAGE_CREATE_BIND_SFR_BIT_KHX
-VK_IMAGE_CREATE_2D_ARRAY_COMPATIBLE_BIT_KHR
-#endif
-			vici.imageType = VK_IMAGE_TYPE_2D;
-			//vici.format = VK_FORMAT_R8G8B8A8_UNORM;
-			vici.format = VK_FORMAT_B8G8R8A8_SRGB;
-			vici.extent.width = texWidth;
-			vici.extent.height = texHeight;
-			vici.extent.depth = 1;
-			vici.mipLevels = 1;
-			vici.arrayLayers = 1;
-			vici.samples = VK_SAMPLE_COUNT_1_BIT;
-			vici.tiling = VK_IMAGE_TILING_LINEAR;
-#ifdef CHOICES
-VK_IMAGE_TILING_OPTIMAL
-VK_IMAGE_TILING_LINEAR
-#endif
-			vici.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-#ifdef CHOICES
-VK_IMAGE_USAGE_TRANSFER_SRC_BIT
-VK_IMAGE_USAGE_TRANSFER_DST_BIT
-VK_IMAGE_USAGE_SAMPLED_BIT
-VK_IMAGE_USAGE_STORAGE_BIT
-VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
-VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
-VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
-VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT
-#endif
-			vici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			vici.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
-#ifdef CHOICES
-VK_IMAGE_LAYOUT_UNDEFINED
-VK_IMAGE_LAYOUT_PREINITIALIZED
-#endif
-			vici.queueFamilyIndexCount = 0;
-			vici.pQueueFamilyIndices = (const uint32_t *)nullptr;
+		VkDeviceSize stagingSize = size > UPLOAD_STAGING_SIZE ? size : UPLOAD_STAGING_SIZE;
 
-		result = vkCreateImage(LogicalDevice, IN &vici, PALLOCATOR, OUT &stagingImage);	// allocated, but not filled
-		REPORT("vkCreateImage");
+		MyBuffer myStaging;
+		Init05DataBuffer( stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, OUT &myStaging );
 
-		VkMemoryRequirements			vmr;
-		vkGetImageMemoryRequirements(LogicalDevice, IN stagingImage, OUT &vmr);
+		pMyBatch->staging.push_back( myStaging );
+		pMyBatch->mapped = (unsigned char *)myStaging.allocation.mapped;		// already mapped by the sub-allocator
+		offset = 0;
+	}
 
-		if (Verbose)
-		{
-			fprintf(FpDebug, "Image vmr.size = %lld\n", vmr.size);
-			fprintf(FpDebug, "Image vmr.alignment = %lld\n", vmr.alignment);
-			fprintf(FpDebug, "Image vmr.memoryTypeBits = 0x%08x\n", vmr.memoryTypeBits);
-			fflush(FpDebug);
-		}
+	pMyBatch->head = offset + size;
+	*pOffset = offset;
+	return pMyBatch->mapped + offset;
+}
 
-		VkMemoryAllocateInfo			vmai;
-			vmai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			vmai.pNext = nullptr;
-			vmai.allocationSize = vmr.size;
-			vmai.memoryTypeIndex = FindMemoryThatIsHostVisible( vmr.memoryTypeBits );	// because we want to mmap it
 
-		VkDeviceMemory				vdm;
-		result = vkAllocateMemory(LogicalDevice, IN &vmai, PALLOCATOR, OUT &vdm);
-		REPORT("vkAllocateMemory");
-		pMyTexture->vdm = vdm;
+// copy a block of data into staging memory
+// returns the offset of the data in the last staging buffer:
 
-		result = vkBindImageMemory(LogicalDevice, IN stagingImage, IN vdm, OFFSET_ZERO );
-		REPORT("vkBindImageMemory");
+VkDeviceSize
+Stage05Upload( INOUT MyUploadBatch * pMyBatch, IN void * data, VkDeviceSize size )
+{
+	VkDeviceSize offset;
+	unsigned char * dst = Reserve05Upload( pMyBatch, size, OUT &offset );
+	memcpy( dst, data, (size_t)size );
+	return offset;
+}
 
 
-		// we have now created the staging image -- fill it with the pixel data:
+// stage the data and record a copy into a device-local buffer
+// dstAccess and dstStages say how the buffer will be read once it is there:
 
-		VkImageSubresource			vis;
-			vis.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			vis.mipLevel = 0;
-			vis.arrayLayer = 0;
+VkResult
+Upload05DataBuffer( INOUT MyUploadBatch * pMyBatch, IN void * data, IN MyBuffer myBuffer, VkAccessFlags dstAccess, VkPipelineStageFlags dstStages )
+{
+	VkDeviceSize offset = Stage05Upload( pMyBatch, data, myBuffer.size );
 
-		VkSubresourceLayout			vsl;
-		vkGetImageSubresourceLayout(LogicalDevice, stagingImage, IN &vis, OUT &vsl);
+	VkBufferCopy				vbc;
+		vbc.srcOffset = offset;
+		vbc.dstOffset = 0;
+		vbc.size = myBuffer.size;
 
-		if (Verbose)
-		{
-			fprintf(FpDebug, "Subresource Layout:\n");
-			fprintf(FpDebug, "\toffset = %lld\n", vsl.offset);
-			fprintf(FpDebug, "\tsize = %lld\n", vsl.size);
-			fprintf(FpDebug, "\trowPitch = %lld\n", vsl.rowPitch);
-			fprintf(FpDebug, "\tarrayPitch = %lld\n", vsl.arrayPitch);
-			fprintf(FpDebug, "\tdepthPitch = %lld\n", vsl.depthPitch);
-			fflush(FpDebug);
-		}
+	vkCmdCopyBuffer( pMyBatch->commandBuffer, pMyBatch->staging.back( ).buffer, myBuffer.buffer, 1, IN &vbc );
 
-		void * gpuMemory;
-		vkMapMemory(LogicalDevice, vdm, OFFSET_ZERO, VK_WHOLE_SIZE, 0, OUT &gpuMemory);		// 0 = the memory map flags
+	// one memory barrier at submit time covers all of the buffer copies:
 
-		if (vsl.rowPitch == 4 * texWidth)
-		{
-			memcpy(gpuMemory, (void *)texture, (size_t)textureSize);
-		}
-		else
-		{
-			unsigned char *gpuBytes = (unsigned char *)gpuMemory;
-			for (unsigned int y = 0; y < texHeight; y++)
-			{
-				memcpy(&gpuBytes[y * vsl.rowPitch], &texture[4 * y * texWidth], (size_t)(4*texWidth) );
-			}
-		}
+	pMyBatch->bufferDstAccess |= dstAccess;
+	pMyBatch->bufferDstStages |= dstStages;
 
-		vkUnmapMemory(LogicalDevice, vdm);
+	return VK_SUCCESS;
+}
 
-	}
-	// *******************************************************************************
 
+// record a copy of rgba pixels into a device-local, optimally-tiled image, then fill in its mip levels
+// the pixels must already be at offset in the last staging buffer (see Reserve05Upload( ) and Stage05Upload( ))
+// the image ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
 
-	// *******************************************************************************
-	// this second {...} is to create the actual texture image:
-	// *******************************************************************************
-	{
-		VkImageCreateInfo			vici;
-			vici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-			vici.pNext = nullptr;
-			vici.flags = 0;
-			vici.imageType = VK_IMAGE_TYPE_2D;
-			vici.format = VK_FORMAT_R8G8B8A8_SRGB;
-			vici.extent.width  = texWidth;
-			vici.extent.height = texHeight;
-			vici.extent.depth = 1;
-			vici.mipLevels = 1;
-			vici.arrayLayers = 1;
-			vici.samples = VK_SAMPLE_COUNT_1_BIT;
-			vici.tiling = VK_IMAGE_TILING_OPTIMAL;
-			vici.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-					// because we are transfering into it and will eventual sample from it
-			vici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			vici.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
-			vici.queueFamilyIndexCount = 0;
-			vici.pQueueFamilyIndices = (const uint32_t *)nullptr;
+VkResult
+Upload07TextureImage( INOUT MyUploadBatch * pMyBatch, VkDeviceSize offset, uint32_t width, uint32_t height, uint32_t mipLevels, IN VkImage image )
+{
+	VkDataBuffer staging = pMyBatch->staging.back( ).buffer;
+	unsigned char * level0 = pMyBatch->mapped + offset;		// still good after another staging buffer gets added
 
-		result = vkCreateImage(LogicalDevice, IN &vici, PALLOCATOR, OUT &textureImage);	// allocated, but not filled
-		REPORT("vkCreateImage");
+	VkImageSubresourceRange			visr;
+		visr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		visr.baseMipLevel = 0;
+		visr.levelCount = mipLevels;
+		visr.baseArrayLayer = 0;
+		visr.layerCount = 1;
 
-		VkMemoryRequirements			vmr;
-		vkGetImageMemoryRequirements(LogicalDevice, IN textureImage, OUT &vmr);
+	VkImageMemoryBarrier			vimb;
+		vimb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		vimb.pNext = nullptr;
+		vimb.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		vimb.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		vimb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vimb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vimb.image = image;
+		vimb.srcAccessMask = 0;
+		vimb.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vimb.subresourceRange = visr;
+
+	vkCmdPipelineBarrier( pMyBatch->commandBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, (VkMemoryBarrier *)nullptr,
+			0, (VkBufferMemoryBarrier *)nullptr,
+			1, IN &vimb );
+
+	VkBufferImageCopy			vbic;
+		vbic.bufferOffset = offset;
+		vbic.bufferRowLength = 0;		// 0 = tightly packed
+		vbic.bufferImageHeight = 0;
+		vbic.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		vbic.imageSubresource.mipLevel = 0;
+		vbic.imageSubresource.baseArrayLayer = 0;
+		vbic.imageSubresource.layerCount = 1;
+		vbic.imageOffset.x = 0;
+		vbic.imageOffset.y = 0;
+		vbic.imageOffset.z = 0;
+		vbic.imageExtent.width = width;
+		vbic.imageExtent.height = height;
+		vbic.imageExtent.depth = 1;
+
+	vkCmdCopyBufferToImage( pMyBatch->commandBuffer, staging,
+		image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, IN &vbic );
+
+	if( mipLevels > 1  &&  Texture07CanBlit( VK_FORMAT_R8G8B8A8_SRGB )  &&  ! ForceCpuMipmaps )
+	{
+		Record07MipBlits( pMyBatch->commandBuffer, image, width, height, mipLevels );
+		return VK_SUCCESS;
+	}
 
-		if( Verbose )
+	if( mipLevels > 1 )
+	{
+		// the format cannot be blitted with linear filtering, so build the levels on the cpu,
+		// right into staging memory, and copy them all in:
+
+		VkDeviceSize chainOffset;
+		unsigned char * chain = Reserve05Upload( pMyBatch, MipChainBytes( width, height, mipLevels ), OUT &chainOffset );
+		MipGenerateChain( level0, width, height, mipLevels, OUT chain );
+
+		std::vector<VkBufferImageCopy> regions;
+		uint32_t mipWidth  = width;
+		uint32_t mipHeight = height;
+		for( uint32_t level = 1; level < mipLevels; level++ )
 		{
-			fprintf( FpDebug, "Texture vmr.size = %lld\n", vmr.size );
-			fprintf( FpDebug, "Texture vmr.alignment = %lld\n", vmr.alignment );
-			fprintf( FpDebug, "Texture vmr.memoryTypeBits = 0x%08x\n", vmr.memoryTypeBits );
-			fflush( FpDebug );
+			mipWidth  = mipWidth  > 1 ? mipWidth  / 2 : 1;
+			mipHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+				vbic.bufferOffset = chainOffset;
+				vbic.imageSubresource.mipLevel = level;
+				vbic.imageExtent.width = mipWidth;
+				vbic.imageExtent.height = mipHeight;
+			regions.push_back( vbic );
+			chainOffset += 4 * (VkDeviceSize)mipWidth * mipHeight;
 		}
 
-		VkMemoryAllocateInfo			vmai;
-			vmai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			vmai.pNext = nullptr;
-			vmai.allocationSize = vmr.size;
-			vmai.memoryTypeIndex = FindMemoryThatIsDeviceLocal( vmr.memoryTypeBits );  // because we want to sample from it
+		vkCmdCopyBufferToImage( pMyBatch->commandBuffer, pMyBatch->staging.back( ).buffer,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size( ), IN regions.data( ) );
+	}
 
-		VkDeviceMemory				vdm;
-		result = vkAllocateMemory(LogicalDevice, IN &vmai, PALLOCATOR, OUT &vdm);
-		REPORT("vkAllocateMemory");
+		vimb.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		vimb.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vimb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vimb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-		result = vkBindImageMemory( LogicalDevice, IN textureImage, IN vdm, OFFSET_ZERO);
-		REPORT( "vkBindImageMemory" );
-	}
-	// *******************************************************************************
+	vkCmdPipelineBarrier( pMyBatch->commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, (VkMemoryBarrier *)nullptr,
+			0, (VkBufferMemoryBarrier *)nullptr,
+			1, IN &vimb );
 
+	return VK_SUCCESS;
+}
 
-	// copy pixels from the staging image to the texture:
 
-	VkCommandBufferBeginInfo		vcbbi;
-		vcbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		vcbbi.pNext = nullptr;
-		vcbbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vcbbi.pInheritanceInfo = (VkCommandBufferInheritanceInfo *)nullptr;
+// fill in mip levels 1 and below of an image by blitting each one from the level above it
+// level 0 must already have been copied in, and every level must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+// the image ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+// only call if mipLevels > 1, and only on a queue that can do graphics (see Texture07CanBlit( )):
 
-	result = vkBeginCommandBuffer( TextureCommandBuffer, IN &vcbbi);
-	REPORT( "Init07TextureBuffer -- vkBeginCommandBuffer" );
+void
+Record07MipBlits( VkCommandBuffer commandBuffer, IN VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels )
+{
+	VkImageSubresourceRange			visr;
+		visr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		visr.baseMipLevel = 0;
+		visr.levelCount = 1;
+		visr.baseArrayLayer = 0;
+		visr.layerCount = 1;
 
+	VkImageMemoryBarrier			vimb;
+		vimb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		vimb.pNext = nullptr;
+		vimb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vimb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vimb.image = image;
+		vimb.subresourceRange = visr;
 
-	// *******************************************************************************
-	// transition the staging buffer layout:
-	// *******************************************************************************
+	// each level gets blitted from the one above it
+	// the one above has to be switched to a transfer source first:
+
+	int32_t mipWidth  = (int32_t)width;
+	int32_t mipHeight = (int32_t)height;
+	for( uint32_t level = 1; level < mipLevels; level++ )
 	{
-		VkImageSubresourceRange			visr;
-			visr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			visr.baseMipLevel = 0;
-			visr.levelCount = 1;
-			visr.baseArrayLayer = 0;
-			visr.layerCount = 1;
-			
-		VkImageMemoryBarrier			vimb;
-			vimb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			vimb.pNext = nullptr;
-			vimb.oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+			vimb.subresourceRange.baseMipLevel = level - 1;
+			vimb.subresourceRange.levelCount = 1;
+			vimb.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 			vimb.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			vimb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			vimb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			vimb.image = stagingImage;
-			vimb.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-			vimb.dstAccessMask = 0;
-			vimb.subresourceRange = visr;
-
-		vkCmdPipelineBarrier( TextureCommandBuffer,
-			VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			vimb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vimb.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier( commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
 				0, (VkMemoryBarrier *)nullptr,
 				0, (VkBufferMemoryBarrier *)nullptr,
 				1, IN &vimb );
-	}
-	// *******************************************************************************
-
 
+		int32_t nextWidth  = mipWidth  > 1 ? mipWidth  / 2 : 1;
+		int32_t nextHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+
+		VkImageBlit				vib;
+			vib.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			vib.srcSubresource.mipLevel = level - 1;
+			vib.srcSubresource.baseArrayLayer = 0;
+			vib.srcSubresource.layerCount = 1;
+			vib.srcOffsets[0].x = 0;
+			vib.srcOffsets[0].y = 0;
+			vib.srcOffsets[0].z = 0;
+			vib.srcOffsets[1].x = mipWidth;
+			vib.srcOffsets[1].y = mipHeight;
+			vib.srcOffsets[1].z = 1;
+			vib.dstSubresource = vib.srcSubresource;
+			vib.dstSubresource.mipLevel = level;
+			vib.dstOffsets[0] = vib.srcOffsets[0];
+			vib.dstOffsets[1].x = nextWidth;
+			vib.dstOffsets[1].y = nextHeight;
+			vib.dstOffsets[1].z = 1;
+
+		vkCmdBlitImage( commandBuffer,
+			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, IN &vib, VK_FILTER_LINEAR );
+
+		mipWidth  = nextWidth;
+		mipHeight = nextHeight;
+	}
 
-	// *******************************************************************************
-	// transition the texture buffer layout:
-	// *******************************************************************************
-	{
-		VkImageSubresourceRange			visr;
-			visr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			visr.baseMipLevel = 0;
-			visr.levelCount = 1;
-			visr.baseArrayLayer = 0;
-			visr.layerCount = 1;
-
-		VkImageMemoryBarrier			vimb;
-			vimb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			vimb.pNext = nullptr;
-			vimb.oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
-			vimb.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			vimb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			vimb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			vimb.image = textureImage;
-			vimb.srcAccessMask = 0;
-			vimb.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			vimb.subresourceRange = visr;
-
-			vkCmdPipelineBarrier(TextureCommandBuffer,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+	// now all but the last level are transfer sources, and the last one is still a transfer destination:
+
+	VkImageMemoryBarrier			vimbs[2];
+		vimbs[0] = vimb;
+		vimbs[0].subresourceRange.baseMipLevel = 0;
+		vimbs[0].subresourceRange.levelCount = mipLevels - 1;
+		vimbs[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		vimbs[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vimbs[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vimbs[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vimbs[1] = vimb;
+		vimbs[1].subresourceRange.baseMipLevel = mipLevels - 1;
+		vimbs[1].subresourceRange.levelCount = 1;
+		vimbs[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		vimbs[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vimbs[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vimbs[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier( commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
 			0, (VkMemoryBarrier *)nullptr,
 			0, (VkBufferMemoryBarrier *)nullptr,
-			1, IN &vimb);
-
-		// now do the final image transfer:
-
-		VkImageSubresourceLayers		visl;
-			visl.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			visl.baseArrayLayer = 0;
-			visl.mipLevel = 0;
-			visl.layerCount = 1;
-
-		VkOffset3D				vo3;
-			vo3.x = 0;
-			vo3.y = 0;
-			vo3.z = 0;
-
-		VkExtent3D				ve3;
-			ve3.width = texWidth;
-			ve3.height = texHeight;
-			ve3.depth = 1;
-
-		VkImageCopy				vic;
-			vic.srcSubresource = visl;
-			vic.srcOffset = vo3;
-			vic.dstSubresource = visl;
-			vic.dstOffset = vo3;
-			vic.extent = ve3;
-
-		vkCmdCopyImage(TextureCommandBuffer,
-			stagingImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1, IN &vic);
-	}
-// *******************************************************************************
+			2, IN vimbs );
+}
+
+
+// can mip levels of this format be made with a linearly-filtered vkCmdBlitImage( )?
+
+bool
+Texture07CanBlit( VkFormat format )
+{
+	VkFormatProperties			vfp;
+	vkGetPhysicalDeviceFormatProperties( PhysicalDevice, format, OUT &vfp );
+	VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return ( vfp.optimalTilingFeatures & needed ) == needed;
+}
+
+
+// close the batch and hand it to the gpu -- this does not wait:
 
+VkResult
+Submit05UploadBatch( INOUT MyUploadBatch * pMyBatch )
+{
+	HERE_I_AM( "Submit05UploadBatch" );
+	CPU_ZONE( "Submit05UploadBatch" );
+
+	VkResult result = VK_SUCCESS;
 
-// *******************************************************************************
-// transition the texture buffer layout a second time:
-// *******************************************************************************
+	if( pMyBatch->bufferDstAccess != 0 )
 	{
-		VkImageSubresourceRange			visr;
-			visr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			visr.baseMipLevel = 0;
-			visr.levelCount = 1;
-			visr.baseArrayLayer = 0;
-			visr.layerCount = 1;
-
-		VkImageMemoryBarrier			vimb;
-			vimb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			vimb.pNext = nullptr;
-			vimb.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			vimb.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			vimb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			vimb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			vimb.image = textureImage;
-			//vimb.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			vimb.srcAccessMask = 0;
-			//vimb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
-			vimb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			vimb.subresourceRange = visr;
-
-			vkCmdPipelineBarrier(TextureCommandBuffer,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-			0, (VkMemoryBarrier *)nullptr,
-			0, (VkBufferMemoryBarrier *)nullptr,
-			1, IN &vimb);
+		VkMemoryBarrier				vmb;
+			vmb.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			vmb.pNext = nullptr;
+			vmb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vmb.dstAccessMask = pMyBatch->bufferDstAccess;
+
+		vkCmdPipelineBarrier( pMyBatch->commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, pMyBatch->bufferDstStages, 0,
+				1, IN &vmb,
+				0, (VkBufferMemoryBarrier *)nullptr,
+				0, (VkImageMemoryBarrier *)nullptr );
 	}
-	// *******************************************************************************
 
-	result = vkEndCommandBuffer( TextureCommandBuffer );
-	REPORT("Init07TextureBuffer -- vkEndCommandBuffer");
+	result = vkEndCommandBuffer( pMyBatch->commandBuffer );
+	REPORT( "Submit05UploadBatch -- vkEndCommandBuffer" );
+	pMyBatch->recording = false;
 
 	VkSubmitInfo				vsi;
 		vsi.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 		vsi.pNext = nullptr;
 		vsi.commandBufferCount = 1;
-		vsi.pCommandBuffers = &TextureCommandBuffer;
+		vsi.pCommandBuffers = &pMyBatch->commandBuffer;
 		vsi.waitSemaphoreCount = 0;
 		vsi.pWaitSemaphores = (VkSemaphore *)nullptr;
 		vsi.signalSemaphoreCount = 0;
 		vsi.pSignalSemaphores = (VkSemaphore *)nullptr;
 		vsi.pWaitDstStageMask = (VkPipelineStageFlags *)nullptr;
 
-	result = vkQueueSubmit( Queue, 1, IN &vsi, VK_NULL_HANDLE );
-	if (Verbose)		REPORT("vkQueueSubmit");
+	result = vkQueueSubmit( Queue, 1, IN &vsi, IN pMyBatch->fence );
+	REPORT( "vkQueueSubmit -- upload batch" );
+	pMyBatch->inFlight = true;
 
-	result = vkQueueWaitIdle( Queue );
-	if (Verbose)		REPORT("vkQueueWaitIdle");
+	if( Verbose )
+	{
+		LOG_INFO( "Upload batch submitted: %d staging buffer(s)\n", (int)pMyBatch->staging.size( ) );
+	}
 
+	return result;
+}
 
-	// create an image view for the texture image:
 
-	VkImageSubresourceRange			visr;
-		visr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		visr.baseMipLevel = 0;
-		visr.levelCount = 1;
-		visr.baseArrayLayer = 0;
-		visr.layerCount = 1;
+// free the staging buffers and the fence -- the gpu must not be using them any more:
 
-	VkImageViewCreateInfo			vivci;
-		vivci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		vivci.pNext = nullptr;
-		vivci.flags = 0;
-		vivci.image = textureImage;
-		vivci.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		vivci.format = VK_FORMAT_R8G8B8A8_SRGB;
-		vivci.components.r = VK_COMPONENT_SWIZZLE_R;
-		vivci.components.g = VK_COMPONENT_SWIZZLE_G;
-		vivci.components.b = VK_COMPONENT_SWIZZLE_B;
-		vivci.components.a = VK_COMPONENT_SWIZZLE_A;
-		vivci.subresourceRange = visr;
+static void
+Free05UploadBatch( INOUT MyUploadBatch * pMyBatch )
+{
+	for( size_t i = 0; i < pMyBatch->staging.size( ); i++ )
+	{
+		vkDestroyBuffer( LogicalDevice, pMyBatch->staging[i].buffer, PALLOCATOR );
+		Free05Memory( &pMyBatch->staging[i].allocation );
+	}
+	pMyBatch->staging.clear( );
+	pMyBatch->mapped = (unsigned char *)nullptr;
+	pMyBatch->head = 0;
+	pMyBatch->inFlight = false;
+
+	if( pMyBatch->fence != VK_NULL_HANDLE )
+		vkDestroyFence( LogicalDevice, pMyBatch->fence, PALLOCATOR );
+	pMyBatch->fence = VK_NULL_HANDLE;
+}
 
-	result = vkCreateImageView(LogicalDevice, IN &vivci, PALLOCATOR, OUT &pMyTexture->texImageView);
-	REPORT("vkCreateImageView");
 
-	vkDestroyImage( LogicalDevice, stagingImage, PALLOCATOR );
+// if the gpu has finished the batch, free its staging memory
+// returns true if the batch is done (or was never submitted):
 
-	return result;
+bool
+Poll05UploadBatch( INOUT MyUploadBatch * pMyBatch )
+{
+	if( ! pMyBatch->inFlight )
+		return true;
+
+	if( vkGetFenceStatus( LogicalDevice, pMyBatch->fence ) != VK_SUCCESS )
+		return false;
+
+	Free05UploadBatch( pMyBatch );
+
+	if( Verbose )
+	{
+		LOG_INFO( "Upload batch finished -- staging memory freed\n" );
+	}
+	return true;
 }
 
 
+// free everything the batch still holds, whether or not it ever got submitted
+// (call with the device idle):
+
+void
+Destroy05UploadBatch( INOUT MyUploadBatch * pMyBatch )
+{
+	Free05UploadBatch( pMyBatch );
+	pMyBatch->recording = false;		// the command buffer goes away with its pool
+}
 
-// ***************************************
-// CREATE A TEXTURE IMAGE FROM A BMP FILE:
-// ***************************************
+
+
+
+
+// *************************
+// CREATE A TEXTURE SAMPLER:
+// *************************
 
 VkResult
-Init07TextureBufferAndFillFromBmpFile( IN std::string filename, OUT MyTexture * pMyTexture )
+Init07TextureSampler( MyTexture * pMyTexture )
 {
-	HERE_I_AM( "Init07TextureBufferAndFillFromBmpFile" );
+	HERE_I_AM( "Init07TextureSampler" );
+	CPU_ZONE( "Init07TextureSampler" );
 
 	VkResult result = VK_SUCCESS;
+	
+	VkSamplerCreateInfo					vsci;
+		vsci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		vsci.pNext = nullptr;
+		vsci.flags = 0;
+		vsci.magFilter = VK_FILTER_LINEAR;
+		vsci.minFilter = VK_FILTER_LINEAR;
+		vsci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		vsci.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		vsci.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		vsci.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+#ifdef CHOICES
+VK_SAMPLER_ADDRESS_MODE_REPEAT
+VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT
+VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE
+VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
+VK_SAMPLER_ADDRESS_MODE_MIRROR_CLAMP_TO_EDGE
+#endif
+		vsci.mipLodBias = 0.;
+		vsci.anisotropyEnable = PhysicalDeviceFeatures.samplerAnisotropy;		// all supported features got enabled in Init04
+		vsci.maxAnisotropy = PhysicalDeviceFeatures.samplerAnisotropy ? PhysicalDeviceProperties.limits.maxSamplerAnisotropy : 1.f;
+		vsci.compareEnable = VK_FALSE;
+		vsci.compareOp = VK_COMPARE_OP_NEVER;
+#ifdef CHOICES
+VK_COMPARE_OP_NEVER
+VK_COMPARE_OP_LESS
+VK_COMPARE_OP_EQUAL
+VK_COMPARE_OP_LESS_OR_EQUAL
+VK_COMPARE_OP_GREATER
+VK_COMPARE_OP_NOT_EQUAL
+VK_COMPARE_OP_GREATER_OR_EQUAL
+VK_COMPARE_OP_ALWAYS
+#endif
+		vsci.minLod = 0.;
+		vsci.maxLod = VK_LOD_CLAMP_NONE;		// use however many mip levels the texture has
+		vsci.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+#ifdef CHOICES
+VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK
+VK_BORDER_COLOR_INT_TRANSPARENT_BLACK
+VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK
+VK_BORDER_COLOR_INT_OPAQUE_BLACK
+VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE
+VK_BORDER_COLOR_INT_OPAQUE_WHITE
+#endif
+		vsci.unnormalizedCoordinates = VK_FALSE;	// VK_TRUE means we are use raw texels as the index
+								// VK_FALSE means we are uing the usual 0. - 1.
 
-	const int birgb = { 0 };
+	result = vkCreateSampler( LogicalDevice, IN &vsci, PALLOCATOR, OUT &pMyTexture->texSampler );
+	REPORT( "vkCreateSampler" );
+	return result;
+}
 
-	FILE * fp;
-#ifdef _WIN32
-	errno_t err = fopen_s( &fp, filename.c_str( ), "rb" );
-	if( err != 0 )
-	{
-		fprintf( stderr, "Cannot open BMP file '%s'\n", filename.c_str( ) );
-		return VK_FAILURE;
-	}
-#else
-	fp = fopen( filename.c_str( ), "rb" );
-	if( fp == NULL )
-	{
-		fprintf( stderr, "Cannot open BMP file '%s'\n", filename.c_str( ) );
-		return VK_FAILURE;
-	}
-#endif
 
-	FileHeader.bfType = ReadShort( fp );
 
-	// if bfType is not 0x4d42, the file is not a bmp:
+// ************************
+// CREATE A TEXTURE BUFFER:
+// ************************
 
-	if( FileHeader.bfType != 0x4d42 )
-	{
-		fprintf( FpDebug, "Wrong type of file: 0x%0x\n", FileHeader.bfType );
-		fclose( fp );
-		return VK_FAILURE;
-	}
+// assume we get to here and have in a MyTexture struct:
+// 	* an unsigned char array, holding the pixel rgba
+//	* width  is the number of texels in s
+//	* height is the number of texels in t
 
+VkResult
+Init07TextureBuffer( INOUT MyTexture * pMyTexture)
+{
+	HERE_I_AM( "Init07TextureBuffer" );
+	CPU_ZONE( "Init07TextureBuffer" );
 
-	FileHeader.bfSize = ReadInt( fp );
-	FileHeader.bfReserved1 = ReadShort( fp );
-	FileHeader.bfReserved2 = ReadShort( fp );
-	FileHeader.bfOffBits = ReadInt( fp );
+	VkResult result = Init07TextureImage( INOUT pMyTexture );
+	REPORT( "Init07TextureImage" );
 
-	InfoHeader.biSize = ReadInt( fp );
-	InfoHeader.biWidth = ReadInt( fp );
-	InfoHeader.biHeight = ReadInt( fp );
+	// copy pixels through the upload batch's staging buffer into the texture
+	// (this just records the copy -- it happens when the batch gets submitted):
 
-	uint32_t texWidth  = InfoHeader.biWidth;
-	uint32_t texHeight = InfoHeader.biHeight;
+	VkDeviceSize offset = Stage05Upload( &MyUploads, (void *)pMyTexture->pixels, (VkDeviceSize)pMyTexture->width * pMyTexture->height * 4 );	// rgba, 1 byte each
+	result = Upload07TextureImage( &MyUploads, offset, pMyTexture->width, pMyTexture->height, pMyTexture->mipLevels, pMyTexture->texImage );
+	REPORT( "Upload07TextureImage" );
 
-	InfoHeader.biPlanes = ReadShort( fp );
-	InfoHeader.biBitCount = ReadShort( fp );
-	InfoHeader.biCompression = ReadInt( fp );
-	InfoHeader.biSizeImage = ReadInt( fp );
-	InfoHeader.biXPelsPerMeter = ReadInt( fp );
-	InfoHeader.biYPelsPerMeter = ReadInt( fp );
-	InfoHeader.biClrUsed = ReadInt( fp );
-	InfoHeader.biClrImportant = ReadInt( fp );
+	return result;
+}
 
-	fprintf( FpDebug, "Image size found: %d x %d\n", texWidth, texHeight );
 
-	unsigned char * texture = new unsigned char[ 4 * texWidth * texHeight ];
 
-	// extra padding bytes:
+// ***********************
+// CREATE A TEXTURE IMAGE:
+// ***********************
 
-	int numExtra =  4*(( (3*InfoHeader.biWidth)+3)/4) - 3*InfoHeader.biWidth;
+// creates the device-local image, with a full mip chain, and its image view from the width and height in the MyTexture struct
+// the image is left for the upload batch to fill and transition
 
-	// we do not support compression:
+VkResult
+Init07TextureImage( INOUT MyTexture * pMyTexture)
+{
+	HERE_I_AM( "Init07TextureImage" );
+	CPU_ZONE( "Init07TextureImage" );
 
-	if( InfoHeader.biCompression != birgb )
-	{
-		fprintf( FpDebug, "Wrong type of image compression: %d\n", InfoHeader.biCompression );
-		fclose( fp );
-		return VK_FAILURE;
-	}
+	VkResult result = VK_SUCCESS;
+
+	uint32_t texWidth = pMyTexture->width;
+	uint32_t texHeight = pMyTexture->height;
+	pMyTexture->mipLevels = MipNumLevels( texWidth, texHeight );
+
+	VkImage  textureImage;
 
-	rewind( fp );
-	fseek( fp, 14+40, SEEK_SET );
 
-	if( InfoHeader.biBitCount == 24 )
+	// *******************************************************************************
+	// create the actual texture image:
+	// *******************************************************************************
 	{
-		unsigned char *tp = texture;
-		for( unsigned int t = 0; t < texHeight; t++ )
-		{
-			for( unsigned int s = 0; s < texWidth; s++, tp += 4 )
-			{
-				*(tp+3) = 255;			// a
-				*(tp+2) = fgetc( fp );		// b
-				*(tp+1) = fgetc( fp );		// g
-				*(tp+0) = fgetc( fp );		// r
-			}
+		VkImageCreateInfo			vici;
+			vici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			vici.pNext = nullptr;
+			vici.flags = 0;
+#ifdef CHOICES
+VK_IMAGE_CREATE_SPARSE_BINDING_BIT
+VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT
+VK_IMAGE_CREATE_SPARSE_ALIASED_BIT
+VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT
+VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT
+VK_IMAGE_CREATE_BIND_SFR_BIT_KHX
+VK_IMAGE_CREATE_2D_ARRAY_COMPATIBLE_BIT_KHR
+#endif
+			vici.imageType = VK_IMAGE_TYPE_2D;
+			vici.format = VK_FORMAT_R8G8B8A8_SRGB;
+			vici.extent.width  = texWidth;
+			vici.extent.height = texHeight;
+			vici.extent.depth = 1;
+			vici.mipLevels = pMyTexture->mipLevels;
+			vici.arrayLayers = 1;
+			vici.samples = VK_SAMPLE_COUNT_1_BIT;
+			vici.tiling = VK_IMAGE_TILING_OPTIMAL;
+#ifdef CHOICES
+VK_IMAGE_TILING_OPTIMAL
+VK_IMAGE_TILING_LINEAR
+#endif
+			vici.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+					// because we are transfering into it (and blitting between its mip levels) and will eventual sample from it
+#ifdef CHOICES
+VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+VK_IMAGE_USAGE_TRANSFER_DST_BIT
+VK_IMAGE_USAGE_SAMPLED_BIT
+VK_IMAGE_USAGE_STORAGE_BIT
+VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT
+#endif
+			vici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			vici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;		// the upload batch transitions it
+#ifdef CHOICES
+VK_IMAGE_LAYOUT_UNDEFINED
+VK_IMAGE_LAYOUT_PREINITIALIZED
+#endif
+			vici.queueFamilyIndexCount = 0;
+			vici.pQueueFamilyIndices = (const uint32_t *)nullptr;
 
-			for( int e = 0; e < numExtra; e++ )
-			{
-				fgetc( fp );
-			}
+		result = vkCreateImage(LogicalDevice, IN &vici, PALLOCATOR, OUT &textureImage);	// allocated, but not filled
+		REPORT("vkCreateImage");
+
+		VkMemoryRequirements			vmr;
+		vkGetImageMemoryRequirements(LogicalDevice, IN textureImage, OUT &vmr);
+
+		if( Verbose )
+		{
+			LOG_INFO( "Texture vmr.size = %lld\n", vmr.size );
+			LOG_INFO( "Texture vmr.alignment = %lld\n", vmr.alignment );
+			LOG_INFO( "Texture vmr.memoryTypeBits = 0x%08x\n", vmr.memoryTypeBits );
 		}
+
+		// device-local because we want to sample from it
+		// optimal tiling, so it goes in a different block than the buffers:
+
+		result = Alloc05Memory( vmr, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, OUT &pMyTexture->allocation );
+		REPORT( "Alloc05Memory" );
+
+		result = vkBindImageMemory( LogicalDevice, IN textureImage, IN pMyTexture->allocation.vdm, pMyTexture->allocation.offset );
+		REPORT( "vkBindImageMemory" );
+
+		pMyTexture->texImage = textureImage;
 	}
-	fclose( fp );
+	// *******************************************************************************
+
 
-	pMyTexture->width = texWidth;
-	pMyTexture->height = texHeight;
-	pMyTexture->pixels = texture;
+	// create an image view for the texture image:
 
-	result = Init07TextureBuffer( INOUT pMyTexture );
-	REPORT( "Init07TextureBuffer" );
+	VkImageSubresourceRange			visr;
+		visr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		visr.baseMipLevel = 0;
+		visr.levelCount = pMyTexture->mipLevels;
+		visr.baseArrayLayer = 0;
+		visr.layerCount = 1;
+
+	VkImageViewCreateInfo			vivci;
+		vivci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		vivci.pNext = nullptr;
+		vivci.flags = 0;
+		vivci.image = textureImage;
+		vivci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		vivci.format = VK_FORMAT_R8G8B8A8_SRGB;
+		vivci.components.r = VK_COMPONENT_SWIZZLE_R;
+		vivci.components.g = VK_COMPONENT_SWIZZLE_G;
+		vivci.components.b = VK_COMPONENT_SWIZZLE_B;
+		vivci.components.a = VK_COMPONENT_SWIZZLE_A;
+		vivci.subresourceRange = visr;
+
+	result = vkCreateImageView(LogicalDevice, IN &vivci, PALLOCATOR, OUT &pMyTexture->texImageView);
+	REPORT("vkCreateImageView");
 
 	return result;
 }
@@ -1941,6 +2563,7 @@ VkResult
 Init08Swapchain( )
 {
 	HERE_I_AM( "Init08Swapchain" );
+	CPU_ZONE( "Init08Swapchain" );
 
 	VkResult result = VK_SUCCESS;
 
@@ -1960,28 +2583,45 @@ vsc.VkCompositeAlphaFlagsKHR         supportedCompositeAlpha;
 vsc.VkImageUsageFlags                supportedUsageFlags;
 #endif
 
+	// 0xffffffff means the surface takes its size from the swapchain -- use the window's:
+
 	VkExtent2D surfaceRes = vsc.currentExtent;
-	fprintf( FpDebug, "\nvkGetPhysicalDeviceSurfaceCapabilitiesKHR:\n" );
-	fprintf( FpDebug, "\tminImageCount = %d ; maxImageCount = %d\n", vsc.minImageCount, vsc.maxImageCount );
-	fprintf( FpDebug, "\tcurrentExtent = %d x %d\n", vsc.currentExtent.width, vsc.currentExtent.height );
-	fprintf( FpDebug, "\tminImageExtent = %d x %d\n", vsc.minImageExtent.width, vsc.minImageExtent.height );
-	fprintf( FpDebug, "\tmaxImageExtent = %d x %d\n", vsc.maxImageExtent.width, vsc.maxImageExtent.height );
-	fprintf( FpDebug, "\tmaxImageArrayLayers = %d\n", vsc.maxImageArrayLayers );
-	fprintf( FpDebug, "\tsupportedTransforms = 0x%04x\n", vsc.supportedTransforms );
-	fprintf( FpDebug, "\tcurrentTransform = 0x%04x\n", vsc.currentTransform );
-	fprintf( FpDebug, "\tsupportedCompositeAlpha = 0x%04x\n", vsc.supportedCompositeAlpha );
-	fprintf( FpDebug, "\tsupportedUsageFlags = 0x%04x\n", vsc.supportedUsageFlags );
+	if( surfaceRes.width == 0xffffffff )
+	{
+		int width, height;
+		glfwGetFramebufferSize( MainWindow, &width, &height );
+		surfaceRes.width  = glm::clamp( (uint32_t)width,  vsc.minImageExtent.width,  vsc.maxImageExtent.width );
+		surfaceRes.height = glm::clamp( (uint32_t)height, vsc.minImageExtent.height, vsc.maxImageExtent.height );
+	}
+	Width  = surfaceRes.width;			// the depth image, the framebuffers, and the viewport all use these
+	Height = surfaceRes.height;
+
+	uint32_t minImageCount = RequestedImageCount;
+	if( minImageCount < vsc.minImageCount )
+		minImageCount = vsc.minImageCount;
+	if( vsc.maxImageCount != 0  &&  minImageCount > vsc.maxImageCount )	// 0 = no maximum
+		minImageCount = vsc.maxImageCount;
+	LOG_INFO( "\nvkGetPhysicalDeviceSurfaceCapabilitiesKHR:\n" );
+	LOG_INFO( "\tminImageCount = %d ; maxImageCount = %d\n", vsc.minImageCount, vsc.maxImageCount );
+	LOG_INFO( "\tcurrentExtent = %d x %d\n", vsc.currentExtent.width, vsc.currentExtent.height );
+	LOG_INFO( "\tminImageExtent = %d x %d\n", vsc.minImageExtent.width, vsc.minImageExtent.height );
+	LOG_INFO( "\tmaxImageExtent = %d x %d\n", vsc.maxImageExtent.width, vsc.maxImageExtent.height );
+	LOG_INFO( "\tmaxImageArrayLayers = %d\n", vsc.maxImageArrayLayers );
+	LOG_INFO( "\tsupportedTransforms = 0x%04x\n", vsc.supportedTransforms );
+	LOG_INFO( "\tcurrentTransform = 0x%04x\n", vsc.currentTransform );
+	LOG_INFO( "\tsupportedCompositeAlpha = 0x%04x\n", vsc.supportedCompositeAlpha );
+	LOG_INFO( "\tsupportedUsageFlags = 0x%04x\n", vsc.supportedUsageFlags );
 
 	VkBool32  supported;
 	result = vkGetPhysicalDeviceSurfaceSupportKHR( PhysicalDevice, FindQueueFamilyThatDoesGraphics( ), Surface, &supported );
 	REPORT( "vkGetPhysicalDeviceSurfaceSupportKHR" );
 	if( supported == VK_TRUE )
 	{
-		fprintf( FpDebug, "** This Surface is supported by the Graphics Queue **\n" );
+		LOG_INFO( "** This Surface is supported by the Graphics Queue **\n" );
 	}
 	else
 	{
-		fprintf( FpDebug, "** This Surface is not supported by the Graphics Queue **\n" );
+		LOG_INFO( "** This Surface is not supported by the Graphics Queue **\n" );
 	}
 
 
@@ -2019,23 +2659,23 @@ VK_COLOR_SPACE_HDR10_ST2084_EXT = 1000104008,
 VK_COLOR_SPACE_DOLBYVISION_EXT = 1000104009,
 VK_COLOR_SPACE_HDR10_HLG_EXT = 1000104010,
 #endif
-	fprintf( FpDebug, "\nFound %d Surface Formats:\n", formatCount );
+	LOG_INFO( "\nFound %d Surface Formats:\n", formatCount );
 	for( uint32_t i = 0; i < formatCount; i++ )
 	{
-		fprintf( FpDebug, "%3d:     %4d     %12d", i, surfaceFormats[i].format, surfaceFormats[i].colorSpace );\
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)			fprintf(FpDebug, "\tVK_COLOR_SPACE_SRGB_NONLINEAR_KHR\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_DISPLAY_P3_NONLINEAR_EXT)		fprintf(FpDebug, "\tVK_COLOR_SPACE_DISPLAY_P3_NONLINEAR_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_EXTENDED_SRGB_LINEAR_EXT)		fprintf(FpDebug, "\tVK_COLOR_SPACE_EXTENDED_SRGB_LINEAR_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_DCI_P3_LINEAR_EXT)			fprintf(FpDebug, "\tVK_COLOR_SPACE_DCI_P3_LINEAR_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_DCI_P3_NONLINEAR_EXT)		fprintf(FpDebug, "\tVK_COLOR_SPACE_DCI_P3_NONLINEAR_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_BT709_LINEAR_EXT)			fprintf(FpDebug, "\tVK_COLOR_SPACE_BT709_LINEAR_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_BT709_NONLINEAR_EXT)			fprintf(FpDebug, "\tVK_COLOR_SPACE_BT709_NONLINEAR_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_BT2020_LINEAR_EXT)			fprintf(FpDebug, "\tVK_COLOR_SPACE_BT2020_LINEAR_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_HDR10_ST2084_EXT)			fprintf(FpDebug, "\tVK_COLOR_SPACE_HDR10_ST2084_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_DOLBYVISION_EXT)			fprintf(FpDebug, "\tVK_COLOR_SPACE_DOLBYVISION_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_HDR10_HLG_EXT)			fprintf(FpDebug, "\tVK_COLOR_SPACE_HDR10_HLG_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_ADOBERGB_LINEAR_EXT)			fprintf(FpDebug, "\tVK_COLOR_SPACE_ADOBERGB_LINEAR_EXT\n");
-		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_ADOBERGB_NONLINEAR_EXT)		fprintf(FpDebug, "\tVK_COLOR_SPACE_ADOBERGB_NONLINEAR_EXT\n");
+		LOG_INFO( "%3d:     %4d     %12d", i, surfaceFormats[i].format, surfaceFormats[i].colorSpace );\
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)			LOG_INFO( "\tVK_COLOR_SPACE_SRGB_NONLINEAR_KHR\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_DISPLAY_P3_NONLINEAR_EXT)		LOG_INFO( "\tVK_COLOR_SPACE_DISPLAY_P3_NONLINEAR_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_EXTENDED_SRGB_LINEAR_EXT)		LOG_INFO( "\tVK_COLOR_SPACE_EXTENDED_SRGB_LINEAR_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_DCI_P3_LINEAR_EXT)			LOG_INFO( "\tVK_COLOR_SPACE_DCI_P3_LINEAR_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_DCI_P3_NONLINEAR_EXT)		LOG_INFO( "\tVK_COLOR_SPACE_DCI_P3_NONLINEAR_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_BT709_LINEAR_EXT)			LOG_INFO( "\tVK_COLOR_SPACE_BT709_LINEAR_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_BT709_NONLINEAR_EXT)			LOG_INFO( "\tVK_COLOR_SPACE_BT709_NONLINEAR_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_BT2020_LINEAR_EXT)			LOG_INFO( "\tVK_COLOR_SPACE_BT2020_LINEAR_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_HDR10_ST2084_EXT)			LOG_INFO( "\tVK_COLOR_SPACE_HDR10_ST2084_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_DOLBYVISION_EXT)			LOG_INFO( "\tVK_COLOR_SPACE_DOLBYVISION_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_HDR10_HLG_EXT)			LOG_INFO( "\tVK_COLOR_SPACE_HDR10_HLG_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_ADOBERGB_LINEAR_EXT)			LOG_INFO( "\tVK_COLOR_SPACE_ADOBERGB_LINEAR_EXT\n");
+		if (surfaceFormats[i].colorSpace == VK_COLOR_SPACE_ADOBERGB_NONLINEAR_EXT)		LOG_INFO( "\tVK_COLOR_SPACE_ADOBERGB_NONLINEAR_EXT\n");
 
 	}
 	delete [ ] surfaceFormats;
@@ -2053,32 +2693,35 @@ VK_PRESENT_MODE_FIFO_RELAXED_KHR = 3,	<----- the 1080tis can handle this
 VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR = 1000111000,
 VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR = 1000111001,
 #endif
-	fprintf( FpDebug, "\nFound %d Present Modes:\n", presentModeCount );
+	LOG_INFO( "\nFound %d Present Modes:\n", presentModeCount );
 	for( uint32_t i = 0; i < presentModeCount; i++ )
 	{
-		fprintf( FpDebug, "%3d:     %4d", i, presentModes[i] );
-		if( presentModes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR )			fprintf( FpDebug, "\tVK_PRESENT_MODE_IMMEDIATE_KHR\n" );
-		if( presentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR )			fprintf( FpDebug, "\tVK_PRESENT_MODE_MAILBOX_KHR\n" );
-		if( presentModes[i] == VK_PRESENT_MODE_FIFO_KHR )			fprintf( FpDebug, "\tVK_PRESENT_MODE_FIFO_KHR\n" );
-		if( presentModes[i] == VK_PRESENT_MODE_FIFO_RELAXED_KHR )		fprintf( FpDebug, "\tVK_PRESENT_MODE_FIFO_RELAXED_KHR\n" );
-		if( presentModes[i] == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR )	fprintf( FpDebug, "\tVK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR\n" );
-		if( presentModes[i] == VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR )	fprintf( FpDebug, "\tVK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR\n" );
+		LOG_INFO( "%3d:     %4d", i, presentModes[i] );
+		if( presentModes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR )			LOG_INFO( "\tVK_PRESENT_MODE_IMMEDIATE_KHR\n" );
+		if( presentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR )			LOG_INFO( "\tVK_PRESENT_MODE_MAILBOX_KHR\n" );
+		if( presentModes[i] == VK_PRESENT_MODE_FIFO_KHR )			LOG_INFO( "\tVK_PRESENT_MODE_FIFO_KHR\n" );
+		if( presentModes[i] == VK_PRESENT_MODE_FIFO_RELAXED_KHR )		LOG_INFO( "\tVK_PRESENT_MODE_FIFO_RELAXED_KHR\n" );
+		if( presentModes[i] == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR )	LOG_INFO( "\tVK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR\n" );
+		if( presentModes[i] == VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR )	LOG_INFO( "\tVK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR\n" );
 
 	}
 	fprintf( stderr, "\n" );
 
 
-	// find the present mode we should use:
+	// find the present mode we should use -- the latency policy's, if the surface has it:
+	// (VK_PRESENT_MODE_IMMEDIATE_KHR is 0, the same as VK_NULL_HANDLE, so "found" is kept separately)
 
 	VkPresentModeKHR acceptablePresentModes[ ] =
 	{
+			LatencyPolicies[LatencyPolicy].presentMode,
 			VK_PRESENT_MODE_MAILBOX_KHR,
 			VK_PRESENT_MODE_FIFO_KHR,
 			VK_PRESENT_MODE_FIFO_RELAXED_KHR,
 			VK_PRESENT_MODE_IMMEDIATE_KHR,
 	};
 
-	VkPresentModeKHR thePresentMode = (VkPresentModeKHR) VK_NULL_HANDLE;
+	VkPresentModeKHR thePresentMode = VK_PRESENT_MODE_FIFO_KHR;	// the one that every surface has to have
+	bool found = false;
 	for( VkPresentModeKHR apm : acceptablePresentModes )
 	{
 		for( uint32_t i = 0; i < presentModeCount; i++ )
@@ -2086,22 +2729,26 @@ VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR = 1000111001,
 			if( apm == presentModes[i] )
 			{
 				thePresentMode = apm;
+				found = true;
 				break;
 			}
 		}
-		if (thePresentMode != (VkPresentModeKHR)VK_NULL_HANDLE)
+		if( found )
 			break;
 	}
 
-	if( thePresentMode == (VkPresentModeKHR) VK_NULL_HANDLE )
+	if( ! found )
 	{
-		fprintf( FpDebug, "Couldn't find an acceptable Present Mode!\n" );
+		LOG_INFO( "Couldn't find an acceptable Present Mode!\n" );
 	}
 	else
 	{
-		fprintf( FpDebug, "The Present Mode to use = %d\n", thePresentMode );
+		LOG_INFO( "The Present Mode to use = %d\n", thePresentMode );
 	}
-	
+	if( thePresentMode != LatencyPolicies[LatencyPolicy].presentMode )
+		LOG_INFO( "The surface does not have the '%s' present mode -- using %d instead\n", LatencyPolicies[LatencyPolicy].name, thePresentMode );
+	PresentMode = thePresentMode;
+
 	delete [ ] presentModes;
 
 
@@ -2115,7 +2762,7 @@ surfaceRes.height;
 		vscci.pNext = nullptr;
 		vscci.flags = 0;
 		vscci.surface = Surface;
-		vscci.minImageCount = 2;			// double buffering
+		vscci.minImageCount = minImageCount;		// 2 = double buffering, 3 = triple buffering (use with mailbox)
 		//vscci.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
 		vscci.imageFormat = VK_FORMAT_B8G8R8A8_SRGB;
 		vscci.imageColorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
@@ -2130,30 +2777,31 @@ surfaceRes.height;
 		vscci.pQueueFamilyIndices = (const uint32_t *)nullptr;
 		//vscci.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
 		vscci.presentMode = thePresentMode;
-		vscci.oldSwapchain = VK_NULL_HANDLE;	// we're not replacing an old swapchain
+		vscci.oldSwapchain = SwapChain;		// VK_NULL_HANDLE the first time, the one being replaced after that
 		vscci.clipped = VK_TRUE;
-	
+
+	VkSwapchainKHR oldSwapchain = SwapChain;
 	result = vkCreateSwapchainKHR( LogicalDevice, IN &vscci, PALLOCATOR, OUT &SwapChain );
 	REPORT( "vkCreateSwapchainKHR" );
+	if( oldSwapchain != VK_NULL_HANDLE )
+		vkDestroySwapchainKHR( LogicalDevice, oldSwapchain, PALLOCATOR );	// the device is idle, so nothing is using it
 
 
 	uint32_t imageCount;
 	result = vkGetSwapchainImagesKHR( LogicalDevice, IN SwapChain, OUT &imageCount, (VkImage *)nullptr );	// 0 
 	REPORT( "vkGetSwapchainImagesKHR - 0" );
-	if( imageCount != 2 )
-	{
-		fprintf( FpDebug, "imageCount return from vkGetSwapchainImages = %d; should have been 2\n", imageCount );
-		return result;
-	}
+	LOG_INFO( "Swapchain: asked for %d images, got %d, %d x %d\n", minImageCount, imageCount, Width, Height );
+	SwapchainImageCount = imageCount;		// the driver may give us more than we asked for
+	ImageFences.assign( SwapchainImageCount, (VkFence)VK_NULL_HANDLE );	// no frame has used these images yet
 
 	PresentImages = new VkImage[ imageCount ];
 	result = vkGetSwapchainImagesKHR( LogicalDevice, SwapChain, OUT &imageCount, PresentImages );	// 0 
 	REPORT( "vkGetSwapchainImagesKHR - 1" );
 
 
-	// present views for the double-buffering:
+	// present views, one per swapchain image:
 
-	PresentImageViews = new VkImageView[ imageCount ];	// better be 2
+	PresentImageViews = new VkImageView[ imageCount ];
 	for( unsigned int i = 0; i < imageCount; i++ )
 	{
 		VkImageViewCreateInfo		vivci;
@@ -2182,6 +2830,55 @@ surfaceRes.height;
 }
 
 
+
+// ******************************************************************
+// RE-MAKE THE SWAPCHAIN AND EVERYTHING SIZED BY IT (AFTER A RESIZE):
+// ******************************************************************
+// the new swapchain is created with the old one as its oldSwapchain, then the depth image
+// and the framebuffers are re-made -- the pipelines take the viewport as dynamic state, so they stay
+
+VkResult
+Recreate08Swapchain( )
+{
+	HERE_I_AM( "Recreate08Swapchain" );
+	CPU_ZONE( "Recreate08Swapchain" );
+
+	// a minimized window has a 0 x 0 framebuffer -- wait until it is back:
+
+	int width = 0, height = 0;
+	glfwGetFramebufferSize( MainWindow, &width, &height );
+	while( ( width == 0  ||  height == 0 )  &&  ! glfwWindowShouldClose( MainWindow ) )
+	{
+		glfwWaitEvents( );
+		glfwGetFramebufferSize( MainWindow, &width, &height );
+	}
+
+	vkDeviceWaitIdle( LogicalDevice );		// every frame-in-flight is done with the old images
+
+	for( size_t i = 0; i < Framebuffers.size( ); i++ )
+		vkDestroyFramebuffer( LogicalDevice, Framebuffers[i], PALLOCATOR );
+	Framebuffers.clear( );
+
+	vkDestroyImageView( LogicalDevice, DepthStencilImageView, PALLOCATOR );
+	vkDestroyImage( LogicalDevice, DepthStencilImage, PALLOCATOR );
+	Free05Memory( &DepthStencilImageMemory );
+
+	for( uint32_t i = 0; i < SwapchainImageCount; i++ )
+		vkDestroyImageView( LogicalDevice, PresentImageViews[i], PALLOCATOR );
+	delete [ ] PresentImageViews;
+	delete [ ] PresentImages;			// these belong to the swapchain -- only the array is ours
+
+	VkResult result = Init08Swapchain( );
+	REPORT( "Init08Swapchain -- re-made" );
+	Init09DepthStencilImage( );
+	Init11Framebuffers( );
+
+	SwapchainRecreations++;
+	LOG_INFO( "Swapchain re-made: %d x %d, %d images\n", Width, Height, SwapchainImageCount );
+	return result;
+}
+
+
 
 // *************************************
 // CREATING THE DEPTH AND STENCIL IMAGE:
@@ -2191,6 +2888,7 @@ VkResult
 Init09DepthStencilImage( )
 {
 	HERE_I_AM( "Init09DepthStencilImage" );
+	CPU_ZONE( "Init09DepthStencilImage" );
 	
 	VkResult result = VK_SUCCESS;
 	
@@ -2219,17 +2917,10 @@ Init09DepthStencilImage( )
 	VkMemoryRequirements			vmr;
 	vkGetImageMemoryRequirements( LogicalDevice, IN DepthStencilImage, OUT &vmr );
 
-	VkMemoryAllocateInfo			vmai;
-		vmai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		vmai.pNext = nullptr;
-		vmai.allocationSize = vmr.size;
-		vmai.memoryTypeIndex = FindMemoryThatIsDeviceLocal( vmr.memoryTypeBits );
-
-	VkDeviceMemory imageMemory;
-	result = vkAllocateMemory( LogicalDevice, IN &vmai, PALLOCATOR, OUT &imageMemory );
-	REPORT( "vkAllocateMemory" );
+	result = Alloc05Memory( vmr, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, OUT &DepthStencilImageMemory );
+	REPORT( "Alloc05Memory" );
 
-	result = vkBindImageMemory( LogicalDevice, DepthStencilImage, imageMemory, OFFSET_ZERO );
+	result = vkBindImageMemory( LogicalDevice, DepthStencilImage, DepthStencilImageMemory.vdm, DepthStencilImageMemory.offset );
 	REPORT( "vkBindImageMemory" );
 
 	VkImageViewCreateInfo			vivci;
@@ -2265,6 +2956,7 @@ VkResult
 Init10RenderPasses( )
 {
 	HERE_I_AM( "Init10RenderPasses" );
+	CPU_ZONE( "Init10RenderPasses" );
 
 	VkResult result = VK_SUCCESS;
 
@@ -2279,6 +2971,8 @@ Init10RenderPasses( )
 		vad[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		vad[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		vad[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		if( Headless )
+			vad[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;	// ready for Record08Readback( ) to copy
 		vad[0].flags = 0;
 		//vad[0].flags = VK_ATTACHMENT_DESCRIPTION_MAT_ALIAS_BIT;
 
@@ -2312,6 +3006,29 @@ Init10RenderPasses( )
 		vsd.preserveAttachmentCount = 0;
 		vsd.pPreserveAttachments = (uint32_t *)nullptr;
 
+	// with more than one frame-in-flight, this render pass must not start writing color until the
+	// swapchain image is available, and must not clear the shared depth image until the previous frame
+	// is done depth-testing with it:
+
+	VkSubpassDependency				vsdep[2];
+		vsdep[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		vsdep[0].dstSubpass = 0;
+		vsdep[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		vsdep[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		vsdep[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vsdep[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vsdep[0].dependencyFlags = 0;
+
+	// headless, the copy into the readback ring has to wait for the color writes (and the layout change):
+
+		vsdep[1].srcSubpass = 0;
+		vsdep[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		vsdep[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		vsdep[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		vsdep[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		vsdep[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vsdep[1].dependencyFlags = 0;
+
 	VkRenderPassCreateInfo				vrpci;
 		vrpci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 		vrpci.pNext = nullptr;
@@ -2320,8 +3037,8 @@ Init10RenderPasses( )
 		vrpci.pAttachments = vad;
 		vrpci.subpassCount = 1;
 		vrpci.pSubpasses = &vsd;
-		vrpci.dependencyCount = 0;			// ********************* ERROR ?
-		vrpci.pDependencies = (VkSubpassDependency *)nullptr;
+		vrpci.dependencyCount = Headless ? 2 : 1;
+		vrpci.pDependencies = vsdep;
 
 	result = vkCreateRenderPass( LogicalDevice, IN &vrpci, PALLOCATOR, OUT &RenderPass );
 	REPORT( "vkCreateRenderPass" );
@@ -2339,6 +3056,7 @@ VkResult
 Init11Framebuffers( )
 {
 	HERE_I_AM( "Init11Framebuffers" );
+	CPU_ZONE( "Init11Framebuffers" );
 
 	VkResult result = VK_SUCCESS;
 	VkImageView frameBufferAttachments[2];		// color + depth/stencil
@@ -2354,15 +3072,14 @@ Init11Framebuffers( )
 		vfbci.height = Height;
 		vfbci.layers = 1;
 
-	frameBufferAttachments[0] = PresentImageViews[0];
-	frameBufferAttachments[1] = DepthStencilImageView;
-	result = vkCreateFramebuffer( LogicalDevice, IN &vfbci, PALLOCATOR, OUT &Framebuffers[0] );
-	REPORT( "vkCreateFrameBuffer - 0" );
-
-	frameBufferAttachments[0] = PresentImageViews[1];
-	frameBufferAttachments[1] = DepthStencilImageView;
-	result = vkCreateFramebuffer( LogicalDevice, IN &vfbci, PALLOCATOR, OUT &Framebuffers[1] );
-	REPORT( "vkCreateFrameBuffer - 1" );
+	Framebuffers.resize( SwapchainImageCount );
+	for( uint32_t i = 0; i < SwapchainImageCount; i++ )
+	{
+		frameBufferAttachments[0] = PresentImageViews[i];
+		frameBufferAttachments[1] = DepthStencilImageView;
+		result = vkCreateFramebuffer( LogicalDevice, IN &vfbci, PALLOCATOR, OUT &Framebuffers[i] );
+		REPORT( "vkCreateFrameBuffer" );
+	}
 
 	return result;
 }
@@ -2379,6 +3096,7 @@ VkResult
 Init06CommandPools( )
 {
 	HERE_I_AM( "Init06CommandPools" );
+	CPU_ZONE( "Init06CommandPools" );
 
 	VkResult result = VK_SUCCESS;
 
@@ -2419,10 +3137,11 @@ VkResult
 Init06CommandBuffers( )
 {
 	HERE_I_AM( "Init06CommandBuffers" );
+	CPU_ZONE( "Init06CommandBuffers" );
 
 	VkResult result = VK_SUCCESS;
 
-	// allocate 2 command buffers for the double-buffered rendering:
+	// allocate one command buffer for each frame-in-flight:
 
 	{
 		VkCommandBufferAllocateInfo			vcbai;
@@ -2430,20 +3149,21 @@ Init06CommandBuffers( )
 			vcbai.pNext = nullptr;
 			vcbai.commandPool = GraphicsCommandPool;
 			vcbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-			vcbai.commandBufferCount = 2;		// 2, because of double-buffering
+			vcbai.commandBufferCount = FRAME_LAG;
 
 		result = vkAllocateCommandBuffers( LogicalDevice, IN &vcbai, OUT &CommandBuffers[0] );
 		REPORT( "vkAllocateCommandBuffers - 1" );
 	}
 
 
-	// allocate 1 command buffer for the transfering pixels from a staging buffer to a texture buffer:
+	// allocate 1 command buffer for the transfering pixels from a staging buffer to a texture buffer
+	// (it comes from the graphics pool: the upload batch gets submitted to Queue, and it blits mip levels):
 
 	{
 		VkCommandBufferAllocateInfo			vcbai;
 			vcbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 			vcbai.pNext = nullptr;
-			vcbai.commandPool = TransferCommandPool;
+			vcbai.commandPool = GraphicsCommandPool;
 			vcbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 			vcbai.commandBufferCount = 1;
 
@@ -2455,6 +3175,89 @@ Init06CommandBuffers( )
 }
 
 
+
+// ******************************************
+// CREATE THE RECORDING SLOTS' COMMAND POOLS:
+// ******************************************
+// one slot per thread that can record (the pool's workers plus the main thread), up to MAX_RECORD_SLOTS,
+// each with its own command pool -- a slot allocates its secondary command buffers as it needs them
+
+VkResult
+Init06RecordCommandPools( )
+{
+	HERE_I_AM( "Init06RecordCommandPools" );
+	CPU_ZONE( "Init06RecordCommandPools" );
+
+	VkResult result = VK_SUCCESS;
+
+	NumRecordSlots = ThreadPoolSize( ) + 1;
+	if( RecordThreads > 0  &&  NumRecordSlots > RecordThreads )
+		NumRecordSlots = RecordThreads;
+	if( NumRecordSlots > MAX_RECORD_SLOTS )
+		NumRecordSlots = MAX_RECORD_SLOTS;
+
+	for( int slot = 0; slot < NumRecordSlots; slot++ )
+	{
+		VkCommandPoolCreateInfo				vcpci;
+			vcpci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			vcpci.pNext = nullptr;
+			vcpci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			vcpci.queueFamilyIndex = FindQueueFamilyThatDoesGraphics( );
+
+		result = vkCreateCommandPool( LogicalDevice, IN &vcpci, PALLOCATOR, OUT &RecordCommandPools[slot] );
+		REPORT( "vkCreateCommandPool -- Recording slot" );
+	}
+
+	LOG_INFO( "Recording the draw groups on %d threads\n", NumRecordSlots );
+	return result;
+}
+
+
+
+// ********************************************
+// CREATE THE FRAMES-IN-FLIGHT SYNCHRONIZATION:
+// ********************************************
+
+// Each of the FRAME_LAG frames-in-flight gets its own command buffer, semaphores, and fence.
+// These are created once here and re-used, so the cpu can record frame N+1 while the gpu
+// is still rendering frame N.
+
+VkResult
+Init06FrameSyncObjects( )
+{
+	HERE_I_AM( "Init06FrameSyncObjects" );
+	CPU_ZONE( "Init06FrameSyncObjects" );
+
+	VkResult result = VK_SUCCESS;
+
+	VkSemaphoreCreateInfo			vsci;
+		vsci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		vsci.pNext = nullptr;
+		vsci.flags = 0;
+
+	VkFenceCreateInfo			vfci;
+		vfci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		vfci.pNext = nullptr;
+		vfci.flags = VK_FENCE_CREATE_SIGNALED_BIT;	// so that the first wait on each frame returns immediately
+
+	for( int i = 0; i < FRAME_LAG; i++ )
+	{
+		result = vkCreateSemaphore( LogicalDevice, IN &vsci, PALLOCATOR, OUT &FrameImageAvailableSemaphores[i] );
+		REPORT( "vkCreateSemaphore -- image available" );
+
+		result = vkCreateSemaphore( LogicalDevice, IN &vsci, PALLOCATOR, OUT &FrameRenderFinishedSemaphores[i] );
+		REPORT( "vkCreateSemaphore -- render finished" );
+
+		result = vkCreateFence( LogicalDevice, IN &vfci, PALLOCATOR, OUT &FrameFences[i] );
+		REPORT( "vkCreateFence" );
+	}
+
+	CurrentFrame = 0;		// ImageFences gets sized by Init08Swapchain( ) or Init08Offscreen( )
+
+	return result;
+}
+
+
 
 // ****************************************
 // READ A SPIR-V SHADER MODULE FROM A FILE:
@@ -2464,42 +3267,14 @@ VkResult
 Init12SpirvShader( std::string filename, VkShaderModule * pShaderModule )
 {
 	HERE_I_AM( "Init12SpirvShader" );
+	CPU_ZONE( "Init12SpirvShader" );
 
-	FILE *fp;
-	(void) fopen_s( &fp, filename.c_str(), "rb");
-	if( fp == NULL )
-	{
-		fprintf( FpDebug, "Cannot open shader file '%s'\n", filename.c_str( ) );
-		return VK_SHOULD_EXIT;
-	}
-	uint32_t magic;
-	fread( &magic, 4, 1, fp );
-	if( magic != SPIRV_MAGIC )
-	{
-		fprintf( FpDebug, "Magic number for spir-v file '%s is 0x%08x -- should be 0x%08x\n", filename.c_str( ), magic, SPIRV_MAGIC );
-		return VK_SHOULD_EXIT;
-	}
+	// the registry reads the file (if it has not already) and owns the module:
 
-	fseek( fp, 0L, SEEK_END );
-	int size = ftell( fp );
-	rewind( fp );
-	unsigned char *code = new unsigned char [size];
-	fread( code, size, 1, fp );
-	fclose( fp );
-
-	VkShaderModuleCreateInfo		vsmci;
-		vsmci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		vsmci.pNext = nullptr;
-		vsmci.flags = 0;
-		vsmci.codeSize = size;
-		vsmci.pCode = (uint32_t *)code;
-
-	VkResult result = vkCreateShaderModule( LogicalDevice, &vsmci, PALLOCATOR, pShaderModule );
-	REPORT( "vkCreateShaderModule" );
-	fprintf(FpDebug, "Shader Module '%s' successfully loaded\n", filename.c_str());
-
-	delete [ ] code;
-	return result;
+	*pShaderModule = Get12ShaderModule( filename );
+	if( *pShaderModule == VK_NULL_HANDLE )
+		return VK_SHOULD_EXIT;
+	return VK_SUCCESS;
 }
 
 
@@ -2512,18 +3287,23 @@ VkResult
 Init13DescriptorSetPool()
 {
 	HERE_I_AM( "Init13DescriptorSetPool" );
+	CPU_ZONE( "Init13DescriptorSetPool" );
 
 	VkResult result = VK_SUCCESS;
 
-	VkDescriptorPoolSize				vdps[4];
-		vdps[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	VkDescriptorPoolSize				vdps[6];
+		vdps[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		vdps[0].descriptorCount = 1;
-		vdps[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		vdps[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		vdps[1].descriptorCount = 1;
-		vdps[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		vdps[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		vdps[2].descriptorCount = 1;
 		vdps[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		vdps[3].descriptorCount = 1;
+		vdps[3].descriptorCount = 1 + STREAM_MAX_TEXTURES;	// the placeholder, plus one set per streamed texture
+		vdps[4].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		vdps[4].descriptorCount = 1;
+		vdps[5].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		vdps[5].descriptorCount = 2;		// the arm instances, in set 2 and in set 4
 #ifdef CHOICES
 VkDescriptorType:
 VK_DESCRIPTOR_TYPE_SAMPLER
@@ -2547,8 +3327,8 @@ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
 0
 VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
 #endif
-		vdpci.maxSets = 4;
-		vdpci.poolSizeCount = 4;
+		vdpci.maxSets = 5 + STREAM_MAX_TEXTURES;
+		vdpci.poolSizeCount = 6;
 		vdpci.pPoolSizes = &vdps[0];
 
 	result = vkCreateDescriptorPool(LogicalDevice, IN &vdpci, PALLOCATOR, OUT &DescriptorPool);
@@ -2588,7 +3368,22 @@ layout( std140, set = 2, binding = 0 ) uniform miscBuf
 	int   uMode;
 } Misc;
 
+layout( std430, set = 2, binding = 1 ) readonly buffer instanceBuf	// the vertex shader's view of the arm instances
+{
+	armInstance Instances[ ];
+};
+
 layout ( set = 3, binding = 0 ) uniform sampler2D uSampler;
+
+layout( std430, set = 4, binding = 0 ) readonly buffer jointBuf		// compute shader only
+{
+	robotJoints Joints[ ];
+};
+
+layout( std430, set = 4, binding = 1 ) buffer instanceBuf		// compute shader only -- it writes the arm instances
+{
+	armInstance Instances[ ];
+};
 #endif
 
 
@@ -2597,6 +3392,7 @@ VkResult
 Init13DescriptorSetLayouts( )
 {
 	HERE_I_AM( "Init13DescriptorSetLayouts" );
+	CPU_ZONE( "Init13DescriptorSetLayouts" );
 
 	VkResult result = VK_SUCCESS;
 
@@ -2604,7 +3400,7 @@ Init13DescriptorSetLayouts( )
 	//DS #0:
 	VkDescriptorSetLayoutBinding		MatrixSet[1];
 		MatrixSet[0].binding            = 0;
-		MatrixSet[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		MatrixSet[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		MatrixSet[0].descriptorCount    = 1;
 		MatrixSet[0].stageFlags         = VK_SHADER_STAGE_VERTEX_BIT;
 		MatrixSet[0].pImmutableSamplers = (VkSampler *)nullptr;
@@ -2612,18 +3408,23 @@ Init13DescriptorSetLayouts( )
 	// DS #1:
 	VkDescriptorSetLayoutBinding		LightSet[1];
 		LightSet[0].binding            = 0;
-		LightSet[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		LightSet[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		LightSet[0].descriptorCount    = 1;
 		LightSet[0].stageFlags         = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 		LightSet[0].pImmutableSamplers = (VkSampler *)nullptr;
 
 	//DS #2:
-	VkDescriptorSetLayoutBinding		MiscSet[1];
+	VkDescriptorSetLayoutBinding		MiscSet[2];
 		MiscSet[0].binding            = 0;
-		MiscSet[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		MiscSet[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		MiscSet[0].descriptorCount    = 1;
 		MiscSet[0].stageFlags         = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 		MiscSet[0].pImmutableSamplers = (VkSampler *)nullptr;
+		MiscSet[1].binding            = 1;
+		MiscSet[1].descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;	// the arm instances, so the graphics pipeline never needs set 4
+		MiscSet[1].descriptorCount    = 1;
+		MiscSet[1].stageFlags         = VK_SHADER_STAGE_VERTEX_BIT;
+		MiscSet[1].pImmutableSamplers = (VkSampler *)nullptr;
 
 	// DS #3:
 	VkDescriptorSetLayoutBinding		TexSamplerSet[1];
@@ -2635,6 +3436,19 @@ Init13DescriptorSetLayouts( )
 		TexSamplerSet[0].stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;
 		TexSamplerSet[0].pImmutableSamplers = (VkSampler *)nullptr;
 
+	// DS #4:
+	VkDescriptorSetLayoutBinding		RobotSet[2];
+		RobotSet[0].binding            = 0;
+		RobotSet[0].descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;	// this frame's slice of the joint angles
+		RobotSet[0].descriptorCount    = 1;
+		RobotSet[0].stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+		RobotSet[0].pImmutableSamplers = (VkSampler *)nullptr;
+		RobotSet[1].binding            = 1;
+		RobotSet[1].descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		RobotSet[1].descriptorCount    = 1;
+		RobotSet[1].stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+		RobotSet[1].pImmutableSamplers = (VkSampler *)nullptr;
+
 #ifdef CHOICES
 VkDescriptorType:
 VK_DESCRIPTOR_TYPE_SAMPLER
@@ -2668,7 +3482,7 @@ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
 		vdslc2.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 		vdslc2.pNext = nullptr;
 		vdslc2.flags = 0;
-		vdslc2.bindingCount = 1;
+		vdslc2.bindingCount = 2;
 		vdslc2.pBindings = &MiscSet[0];
 
 	VkDescriptorSetLayoutCreateInfo			vdslc3;
@@ -2678,6 +3492,13 @@ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
 		vdslc3.bindingCount = 1;
 		vdslc3.pBindings = &TexSamplerSet[0];
 
+	VkDescriptorSetLayoutCreateInfo			vdslc4;
+		vdslc4.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		vdslc4.pNext = nullptr;
+		vdslc4.flags = 0;
+		vdslc4.bindingCount = 2;
+		vdslc4.pBindings = &RobotSet[0];
+
 	result = vkCreateDescriptorSetLayout( LogicalDevice, &vdslc0, PALLOCATOR, OUT &DescriptorSetLayouts[0] );
 	REPORT( "vkCreateDescriptorSetLayout - 0" );
 
@@ -2690,6 +3511,9 @@ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
 	result = vkCreateDescriptorSetLayout( LogicalDevice, &vdslc3, PALLOCATOR, OUT &DescriptorSetLayouts[3] );
 	REPORT( "vkCreateDescriptorSetLayout - 3" );
 
+	result = vkCreateDescriptorSetLayout( LogicalDevice, &vdslc4, PALLOCATOR, OUT &DescriptorSetLayouts[4] );
+	REPORT( "vkCreateDescriptorSetLayout - 4" );
+
 	return result;
 }
 
@@ -2704,6 +3528,7 @@ VkResult
 Init13DescriptorSets( )
 {
 	HERE_I_AM( "Init13DescriptorSets" );
+	CPU_ZONE( "Init13DescriptorSets" );
 
 	VkResult result = VK_SUCCESS;
 
@@ -2711,31 +3536,34 @@ Init13DescriptorSets( )
 		vdsai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 		vdsai.pNext = nullptr;
 		vdsai.descriptorPool = DescriptorPool;
-		vdsai.descriptorSetCount = 4;
+		vdsai.descriptorSetCount = 5;
 		vdsai.pSetLayouts = DescriptorSetLayouts;
 
 
 	result = vkAllocateDescriptorSets( LogicalDevice, IN &vdsai, OUT &DescriptorSets[0] );
 	REPORT( "vkAllocateDescriptorSets" );
 
+	// all three uniform blocks live in the uniform arena
+	// where in the arena is decided every frame by the dynamic offsets in RenderScene( ):
+
 	VkDescriptorBufferInfo				vdbi0;
-		vdbi0.buffer = MyMatrixUniformBuffer.buffer;
+		vdbi0.buffer = MyUniforms.buffer;
 		vdbi0.offset = 0;	// bytes
 		vdbi0.range = sizeof(Matrices);
 
 	VkDescriptorBufferInfo				vdbi1;
-		vdbi1.buffer = MyLightUniformBuffer.buffer;
+		vdbi1.buffer = MyUniforms.buffer;
 		vdbi1.offset = 0;	// bytes
 		vdbi1.range = sizeof(Light);
 
 	VkDescriptorBufferInfo				vdbi2;
-		vdbi2.buffer = MyMiscUniformBuffer.buffer;
+		vdbi2.buffer = MyUniforms.buffer;
 		vdbi2.offset = 0;	// bytes
 		vdbi2.range = sizeof(Misc);
 
 	VkDescriptorImageInfo				vdii0;
-		vdii0.sampler   = MyPuppyTexture.texSampler;
-		vdii0.imageView = MyPuppyTexture.texImageView;
+		vdii0.sampler   = MyPlaceholderTexture.texSampler;	// the streamer has its own sets for the real textures
+		vdii0.imageView = MyPlaceholderTexture.texImageView;
 		vdii0.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
 	VkWriteDescriptorSet				vwds0;
@@ -2746,7 +3574,7 @@ Init13DescriptorSets( )
 		vwds0.dstBinding = 0;
 		vwds0.dstArrayElement = 0;
 		vwds0.descriptorCount = 1;
-		vwds0.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		vwds0.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		vwds0.pBufferInfo = &vdbi0;
 		vwds0.pImageInfo = (VkDescriptorImageInfo *)nullptr;
 		vwds0.pTexelBufferView = (VkBufferView *)nullptr;
@@ -2759,7 +3587,7 @@ Init13DescriptorSets( )
 		vwds1.dstBinding = 0;
 		vwds1.dstArrayElement = 0;
 		vwds1.descriptorCount = 1;
-		vwds1.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		vwds1.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		vwds1.pBufferInfo = &vdbi1;
 		vwds1.pImageInfo = (VkDescriptorImageInfo *)nullptr;
 		vwds1.pTexelBufferView = (VkBufferView *)nullptr;
@@ -2772,11 +3600,23 @@ Init13DescriptorSets( )
 		vwds2.dstBinding = 0;
 		vwds2.dstArrayElement = 0;
 		vwds2.descriptorCount = 1;
-		vwds2.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		vwds2.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		vwds2.pBufferInfo = &vdbi2;
 		vwds2.pImageInfo = (VkDescriptorImageInfo *)nullptr;
 		vwds2.pTexelBufferView = (VkBufferView *)nullptr;
 
+		// ds 2, binding 1 -- the arm instances that the vertex shader reads:
+	VkDescriptorBufferInfo				vdbi2i;
+		vdbi2i.buffer = RobotInstances.buffer;
+		vdbi2i.offset = 0;
+		vdbi2i.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet				vwds2i;
+		vwds2i = vwds2;
+		vwds2i.dstBinding = 1;
+		vwds2i.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		vwds2i.pBufferInfo = &vdbi2i;
+
 		// ds 3:
 	VkWriteDescriptorSet				vwds3;
 		vwds3.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -2790,6 +3630,31 @@ Init13DescriptorSets( )
 		vwds3.pImageInfo = &vdii0;
 		vwds3.pTexelBufferView = (VkBufferView *)nullptr;
 
+		// ds 4 -- the robots' joint angles and arm instances:
+	VkDescriptorBufferInfo				vdbi4[2];
+		vdbi4[0].buffer = RobotJoints.buffer;
+		vdbi4[0].offset = 0;		// the slice is picked by a dynamic offset
+		vdbi4[0].range = RobotJointsSliceSize;
+		vdbi4[1].buffer = RobotInstances.buffer;
+		vdbi4[1].offset = 0;
+		vdbi4[1].range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet				vwds4[2];
+		vwds4[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		vwds4[0].pNext = nullptr;
+		vwds4[0].dstSet = DescriptorSets[4];
+		vwds4[0].dstBinding = 0;
+		vwds4[0].dstArrayElement = 0;
+		vwds4[0].descriptorCount = 1;
+		vwds4[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		vwds4[0].pBufferInfo = &vdbi4[0];
+		vwds4[0].pImageInfo = (VkDescriptorImageInfo *)nullptr;
+		vwds4[0].pTexelBufferView = (VkBufferView *)nullptr;
+		vwds4[1] = vwds4[0];
+		vwds4[1].dstBinding = 1;
+		vwds4[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		vwds4[1].pBufferInfo = &vdbi4[1];
+
 	uint32_t copyCount = 0;
 
 	// this could have been done with one call and an array of VkWriteDescriptorSets:
@@ -2797,7 +3662,9 @@ Init13DescriptorSets( )
 	vkUpdateDescriptorSets( LogicalDevice, 1, IN &vwds0, IN copyCount, (VkCopyDescriptorSet *)nullptr );
 	vkUpdateDescriptorSets( LogicalDevice, 1, IN &vwds1, IN copyCount, (VkCopyDescriptorSet *)nullptr );
 	vkUpdateDescriptorSets( LogicalDevice, 1, IN &vwds2, IN copyCount, (VkCopyDescriptorSet *)nullptr );
+	vkUpdateDescriptorSets( LogicalDevice, 1, IN &vwds2i, IN copyCount, (VkCopyDescriptorSet *)nullptr );
 	vkUpdateDescriptorSets( LogicalDevice, 1, IN &vwds3, IN copyCount, (VkCopyDescriptorSet *)nullptr );
+	vkUpdateDescriptorSets( LogicalDevice, 2, IN vwds4, IN copyCount, (VkCopyDescriptorSet *)nullptr );
 
 	return VK_SUCCESS;
 }
@@ -2810,6 +3677,7 @@ VkResult
 Init14GraphicsPipelineLayout( )
 {
 	HERE_I_AM( "Init14GraphicsPipelineLayout" );
+	CPU_ZONE( "Init14GraphicsPipelineLayout" );
 
 	VkResult result = VK_SUCCESS;
 
@@ -2824,7 +3692,7 @@ Init14GraphicsPipelineLayout( )
 		vplci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		vplci.pNext = nullptr;
 		vplci.flags = 0;
-		vplci.setLayoutCount = 4;
+		vplci.setLayoutCount = 4;			// set 4 is the robots compute shader's -- and 4 is all that maxBoundDescriptorSets promises
 		vplci.pSetLayouts = &DescriptorSetLayouts[0];
 		vplci.pushConstantRangeCount = 1;
 		vplci.pPushConstantRanges = vpcr;
@@ -2874,7 +3742,8 @@ struct vertex
 
 
 VkResult
-Init14GraphicsVertexFragmentPipeline( VkShaderModule vertexShader, VkShaderModule fragmentShader, VkPrimitiveTopology topology, OUT VkPipeline *pGraphicsPipeline  )
+Init14GraphicsVertexFragmentPipeline( VkShaderModule vertexShader, VkShaderModule fragmentShader, VkPrimitiveTopology topology,
+					int mode, int lighting, VkPipeline basePipeline, OUT VkPipeline *pGraphicsPipeline )
 {
 #ifdef ASSUMPTIONS
 		vds[0] = VK_DYNAMIC_STATE_VIEWPORT;
@@ -2894,27 +3763,12 @@ Init14GraphicsVertexFragmentPipeline( VkShaderModule vertexShader, VkShaderModul
 #endif
 
 		HERE_I_AM( "Init14GraphicsVertexFragmentPipeline" );
+		CPU_ZONE( "Init14GraphicsVertexFragmentPipeline" );	// also runs on the pipeline compiler's jobs
 
 		VkResult result = VK_SUCCESS;
 
-	VkPushConstantRange vpcr[1];
-			vpcr[0].stageFlags =
-				VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
-				| VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-			vpcr[0].offset = 0;
-			vpcr[0].size = sizeof(struct arm);
-
-	VkPipelineLayoutCreateInfo				vplci;
-		vplci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		vplci.pNext = nullptr;
-		vplci.flags = 0;
-		vplci.setLayoutCount = 4;
-		vplci.pSetLayouts = DescriptorSetLayouts;
-		vplci.pushConstantRangeCount = 1;
-		vplci.pPushConstantRanges = vpcr;
-
-	result = vkCreatePipelineLayout( LogicalDevice, IN &vplci, PALLOCATOR, OUT &GraphicsPipelineLayout );
-	REPORT( "vkCreatePipelineLayout" );
+	// GraphicsPipelineLayout comes from Init14GraphicsPipelineLayout( ), so this can also be
+	// called from a worker thread to rebuild the pipeline (see SampleShaderHotReload.cpp):
 
 	VkPipelineShaderStageCreateInfo				vpssci[2];
 		vpssci[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -2941,7 +3795,24 @@ VK_SHADER_STAGE_ALL
 		vpssci[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		vpssci[1].module = fragmentShader;
 		vpssci[1].pName = "main";
-		vpssci[1].pSpecializationInfo = (VkSpecializationInfo *)nullptr;
+		vpssci[1].pSpecializationInfo = (VkSpecializationInfo *)nullptr;		// the uber pipeline leaves it this way
+
+	// the fragment shader's mode and lighting are specialization constants, so each variant
+	// gets compiled with its branches already decided (-1 leaves them to Misc.uMode and Misc.uLighting):
+
+	struct fragmentSpecialization
+	{
+		int32_t		mode;			// constant_id = 0
+		int32_t		lighting;		// constant_id = 1
+	};
+
+	VkSpecializationMapEntry			vsme[2];
+		vsme[0].constantID = 0;
+		vsme[0].offset = offsetof( struct fragmentSpecialization, mode );
+		vsme[0].size = sizeof(int32_t);
+		vsme[1].constantID = 1;
+		vsme[1].offset = offsetof( struct fragmentSpecialization, lighting );
+		vsme[1].size = sizeof(int32_t);
 
 	VkVertexInputBindingDescription			vvibd[1];	// an array containing one of these per buffer being used
 		vvibd[0].binding = 0;		// which binding # this is
@@ -3145,11 +4016,11 @@ VK_LOGIC_OP_SET
 		vpcbsci.blendConstants[2] = 0;
 		vpcbsci.blendConstants[3] = 0;
 
-#ifdef EXAMPLE_OF_USING_DYNAMIC_STATE_VARIABLES
+	// the viewport and scissor get set in RenderScene( ), so a resized window does not need new pipelines:
+
 	VkDynamicState					vds[2];
 		vds[0] = VK_DYNAMIC_STATE_VIEWPORT;
 		vds[1] = VK_DYNAMIC_STATE_SCISSOR;
-#endif
 
 #ifdef CHOICES
 VK_DYNAMIC_STATE_VIEWPORT	--	vkCmdSetViewort( )
@@ -3166,12 +4037,8 @@ VK_DYNAMIC_STATE_STENCIL_REFERENCE	--	vkCmdSetStencilReferences( )
 		vpdsci.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
 		vpdsci.pNext = nullptr;
 		vpdsci.flags = 0;
-		vpdsci.dynamicStateCount = 0;			// leave turned off for now
-		vpdsci.pDynamicStates = (VkDynamicState *) nullptr;
-#ifdef EXAMPLE_OF_USING_DYNAMIC_STATE_VARIABLES
 		vpdsci.dynamicStateCount = 2;
 		vpdsci.pDynamicStates = vds;
-#endif
 
 	VkStencilOpState					vsosf;	// front
 		vsosf.failOp = VK_STENCIL_OP_KEEP;
@@ -3240,7 +4107,7 @@ VK_COMPARE_OP_ALWAYS
 	VkGraphicsPipelineCreateInfo				vgpci;
 		vgpci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		vgpci.pNext = nullptr;
-		vgpci.flags = 0;
+		vgpci.flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;		// the specialized variants derive from the uber pipeline
 #ifdef CHOICES
 VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT
 VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT
@@ -3256,16 +4123,36 @@ VK_PIPELINE_CREATE_DERIVATIVE_BIT
 		vgpci.pMultisampleState = &vpmsci;
 		vgpci.pDepthStencilState = &vpdssci;
 		vgpci.pColorBlendState = &vpcbsci;
-		vgpci.pDynamicState = (VkPipelineDynamicStateCreateInfo *) nullptr;
-		//vgpci.pDynamicState = &vpdsci;
+		vgpci.pDynamicState = &vpdsci;
 		vgpci.layout = IN GraphicsPipelineLayout;
 		vgpci.renderPass = IN RenderPass;
 		vgpci.subpass = 0;				// subpass number
 		vgpci.basePipelineHandle = (VkPipeline) VK_NULL_HANDLE;
-		vgpci.basePipelineIndex = 0;
+		vgpci.basePipelineIndex = -1;
+
+	struct fragmentSpecialization values = { mode, lighting };
+	VkSpecializationInfo				vsi;
+		vsi.mapEntryCount = 2;
+		vsi.pMapEntries = vsme;
+		vsi.dataSize = sizeof(values);
+		vsi.pData = &values;
+
+	if( mode >= 0 )
+	{
+		// a specialized variant -- derived from the uber pipeline when there is one:
+
+		vpssci[1].pSpecializationInfo = &vsi;
+		if( basePipeline != VK_NULL_HANDLE )
+		{
+			vgpci.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+			vgpci.basePipelineHandle = basePipeline;
+		}
+	}
 
-	result = vkCreateGraphicsPipelines( LogicalDevice, VK_NULL_HANDLE, 1, IN &vgpci, PALLOCATOR, OUT pGraphicsPipeline );
+	double createStart = GLFWGetTime( );
+	result = vkCreateGraphicsPipelines( LogicalDevice, GraphicsPipelineCache, 1, IN &vgpci, PALLOCATOR, OUT pGraphicsPipeline );
 	REPORT( "vkCreateGraphicsPipelines" );
+	Count14PipelineCreation( GLFWGetTime( ) - createStart );
 
 	return result;
 }
@@ -3279,41 +4166,56 @@ VK_PIPELINE_CREATE_DERIVATIVE_BIT
 // SETUP A COMPUTE PIPELINE:
 // *************************
 
+// the robots compute shader sees descriptor set 4 as its set 0:
+
 VkResult
-Init14ComputePipeline( VkShaderModule computeShader, OUT VkPipeline * pComputePipeline  )
+Init14ComputePipelineLayout( )
 {
-	HERE_I_AM( "Init14ComputePipeline" );
+	HERE_I_AM( "Init14ComputePipelineLayout" );
+	CPU_ZONE( "Init14ComputePipelineLayout" );
 
 	VkResult result = VK_SUCCESS;
 
-	VkPipelineShaderStageCreateInfo			vpssci;
-		vpssci.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vpssci.pNext = nullptr;
-		vpssci.flags = 0;
-		vpssci.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-		vpssci.module = computeShader;
-		vpssci.pName = "main";
-		vpssci.pSpecializationInfo = (VkSpecializationInfo *)nullptr;
-
 	VkPushConstantRange vpcr[1];
-		vpcr[0].stageFlags =
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
-			| VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		vpcr[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 		vpcr[0].offset = 0;
-		vpcr[0].size = sizeof(struct arm);
+		vpcr[0].size = sizeof(struct robotPush);
 
 	VkPipelineLayoutCreateInfo				vplci;
 		vplci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		vplci.pNext = nullptr;
 		vplci.flags = 0;
 		vplci.setLayoutCount = 1;
-		vplci.pSetLayouts = DescriptorSetLayouts;
+		vplci.pSetLayouts = &DescriptorSetLayouts[4];
 		vplci.pushConstantRangeCount = 1;
 		vplci.pPushConstantRanges = vpcr;
 
 	result = vkCreatePipelineLayout( LogicalDevice, IN &vplci, PALLOCATOR, OUT &ComputePipelineLayout );
 	REPORT( "vkCreatePipelineLayout" );
 
+	return result;
+}
+
+
+VkResult
+Init14ComputePipeline( VkShaderModule computeShader, OUT VkPipeline * pComputePipeline  )
+{
+	HERE_I_AM( "Init14ComputePipeline" );
+	CPU_ZONE( "Init14ComputePipeline" );
+
+	VkResult result = VK_SUCCESS;
+
+	VkPipelineShaderStageCreateInfo			vpssci;
+		vpssci.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vpssci.pNext = nullptr;
+		vpssci.flags = 0;
+		vpssci.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		vpssci.module = computeShader;
+		vpssci.pName = "main";
+		vpssci.pSpecializationInfo = (VkSpecializationInfo *)nullptr;
+
+	// ComputePipelineLayout comes from Init14ComputePipelineLayout( ):
+
 	VkComputePipelineCreateInfo			vcpci[1];
 		vcpci[0].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
 		vcpci[0].pNext = nullptr;
@@ -3323,8 +4225,10 @@ Init14ComputePipeline( VkShaderModule computeShader, OUT VkPipeline * pComputePi
 		vcpci[0].basePipelineHandle = VK_NULL_HANDLE;
 		vcpci[0].basePipelineIndex = 0;
 
-	result = vkCreateComputePipelines( LogicalDevice, VK_NULL_HANDLE, 1, &vcpci[0], PALLOCATOR, pComputePipeline );
+	double createStart = GLFWGetTime( );
+	result = vkCreateComputePipelines( LogicalDevice, ComputePipelineCache, 1, &vcpci[0], PALLOCATOR, pComputePipeline );
 	REPORT( "vkCreateComputePipelines" );
+	Count14PipelineCreation( GLFWGetTime( ) - createStart );
 	return result;
 }
 
@@ -3502,10 +4406,9 @@ ErrorCodes[ ] =
 void
 PrintVkError( VkResult result, std::string prefix )
 {
-	if (Verbose  &&  result == VK_SUCCESS)
+	if( result == VK_SUCCESS )
 	{
-		fprintf(FpDebug, "%s: %s\n", prefix.c_str(), "Successful");
-		fflush(FpDebug);
+		LOG_DEBUG( "%s: %s\n", prefix.c_str(), "Successful" );
 		return;
 	}
 
@@ -3520,8 +4423,7 @@ PrintVkError( VkResult result, std::string prefix )
 		}
 	}
 
-	fprintf( FpDebug, "\n%s: %s\n", prefix.c_str(), meaning.c_str() );
-	fflush(FpDebug);
+	LOG_ERROR( "\n%s: %s\n", prefix.c_str(), meaning.c_str() );
 }
 
 
@@ -3649,128 +4551,51 @@ InitSemaphore( )
 
 
 
-VkResult
-DestroyAllVulkan( )
-{
-	VkResult result = VK_SUCCESS;
-
-	result = vkDeviceWaitIdle( LogicalDevice );
-	REPORT( "vkWaitIdle" );
-
-
-	// destroy things in the opposite order in which they were created:
-
-	//destroy the swap chain imageViews
-#ifdef TREVOR
-	for(uint32_t i = 0; i < SWAPCHAINIMAGECOUNT; i++)
-		vkDestroyImageView(LogicalDevice, PresentImageViews[i], PALLOCATOR);
-	delete[] PresentImageViews;
-	vkDestroySwapchainKHR(LogicalDevice, SwapChain, PALLOCATOR);
-	vkDestroySurfaceKHR(Instance, Surface, PALLOCATOR);
-
-	//do not need to free invdividual descriptors because we did not enable VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT in the flags
-	vkDestroyDescriptorPool(LogicalDevice, DescriptorPool, PALLOCATOR);
-
-	// The source code is not using the global 'Fence' variable
-	//vkDestroyFence(LogicalDevice, Fence, PALLOCATOR);
-	// The source code is not using the global semaphore variables
-	//vkDestroySemaphore(LogicalDevice, SemaphoreImageAvailable, PALLOCATOR);
-
-	vkFreeCommandBuffers(LogicalDevice, GraphicsCommandPool, sizeof(CommandBuffers) / sizeof(CommandBuffers[0]), CommandBuffers);
-	vkFreeCommandBuffers(LogicalDevice, TransferCommandPool, 1, &TextureCommandBuffer);
-
-	vkDestroyRenderPass(LogicalDevice, RenderPass, PALLOCATOR);
-
-	for(auto frameBuffer: Framebuffers)
-		vkDestroyFramebuffer(LogicalDevice, frameBuffer, PALLOCATOR);
+VkResult
+DestroyAllVulkan( )
+{
+	VkResult result = VK_SUCCESS;
 
-	vkDestroyShaderModule(LogicalDevice, ShaderModuleVertex, PALLOCATOR);
-	vkDestroyShaderModule(LogicalDevice, ShaderModuleFragment, PALLOCATOR);
+	result = vkDeviceWaitIdle( LogicalDevice );
+	REPORT( "vkWaitIdle" );
 
-	//destory depth/stencil
-	vkDestroyImageView(LogicalDevice, DepthStencilImageView, PALLOCATOR);
-	vkDestroyImage(LogicalDevice, DepthStencilImage, PALLOCATOR);
-	vkFreeMemory(LogicalDevice, DepthStencilImageMemory, PALLOCATOR);
+	for( int i = 0; i < FRAME_LAG; i++ )
+	{
+		vkDestroyFence( LogicalDevice, FrameFences[i], PALLOCATOR );
+		vkDestroySemaphore( LogicalDevice, FrameRenderFinishedSemaphores[i], PALLOCATOR );
+		vkDestroySemaphore( LogicalDevice, FrameImageAvailableSemaphores[i], PALLOCATOR );
+	}
 
-	vkDestroyCommandPool(LogicalDevice, GraphicsCommandPool, PALLOCATOR);
-	vkDestroyCommandPool(LogicalDevice, TransferCommandPool, PALLOCATOR);
+	Destroy05UploadBatch( &MyUploads );		// the device is idle -- this also covers a batch that never got submitted
 
-	vkDestroyImageView(LogicalDevice, MyPuppyTexture.texImageView, PALLOCATOR);
-	vkDestroyImage(LogicalDevice, MyPuppyTexture.texImage, PALLOCATOR);
-	vkDestroySampler(LogicalDevice, MyPuppyTexture.texSampler, PALLOCATOR);
-	vkFreeMemory(LogicalDevice, MyPuppyTexture.stagingMemory, PALLOCATOR);
-	vkFreeMemory(LogicalDevice, MyPuppyTexture.textureMemory, PALLOCATOR);
+	vkDestroyBuffer( LogicalDevice, MyUniforms.buffer, PALLOCATOR );
+	Free05Memory( &MyUniforms.allocation );
 
-	vkDestroyPipeline(LogicalDevice, GraphicsPipeline, PALLOCATOR);
+	for( int slot = 0; slot < NumRecordSlots; slot++ )
+		vkDestroyCommandPool( LogicalDevice, RecordCommandPools[slot], PALLOCATOR );	// frees its secondary command buffers too
 
-	vkDestroyPipelineLayout(LogicalDevice, GraphicsPipelineLayout, PALLOCATOR);
-	for(auto descriptorSetLayout: DescriptorSetLayouts)
-		vkDestroyDescriptorSetLayout(LogicalDevice, descriptorSetLayout, PALLOCATOR);
+	Stream07Destroy( );
+	Robots05Destroy( );
+	vkDestroyPipeline( LogicalDevice, ComputePipeline, PALLOCATOR );
+	vkDestroyPipelineLayout( LogicalDevice, ComputePipelineLayout, PALLOCATOR );
+	Destroy14ShaderHotReload( );		// before the caches get saved -- a rebuild in progress is still using one
+	Destroy14PipelineCompiler( );		// same for a variant that is still compiling
+	Report14PipelineCreation( "for the whole run" );	// now the lazily-compiled variants are in it too
+	Destroy06GpuProfiler( );		// reads back the frames that were still in flight
+	if( Headless )
+		Destroy08Offscreen( );		// same for the readback ring
 
-	vkDestroyBuffer(LogicalDevice, MyVertexDataBuffer.buffer, PALLOCATOR);
-	vkFreeMemory(LogicalDevice, MyVertexDataBuffer.vdm, PALLOCATOR);
-	vkDestroyBuffer(LogicalDevice, MyMatrixUniformBuffer.buffer, PALLOCATOR);
-	vkFreeMemory(LogicalDevice, MyMatrixUniformBuffer.vdm, PALLOCATOR);
-	vkDestroyBuffer(LogicalDevice, MyLightUniformBuffer.buffer, PALLOCATOR);
-	vkFreeMemory(LogicalDevice, MyLightUniformBuffer.vdm, PALLOCATOR);
-	vkDestroyBuffer(LogicalDevice, MyMiscUniformBuffer.buffer, PALLOCATOR);
-	vkFreeMemory(LogicalDevice, MyMiscUniformBuffer.vdm, PALLOCATOR);
+	// save what the driver compiled, so the next run can skip it:
 
-	vkDestroyDevice(LogicalDevice, PALLOCATOR);
-	vkDestroyInstance(Instance, PALLOCATOR);
-#endif
+	Save14PipelineCache( GRAPHICS_PIPELINE_CACHE_FILE, GraphicsPipelineCache );
+	Save14PipelineCache( COMPUTE_PIPELINE_CACHE_FILE,  ComputePipelineCache );
+	vkDestroyPipelineCache( LogicalDevice, GraphicsPipelineCache, PALLOCATOR );
+	vkDestroyPipelineCache( LogicalDevice, ComputePipelineCache,  PALLOCATOR );
 
-#ifdef NOTDEF
-	vkFreeMemory( LogicalDevice, MyLightUniformBuffer.vdm, PALLOCATOR );
-	vkFreeMemory( LogicalDevice, MyMatrixUniformBuffer.vdm, PALLOCATOR );
-	vkFreeMemory( LogicalDevice, MyMiscUniformBuffer.vdm, PALLOCATOR );
-	vkFreeMemory( LogicalDevice, MyVertexDataBuffer.vdm, PALLOCATOR );
-	vkFreeMemory( LogicalDevice, MyPuppyTexture.vdm, PALLOCATOR );
-
-	vkDestroySemaphore( LogicalDevice, SemaphoreImageAvailable, PALLOCATOR );
-	vkDestroySemaphore( LogicalDevice, SemaphoreRenderFinished, PALLOCATOR );
-
-	vkDestroyBuffer( LogicalDevice, MyLightUniformBuffer.buffer, PALLOCATOR );
-	vkDestroyBuffer( LogicalDevice, MyMatrixUniformBuffer.buffer, PALLOCATOR );
-	vkDestroyBuffer( LogicalDevice, MyMiscUniformBuffer.buffer, PALLOCATOR );
-	vkDestroyBuffer( LogicalDevice, MyVertexDataBuffer.buffer, PALLOCATOR );
-
-	vkDestroyCommandPool( LogicalDevice, GraphicsCommandPool, PALLOCATOR );
-	vkDestroyCommandPool( LogicalDevice, TransferCommandPool, PALLOCATOR );
-
-	vkDestroyImage(LogicalDevice, MyPuppyTexture.texImage, PALLOCATOR);
-	vkDestroyImage(LogicalDevice, PresentImages[0], PALLOCATOR);
-	vkDestroyImage(LogicalDevice, PresentImages[1], PALLOCATOR);
-	vkDestroyImage(LogicalDevice, DepthStencilImage, PALLOCATOR);
-
-	vkDestroyImageView(LogicalDevice, MyPuppyTexture.texImageView, PALLOCATOR);
-	vkDestroyImageView(LogicalDevice, PresentImageViews[0], PALLOCATOR);
-	vkDestroyImageView(LogicalDevice, PresentImageViews[1], PALLOCATOR);
-	vkDestroyImageView(LogicalDevice, DepthStencilImageView, PALLOCATOR);
-
-	vkDestroySampler( LogicalDevice, MyPuppyTexture.texSampler, PALLOCATOR );
-	vkDestroyRenderPass( LogicalDevice, RenderPass, PALLOCATOR );
-	vkDestroyFramebuffer( LogicalDevice, Framebuffers[0], PALLOCATOR );
-	vkDestroyFramebuffer( LogicalDevice, Framebuffers[1], PALLOCATOR );
-	vkDestroyShaderModule( LogicalDevice, ShaderModuleVertex, PALLOCATOR );
-	vkDestroyShaderModule( LogicalDevice, ShaderModuleFragment, PALLOCATOR );
-
-	vkDestroyDescriptorPool( LogicalDevice, DescriptorPool, PALLOCATOR );
-	vkDestroyDescriptorSetLayout( LogicalDevice, DescriptorSetLayouts[0], PALLOCATOR );
-	vkDestroyDescriptorSetLayout( LogicalDevice, DescriptorSetLayouts[1], PALLOCATOR );
-	vkDestroyDescriptorSetLayout( LogicalDevice, DescriptorSetLayouts[2], PALLOCATOR );
-	vkDestroyDescriptorSetLayout( LogicalDevice, DescriptorSetLayouts[3], PALLOCATOR );
-
-	vkDestroyPipelineLayout( LogicalDevice, GraphicsPipelineLayout, PALLOCATOR );
-	vkDestroyPipeline(LogicalDevice, GraphicsPipeline, PALLOCATOR);
-
-	vkDestroySwapchainKHR(LogicalDevice, SwapChain, PALLOCATOR);
-	vkDestroySurfaceKHR( Instance, Surface, PALLOCATOR );
-
-	vkDestroyDevice( LogicalDevice, PALLOCATOR );
-	vkDestroyInstance( Instance, PALLOCATOR );
+	Destroy12ShaderRegistry( );
 
-#endif
+	Report05Memory( );
+	Destroy05MemoryAllocator( );		// nothing that is still bound to these blocks gets used after this
 
 	return result;
 }
@@ -3794,6 +4619,15 @@ FindMemoryThatIsHostVisible( uint32_t memoryTypeBits )
 }
 
 
+int
+FindMemoryThatIsHostCoherent( uint32_t memoryTypeBits )
+{
+	return FindMemoryByFlagAndType( (VkMemoryPropertyFlagBits)( VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ), memoryTypeBits );
+}
+
+
+// all of the bits in memoryFlagBits must be set:
+
 int
 FindMemoryByFlagAndType( VkMemoryPropertyFlagBits memoryFlagBits, uint32_t  memoryTypeBits )
 {
@@ -3805,15 +4639,15 @@ FindMemoryByFlagAndType( VkMemoryPropertyFlagBits memoryFlagBits, uint32_t  memo
 		VkMemoryPropertyFlags vmpf = vmt.propertyFlags;
 		if( ( memoryTypeBits & (1<<i) ) != 0 )
 		{
-			if( ( vmpf & memoryFlagBits ) != 0 )
+			if( ( vmpf & memoryFlagBits ) == memoryFlagBits )
 			{
-				fprintf(FpDebug, "\n***** Found given memory flag (0x%08x) and type (0x%08x): i = %d *****\n", memoryFlagBits, memoryTypeBits, i );
+				LOG_INFO( "\n***** Found given memory flag (0x%08x) and type (0x%08x): i = %d *****\n", memoryFlagBits, memoryTypeBits, i );
 				return i;
 			}
 		}
 	}
 
-	fprintf(FpDebug, "\n***** Could not find given memory flag (0x%08x) and type (0x%08x) *****\n", memoryFlagBits, memoryTypeBits);
+	LOG_INFO( "\n***** Could not find given memory flag (0x%08x) and type (0x%08x) *****\n", memoryFlagBits, memoryTypeBits);
 	//throw  std::runtime_error( "Could not find given memory flag and type" );
 	return  -1;
 }
@@ -3861,6 +4695,8 @@ FindQueueFamilyThatDoesCompute( )
 }
 
 
+// prefers a transfer-only family (usually the gpu's dma engines), so copies can run alongside the rendering:
+
 int
 FindQueueFamilyThatDoesTransfer( )
 {
@@ -3869,6 +4705,14 @@ FindQueueFamilyThatDoesTransfer( )
 	VkQueueFamilyProperties *vqfp = new VkQueueFamilyProperties[ count ];
 	vkGetPhysicalDeviceQueueFamilyProperties( IN PhysicalDevice, &count, OUT vqfp );
 	for( unsigned int i = 0; i < count; i++ )
+	{
+		if( ( vqfp[i].queueFlags & ( VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT ) ) == VK_QUEUE_TRANSFER_BIT )
+		{
+			delete[ ] vqfp;
+			return i;
+		}
+	}
+	for( unsigned int i = 0; i < count; i++ )
 	{
 		if( ( vqfp[i].queueFlags & VK_QUEUE_TRANSFER_BIT ) != 0 )
 		{
@@ -3884,180 +4728,383 @@ FindQueueFamilyThatDoesTransfer( )
 
 
 
-// *********************************************
-// EXECUTE THE CODE FOR THE RENDERING OPERATION:
-// *********************************************
+// *********************************
+// RECORD ONE DRAW GROUP'S COMMANDS:
+// *********************************
+// into a secondary command buffer that continues the render pass -- it has no framebuffer,
+// so it can run in the render pass of whichever swapchain image the frame gets
 
-VkResult
-RenderScene( )
+void
+RecordDrawGroup( VkCommandBuffer commandBuffer, IN const struct drawKey & key, uint32_t group )
 {
-	NumRenders++;
-	if (NumRenders <= 2)
-		HERE_I_AM( "RenderScene" );
-	
-	VkResult result = VK_SUCCESS;
-
-	VkSemaphoreCreateInfo			vsci;
-		vsci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-		vsci.pNext = nullptr;
-		vsci.flags = 0;
-
-	VkSemaphore imageReadySemaphore;
-	result = vkCreateSemaphore( LogicalDevice, IN &vsci, PALLOCATOR, OUT &imageReadySemaphore );
-	uint32_t nextImageIndex;
-	vkAcquireNextImageKHR( LogicalDevice, IN SwapChain, IN UINT64_MAX,
-				IN imageReadySemaphore, IN VK_NULL_HANDLE, OUT &nextImageIndex );
-	//REPORT( "vkCreateSemaphore" );
-
-	if( Verbose &&  NumRenders <= 2 )	fprintf(FpDebug, "nextImageIndex = %d\n", nextImageIndex);
+	VkCommandBufferInheritanceInfo		vcbii;
+		vcbii.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		vcbii.pNext = nullptr;
+		vcbii.renderPass = RenderPass;
+		vcbii.subpass = 0;
+		vcbii.framebuffer = VK_NULL_HANDLE;
+		vcbii.occlusionQueryEnable = VK_FALSE;
+		vcbii.queryFlags = 0;
+		vcbii.pipelineStatistics = 0;
 
 	VkCommandBufferBeginInfo		vcbbi;
 		vcbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 		vcbbi.pNext = nullptr;
-		vcbbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		//vcbbi.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;   <----- or could use this one??
-		vcbbi.pInheritanceInfo = (VkCommandBufferInheritanceInfo *)nullptr;
-
-	result = vkBeginCommandBuffer( CommandBuffers[nextImageIndex], IN &vcbbi );
-	//REPORT( "vkBeginCommandBuffer" );
-
-	VkClearColorValue			vccv;
-		vccv.float32[0] = 0.0;
-		vccv.float32[1] = 0.0;
-		vccv.float32[2] = 0.0;
-		vccv.float32[3] = 1.0;
-
-	VkClearDepthStencilValue		vcdsv;
-		vcdsv.depth = 1.f;
-		vcdsv.stencil = 0;
-
-	VkClearValue				vcv[2];
-		vcv[0].color = vccv;
-		vcv[1].depthStencil = vcdsv;
+		vcbbi.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;		// not ONE_TIME_SUBMIT -- it gets executed again until the key changes
+		vcbbi.pInheritanceInfo = &vcbii;
 
-	VkOffset2D o2d = { 0, 0 };
-	VkExtent2D e2d = { Width, Height };
-	VkRect2D r2d = { o2d, e2d };
+	vkBeginCommandBuffer( commandBuffer, IN &vcbbi );
+	Write06GpuTimestamp( commandBuffer, key.groupScopes[group], CurrentFrame, false );
 
-	VkRenderPassBeginInfo				vrpbi;
-		vrpbi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		vrpbi.pNext = nullptr;
-		vrpbi.renderPass = RenderPass;
-		vrpbi.framebuffer = Framebuffers[ nextImageIndex ];
-		vrpbi.renderArea = r2d;
-		vrpbi.clearValueCount = 2;
-		vrpbi.pClearValues = vcv;		// used for VK_ATTACHMENT_LOAD_OP_CLEAR
-	vkCmdBeginRenderPass( CommandBuffers[nextImageIndex], IN &vrpbi, IN VK_SUBPASS_CONTENTS_INLINE );
+	vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, key.pipeline );
 
-	//vkCmdBindPipeline( CommandBuffers[nextImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, GraphicsPipeline );
+	// the pipelines take these as dynamic state, and a secondary command buffer does not inherit them:
 
-#ifdef EXAMPLE_OF_USING_DYNAMIC_STATE_VARIABLES
 	VkViewport viewport =
 	{
 		0.,			// x
 		0.,			// y
-		(float)Width,
-		(float)Height,
+		(float)key.width,
+		(float)key.height,
 		0.,			// minDepth
 		1.			// maxDepth
 	};
 
-	vkCmdSetViewport( CommandBuffers[nextImageIndex], 0, 1, IN &viewport );		// 0=firstViewport, 1=viewportCount
+	vkCmdSetViewport( commandBuffer, 0, 1, IN &viewport );		// 0=firstViewport, 1=viewportCount
 
 	VkRect2D scissor =
 	{
 		0,
 		0,
-		Width,
-		Height
+		key.width,
+		key.height
 	};
 
-	vkCmdSetScissor( CommandBuffers[nextImageIndex], 0, 1, &scissor );
-#endif
+	vkCmdSetScissor( commandBuffer, 0, 1, &scissor );
+
+	VkDescriptorSet groupSets[4] = { DescriptorSets[0], DescriptorSets[1], DescriptorSets[2], key.textureSets[group] };
+	vkCmdBindDescriptorSets( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GraphicsPipelineLayout, 0, 4,
+		groupSets, 3, key.dynamicOffsets );		// dynamic offset count, dynamic offsets
 
         VkBuffer buffers[1]  = { MyVertexDataBuffer.buffer };
         VkBuffer vBuffers[1] = { MyJustVertexDataBuffer.buffer };
         VkBuffer iBuffer     = { MyJustIndexDataBuffer.buffer  };
 		VkDeviceSize offsets[1] = { 0 };
 
-	if( UseIndexBuffer )
+	if( key.useIndexBuffer )
 	{
-        	vkCmdBindVertexBuffers( CommandBuffers[nextImageIndex], 0, 1, vBuffers, offsets );              // 0, 1 = firstBinding, bindingCount
-        	vkCmdBindIndexBuffer( CommandBuffers[nextImageIndex], iBuffer, 0, VK_INDEX_TYPE_UINT32 );
+        	vkCmdBindVertexBuffers( commandBuffer, 0, 1, vBuffers, offsets );              // 0, 1 = firstBinding, bindingCount
+        	vkCmdBindIndexBuffer( commandBuffer, iBuffer, 0, VK_INDEX_TYPE_UINT32 );
 	}
 	else
 	{
-        	vkCmdBindVertexBuffers( CommandBuffers[nextImageIndex], 0, 1, buffers, offsets );               // 0, 1 = firstBinding, bindingCount
-        	vkCmdBindVertexBuffers( CommandBuffers[nextImageIndex], 0, 1, buffers, offsets );               // 0, 1 = firstBinding, bindingCount
-			vkCmdBindDescriptorSets(CommandBuffers[nextImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, GraphicsPipelineLayout, 0, 4,
-				DescriptorSets, 0, (uint32_t*)nullptr);
+        	vkCmdBindVertexBuffers( commandBuffer, 0, 1, buffers, offsets );               // 0, 1 = firstBinding, bindingCount
 	}
 
-
 	const uint32_t vertexCount = sizeof(VertexData)     / sizeof(VertexData[0]);
     const uint32_t indexCount  = sizeof(JustIndexData)  / sizeof(JustIndexData[0]);
-    const uint32_t instanceCount = 1;
     const uint32_t firstVertex = 0;
     const uint32_t firstIndex = 0;
-    const uint32_t firstInstance = 0;
     const uint32_t vertexOffset  = 0;
 
-	//vkCmdBeginRenderPass(CommandBuffers[nextImageIndex], IN & vrpbi, IN VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(CommandBuffers[nextImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, GraphicsPipeline);
-	
+	uint32_t numGroups = (uint32_t)key.textureSets.size( );
+	uint32_t groupFirstInstance = ( key.instanceCount * group ) / numGroups;
+	uint32_t groupInstanceCount = ( key.instanceCount * ( group + 1 ) ) / numGroups - groupFirstInstance;
+	if( groupInstanceCount > 0 )
+	{
+		if( key.useIndexBuffer )
+		{
+        		vkCmdDrawIndexed( commandBuffer, indexCount, groupInstanceCount, firstIndex, vertexOffset, groupFirstInstance );
+		}
+		else
+		{
+        		vkCmdDraw( commandBuffer, vertexCount, groupInstanceCount, firstVertex, groupFirstInstance );
+		}
+	}
+
+	Write06GpuTimestamp( commandBuffer, key.groupScopes[group], CurrentFrame, true );
+	vkEndCommandBuffer( commandBuffer );
+}
+
+
+
+// *************************************************
+// RECORD ALL OF THE DRAW GROUPS ON THE THREAD POOL:
+// *************************************************
+// splits the draw groups across NumRecordSlots slots and fills GroupCommandBuffers[CurrentFrame], in group order
+// slot s only ever records with RecordCommandPools[s] and only grows SecondaryCommandBuffers[ ][s],
+// so no two threads use a pool at the same time
+
+void
+RecordDrawGroups( IN const struct drawKey & key )
+{
+	CPU_ZONE( "RecordDrawGroups" );
+
+	int frame = CurrentFrame;
+	uint32_t numGroups = (uint32_t)key.textureSets.size( );
+	GroupCommandBuffers[frame].assign( numGroups, (VkCommandBuffer)VK_NULL_HANDLE );
+	if( numGroups == 0 )
+		return;
+
+	int numSlots = NumRecordSlots;
+	if( (uint32_t)numSlots > numGroups )
+		numSlots = (int)numGroups;
+	uint32_t groupsPerSlot = ( numGroups + numSlots - 1 ) / numSlots;
+
+	double start = GLFWGetTime( );
+
+	ThreadPoolParallelFor( numSlots, 1, [ & ]( int firstSlot, int lastSlot )
+	{
+		for( int slot = firstSlot; slot < lastSlot; slot++ )
+		{
+			uint32_t firstGroup = slot * groupsPerSlot;
+			uint32_t lastGroup  = firstGroup + groupsPerSlot < numGroups ? firstGroup + groupsPerSlot : numGroups;
+			std::vector<VkCommandBuffer> & slotBuffers = SecondaryCommandBuffers[frame][slot];
+			if( slotBuffers.size( ) < lastGroup - firstGroup )
+			{
+				size_t have = slotBuffers.size( );
+				slotBuffers.resize( lastGroup - firstGroup );
+
+				VkCommandBufferAllocateInfo			vcbai;
+					vcbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+					vcbai.pNext = nullptr;
+					vcbai.commandPool = RecordCommandPools[slot];
+					vcbai.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+					vcbai.commandBufferCount = (uint32_t)( slotBuffers.size( ) - have );
+
+				vkAllocateCommandBuffers( LogicalDevice, IN &vcbai, OUT &slotBuffers[have] );
+			}
+
+			for( uint32_t g = firstGroup; g < lastGroup; g++ )
+			{
+				RecordDrawGroup( slotBuffers[g - firstGroup], key, g );
+				GroupCommandBuffers[frame][g] = slotBuffers[g - firstGroup];
+			}
+		}
+	} );
+
+	RecordSeconds += GLFWGetTime( ) - start;
+}
 
-	vkCmdBindVertexBuffers(CommandBuffers[nextImageIndex], 0, 1, buffers, offsets);
 
+// everything in the keys has to match -- the groups' texture sets and profiler scopes too:
 
+bool
+SameDrawKey( IN const struct drawKey & a, IN const struct drawKey & b )
+{
+	return a.pipeline == b.pipeline  &&  a.useIndexBuffer == b.useIndexBuffer  &&  a.instanceCount == b.instanceCount  &&
+		a.width == b.width  &&  a.height == b.height  &&
+		a.dynamicOffsets[0] == b.dynamicOffsets[0]  &&  a.dynamicOffsets[1] == b.dynamicOffsets[1]  &&  a.dynamicOffsets[2] == b.dynamicOffsets[2]  &&
+		a.textureSets == b.textureSets  &&  a.groupScopes == b.groupScopes;
+}
+
+
+// call when something a recorded draw group refers to gets destroyed --
+// a new object could get the old one's handle, and then the keys would still match:
+
+void
+InvalidateRecordedCommands( )
+{
+	for( int i = 0; i < FRAME_LAG; i++ )
+		RecordedValid[i] = false;
+}
 
-	// provide the information for Arm1:
-	vkCmdPushConstants(CommandBuffers[nextImageIndex], GraphicsPipelineLayout, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
-		sizeof(struct arm), &Arm1);
 
-	// draw the cube, which will become Arm1:
-	vkCmdDraw(CommandBuffers[nextImageIndex], vertexCount, instanceCount, firstVertex, firstInstance);
 
 
+// *********************************************
+// EXECUTE THE CODE FOR THE RENDERING OPERATION:
+// *********************************************
 
-	// provide the information for Arm2:
-	vkCmdPushConstants(CommandBuffers[nextImageIndex], GraphicsPipelineLayout, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
-		sizeof(struct arm), &Arm2);
+VkResult
+RenderScene( )
+{
+	NumRenders++;
+	if (NumRenders <= 2)
+		HERE_I_AM( "RenderScene" );
+	CPU_ZONE( "RenderScene" );
+	
+	VkResult result = VK_SUCCESS;
 
-	// draw the cube, which will become Arm2:
-	vkCmdDraw(CommandBuffers[nextImageIndex], vertexCount, instanceCount, firstVertex, firstInstance);
+	ReportFrameStats( );
+	Poll05UploadBatch( &MyUploads );		// frees the startup staging memory once the gpu is done with it
 
+	if( FramebufferResized  ||  LatencyPolicyChanged )
+	{
+		FramebufferResized = false;
+		LatencyPolicyChanged = false;
+		Recreate08Swapchain( );
+	}
 
 
-	// provide the information for Arm3:
-	vkCmdPushConstants(CommandBuffers[nextImageIndex], GraphicsPipelineLayout, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
-		sizeof(struct arm), &Arm3);
+	// wait until the gpu is done with the last frame that used this frame's command buffer and semaphores
+	// (with FRAME_LAG frames-in-flight, that was FRAME_LAG frames ago, so usually this does not block):
 
-	// draw the cube, which will become Arm3:
-	vkCmdDraw(CommandBuffers[nextImageIndex], vertexCount, instanceCount, firstVertex, firstInstance);
+	struct cpuZone waitZone( "wait for the frame" );
+	double waitStart = GLFWGetTime( );
+	result = vkWaitForFences( LogicalDevice, 1, IN &FrameFences[CurrentFrame], VK_TRUE, UINT64_MAX );	// waitAll, timeout
+	if (Verbose && NumRenders <= 2)		REPORT("vkWaitForFences");
 
+	if( Headless )
+		Collect08Offscreen( CurrentFrame );		// hands the frame read back FRAME_LAG frames ago to a worker
 
-	if( UseIndexBuffer )
+	uint32_t nextImageIndex;
+	bool recreateAfterPresent = false;
+	if( Headless )
 	{
-        	vkCmdDrawIndexed( CommandBuffers[nextImageIndex], indexCount, instanceCount, firstIndex, vertexOffset, firstInstance );
+		nextImageIndex = Next08OffscreenImage( );
 	}
 	else
 	{
-        	vkCmdDraw( CommandBuffers[nextImageIndex], vertexCount, instanceCount, firstVertex, firstInstance );
+		result = vkAcquireNextImageKHR( LogicalDevice, IN SwapChain, IN UINT64_MAX,
+				IN FrameImageAvailableSemaphores[CurrentFrame], IN VK_NULL_HANDLE, OUT &nextImageIndex );
+
+		// the swapchain no longer matches the window -- re-make it and skip this frame
+		// (this frame's fence has not been reset and its semaphore was not signaled, so both are still good to use)
+		// VK_SUBOPTIMAL_KHR still presents, so draw this frame and re-make it after the present:
+
+		if( result == VK_ERROR_OUT_OF_DATE_KHR )
+		{
+			waitZone.end( );
+			return Recreate08Swapchain( );
+		}
+		recreateAfterPresent = ( result == VK_SUBOPTIMAL_KHR );
 	}
 
-	vkCmdEndRenderPass( CommandBuffers[nextImageIndex] );
+	if( NumRenders <= 2 )	LOG_DEBUG( "CurrentFrame = %d ; nextImageIndex = %d\n", CurrentFrame, nextImageIndex);
 
-	vkEndCommandBuffer( CommandBuffers[nextImageIndex] );
 
-	VkFenceCreateInfo			vfci;
-		vfci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		vfci.pNext = nullptr;
-		vfci.flags = 0;
+	// if a different frame-in-flight is still rendering into this swapchain image, wait for it too:
+
+	if( ImageFences[nextImageIndex] != VK_NULL_HANDLE  &&  ImageFences[nextImageIndex] != FrameFences[CurrentFrame] )
+	{
+		vkWaitForFences( LogicalDevice, 1, IN &ImageFences[nextImageIndex], VK_TRUE, UINT64_MAX );
+	}
+	ImageFences[nextImageIndex] = FrameFences[CurrentFrame];
+	FrameStats.sumWait += GLFWGetTime( ) - waitStart;
+	waitZone.end( );
+
+	vkResetFences( LogicalDevice, 1, IN &FrameFences[CurrentFrame] );
+
+	Poll14ShaderHotReload( );		// swaps in a rebuilt uber pipeline, if one is ready
+
+
+	// now that the gpu is done with this frame's slice of the uniform arena, fill it:
+
+	struct cpuZone recordZone( "record" );
+	Reset05UniformArena( &MyUniforms, CurrentFrame );
+	uint32_t dynamicOffsets[3] = { 0, 0, 0 };			// one per dynamic buffer, in set order
+	bool uniformsPushed =
+		Push05UniformArena( &MyUniforms, (void *) &Matrices, sizeof(Matrices), OUT &dynamicOffsets[0] ) == VK_SUCCESS  &&
+		Push05UniformArena( &MyUniforms, (void *) &Light,    sizeof(Light),    OUT &dynamicOffsets[1] ) == VK_SUCCESS  &&
+		Push05UniformArena( &MyUniforms, (void *) &Misc,     sizeof(Misc),     OUT &dynamicOffsets[2] ) == VK_SUCCESS;
+
+	VkCommandBuffer commandBuffer = CommandBuffers[CurrentFrame];
+
+	VkCommandBufferBeginInfo		vcbbi;
+		vcbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		vcbbi.pNext = nullptr;
+		vcbbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		//vcbbi.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;   <----- or could use this one??
+		vcbbi.pInheritanceInfo = (VkCommandBufferInheritanceInfo *)nullptr;
+
+	result = vkBeginCommandBuffer( commandBuffer, IN &vcbbi );
+	//REPORT( "vkBeginCommandBuffer" );
+
+	Begin06GpuProfilerFrame( commandBuffer );	// reads back this frame-in-flight's timestamps from FRAME_LAG frames ago
+	int frameScope = Begin06GpuScope( commandBuffer, "frame" );
+
+	int streamScope = Begin06GpuScope( commandBuffer, "texture streaming" );
+	Stream07Pump( commandBuffer );		// has to be outside the render pass -- it can record image barriers
+	End06GpuScope( commandBuffer, streamScope );
+
+	int robotsScope = Begin06GpuScope( commandBuffer, "robots compute" );
+	Robots14Dispatch( commandBuffer );	// so does this -- it poses every robot for this frame
+	End06GpuScope( commandBuffer, robotsScope );
+
+
+	// what the draw groups get recorded with -- this has to happen here, on the main thread:
+	// one draw for every arm of every robot -- each instance is one cube that becomes one arm
+	// (if the scene has more than one texture, the instances get split evenly, one draw group per texture)
+	// without this frame's uniforms there is nothing to draw with, so then the render pass only clears:
+
+	struct drawKey key;
+	key.pipeline = Get14GraphicsPipeline( Mode, UseLighting ? 1 : 0 );
+	key.useIndexBuffer = UseIndexBuffer;
+	key.instanceCount = RobotArmDepth * NumRobots;	// one instance per arm
+	key.width = Width;
+	key.height = Height;
+	for( int i = 0; i < 3; i++ )
+		key.dynamicOffsets[i] = dynamicOffsets[i];
+	uint32_t numGroups = uniformsPushed ? (uint32_t)SceneTextures.size( ) : 0;
+	for( uint32_t d = 0; d < numGroups; d++ )
+	{
+		// each group gets its own scope, so the gpu times line up with how the draws are submitted:
+
+		char groupName[32];
+		snprintf( groupName, sizeof(groupName), "arms draw group %d", (int)d );
+		key.textureSets.push_back( Stream07Use( SceneTextures[d] ) );		// also keeps it resident
+		key.groupScopes.push_back( Reserve06GpuScope( groupName ) );
+	}
+
+	VkClearColorValue			vccv;
+		vccv.float32[0] = 0.0;
+		vccv.float32[1] = 0.0;
+		vccv.float32[2] = 0.0;
+		vccv.float32[3] = 1.0;
+
+	VkClearDepthStencilValue		vcdsv;
+		vcdsv.depth = 1.f;
+		vcdsv.stencil = 0;
+
+	VkClearValue				vcv[2];
+		vcv[0].color = vccv;
+		vcv[1].depthStencil = vcdsv;
+
+	VkOffset2D o2d = { 0, 0 };
+	VkExtent2D e2d = { Width, Height };
+	VkRect2D r2d = { o2d, e2d };
+
+	VkRenderPassBeginInfo				vrpbi;
+		vrpbi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		vrpbi.pNext = nullptr;
+		vrpbi.renderPass = RenderPass;
+		vrpbi.framebuffer = Framebuffers[ nextImageIndex ];
+		vrpbi.renderArea = r2d;
+		vrpbi.clearValueCount = 2;
+		vrpbi.pClearValues = vcv;		// used for VK_ATTACHMENT_LOAD_OP_CLEAR
+	int renderPassScope = Begin06GpuScope( commandBuffer, "render pass" );
+	vkCmdBeginRenderPass( commandBuffer, IN &vrpbi, IN VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS );
 
-	VkFence renderFence;
-	vkCreateFence( LogicalDevice, &vfci, PALLOCATOR, OUT &renderFence );
+	// the draw groups are in this frame-in-flight's secondary command buffers
+	// if nothing they depend on has changed since they were recorded, they get executed as they are:
 
-	VkPipelineStageFlags waitAtBottom = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	if( ! UseCommandCache  ||  ! RecordedValid[CurrentFrame]  ||  ! SameDrawKey( key, RecordedKeys[CurrentFrame] ) )
+	{
+		RecordDrawGroups( key );
+		RecordedKeys[CurrentFrame] = key;
+		RecordedValid[CurrentFrame] = true;
+		CommandCacheMisses++;
+	}
+	else
+	{
+		CommandCacheHits++;
+	}
+	if( ! GroupCommandBuffers[CurrentFrame].empty( ) )
+		vkCmdExecuteCommands( commandBuffer, (uint32_t)GroupCommandBuffers[CurrentFrame].size( ), GroupCommandBuffers[CurrentFrame].data( ) );
+
+	vkCmdEndRenderPass( commandBuffer );
+	End06GpuScope( commandBuffer, renderPassScope );
+	if( Headless )
+		Record08Readback( commandBuffer, nextImageIndex );
+	End06GpuScope( commandBuffer, frameScope );
+
+	vkEndCommandBuffer( commandBuffer );
+	recordZone.end( );
+
+	// only the color attachment writes need to wait for the swapchain image to be available:
+
+	VkPipelineStageFlags waitAtColorOutput = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 #ifdef CHOICES
 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT = 0x00000001,
 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT = 0x00000002,
@@ -4078,43 +5125,69 @@ VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT = 0x00008000,
 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT = 0x00010000,
 VK_PIPELINE_STAGE_COMMAND_PROCESS_BIT_NVX = 0x00020000,
 #endif
-	VkQueue presentQueue;
-	vkGetDeviceQueue( LogicalDevice, FindQueueFamilyThatDoesGraphics( ), 0, OUT &presentQueue );
-					// 0 = queueIndex
 	VkSubmitInfo				vsi;
 		vsi.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 		vsi.pNext = nullptr;
 		vsi.waitSemaphoreCount = 1;
-		vsi.pWaitSemaphores = &imageReadySemaphore;
-		vsi.pWaitDstStageMask = &waitAtBottom;
+		vsi.pWaitSemaphores = &FrameImageAvailableSemaphores[CurrentFrame];
+		vsi.pWaitDstStageMask = &waitAtColorOutput;
 		vsi.commandBufferCount = 1;
-		vsi.pCommandBuffers = &CommandBuffers[nextImageIndex];
-///		vsi.signalSemaphoreCount = 1;
+		vsi.pCommandBuffers = &commandBuffer;
+		vsi.signalSemaphoreCount = 1;
+		vsi.pSignalSemaphores = &FrameRenderFinishedSemaphores[CurrentFrame];
+	if( Headless )
+	{
+		vsi.waitSemaphoreCount = 0;		// nothing gets acquired or presented
 		vsi.signalSemaphoreCount = 0;
-		vsi.pSignalSemaphores = &SemaphoreRenderFinished;
+	}
 
-	result = vkQueueSubmit( presentQueue, 1, IN &vsi, IN renderFence );	// 1 = submitCount
+	struct cpuZone submitZone( "submit" );
+	result = vkQueueSubmit( Queue, 1, IN &vsi, IN FrameFences[CurrentFrame] );	// 1 = submitCount
 	if( Verbose && NumRenders <= 2 )	REPORT("vkQueueSubmit");
+	submitZone.end( );
 
-	result = vkWaitForFences( LogicalDevice, 1, IN &renderFence, VK_TRUE, UINT64_MAX );	// waitAll, timeout
-	if (Verbose && NumRenders <= 2)		REPORT("vkWaitForFences");
+	if( SerializeFrames )
+	{
+		// the old way -- the cpu sits idle until the gpu has finished this frame:
 
-	vkDestroyFence( LogicalDevice, renderFence, PALLOCATOR );
+		double serialStart = GLFWGetTime( );
+		result = vkWaitForFences( LogicalDevice, 1, IN &FrameFences[CurrentFrame], VK_TRUE, UINT64_MAX );	// waitAll, timeout
+		FrameStats.sumWait += GLFWGetTime( ) - serialStart;
+	}
 
 	VkPresentInfoKHR				vpi;
 		vpi.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		vpi.pNext = nullptr;
-		vpi.waitSemaphoreCount = 0;
-		vpi.pWaitSemaphores = (VkSemaphore *)nullptr;
+		vpi.waitSemaphoreCount = 1;
+		vpi.pWaitSemaphores = &FrameRenderFinishedSemaphores[CurrentFrame];
 		vpi.swapchainCount = 1;
 		vpi.pSwapchains = &SwapChain;
 		vpi.pImageIndices = &nextImageIndex;
 		vpi.pResults = (VkResult *)nullptr;
 
-	result = vkQueuePresentKHR( presentQueue, IN &vpi );
-	if (Verbose && NumRenders <= 2)		REPORT("vkQueuePresentKHR");
+	if( ! Headless )
+	{
+		struct cpuZone presentZone( "present" );
+		result = vkQueuePresentKHR( Queue, IN &vpi );
+		if (Verbose && NumRenders <= 2)		REPORT("vkQueuePresentKHR");
+		NotePresent( );
+		if( result == VK_ERROR_OUT_OF_DATE_KHR  ||  result == VK_SUBOPTIMAL_KHR )
+			recreateAfterPresent = true;
+	}
+
+	if( NumRenders == 1 )
+	{
+		CpuProfilerMark( "first frame presented" );
+		LOG_INFO( "Time to first frame: %.3f ms\n", CpuProfilerMilliseconds( ) );
+	}
+
+	CurrentFrame = ( CurrentFrame + 1 ) % FRAME_LAG;
 
-	vkDestroySemaphore( LogicalDevice, imageReadySemaphore, PALLOCATOR );
+	if( recreateAfterPresent  ||  FramebufferResized )
+	{
+		FramebufferResized = false;
+		result = Recreate08Swapchain( );
+	}
 
 	return result;
 
@@ -4122,6 +5195,58 @@ VK_PIPELINE_STAGE_COMMAND_PROCESS_BIT_NVX = 0x00020000,
 
 
 
+// ******************************
+// MEASURE AND REPORT FRAME TIME:
+// ******************************
+
+// Called once at the top of every RenderScene( ).
+// Press 'f' to flip between overlapped and serialized frames and compare the two reports.
+
+void
+ReportFrameStats( )
+{
+	double now = GLFWGetTime( );
+	if( FrameStats.lastTime > 0. )
+	{
+		double dt = now - FrameStats.lastTime;
+		FrameStats.count++;
+		FrameStats.sumFrame += dt;
+		if( dt < FrameStats.minFrame )
+			FrameStats.minFrame = dt;
+		if( dt > FrameStats.maxFrame )
+			FrameStats.maxFrame = dt;
+	}
+	FrameStats.lastTime = now;
+
+	if( FrameStats.count < FRAME_STATS_INTERVAL )
+		return;
+
+	double avgFrame = 1000. * FrameStats.sumFrame / (double)FrameStats.count;
+	double avgWait  = 1000. * FrameStats.sumWait  / (double)FrameStats.count;
+	LOG_INFO( "Frame time (%s, FRAME_LAG = %d): avg = %7.3f ms ; min = %7.3f ms ; max = %7.3f ms ; fence wait = %7.3f ms ; %6.1f fps\n",
+		SerializeFrames ? "serialized" : "overlapped", FRAME_LAG,
+		avgFrame, 1000.*FrameStats.minFrame, 1000.*FrameStats.maxFrame, avgWait, 1000./avgFrame );
+	Report05Memory( );
+	Report06GpuProfiler( );
+
+	ResetFrameStats( );
+	FrameStats.lastTime = now;
+}
+
+
+void
+ResetFrameStats( )
+{
+	FrameStats.count = 0;
+	FrameStats.lastTime = 0.;
+	FrameStats.sumFrame = 0.;
+	FrameStats.minFrame = 1.e10;
+	FrameStats.maxFrame = 0.;
+	FrameStats.sumWait = 0.;
+}
+
+
+
 
 // ***************************
 // RESET THE GLOBAL VARIABLES:
@@ -4136,11 +5261,13 @@ Reset()
 	NumRenders = 0;
 	Paused = false;
 	Scale = 1.0;
+	SerializeFrames = false;
 	UseIndexBuffer = false;
 	UseLighting = false;
 	UseRotate = true;
-	Verbose = true;
+	Verbose = false;		// LOG_DEBUG( ) and HERE_I_AM( ) only write once 'v' or --verbose turns this on
 	Xrot = Yrot = 0.;
+	ResetFrameStats( );
 
 
 	// initialize the matrices:
@@ -4193,6 +5320,8 @@ Reset()
 void
 UpdateScene( )
 {
+	CPU_ZONE( "UpdateScene" );
+
 // change the object orientation:
 
 	if( UseRotate )
@@ -4229,7 +5358,8 @@ UpdateScene( )
 	// change the normal matrix:
 
 	Matrices.uNormalMatrix = glm::mat4(glm::inverseTranspose(glm::mat3(Matrices.uModelMatrix)));
-	Fill05DataBuffer( MyMatrixUniformBuffer, (void *) &Matrices );
+		// Matrices, Light, and Misc get pushed into the uniform arena by RenderScene( ),
+		// once this frame's slice is no longer being read by the gpu
 
 
 	// possibly change the light position:
@@ -4241,7 +5371,6 @@ UpdateScene( )
         //Light.uLightPos = glm::vec4( 10., 10., 10., 1. );
         //Light.uLightSpecularColor = glm::vec3( 1., 1., 1. );
         //Light.uShininess = 10.f;
-        //Fill05DataBuffer( MyLightUniformBuffer, (void*) &Light );     // don't need this now:
 
 
 	// change the miscellaneous stuff:
@@ -4249,26 +5378,14 @@ UpdateScene( )
 	Misc.uTime = (float)Time;
 	Misc.uMode = Mode;
 	Misc.uLighting = UseLighting ? 1 : 0;
-	Fill05DataBuffer( MyMiscUniformBuffer, (void *) &Misc );
+
+	// the joint angles -- the compute shader in Robots14Dispatch( ) turns them into
+	// the m1g, m2g, and m3g matrices of every robot's arms:
 
 	float rot1 = (float)Time;
 	float rot2 = 2.f * rot1;
 	float rot3 = 2.f * rot2;
-	glm::vec3 zaxis = glm::vec3(0., 0., 1.);
-	glm::mat4 m1g = glm::mat4(1.); // identity
-	m1g = glm::translate(m1g, glm::vec3(0., 0., 0.));
-	m1g = glm::rotate(m1g, rot1, zaxis); // [T]*[R]
-	glm::mat4 m21 = glm::mat4(1.); // identity
-	m21 = glm::translate(m21, glm::vec3(2. * Arm1.armScale, 0., 0.));
-	m21 = glm::rotate(m21, rot2, zaxis); // [T]*[R]
-	m21 = glm::translate(m21, glm::vec3(0., 0., 2.)); // z-offset from previous arm
-	glm::mat4 m32 = glm::mat4(1.); // identity
-	m32 = glm::translate(m32, glm::vec3(2. * Arm2.armScale, 0., 0.));
-	m32 = glm::rotate(m32, rot3, zaxis); // [T]*[R]
-	m32 = glm::translate(m32, glm::vec3(0., 0., 2.)); // z-offset from previous arm
-	Arm1.armMatrix = m1g; // m1g
-	Arm2.armMatrix = m1g * m21; // m2g
-	Arm3.armMatrix = m1g * m21 * m32; // m3g
+	RobotAngles = glm::vec3( rot1, rot2, rot3 );
 
 
 }
@@ -4287,20 +5404,33 @@ InitGLFW( )
 	glfwInit( );
 
 	glfwWindowHint( GLFW_CLIENT_API, GLFW_NO_API );
-	glfwWindowHint( GLFW_RESIZABLE, GLFW_FALSE );
+	glfwWindowHint( GLFW_RESIZABLE, GLFW_TRUE );		// RenderScene( ) re-makes the swapchain when it changes
 	MainWindow = glfwCreateWindow( Width, Height, "Vulkan Sample", NULL, NULL );
 
 	uint32_t count;
 	const char ** extensions = glfwGetRequiredInstanceExtensions (&count);
-	fprintf( FpDebug, "\nFound %d GLFW Required Instance Extensions:\n", count );
+	LOG_INFO( "\nFound %d GLFW Required Instance Extensions:\n", count );
 	for( uint32_t i = 0; i < count; i++ )
 	{
-		fprintf( FpDebug, "\t%s\n", extensions[ i ] );
+		LOG_INFO( "\t%s\n", extensions[ i ] );
 	}
 
 	glfwSetKeyCallback( MainWindow, GLFWKeyboard );
 	glfwSetCursorPosCallback( MainWindow, GLFWMouseMotion );
 	glfwSetMouseButtonCallback( MainWindow, GLFWMouseButton );
+	glfwSetFramebufferSizeCallback( MainWindow, GLFWFramebufferSize );
+}
+
+
+// the window got resized -- the next RenderScene( ) re-makes the swapchain:
+
+void
+GLFWFramebufferSize( GLFWwindow * window, int width, int height )
+{
+	(void)window;		// Recreate08Swapchain( ) asks the surface for the new extent itself
+	(void)width;
+	(void)height;
+	FramebufferResized = true;
 }
 
 
@@ -4312,21 +5442,42 @@ InitGLFWSurface( )
 }
 
 
+// elapsed seconds -- headless, glfwInit( ) never gets called, so this uses steady_clock instead:
+
+double
+GLFWGetTime( )
+{
+	if( ! Headless )
+		return glfwGetTime( );
+
+	static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+	return std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+}
+
+
 
 void
 GLFWErrorCallback( int error, const char * description )
 {
-	fprintf( FpDebug, "GLFW Error = %d: '%s'\n", error, description );
+	LOG_INFO( "GLFW Error = %d: '%s'\n", error, description );
 }
 
 
 void
 GLFWKeyboard( GLFWwindow * window, int key, int scancode, int action, int mods )
 {
+	NoteInput( );
+
 	if( action == GLFW_PRESS )
 	{
 		switch( key )
 		{
+			case 'f':
+			case 'F':
+				SerializeFrames = ! SerializeFrames;
+				ResetFrameStats( );
+				break;
+
 			case 'i':
 			case 'I':
 				UseIndexBuffer = ! UseIndexBuffer;
@@ -4340,7 +5491,7 @@ GLFWKeyboard( GLFWwindow * window, int key, int scancode, int action, int mods )
 			case 'm':
 			case 'M':
 				Mode++;
-				if( Mode >= 2 )
+				if( Mode >= NUM_MODES )
 					Mode = 0;
 				break;
 
@@ -4359,6 +5510,18 @@ GLFWKeyboard( GLFWwindow * window, int key, int scancode, int action, int mods )
 			case 'R':
 				UseRotate = ! UseRotate;
 				break;
+
+			case 's':
+			case 'S':
+				LatencyPolicy = ( LatencyPolicy + 1 ) % NUM_LATENCY_POLICIES;
+				LatencyPolicyChanged = true;
+				fprintf( stderr, "Present mode: %s\n", LatencyPolicies[LatencyPolicy].name );
+				break;
+
+			case 't':
+			case 'T':
+				Stream07EvictAll( );		// watch the placeholder show up, then the textures stream back in
+				break;
 		
 			case 'v':
 			case 'V':
@@ -4366,9 +5529,8 @@ GLFWKeyboard( GLFWwindow * window, int key, int scancode, int action, int mods )
 				break;
 
 			default:
-				fprintf( FpDebug, "Unknown key hit: 0x%04x = '%c'\n", key, key );
+				LOG_INFO( "Unknown key hit: 0x%04x = '%c'\n", key, key );
 				fprintf( stderr,  "Unknown key hit: 0x%04x = '%c'\n", key, key );
-				fflush(FpDebug);
 		}
 	}
 }
@@ -4381,7 +5543,9 @@ GLFWKeyboard( GLFWwindow * window, int key, int scancode, int action, int mods )
 void
 GLFWMouseButton( GLFWwindow *window, int button, int action, int mods )
 {
-	if( Verbose )		fprintf( FpDebug, "Mouse button = %d; Action = %d\n", button, action );
+	NoteInput( );
+
+	LOG_DEBUG( "Mouse button = %d; Action = %d\n", button, action );
 
 	int b = 0;		// LEFT, MIDDLE, or RIGHT
 
@@ -4401,7 +5565,7 @@ GLFWMouseButton( GLFWwindow *window, int button, int action, int mods )
 
 		default:
 			b = 0;
-			fprintf( FpDebug, "Unknown mouse button: %d\n", button );
+			LOG_INFO( "Unknown mouse button: %d\n", button );
 	}
 
 
@@ -4429,6 +5593,9 @@ GLFWMouseButton( GLFWwindow *window, int button, int action, int mods )
 void
 GLFWMouseMotion( GLFWwindow *window, double xpos, double ypos )
 {
+	if( ActiveButton != 0 )
+		NoteInput( );			// only a drag changes the scene
+
 	int dx = (int)xpos - Xmouse;		// change in mouse coords
 	int dy = (int)ypos - Ymouse;
 